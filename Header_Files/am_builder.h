@@ -0,0 +1,103 @@
+/* Header_Files/am_builder.h */
+#ifndef AM_BUILDER_H
+#define AM_BUILDER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "structs.h"
+
+#define MAX_EXPANSION_THREADS 8          /* threads building one .am file */
+#define PARALLEL_AM_MIN_PIECES (1 << 14) /* fewer pieces are measured by the calling thread */
+#define PARALLEL_AM_MIN_BYTES (1 << 20)  /* smaller .am files are copied by the calling thread */
+
+/*
+ * The .am file is planned first and built afterwards. While the source is
+ * read, every line becomes a piece of the plan: its own text (comments
+ * stripped), or a macro expansion written one or more times (a call).
+ * Each expansion is rendered once, so
+ * the length of every piece is known. The pieces are split among threads
+ * that add up the lengths of their share, and a prefix sum over the shares
+ * and then within each share gives every piece its offset in the file.
+ * The file is then split into equal byte ranges, and each thread copies
+ * the pieces (or parts of pieces) of its range into one buffer, written
+ * with a single call. The bytes are those of writing the lines one by one.
+ */
+
+/**
+ * @struct AmPiece
+ * @brief A run of source lines, or the copies of one expansion.
+ */
+typedef struct
+{
+    size_t offset; /* of the lines in the text of the plan, for source lines */
+    size_t length; /* bytes of the lines, for source lines */
+    int expansion; /* index of the expansion in the macro table, -1 for source lines */
+    long repeat;   /* copies of the expansion */
+} AmPiece;
+
+/**
+ * @struct AmPlan
+ * @brief The pieces of an .am file, in order.
+ */
+typedef struct
+{
+    AmPiece *pieces;
+    int piece_count;
+    int piece_capacity;
+    char *text; /* the source lines, as written */
+    size_t text_size;
+    size_t text_capacity;
+} AmPlan;
+
+/**
+ * @brief Shares the processors among the files assembled at the same time.
+ *
+ * @param jobs Number of files assembled at the same time (-j).
+ */
+void set_expansion_threads(int jobs);
+
+/**
+ * @brief Prepares an empty plan.
+ *
+ * @param plan Pointer to the plan.
+ */
+void init_am_plan(AmPlan *plan);
+
+/**
+ * @brief Appends the text of a source line, as it is to be written.
+ *
+ * @param plan Pointer to the plan.
+ * @param line The bytes of the line.
+ * @param length Number of bytes.
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+int add_am_line(AmPlan *plan, const char *line, size_t length);
+
+/**
+ * @brief Appends copies of a macro expansion, each of its lines followed by a newline.
+ *
+ * @param plan Pointer to the plan.
+ * @param expansion Index of the expansion in the macro table.
+ * @param repeat Number of copies.
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+int add_am_expansion(AmPlan *plan, int expansion, long repeat);
+
+/**
+ * @brief Builds the bytes of a plan and writes them.
+ *
+ * @param fp The .am file.
+ * @param plan The plan.
+ * @param mcro_table The macro table holding the expansions of the plan.
+ * @return TRUE (1) on success, FALSE (0) on allocation or write failure.
+ */
+int write_am_plan(FILE *fp, const AmPlan *plan, const McroTable *mcro_table);
+
+/**
+ * @brief Releases a plan.
+ *
+ * @param plan Pointer to the plan.
+ */
+void free_am_plan(AmPlan *plan);
+
+#endif /* AM_BUILDER_H */
@@ -0,0 +1,49 @@
+/* Header_Files/batch_io.h */
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <stddef.h>
+
+#define BATCH_IO_RING_SIZE 64 /* operations submitted to the kernel at once */
+
+/**
+ * @struct BatchedWrite
+ * @brief One whole file to be written by write_files.
+ */
+typedef struct
+{
+    const char *path;
+    const char *data;
+    size_t size;
+    int written;      /* set by write_files: TRUE if the file now holds data */
+} BatchedWrite;
+
+/*
+ * On Linux the files of a batch are written through io_uring: the opens of
+ * up to BATCH_IO_RING_SIZE files are submitted with a single system call,
+ * then their writes, then their closes. Where io_uring is not available
+ * (older kernels, other systems, seccomp filters) the same calls fall back
+ * to plain open/write/close, one file at a time.
+ */
+
+/**
+ * @brief Creates (truncates) and writes every file of a batch.
+ *
+ * Safe to call from several threads, the batches are submitted one after another.
+ *
+ * @param files The files, their written flags are filled in.
+ * @param count Number of files.
+ * @return TRUE (1) if every file was written, FALSE (0) otherwise.
+ */
+int write_files(BatchedWrite *files, int count);
+
+/**
+ * @brief Flushes the given files to stable storage, as one barrier.
+ *
+ * @param paths Paths of the files.
+ * @param count Number of files.
+ * @return TRUE (1) if every file was synced, FALSE (0) otherwise.
+ */
+int sync_files(const char *const *paths, int count);
+
+#endif /* BATCH_IO_H */
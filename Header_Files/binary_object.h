@@ -0,0 +1,146 @@
+/* Header_Files/binary_object.h */
+#ifndef BINARY_OBJECT_H
+#define BINARY_OBJECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "structs.h"
+#include "output_builder.h"
+
+/*
+ * Layout of a .obb file (all integers little-endian):
+ *
+ *   BinaryObjectHeader                      (OBB_HEADER_SIZE bytes)
+ *   image    code_words + data_words words  (OBB_WORD_SIZE bytes each)
+ *   padding  up to a 4 byte boundary
+ *   entries  entry_count  BinaryObjectSymbol records, sorted by address
+ *   externs  extern_count BinaryObjectSymbol records, one per reference
+ *
+ * Every field sits at a fixed, naturally aligned offset. A mapped file is
+ * read byte by byte at those offsets, as the writer encodes it, so neither
+ * the byte order nor the structure layout of the host matters; the structures
+ * below hold the decoded values.
+ */
+#define OBB_MAGIC "AOBJ"
+#define OBB_VERSION 1
+#define OBB_HEADER_SIZE 40
+#define OBB_WORD_SIZE 3
+#define OBB_SYMBOL_NAME_SIZE 32
+#define OBB_SYMBOL_SIZE 36
+
+/**
+ * @struct BinaryObjectHeader
+ * @brief Fixed header at the start of a .obb file.
+ */
+typedef struct
+{
+    char magic[4];           /* OBB_MAGIC, not null terminated */
+    uint16_t version;        /* OBB_VERSION */
+    uint16_t header_size;    /* OBB_HEADER_SIZE */
+    uint32_t load_address;   /* address of the first image word (100) */
+    uint32_t code_words;     /* IC - 100 */
+    uint32_t data_words;     /* DC */
+    uint32_t entry_count;
+    uint32_t extern_count;
+    uint32_t image_offset;   /* byte offset of the packed image */
+    uint32_t entries_offset; /* byte offset of the entry table */
+    uint32_t externs_offset; /* byte offset of the extern reference table */
+} BinaryObjectHeader;
+
+/**
+ * @struct BinaryObjectSymbol
+ * @brief A record of the entry or extern table: a label and an address.
+ */
+typedef struct
+{
+    char name[OBB_SYMBOL_NAME_SIZE]; /* null terminated label name */
+    uint32_t address;                /* label address (entries) or usage address (externs) */
+} BinaryObjectSymbol;
+
+/**
+ * @struct BinaryObjectView
+ * @brief A validated, read-only mapping of a .obb file.
+ */
+typedef struct
+{
+    void *base;
+    size_t size;
+    BinaryObjectHeader header;      /* decoded from the mapped bytes */
+    const unsigned char *image;
+    const unsigned char *entries;   /* entry_count records of OBB_SYMBOL_SIZE bytes */
+    const unsigned char *externs;   /* extern_count records of OBB_SYMBOL_SIZE bytes */
+} BinaryObjectView;
+
+/**
+ * @brief Writes the assembled image and its symbol tables into a .obb file.
+ *
+ * Uses the same data as the text writers: the image words of the VirtualPC,
+ * the labels marked as entry (sorted by address) and every word that refers
+ * to an external label.
+ *
+ * @param vpc Pointer to the VirtualPC structure containing the machine code.
+ * @param label_table Pointer to the LabelTable structure containing the labels.
+ * @param filename The base name of the source file (without extension).
+ * @return OUTPUT_WRITTEN if the file was written, OUTPUT_FAILED otherwise.
+ */
+OutputStatus generate_binary_object_file(VirtualPC *vpc, LabelTable *label_table, const char *filename);
+
+/**
+ * @brief Maps a .obb file into memory and validates its header and tables.
+ *
+ * The header is decoded field by field; the tables must end exactly where
+ * the file does.
+ *
+ * @param path Path of the .obb file.
+ * @param view Pointer to the view to fill.
+ * @return TRUE (1) if the file is a valid binary object, FALSE (0) otherwise.
+ */
+int map_binary_object(const char *path, BinaryObjectView *view);
+
+/**
+ * @brief Releases a mapping created by map_binary_object.
+ *
+ * @param view Pointer to the view to release.
+ */
+void unmap_binary_object(BinaryObjectView *view);
+
+/**
+ * @brief Returns the image word at the given index of a mapped binary object.
+ *
+ * @param view Pointer to a mapped binary object.
+ * @param index Word index, 0 is the word at the load address.
+ * @return The 24-bit word value.
+ */
+uint32_t binary_object_word(const BinaryObjectView *view, uint32_t index);
+
+/**
+ * @brief Decodes a record of the entry or extern table of a mapped binary object.
+ *
+ * @param table view->entries or view->externs.
+ * @param index Index of the record in the table.
+ * @param symbol Receives the record, its name null terminated.
+ */
+void binary_object_symbol(const unsigned char *table, uint32_t index, BinaryObjectSymbol *symbol);
+
+/**
+ * @brief Converts filename.obb into filename.ob, filename.ent and filename.ext.
+ *
+ * The .ent and .ext files are only created when their tables are not empty,
+ * exactly like the assembler does.
+ *
+ * @param filename The base name of the files (without extension).
+ * @return TRUE (1) on success, FALSE (0) otherwise.
+ */
+int convert_binary_to_text(const char *filename);
+
+/**
+ * @brief Converts filename.ob, filename.ent and filename.ext into filename.obb.
+ *
+ * The .ent and .ext files are optional, a missing file means an empty table.
+ *
+ * @param filename The base name of the files (without extension).
+ * @return TRUE (1) on success, FALSE (0) otherwise.
+ */
+int convert_text_to_binary(const char *filename);
+
+#endif /* BINARY_OBJECT_H */
@@ -0,0 +1,131 @@
+/* Header_Files/conditional.h */
+#ifndef CONDITIONAL_H
+#define CONDITIONAL_H
+
+#include <stddef.h>
+
+#define MAX_CONDITION_DEPTH 32 /* nested .if blocks */
+#define MAX_SYMBOL_LENGTH 31   /* longest conditional symbol name, as for labels */
+
+/*
+ * Conditional assembly. Symbols come from -D NAME[=value] and from
+ * `.define NAME [value]` / `.undef NAME` lines, in the order they appear;
+ * a symbol defined without a value is 1.
+ *
+ *   .ifdef NAME / .ifndef NAME   whether NAME is defined
+ *   .if EXPR / .elif EXPR        EXPR is [!]operand [op operand], an operand
+ *                                an integer or a symbol (0 if undefined),
+ *                                op one of == != < <= > >=
+ *   .else / .endif
+ *
+ * The directives are evaluated before macros are collected, together with
+ * .include, so a block that is not assembled may hold anything: its lines
+ * are skipped on their first character, without being tokenized, looked up
+ * or validated. Only the conditional directives inside are recognized, to
+ * find where the block ends.
+ */
+
+/**
+ * @struct ConditionalSymbol
+ * @brief A defined symbol and its value.
+ */
+typedef struct
+{
+    char name[MAX_SYMBOL_LENGTH + 1];
+    long value;
+} ConditionalSymbol;
+
+/**
+ * @struct ConditionalBlock
+ * @brief An open .if block.
+ */
+typedef struct
+{
+    int parent_active; /* whether the lines around the block are assembled */
+    int taken;         /* a branch of the block was assembled already */
+    int in_else;       /* past the .else */
+    int line;          /* the .as line of the .if */
+} ConditionalBlock;
+
+/**
+ * @struct Conditions
+ * @brief The symbols and open blocks while a source is expanded.
+ */
+typedef struct
+{
+    ConditionalSymbol *symbols;
+    int symbol_count;
+    int symbol_capacity;
+    ConditionalBlock blocks[MAX_CONDITION_DEPTH];
+    int depth;
+    int floor;  /* blocks opened by the file being read start here */
+    int active; /* whether the current line is assembled */
+    int valid;  /* FALSE once an error was reported */
+} Conditions;
+
+/**
+ * @brief Parses a -D value, NAME or NAME=value.
+ *
+ * @param text The value of the option.
+ * @param name Receives the name, MAX_SYMBOL_LENGTH + 1 bytes.
+ * @param value Receives the value, 1 if none is given.
+ * @return TRUE (1) if the definition is valid, FALSE (0) otherwise.
+ */
+int parse_symbol_definition(const char *text, char *name, long *value);
+
+/**
+ * @brief Checks quickly whether a source may hold a conditional directive.
+ *
+ * @param data The bytes of the source.
+ * @param size Number of bytes.
+ * @return TRUE (1) if one of the directives appears anywhere, FALSE (0) otherwise.
+ */
+int has_conditional_directive(const char *data, size_t size);
+
+/**
+ * @brief Prepares the conditions of a source, with the -D symbols defined.
+ *
+ * @param conditions Pointer to the conditions.
+ * @param defines The -D values, already checked by parse_symbol_definition.
+ * @param define_count Number of values.
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+int init_conditions(Conditions *conditions, char *const *defines, int define_count);
+
+/**
+ * @brief Handles a line if it is a conditional directive.
+ *
+ * Errors are reported at source_line and clear conditions->valid.
+ *
+ * @param conditions Pointer to the conditions.
+ * @param line The line.
+ * @param end The end of the line.
+ * @param source_line The .as line to report errors at.
+ * @return TRUE (1) if the line was a directive (it is not assembled), FALSE (0) otherwise.
+ */
+int handle_conditional_directive(Conditions *conditions, const char *line, const char *end, int source_line);
+
+/**
+ * @brief Starts reading a file: the blocks open so far cannot be closed in it.
+ *
+ * @return The previous floor, for end_conditional_file.
+ */
+int begin_conditional_file(Conditions *conditions);
+
+/**
+ * @brief Ends a file: reports and closes the blocks it left open.
+ *
+ * @param conditions Pointer to the conditions.
+ * @param floor The value begin_conditional_file returned.
+ * @param source_line The .as line to report at (the .include line), 0 for the .as file itself.
+ */
+void end_conditional_file(Conditions *conditions, int floor, int source_line);
+
+/**
+ * @brief Releases the symbols of the conditions.
+ *
+ * @param conditions Pointer to the conditions.
+ */
+void free_conditions(Conditions *conditions);
+
+#endif /* CONDITIONAL_H */
@@ -0,0 +1,114 @@
+/* Header_Files/context.h */
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "structs.h"
+#include "options.h"
+#include "output_builder.h"
+#include "diagnostics.h"
+#include "source_reader.h"
+#include "output_file.h"
+#include "encode_cache.h"
+
+struct ContextPool;
+
+/**
+ * @struct OutputJob
+ * @brief One output writer of an assembly context, submitted as a pool task.
+ */
+typedef struct
+{
+    struct AssemblyContext *context;
+    OutputKind kind;
+} OutputJob;
+
+/**
+ * @struct AssemblyContext
+ * @brief Everything needed to assemble one source file.
+ *
+ * A context is owned by one file from the moment it is acquired until its
+ * last output writer finishes, at which point it goes back to its pool.
+ */
+typedef struct AssemblyContext
+{
+    VirtualPC *vpc;
+    LabelTable label_table;
+    McroTable mcro_table;
+    const AssemblerOptions *options;
+    const char *filename;          /* base name of the source file */
+    SourceBuffer source;           /* the bytes of filename.as, read ahead */
+    int success;                   /* FALSE once any stage failed */
+    DiagnosticSink diagnostics;    /* errors and warnings of the file */
+    int *result;                   /* where to store success when the file is done */
+    OutputJob output_jobs[OUTPUT_KIND_COUNT];
+    OutputBatch outputs;           /* the rendered outputs, with --batch-output */
+    OutputStatus output_status[OUTPUT_KIND_COUNT];
+    int output_requested[OUTPUT_KIND_COUNT];
+    int pending_outputs;           /* writer tasks still running */
+    uint64_t cache_key;            /* hash of the source and options (--cache-dir) */
+    int has_cache_key;             /* TRUE once cache_key was computed */
+    EncodeCache encode_cache;      /* encoded commands, kept from file to file */
+    struct AssemblyContext *next_free;
+    struct ContextPool *owner;
+} AssemblyContext;
+
+/**
+ * @struct ContextPool
+ * @brief A fixed number of assembly contexts shared by the files of a run.
+ */
+typedef struct ContextPool
+{
+    AssemblyContext *contexts;
+    int count;
+    AssemblyContext *free_list;
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+} ContextPool;
+
+/**
+ * @brief Allocates a pool of assembly contexts, each with its own VirtualPC.
+ *
+ * @param pool Pointer to the pool to initialize.
+ * @param count Number of contexts (the number of files assembled at once).
+ * @param options The options shared by every context.
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+int init_context_pool(ContextPool *pool, int count, const AssemblerOptions *options);
+
+/**
+ * @brief Takes a free context from the pool, waiting until one is released.
+ *
+ * The returned context is ready for a new file. Only the words, labels and
+ * macros the previous file used are cleared, so the cost does not depend
+ * on the size of the VirtualPC.
+ *
+ * @param pool Pointer to the pool.
+ * @return Pointer to the acquired context.
+ */
+AssemblyContext *acquire_context(ContextPool *pool);
+
+/**
+ * @brief Marks one output writer of a context as finished.
+ *
+ * @param context Pointer to the context.
+ * @return TRUE (1) if it was the last running writer, FALSE (0) otherwise.
+ */
+int finish_output_job(AssemblyContext *context);
+
+/**
+ * @brief Returns a context to its pool.
+ *
+ * @param context Pointer to the context.
+ */
+void release_context(AssemblyContext *context);
+
+/**
+ * @brief Frees every context of the pool.
+ *
+ * @param pool Pointer to the pool.
+ */
+void destroy_context_pool(ContextPool *pool);
+
+#endif /* CONTEXT_H */
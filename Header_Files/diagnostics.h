@@ -0,0 +1,247 @@
+/* Header_Files/diagnostics.h */
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "globals.h"
+
+#define DIAGNOSTIC_NO_LINE (-1)     /* line number of a diagnostic not tied to a source line */
+#define DIAGNOSTIC_BATCH_SIZE 64    /* records collected before they are written out together */
+#define DIAGNOSTIC_TEXT_SIZE 2048   /* upper bound of one formatted record */
+#define DIAGNOSTIC_WRITER_SIZE 65536 /* bytes buffered before the writer goes to stderr */
+
+/**
+ * @enum DiagnosticFormat
+ * @brief How diagnostics are written (--diagnostics-format).
+ */
+typedef enum
+{
+    DIAGNOSTICS_TEXT,  /* colored human readable lines (default) */
+    DIAGNOSTICS_JSONL, /* one JSON object per line */
+    DIAGNOSTICS_SARIF  /* a single SARIF 2.1.0 log */
+} DiagnosticFormat;
+
+/**
+ * @enum DiagnosticSeverity
+ * @brief Whether a diagnostic record holds an ErrorCode or a WarningCode.
+ */
+typedef enum
+{
+    DIAGNOSTIC_ERROR,
+    DIAGNOSTIC_WARNING
+} DiagnosticSeverity;
+
+/**
+ * @struct Diagnostic
+ * @brief One reported error or warning.
+ */
+typedef struct
+{
+    DiagnosticSeverity severity;
+    int code;                        /* ErrorCode or WarningCode, by severity */
+    int line_number;                 /* line in the file being read (.as or .am), or DIAGNOSTIC_NO_LINE */
+    int source_line;                 /* the .as line it comes from, 0 if unknown */
+    int am_line;                     /* the .am line, 0 if the line was read from the .as file */
+    int expanded;                    /* TRUE if the .am line comes from a macro body */
+    int column_start;                /* 1-based first column of the span, 0 if unknown */
+    int column_end;                  /* 1-based last column of the span, 0 if unknown */
+    const char *file;                /* base name of the source file, NULL outside a file */
+    int has_excerpt;                 /* TRUE if the record highlights part of the line */
+    char excerpt[MAX_LINE_LENGTH];   /* the highlighted text */
+} Diagnostic;
+
+/**
+ * @struct LineOrigin
+ * @brief Where a line of the .am file comes from in the .as file.
+ */
+typedef struct
+{
+    int source_line; /* line of the .as file (the macro call for expanded lines) */
+    int expanded;    /* TRUE if the line is part of a macro body */
+    int expansion;   /* index of the macro expansion in the macro table, -1 for source lines */
+    int mcro_line;   /* index of the line in the macro body */
+} LineOrigin;
+
+/**
+ * @struct DiagnosticSink
+ * @brief Collects the diagnostics of one assembly context and writes them in batches.
+ *
+ * The sink also enforces the error limit: once max_errors errors tied to a
+ * source line were reported, the sink stops and the passes give up on the file.
+ */
+typedef struct
+{
+    const char *file;
+    Diagnostic records[DIAGNOSTIC_BATCH_SIZE];
+    int count;                       /* records waiting to be written */
+    int error_count;
+    int warning_count;
+    int max_errors;                  /* 0 for no limit */
+    int stopped;                     /* TRUE once the limit was reached */
+    int suppressed;                  /* errors dropped after the limit */
+    const char *line;                /* the line being processed, for column spans */
+    LineOrigin *line_origins;        /* origin of every .am line, filled by the preprocessor */
+    int line_origin_count;
+    int line_origin_capacity;
+    int use_line_origins;            /* TRUE once line numbers refer to the .am file */
+    int keep_history;                /* TRUE to keep every record of the file (for the cache) */
+    int silent;                      /* TRUE to only keep records in the history, never writing them */
+    Diagnostic *history;             /* every record of the file, when keep_history is set */
+    int history_count;
+    int history_capacity;
+    pthread_mutex_t lock;            /* output writers of a file report concurrently */
+} DiagnosticSink;
+
+/**
+ * @brief Initializes a sink once, before its first use.
+ *
+ * @param sink Pointer to the sink.
+ */
+void init_diagnostic_sink(DiagnosticSink *sink);
+
+/**
+ * @brief Prepares a sink for a new file.
+ *
+ * @param sink Pointer to the sink.
+ * @param file Base name of the source file.
+ * @param max_errors Number of errors after which the file is abandoned, 0 for no limit.
+ */
+void reset_diagnostic_sink(DiagnosticSink *sink, const char *file, int max_errors);
+
+/**
+ * @brief Makes a sink keep every record of the current file in its history.
+ *
+ * @param sink Pointer to the sink.
+ */
+void keep_diagnostic_history(DiagnosticSink *sink);
+
+/**
+ * @brief Makes a sink collect the records of the current file in its history only.
+ *
+ * Nothing reported to the sink is written out; the caller reads the history.
+ *
+ * @param sink Pointer to the sink.
+ */
+void capture_diagnostics(DiagnosticSink *sink);
+
+/**
+ * @brief Releases the resources of a sink.
+ *
+ * @param sink Pointer to the sink.
+ */
+void destroy_diagnostic_sink(DiagnosticSink *sink);
+
+/**
+ * @brief Selects the output format of every diagnostic written from now on.
+ *
+ * For SARIF this writes the opening of the log.
+ *
+ * @param format The format.
+ */
+void set_diagnostics_format(DiagnosticFormat format);
+
+/**
+ * @brief Writes whatever the diagnostics writer still buffers.
+ *
+ * For SARIF this also closes the log, so it is called once, before the program exits.
+ */
+void close_diagnostics_output(void);
+
+/**
+ * @brief Makes a sink the destination of the diagnostics reported by the calling thread.
+ *
+ * With no sink (NULL) diagnostics go straight to the diagnostics writer.
+ *
+ * @param sink Pointer to the sink, or NULL.
+ */
+void set_current_sink(DiagnosticSink *sink);
+
+/**
+ * @brief Returns the sink of the calling thread, or NULL.
+ */
+DiagnosticSink *get_current_sink(void);
+
+/**
+ * @brief Records a diagnostic in the sink of the calling thread.
+ *
+ * @param severity Error or warning.
+ * @param code The ErrorCode or WarningCode.
+ * @param line_number The source line, or DIAGNOSTIC_NO_LINE.
+ * @param start Start of the highlighted text, or NULL.
+ * @param end End of the highlighted text, or NULL.
+ */
+void report_diagnostic(DiagnosticSeverity severity, int code, int line_number, const char *start, const char *end);
+
+/**
+ * @brief Records a diagnostic saved by an earlier run, as it was reported then.
+ *
+ * The record is not counted against the error limit.
+ *
+ * @param diagnostic Pointer to the saved record (its file is replaced by the current one).
+ */
+void replay_diagnostic(const Diagnostic *diagnostic);
+
+/**
+ * @brief Reports a diagnostic recorded while a line was checked on its own, as found on another line.
+ *
+ * The record is located and counted as if it were reported now; its
+ * columns and highlighted text are kept.
+ *
+ * @param diagnostic Pointer to the recorded diagnostic.
+ * @param line_number The line it applies to, unless the record has no line.
+ */
+void report_recorded_diagnostic(const Diagnostic *diagnostic, int line_number);
+
+/**
+ * @brief Tells the sink of the calling thread which line is being processed.
+ *
+ * Highlighted text inside this line gets a column span in its record.
+ *
+ * @param line The line buffer, or NULL once the pass is done with lines.
+ */
+void set_diagnostic_line(const char *line);
+
+/**
+ * @brief Records where the next line written to the .am file comes from.
+ *
+ * @param source_line The .as line.
+ * @param expansion Index of the macro expansion the line comes from, -1 for a source line.
+ * @param mcro_line Index of the line in the macro body.
+ */
+void add_line_origin(int source_line, int expansion, int mcro_line);
+
+/**
+ * @brief Tells which macro body line an .am line was expanded from.
+ *
+ * @param line_number The .am line.
+ * @param mcro_line Receives the index of the line in the macro body.
+ * @return The index of the macro expansion in the macro table, or -1 if the line is not from a macro body.
+ */
+int get_line_expansion(int line_number, int *mcro_line);
+
+/**
+ * @brief Marks that line numbers reported from now on are .am lines.
+ *
+ * Their .as line is then looked up in the origins added by the preprocessor.
+ */
+void use_line_origins(void);
+
+/**
+ * @brief Checks whether the sink of the calling thread reached its error limit.
+ *
+ * @return TRUE (1) if the current file should be abandoned, FALSE (0) otherwise.
+ */
+int diagnostics_stopped(void);
+
+/**
+ * @brief Hands every collected record of a sink to the diagnostics writer.
+ *
+ * In text mode the writer goes out right away, in a single write; the
+ * machine readable formats stay buffered until the buffer fills up.
+ *
+ * @param sink Pointer to the sink.
+ */
+void flush_diagnostics(DiagnosticSink *sink);
+
+#endif /* DIAGNOSTICS_H */
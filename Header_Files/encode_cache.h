@@ -0,0 +1,93 @@
+/* Header_Files/encode_cache.h */
+#ifndef ENCODE_CACHE_H
+#define ENCODE_CACHE_H
+
+#include "structs.h"
+#include "vpc_utils.h"
+
+#define ENCODE_CACHE_SIZE 1024 /* entries of a cache, a power of two */
+#define ENCODE_KEY_SIZE 64     /* longest key kept, with its terminator */
+
+/*
+ * Generated sources repeat the same instructions over and over, so the
+ * words of a command are cached under a normalized form of it: the command
+ * name and, for each operand, its text if it is a register or an
+ * immediate, or only its addressing mode if it names a label. A label
+ * operand word is a placeholder until fill_addresses_words resolves it, so
+ * the cached words are a template and only the label text of those words
+ * is set at each use.
+ *
+ * The cache is direct mapped: a key replaces whatever its slot held, so it
+ * never grows past ENCODE_CACHE_SIZE entries.
+ */
+
+/**
+ * @struct EncodeCacheEntry
+ * @brief The words of one normalized command.
+ */
+typedef struct
+{
+    char key[ENCODE_KEY_SIZE]; /* "" for an empty slot */
+    Word words[MAX_COMMAND_WORDS];
+    int count;
+} EncodeCacheEntry;
+
+/**
+ * @struct EncodeCache
+ * @brief The encoding cache of one assembly context, kept from file to file.
+ */
+typedef struct
+{
+    EncodeCacheEntry *entries; /* allocated on first use */
+    unsigned long lookups;
+    unsigned long hits;
+} EncodeCache;
+
+/**
+ * @brief Prepares an empty cache.
+ *
+ * @param cache Pointer to the cache.
+ */
+void init_encode_cache(EncodeCache *cache);
+
+/**
+ * @brief Makes a cache the one encode_command uses on the calling thread.
+ *
+ * @param cache Pointer to the cache, or NULL to encode without one.
+ */
+void set_current_encode_cache(EncodeCache *cache);
+
+/**
+ * @brief Returns the cache of the calling thread, or NULL.
+ */
+EncodeCache *get_current_encode_cache(void);
+
+/**
+ * @brief Looks a normalized command up, counting the lookup.
+ *
+ * @param cache Pointer to the cache.
+ * @param key The normalized command.
+ * @return The entry holding its words, or NULL on a miss.
+ */
+const EncodeCacheEntry *find_encoding(EncodeCache *cache, const char *key);
+
+/**
+ * @brief Keeps the words of a normalized command, replacing the entry in its slot.
+ *
+ * Nothing is kept if the entries cannot be allocated.
+ *
+ * @param cache Pointer to the cache.
+ * @param key The normalized command, shorter than ENCODE_KEY_SIZE.
+ * @param words The words, with the label text of placeholder words cleared.
+ * @param count Number of words.
+ */
+void store_encoding(EncodeCache *cache, const char *key, const Word *words, int count);
+
+/**
+ * @brief Releases the entries of a cache.
+ *
+ * @param cache Pointer to the cache.
+ */
+void free_encode_cache(EncodeCache *cache);
+
+#endif /* ENCODE_CACHE_H */
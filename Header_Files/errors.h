@@ -2,114 +2,168 @@
 #ifndef ERRORS_H
 #define ERRORS_H
 
+/*
+ * Every diagnostic is listed once, as X(code, message). The lists expand into
+ * the ErrorCode/WarningCode enums below and into the errors[]/warnings[]
+ * tables in errors.c, so a code is always the index of its own table entry.
+ */
+#define ERROR_LIST(X) \
+    /* General errors */ \
+    X(ERROR_SUCCESS, "Operation completed successfully") \
+    X(ERROR_MEMORY_ALLOCATION, "Not enough memory available to complete operation") \
+    X(ERROR_NULL_POINTER, "Null pointer encountered") \
+    \
+    /* File-related errors */ \
+    X(ERROR_MISSING_AS_FILE, "Missing source file - please provide a .as file") \
+    X(ERROR_FILENAME_TOO_LONG, "File name is too long - please use a shorter name") \
+    X(ERROR_FILE_NOT_EXIST, "Could not find the specified file") \
+    X(ERROR_FILE_WRITE, "Could not write to output file - check permissions") \
+    X(ERROR_FILE_READ, "Could not read from file - check if file exists and permissions") \
+    X(ERROR_FILE_DELETE, "Failed to delete the temporary .am file") \
+    X(ERROR_FILE_PROCESSING, "Error in preprocessing file, cannot continue") \
+    X(ERROR_OBJECT_FILE_CREATE, "Failed to create object file.") \
+    X(ERROR_ENTRY_FILE_CREATE, "Failed to create entry file.") \
+    X(ERROR_EXTERNAL_FILE_CREATE, "Failed to create externals file.") \
+    X(ERROR_BINARY_FILE_CREATE, "Failed to create binary object file.") \
+    X(ERROR_BINARY_FILE_INVALID, "Binary object file is malformed or has an unsupported version.") \
+    X(ERROR_UNKNOWN_OPTION, "Unknown command line option - check the usage in the README") \
+    X(ERROR_INVALID_OPTION_VALUE, "Missing or invalid value for a command line option") \
+    X(ERROR_THREAD_CREATE, "Could not start worker threads") \
+    X(ERROR_SERVER_SOCKET, "Could not listen on the server socket - check the path and permissions") \
+    X(ERROR_SERVER_UNTRUSTED, "The server socket, its directory or its peer belongs to another user - refused") \
+    X(ERROR_WATCH_FAILED, "Could not watch the source files for changes (inotify)") \
+    \
+    /* Line length errors */ \
+    X(ERROR_LINE_TOO_LONG, "Line is too long - maximum length is 80 characters") \
+    \
+    /* Assembly process errors */ \
+    X(ERROR_ASSEMBLY_FAILED, "Assembly process failed, could not generate output file") \
+    X(ERROR_VPC_STORAGE_FULL, "VirtualPC storage is full - cannot store additional data") \
+    X(ERROR_TOO_MANY_ERRORS, "Too many errors - stopped assembling this file (see --max-errors and --fail-fast)") \
+    \
+    /* Macro errors */ \
+    X(ERROR_MCRO_NO_NAME, "Macro is missing a name") \
+    X(ERROR_MCRO_DUPLICATE, "Macro name already exists - use a different name") \
+    X(ERROR_MCRO_BEFORE_DEF, "Trying to use macro before defining it") \
+    X(ERROR_MCRO_TOO_LONG, "Macro name exceeds the maximum allowed length.") \
+    X(ERROR_MCRO_IS_REGISTER, "Macro name cannot be a register name.") \
+    X(ERROR_MCRO_ILLEGAL_CHAR, "Macro name contains an illegal character.") \
+    X(ERROR_MCRO_ILLEGAL_START, "Macro name cannot start with a non-letter character.") \
+    X(ERROR_MCRO_RESERVED_NAME, "Macro name cannot be a reserved word.") \
+    X(ERROR_MCRO_ILLEGAL_NAME, "Invalid macro name - use only letters and numbers") \
+    X(ERROR_MCRO_UNEXPECTED_TEXT, "Unexpected text after macro name. Only the macro name and its parameters, separated by commas, may follow 'mcro'.") \
+    X(ERROR_MACRO_CALL_EXTRA_TEXT, "Macro call must appear alone on the line or be followed only by a comment.") \
+    X(ERROR_MCRO_INVALID_PARAM, "Invalid macro parameter - use a legal, unique name that is not a register or reserved word") \
+    X(ERROR_MCRO_TOO_MANY_PARAMS, "Macro has too many parameters") \
+    X(ERROR_MCRO_ARG_COUNT, "Macro call has the wrong number of arguments") \
+    \
+    /* Include and .incbin errors */ \
+    X(ERROR_INCLUDE_SYNTAX, "Invalid .include - expected a file name in double quotes") \
+    X(ERROR_INCBIN_SYNTAX, "Invalid .incbin - expected a file name in double quotes") \
+    X(ERROR_INCLUDE_NOT_FOUND, "Included file not found next to the including file or in the include path (-I)") \
+    X(ERROR_INCLUDE_CYCLE, "File includes itself, directly or through other included files") \
+    X(ERROR_INCLUDE_TOO_DEEP, "Included files are nested too deeply") \
+    \
+    /* Macro library errors */ \
+    X(ERROR_MLIB_INVALID, "Macro library is not a valid .mlib file (recompile it with --compile-mlib)") \
+    X(ERROR_MLIB_STRAY_LINE, "Only macro definitions may appear in a macro library") \
+    \
+    /* Conditional assembly errors */ \
+    X(ERROR_COND_SYNTAX, "Invalid conditional directive - expected a symbol name or an expression such as NAME == 2") \
+    X(ERROR_COND_WITHOUT_IF, "'.elif', '.else' or '.endif' without a matching '.if' in the same file") \
+    X(ERROR_COND_AFTER_ELSE, "'.elif' or '.else' after the '.else' of the same block") \
+    X(ERROR_COND_UNTERMINATED, "'.if' block without a matching '.endif' in the same file") \
+    X(ERROR_COND_TOO_DEEP, "Conditional blocks are nested too deeply") \
+    X(ERROR_DEFINE_SYNTAX, "Invalid '.define' or '.undef' - expected a symbol name and, for '.define', an optional integer value") \
+    \
+    /* Repeated block errors */ \
+    X(ERROR_REPT_SYNTAX, "Invalid '.rept' - expected a repetition count from 0 to 100000") \
+    X(ERROR_REPT_NESTED, "'.rept' blocks cannot be nested") \
+    X(ERROR_REPT_UNTERMINATED, "'.rept' block without a matching '.endr'") \
+    X(ERROR_ENDR_WITHOUT_REPT, "'.endr' without a matching '.rept'") \
+    \
+    /* Bulk data errors */ \
+    X(ERROR_INVALID_FILL, "Invalid '.fill' or '.space' - expected a count from 0 to 2097152 and, for '.fill', a comma and a value") \
+    \
+    /* Label-related errors */ \
+    X(ERROR_LABEL_TOO_LONG, "Label name is too long - maximum length is 30 characters") \
+    X(ERROR_ILLEGAL_LABEL_START, "Invalid label name - start with letter, use only letters and numbers for the rest") \
+    X(ERROR_ILLEGAL_LABEL_CHAR, "Invalid label name - use only letters and numbers") \
+    X(ERROR_LABEL_IS_RESERVED_WORD, "Invalid label name - cannot use reserved words") \
+    X(ERROR_ILLEGAL_LABEL, "Invalid label name - start with letter, use only letters and numbers") \
+    X(ERROR_LABEL_DUPLICATE, "Duplicate label found - use a different name") \
+    X(ERROR_LABEL_IS_MCRO_NAME, "Label name conflicts with macro name - use a different name") \
+    X(ERROR_UNDEFINED_LABEL, "Label not defined in the file - try declaring it before using") \
+    X(ERROR_UNDEFINED_ENTRY_LABEL, "Label not defined in the file - cannot use as an entry") \
+    X(ERROR_UNDEFINED_LABEL_RELATIVE, "Undefined label - label not found in the label table for relative addressing") \
+    X(ERROR_RELATIVE_ADDRESSING_EXTERNAL_LABEL, "Cannot use relative addressing with an external label") \
+    X(ERROR_RELATIVE_ADDRESSING_TO_DATA, "Relative addressing is not allowed for labels pointing to data.") \
+    X(ERROR_LABEL_USED_IN_SAME_LINE, "Label cannot be used as an operand on the same line it is defined") \
+    X(ERROR_LABEL_NOT_DEFINED_IN_FILE, "Label is already declared as .extern and cannot be redefined") \
+    X(ERROR_LABEL_IS_REGISTER, "Invalid label name - cannot use register names") \
+    X(ERROR_EXTERN_LABEL_CONFLICT, "Extern label conflicts with a label declared in this file") \
+    X(ERROR_LABEL_ALREADY_EXTERN, "Label is already declared as extern and cannot be redefined") \
+    X(ERROR_DUPLICATE_ENTRY_LABEL, "Label is already declared as .entry") \
+    \
+    /* Directive errors */ \
+    X(ERROR_ENTRY_MISSING_LABEL, "Missing label after .entry directive.") \
+    X(ERROR_EXTERN_MISSING_LABEL, "Missing label after .extern directive.") \
+    X(ERROR_ENTRY_INSTEAD_OF_EXTERN, "Invalid use of .entry. Expected .extern instead.") \
+    X(ERROR_ENTRY_EXTRA_TEXT, "Unexpected text after entry label. Only spaces or a comment are allowed.") \
+    X(ERROR_EXTERN_EXTRA_TEXT, "Unexpected text after extern label. Only spaces or a comment are allowed.") \
+    X(ERROR_MAYBE_MEANT_ENTRY, "Unexpected characters after '.entry'. Did you mean '.entry <label>'?") \
+    X(ERROR_MAYBE_MEANT_EXTERN, "Unexpected characters after '.extern'. Did you mean '.extern <label>'?") \
+    \
+    /* Command errors */ \
+    X(ERROR_UNKNOWN_COMMAND, "Unknown command - not recognized by the assembler") \
+    X(ERROR_INVALID_PARAM_COUNT, "Missing parameters - check the command syntax") \
+    X(ERROR_MISSING_COMMA, "Missing comma between parameters - add a comma") \
+    X(ERROR_CONSECUTIVE_COMMAS, "Consecutive commas detected - remove extra commas") \
+    X(ERROR_EXTRA_TEXT_AFTER_COMMAND, "Extra text after command - remove unnecessary text") \
+    X(ERROR_INVALID_DIRECT_OR_REGISTER_OPERAND, "Invalid operand. Expected Direct Addressing or Register Address Direct.") \
+    X(ERROR_INVALID_IMMEDIATE_DIRECT_OR_REGISTER_FIRST_OPERAND, "Invalid first operand. Must be Immediate Address, Direct Addressing, or Register Address Direct.") \
+    X(ERROR_INVALID_IMMEDIATE_DIRECT_OR_REGISTER_SECOND_OPERAND, "Invalid second operand. Must be Immediate Address, Direct Addressing, or Register Address Direct.") \
+    X(ERROR_INVALID_DIRECT_OR_REGISTER_SECOND_OPERAND, "Invalid second operand. Must be Direct Addressing or Register Address Direct.") \
+    X(ERROR_INVALID_DIRECT_FIRST_OPERAND, "Invalid first operand. Must be Direct Addressing.") \
+    X(ERROR_INVALID_RELATIVE_OR_DIRECT_OPERAND, "Invalid operand. Expected Relative Addressing or Direct Addressing.") \
+    X(ERROR_INVALID_IMMEDIATE_OPERAND, "Invalid numeric value. Expected Immediate Address.") \
+    X(ERROR_INVALID_IMMEDIATE_DIRECT_OR_REGISTER_OPERAND, "Invalid operand. Expected Immediate Address, Direct Addressing, or Register Address Direct.") \
+    X(ERROR_INVALID_DATA_REAL_NUMBER, "Invalid numeric value. Expected an integer.") \
+    X(ERROR_NOT_EXTERN_LINE, "Line is not a valid .extern directive.") \
+    X(ERROR_NOT_ENTRY_LINE, "Line is not a valid .entry directive.") \
+    \
+    /* Data storage errors */ \
+    X(ERROR_INVALID_DATA_NO_NUMBER, "Invalid .data directive: Must be followed by at least one number.") \
+    X(ERROR_INVALID_DATA_NON_NUMERIC, "Invalid .data directive: Contains a non-numeric value.") \
+    X(ERROR_INVALID_DATA_TRAILING_COMMA, "Invalid .data directive: Trailing comma detected.") \
+    X(ERROR_INVALID_DATA_UNEXPECTED_CHAR, "Invalid .data directive: Unexpected character found.") \
+    X(ERROR_INVALID_STRING_NO_QUOTE, "Invalid .string directive: Must start with a double quote.") \
+    X(ERROR_INVALID_STRING_MISSING_END_QUOTE, "Invalid .string directive: Missing closing double quote.") \
+    X(ERROR_INVALID_STRING_EXTRA_CHARS, "Invalid .string directive: Unexpected characters after closing quote.") \
+    X(ERROR_INVALID_STORAGE_DIRECTIVE, "Invalid storage instruction. Expected .data or .string directive.") \
+    X(ERROR_INVALID_DATA_MISSING_COMMA, "Invalid .data directive: Missing comma between numbers.") \
+    X(ERROR_INVALID_LABEL_CONTENT, "Label content must be a valid .data/.string directive or a valid command.") \
+    X(ERROR_INVALID_DATA_TOO_LARGE, "Integer in .data directive exceeds 24-bit limit.") \
+    X(ERROR_STRING_NO_VALUE, "Missing string value after .string directive.")
+
+#define WARNING_LIST(X) \
+    X(WARNING_LABEL_BEFORE_EXTERN, "Label before .extern directive is ignored.") \
+    X(WARNING_LABEL_BEFORE_ENTRY, "Label before .entry directive is ignored.") \
+    X(WARNING_REDUNDANT_ENTRY, "Label declared multiple times as .entry.") \
+    X(WARNING_LABEL_RESEMBLES_INVALID_REGISTER, "Label name resembles an invalid register (e.g., r9) — valid registers are r0 to r7 and cannot be used as labels.")
+
+#define DIAGNOSTIC_ENUM_ENTRY(code, message) code,
+
 typedef enum
 {
-    /* General errors */
-    ERROR_SUCCESS,
-    ERROR_MEMORY_ALLOCATION,
-    ERROR_NULL_POINTER,
-
-    /* File-related errors */
-    ERROR_MISSING_AS_FILE,
-    ERROR_FILENAME_TOO_LONG,
-    ERROR_FILE_NOT_EXIST,
-    ERROR_FILE_WRITE,
-    ERROR_FILE_READ,
-    ERROR_FILE_DELETE,
-    ERROR_FILE_PROCESSING,
-    ERROR_OBJECT_FILE_CREATE,
-    ERROR_ENTRY_FILE_CREATE,
-    ERROR_EXTERNAL_FILE_CREATE,
-
-    /* Line length errors */
-    ERROR_LINE_TOO_LONG,
-
-    /* Assembly process errors */
-    ERROR_ASSEMBLY_FAILED,
-    ERROR_VPC_STORAGE_FULL,
-
-    /* Macro errors */
-    ERROR_MCRO_NO_NAME,
-    ERROR_MCRO_DUPLICATE,
-    ERROR_MCRO_BEFORE_DEF,
-    ERROR_MCRO_TOO_LONG,
-    ERROR_MCRO_IS_REGISTER,
-    ERROR_MCRO_ILLEGAL_CHAR,
-    ERROR_MCRO_ILLEGAL_START,
-    ERROR_MCRO_RESERVED_NAME,
-    ERROR_MCRO_ILLEGAL_NAME,
-    ERROR_MCRO_UNEXPECTED_TEXT,
-    ERROR_MACRO_CALL_EXTRA_TEXT,
-
-    /* Label-related errors */
-    ERROR_LABEL_TOO_LONG,
-    ERROR_ILLEGAL_LABEL_START,
-    ERROR_ILLEGAL_LABEL_CHAR,
-    ERROR_LABEL_IS_RESERVED_WORD,
-    ERROR_ILLEGAL_LABEL,
-    ERROR_LABEL_DUPLICATE,
-    ERROR_LABEL_IS_MCRO_NAME,
-    ERROR_UNDEFINED_LABEL,
-    ERROR_UNDEFINED_ENTRY_LABEL,
-    ERROR_UNDEFINED_LABEL_RELATIVE,
-    ERROR_RELATIVE_ADDRESSING_EXTERNAL_LABEL,
-    ERROR_RELATIVE_ADDRESSING_TO_DATA,
-    ERROR_LABEL_USED_IN_SAME_LINE,
-    ERROR_LABEL_NOT_DEFINED_IN_FILE,
-    ERROR_LABEL_IS_REGISTER,
-    ERROR_EXTERN_LABEL_CONFLICT,
-    ERROR_LABEL_ALREADY_EXTERN,
-    ERROR_DUPLICATE_ENTRY_LABEL,
-
-    /* Directive errors */
-    ERROR_ENTRY_MISSING_LABEL,
-    ERROR_EXTERN_MISSING_LABEL,
-    ERROR_ENTRY_INSTEAD_OF_EXTERN,
-    ERROR_ENTRY_EXTRA_TEXT,
-    ERROR_EXTERN_EXTRA_TEXT,
-    ERROR_MAYBE_MEANT_ENTRY,
-    ERROR_MAYBE_MEANT_EXTERN,
-
-    /* Command errors */
-    ERROR_UNKNOWN_COMMAND,
-    ERROR_INVALID_PARAM_COUNT,
-    ERROR_MISSING_COMMA,
-    ERROR_CONSECUTIVE_COMMAS,
-    ERROR_EXTRA_TEXT_AFTER_COMMAND,
-    ERROR_INVALID_DIRECT_OR_REGISTER_OPERAND,
-    ERROR_INVALID_IMMEDIATE_DIRECT_OR_REGISTER_FIRST_OPERAND,
-    ERROR_INVALID_IMMEDIATE_DIRECT_OR_REGISTER_SECOND_OPERAND,
-    ERROR_INVALID_DIRECT_OR_REGISTER_SECOND_OPERAND,
-    ERROR_INVALID_DIRECT_FIRST_OPERAND,
-    ERROR_INVALID_RELATIVE_OR_DIRECT_OPERAND,
-    ERROR_INVALID_IMMEDIATE_OPERAND,
-    ERROR_INVALID_IMMEDIATE_DIRECT_OR_REGISTER_OPERAND,
-    ERROR_INVALID_DATA_REAL_NUMBER,
-    ERROR_NOT_EXTERN_LINE,
-    ERROR_NOT_ENTRY_LINE,
-
-    /* Data storage errors */
-    ERROR_INVALID_DATA_NO_NUMBER,
-    ERROR_INVALID_DATA_NON_NUMERIC,
-    ERROR_INVALID_DATA_TRAILING_COMMA,
-    ERROR_INVALID_DATA_UNEXPECTED_CHAR,
-    ERROR_INVALID_STRING_NO_QUOTE,
-    ERROR_INVALID_STRING_MISSING_END_QUOTE,
-    ERROR_INVALID_STRING_EXTRA_CHARS,
-    ERROR_INVALID_STORAGE_DIRECTIVE,
-    ERROR_INVALID_DATA_MISSING_COMMA,
-    ERROR_INVALID_LABEL_CONTENT,
-    ERROR_INVALID_DATA_TOO_LARGE,
-    ERROR_STRING_NO_VALUE
+    ERROR_LIST(DIAGNOSTIC_ENUM_ENTRY)
+    ERROR_COUNT /* number of error codes, not an error */
 } ErrorCode;
 
 typedef enum
 {
-    /* General warnings */
-    WARNING_LABEL_BEFORE_EXTERN, /* Warns about ignored label before .extern */
-    WARNING_LABEL_BEFORE_ENTRY,
-    WARNING_REDUNDANT_ENTRY, /* Warns if .entry is declared multiple times */
-    WARNING_LABEL_RESEMBLES_INVALID_REGISTER
+    WARNING_LIST(DIAGNOSTIC_ENUM_ENTRY)
+    WARNING_COUNT /* number of warning codes, not a warning */
 } WarningCode;
 
 typedef struct
@@ -7,6 +7,7 @@
 #include "first_pass.h"
 #include "structs.h"
 
+#define INCBIN_WORD_BYTES 3 /* bytes of an .incbin file in each word, least significant first */
 
 /**
  * @brief Validates if a given line is a proper data storage directive (.data or .string) and checks its syntax correctness.
@@ -33,5 +34,31 @@ ErrorCode is_data_storage_instruction(char *line);
  */
 int count_data_or_string_elements(char *line);
 
+/**
+ * @brief Reads the count and value of a .fill N, value or .space N directive.
+ *
+ * Only the two numbers are read, so the directive is checked in the same
+ * time whatever the number of words it reserves.
+ *
+ * @param line The directive, after any label.
+ * @param count Receives the number of words.
+ * @param value Receives the value of every word (0 for .space).
+ * @return ERROR_SUCCESS, ERROR_INVALID_FILL or ERROR_INVALID_DATA_TOO_LARGE.
+ */
+ErrorCode parse_fill_directive(const char *line, long *count, long *value);
+
+/**
+ * @brief Finds the bytes of the file of an .incbin directive.
+ *
+ * The file becomes one word per INCBIN_WORD_BYTES bytes, the last one padded with zeros.
+ *
+ * @param line The directive, after any label, with the path the preprocessor found.
+ * @param data Receives the bytes, mapped for the batch (NULL for an empty file).
+ * @param size Receives the number of bytes.
+ * @return ERROR_SUCCESS, ERROR_INCBIN_SYNTAX, ERROR_INCLUDE_NOT_FOUND or
+ *         ERROR_VPC_STORAGE_FULL if the file holds more words than the image.
+ */
+ErrorCode read_incbin_directive(const char *line, const char **data, size_t *size);
+
 
 #endif /* FIRST_PASS_UTILS_H */
\ No newline at end of file
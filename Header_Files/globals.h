@@ -12,9 +12,12 @@
 #define MAX_LABEL_LENGTH 31
 #define MAX_MCROS 50
 #define MAX_MCRO_LINES 100
+#define MAX_MCRO_PARAMS 8
 
 #define MAX_LABELS 100
 
+#define ASSEMBLER_VERSION "1.5.1" /* part of every cache key, bump when any output changes */
+
 #define TRUE 1
 #define FALSE 0
 
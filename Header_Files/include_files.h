@@ -0,0 +1,129 @@
+/* Header_Files/include_files.h */
+#ifndef INCLUDE_FILES_H
+#define INCLUDE_FILES_H
+
+#include <stddef.h>
+
+#define MAX_INCLUDE_DEPTH 16  /* nested .include directives followed */
+#define INCLUDE_PATH_SIZE 1024 /* longest path of an included file */
+
+/*
+ * `.include "file"` at the start of a line is replaced by the lines of
+ * file, before macros are collected. The file is looked up in the
+ * directory of the file including it, then in the -I directories in
+ * order. An included file is mapped once per batch and shared by every
+ * source that includes it; the mappings are released by
+ * release_included_files once the batch is done.
+ *
+ * Included lines are reported at the .include line of the .as file, as
+ * macro body lines are reported at the call.
+ *
+ * The conditional directives (conditional.h) are evaluated in the same
+ * pass, so an .include inside a block that is not assembled is not read.
+ *
+ * `[label:] .incbin "file"` is looked up the same way and the line is
+ * kept with the path found, so the first pass reads the file (through
+ * load_binary_file, from the same batch-wide mappings) without searching.
+ */
+
+/**
+ * @struct IncludeOptions
+ * @brief The options of the source directives: include path, dependency file and -D symbols.
+ */
+typedef struct
+{
+    char **dirs;         /* -I directories, in order */
+    int dir_count;
+    int dependency_file; /* write file.d for make (-MD) */
+    char **defines;      /* -D NAME[=value], in order */
+    int define_count;
+} IncludeOptions;
+
+/**
+ * @struct IncludedSource
+ * @brief A source with its .include directives replaced by the included lines.
+ */
+typedef struct
+{
+    char *text;               /* the lines, each ending with a newline */
+    size_t size;
+    size_t capacity;
+    int *lines;               /* the .as line of each line of text */
+    int line_count;
+    int line_capacity;
+    const char **files;       /* every included file, once, in the order first included */
+    int file_count;
+    int file_capacity;
+} IncludedSource;
+
+/**
+ * @brief Checks quickly whether a source may hold an .include or .incbin directive.
+ *
+ * @param data The bytes of the source.
+ * @param size Number of bytes.
+ * @return TRUE (1) if ".inc" appears anywhere, FALSE (0) otherwise.
+ */
+int has_include_directive(const char *data, size_t size);
+
+/**
+ * @brief Replaces every .include directive of a source by the lines of the included file.
+ *
+ * The lines of conditional blocks that are not assembled are dropped, with
+ * the conditional directives themselves. Missing files, malformed
+ * directives and cycles are reported at the .as line.
+ *
+ * @param path Path of the source, for the directory of the files it includes.
+ * @param data The bytes of the source.
+ * @param size Number of bytes.
+ * @param options The include path and the -D symbols.
+ * @param out Receives the expanded source, to be freed with free_included_source.
+ * @return TRUE (1) on success, FALSE (0) if an error was reported.
+ */
+int expand_includes(const char *path, const char *data, size_t size, const IncludeOptions *options, IncludedSource *out);
+
+/**
+ * @brief Returns the .as line a line of an expanded source comes from.
+ *
+ * @param source The expanded source, or NULL when the source includes nothing.
+ * @param line The line of the expanded source.
+ * @return The .as line.
+ */
+int included_source_line(const IncludedSource *source, int line);
+
+/**
+ * @brief Releases an expanded source (the included files stay mapped).
+ *
+ * @param source Pointer to the expanded source.
+ */
+void free_included_source(IncludedSource *source);
+
+/**
+ * @brief Writes the make dependencies of a source to base.d (-MD).
+ *
+ * The .am and .ob files depend on base.as and every file it includes, and
+ * each included file gets an empty rule, so deleting one does not break make.
+ *
+ * @param base Base name of the source.
+ * @param source The expanded source, or NULL when the source includes nothing.
+ * @return TRUE (1) on success, FALSE (0) if the file could not be written (the error is printed).
+ */
+int write_dependency_file(const char *base, const IncludedSource *source);
+
+/**
+ * @brief Reads the bytes of an .incbin file, mapped once per batch as included files are.
+ *
+ * @param path The path of the file, as the .incbin line holds it.
+ * @param data Receives the bytes (NULL for an empty file).
+ * @param size Receives the number of bytes.
+ * @return TRUE (1) if the file could be read, FALSE (0) otherwise.
+ */
+int load_binary_file(const char *path, const char **data, size_t *size);
+
+/**
+ * @brief Unmaps the files included during a batch.
+ *
+ * Called once every source of the batch was preprocessed.
+ */
+void release_included_files(void);
+
+#endif /* INCLUDE_FILES_H */
@@ -0,0 +1,156 @@
+/* Header_Files/incremental.h */
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stddef.h>
+#include "structs.h"
+#include "diagnostics.h"
+#include "errors.h"
+
+/*
+ * Incremental reassembly, for editors: the assembled state of a source is
+ * kept line by line, and an edit (a range of lines replaced by new text)
+ * parses and encodes only the new lines. Everything else is derived from
+ * what each line recorded the first time:
+ *
+ * - the words of a line are kept with it, so lines after the edit only
+ *   move when the number of words before them changed;
+ * - the label table is rebuilt from the recorded labels, in order, and the
+ *   labels whose address or type changed are collected;
+ * - only the operand words of edited or moved lines, or naming a changed
+ *   label, are resolved again;
+ * - the label checks of the second pass run again for the edited lines,
+ *   the lines naming a changed label and the .entry lines.
+ *
+ * The text is preprocessed source (as in a .am file). The image, label
+ * table and diagnostics are the same as a full first_pass, second_pass and
+ * fill_addresses_words run over the whole text. A .am file holding a .rept
+ * block is not supported: the words of each line are laid out once, and a
+ * block lays out its body N times.
+ */
+
+/**
+ * @enum LineKind
+ * @brief What a source line put into the image.
+ */
+typedef enum
+{
+    LINE_NONE,   /* nothing: an invalid line */
+    LINE_CODE,   /* command words */
+    LINE_DATA,   /* .data or .string words */
+    LINE_EXTERN, /* an external label */
+    LINE_ENTRY   /* an .entry directive, applied by the second pass */
+} LineKind;
+
+/**
+ * @struct LineRecord
+ * @brief One line of the source and everything the passes derived from it.
+ */
+typedef struct
+{
+    char text[MAX_LINE_LENGTH];        /* the line, as fgets reads it */
+    LineKind kind;
+    char label[MAX_LINE_LENGTH];       /* label defined by the line, "" for none */
+    const char *label_type;            /* "code", "data" or "external" */
+    int label_slot;                    /* where in first_pass_diagnostics the label's own result goes */
+    int register_warning;              /* an external label that looks like a register */
+    Word *words;                       /* the encoded words, before operands are resolved */
+    int word_count;
+    int data_count;                    /* how far the line advances DC */
+    char operands[2][MAX_LINE_LENGTH]; /* operands of a command, as the address words are laid out */
+    int operand_count;
+    int code_offset;                   /* words of code before the line */
+    int data_offset;                   /* DC before the line */
+    int data_word_offset;              /* data words stored before the line */
+    ErrorCode label_error;             /* result of adding the label to the table */
+    Diagnostic *first_pass_diagnostics;
+    int first_pass_count;
+    Diagnostic *second_pass_diagnostics;
+    int second_pass_count;
+    int second_pass_valid;             /* FALSE if the label checks reported an error */
+} LineRecord;
+
+/**
+ * @struct IncrementalAssembly
+ * @brief The assembled state of one source, kept between edits.
+ */
+typedef struct
+{
+    LineRecord *lines;
+    int line_count;
+    int line_capacity;
+    VirtualPC *vpc;                    /* the image, laid out as a full build lays it out */
+    LabelTable label_table;
+    const McroTable *mcro_table;       /* macro names, which labels may not reuse */
+    const char *file;                  /* base name reported with the diagnostics */
+    DiagnosticSink sink;               /* collects the diagnostics of the lines being checked */
+    int code_words;                    /* IC - 100 */
+    int data_count;                    /* DC */
+    int data_words;
+    int storage_full;
+    int success;                       /* TRUE if the source assembles without errors */
+    int lines_parsed;                  /* lines parsed by the last edit */
+    int lines_checked;                 /* lines whose label checks ran again in the last edit */
+    int operands_resolved;             /* operand words resolved by the last edit */
+} IncrementalAssembly;
+
+/**
+ * @brief Parses and encodes one line on its own, as the first pass would.
+ *
+ * The diagnostics of the line are kept in the record instead of being
+ * reported, and the label it defines is recorded but not added to any
+ * table, so the record can be replayed wherever the line appears.
+ *
+ * @param record A zeroed record whose text is set.
+ * @param sink A sink used to collect the diagnostics.
+ * @param file Base name of the source, for the diagnostics.
+ * @param line_number Line number the diagnostics are recorded with.
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+int analyze_line_record(LineRecord *record, DiagnosticSink *sink, const char *file, int line_number);
+
+/**
+ * @brief Releases what a line record holds.
+ *
+ * @param record Pointer to the record.
+ */
+void free_line_record(LineRecord *record);
+
+/**
+ * @brief Starts an empty source; the first edit inserts its text.
+ *
+ * @param state Pointer to the state to initialize.
+ * @param vpc The VirtualPC holding the image.
+ * @param mcro_table The macros of the source (may be empty).
+ * @param file Base name of the source, for the diagnostics.
+ */
+void init_incremental(IncrementalAssembly *state, VirtualPC *vpc, const McroTable *mcro_table, const char *file);
+
+/**
+ * @brief Replaces a range of lines and brings the image, labels and diagnostics up to date.
+ *
+ * @param state Pointer to the state.
+ * @param first_line First line replaced (1-based); line_count + 1 appends.
+ * @param removed Number of lines replaced, 0 to insert.
+ * @param text The new lines, split as fgets splits them.
+ * @param length Length of text.
+ * @return TRUE (1) if the edit was applied (state->success tells whether the source is valid),
+ *         FALSE (0) if the range is outside the source or memory ran out (the state is unchanged).
+ */
+int edit_incremental(IncrementalAssembly *state, int first_line, int removed, const char *text, size_t length);
+
+/**
+ * @brief Reports the diagnostics of the source to the current sink, in the order of a full build.
+ *
+ * @param state Pointer to the state.
+ */
+void report_incremental_diagnostics(const IncrementalAssembly *state);
+
+/**
+ * @brief Releases what the state holds (the VirtualPC stays with the caller).
+ *
+ * @param state Pointer to the state.
+ */
+void free_incremental(IncrementalAssembly *state);
+
+#endif /* INCREMENTAL_H */
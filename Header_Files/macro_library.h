@@ -0,0 +1,188 @@
+/* Header_Files/macro_library.h */
+#ifndef MACRO_LIBRARY_H
+#define MACRO_LIBRARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "structs.h"
+#include "preprocessor_utils.h"
+
+/*
+ * Layout of a .mlib file (all integers little-endian):
+ *
+ *   MacroLibraryHeader                          (MLIB_HEADER_SIZE bytes)
+ *   index       index_capacity slots, a uint32_t macro number each
+ *   macros      macro_count MacroLibraryMacro records
+ *   lines       line_count MacroLibraryLine records, the lines of a macro in a run
+ *   references  reference_count MacroLibraryReference records
+ *   strings     null terminated names and lines
+ *
+ * The index is an open addressing hash of the macro names (FNV-1a, linear
+ * probing, MLIB_EMPTY_SLOT for a free slot). The names were validated and
+ * the parameter names of every body line found when the library was
+ * compiled, so a mapped library is used in place: looking a macro up costs
+ * the same whatever the size of the library, and a call of a macro without
+ * parameters expands to lines of the mapping itself. Every table starts at a
+ * multiple of 4, right after the one before it. The fields are decoded from
+ * their little-endian bytes one record at a time into the structures below,
+ * so a library reads the same on any host, and a damaged offset is rejected
+ * when the library is mapped rather than read out of bounds.
+ */
+#define MLIB_MAGIC "AMLB"
+#define MLIB_VERSION 1
+#define MLIB_HEADER_SIZE 56
+#define MLIB_EMPTY_SLOT 0xFFFFFFFFUL
+
+/**
+ * @struct MacroLibraryHeader
+ * @brief Fixed header at the start of a .mlib file, decoded.
+ */
+typedef struct
+{
+    char magic[4];              /* MLIB_MAGIC, not null terminated */
+    uint16_t version;           /* MLIB_VERSION */
+    uint16_t header_size;       /* MLIB_HEADER_SIZE */
+    uint32_t macro_count;
+    uint32_t index_capacity;    /* slots of the name index, a power of two */
+    uint32_t index_offset;
+    uint32_t macros_offset;
+    uint32_t lines_offset;
+    uint32_t line_count;
+    uint32_t references_offset;
+    uint32_t reference_count;
+    uint32_t strings_offset;
+    uint32_t strings_size;      /* the last byte is a null */
+    uint32_t content_hash[2];   /* hash of everything after the header, low word first */
+} MacroLibraryHeader;
+
+/**
+ * @struct MacroLibraryMacro
+ * @brief A macro of the library.
+ */
+typedef struct
+{
+    uint32_t name;        /* offset of the name in the strings */
+    uint32_t hash;        /* FNV-1a of the name */
+    uint32_t param_count;
+    uint32_t first_line;  /* index of its first MacroLibraryLine */
+    uint32_t line_count;
+} MacroLibraryMacro;
+
+/**
+ * @struct MacroLibraryLine
+ * @brief A body line and the parameter names it holds.
+ */
+typedef struct
+{
+    uint32_t text;            /* offset of the line in the strings */
+    uint32_t first_reference; /* index of its first MacroLibraryReference */
+    uint32_t reference_count;
+} MacroLibraryLine;
+
+/**
+ * @struct MacroLibraryReference
+ * @brief A parameter name in a body line.
+ */
+typedef struct
+{
+    uint16_t start; /* offset of the name in the line */
+    uint8_t length;
+    uint8_t param;  /* index of the parameter */
+} MacroLibraryReference;
+
+/**
+ * @struct MacroLibrary
+ * @brief A validated, read-only mapping of a .mlib file.
+ */
+struct MacroLibrary
+{
+    void *base;
+    size_t size;
+    MacroLibraryHeader header;         /* decoded from the mapped bytes */
+    const unsigned char *index;        /* the encoded tables, in the mapping */
+    const unsigned char *macros;
+    const unsigned char *lines;
+    const unsigned char *references;
+    const char *strings;
+};
+
+/**
+ * @brief Compiles the macros of a source into a macro library.
+ *
+ * filename.as may hold only macro definitions, comments and blank lines;
+ * they are checked as the preprocessor checks them and written to
+ * filename.mlib.
+ *
+ * @param filename Base name of the library source.
+ * @return TRUE (1) on success, FALSE (0) if an error was reported.
+ */
+int compile_macro_library(const char *filename);
+
+/**
+ * @brief Maps macro libraries for a batch of files.
+ *
+ * Only the header and the bounds of the tables are checked, so mapping a
+ * library costs the same whatever its size.
+ *
+ * @param paths The .mlib files, in the order they are searched.
+ * @param count Number of files.
+ * @param libraries Receives the mapped libraries, to be released with unmap_macro_libraries.
+ * @return TRUE (1) on success, FALSE (0) if a file could not be mapped (the error is printed).
+ */
+int map_macro_libraries(char *const *paths, int count, MacroLibrary **libraries);
+
+/**
+ * @brief Unmaps libraries mapped by map_macro_libraries.
+ *
+ * @param libraries The libraries (may be NULL).
+ * @param count Number of libraries.
+ */
+void unmap_macro_libraries(MacroLibrary *libraries, int count);
+
+/**
+ * @brief Looks a macro up by name in a list of libraries.
+ *
+ * @param libraries The libraries, searched in order.
+ * @param count Number of libraries.
+ * @param name The name.
+ * @param library Receives the library defining the macro.
+ * @return The index of the macro in its library, or -1 if no library defines it.
+ */
+int find_library_mcro(const MacroLibrary *libraries, int count, const char *name, const MacroLibrary **library);
+
+/**
+ * @brief Checks that the lines and references of a library macro lie inside its file.
+ *
+ * @return TRUE (1) if the body can be read, FALSE (0) for a damaged file.
+ */
+int check_library_mcro(const MacroLibrary *library, int mcro);
+
+/**
+ * @brief Returns the number of parameters of a library macro.
+ */
+int library_mcro_param_count(const MacroLibrary *library, int mcro);
+
+/**
+ * @brief Returns the number of body lines of a library macro.
+ */
+int library_mcro_line_count(const MacroLibrary *library, int mcro);
+
+/**
+ * @brief Returns a body line of a library macro, in the mapping.
+ */
+const char *library_mcro_line(const MacroLibrary *library, int mcro, int line);
+
+/**
+ * @brief Reads the parameter references of a body line of a library macro.
+ *
+ * @param references Receives the references in order, room for MAX_PARAM_REFERENCES.
+ * @return The number of references.
+ */
+int library_line_references(const MacroLibrary *library, int mcro, int line, ParamReference *references);
+
+/**
+ * @brief Returns the hash of the contents of a library, for cache keys.
+ */
+uint64_t macro_library_hash(const MacroLibrary *library);
+
+#endif /* MACRO_LIBRARY_H */
@@ -0,0 +1,76 @@
+/* Header_Files/mcro_template.h */
+#ifndef MCRO_TEMPLATE_H
+#define MCRO_TEMPLATE_H
+
+#include "structs.h"
+#include "globals.h"
+#include "diagnostics.h"
+#include "incremental.h"
+
+/*
+ * Every call of a macro with the same arguments (every call, for a macro
+ * without parameters) expands to the same lines, one McroExpansion of the
+ * macro table, and those lines encode to the same words. The first pass
+ * parses and encodes an expansion once, at its first call, into one
+ * LineRecord per body line (its words, the label it defines, its operands
+ * and its diagnostics).
+ *
+ * What is shared is the work on each line, not a copy per call: the calls
+ * are still expanded as text in the .am file, and the first pass reads
+ * every expanded line, matches it to its record (through the line origins
+ * and a comparison of the text), copies that line's words into the image
+ * and replays the rest at the line. Label references are resolved later
+ * by fill_addresses_words from the text of the line, as for any other line.
+ */
+
+/**
+ * @struct McroTemplate
+ * @brief One macro expansion, parsed and encoded.
+ */
+typedef struct
+{
+    LineRecord *lines; /* one record per body line, NULL until the first call */
+    int line_count;
+} McroTemplate;
+
+/**
+ * @struct McroTemplateTable
+ * @brief The templates of the macros of one file.
+ */
+typedef struct
+{
+    McroTemplate *templates; /* one per expansion of the macro table, grown as they are used */
+    int template_count;
+    const McroTable *mcro_table;
+    const char *file;
+    DiagnosticSink sink; /* collects the diagnostics of body lines */
+    int failed;          /* TRUE once a template could not be built */
+} McroTemplateTable;
+
+/**
+ * @brief Prepares an empty template table for the macros of a file.
+ *
+ * @param table Pointer to the table.
+ * @param mcro_table The macros of the file.
+ */
+void init_mcro_templates(McroTemplateTable *table, const McroTable *mcro_table);
+
+/**
+ * @brief Finds the encoded body line an .am line was expanded from, encoding the macro on first use.
+ *
+ * @param table Pointer to the table.
+ * @param line_number The .am line.
+ * @param line The text of the line, as read from the .am file.
+ * @return The record of the body line, or NULL if the line is not from a macro body
+ *         (or does not read as its body line) and must be processed as usual.
+ */
+const LineRecord *find_mcro_template_line(McroTemplateTable *table, int line_number, const char *line);
+
+/**
+ * @brief Releases the templates.
+ *
+ * @param table Pointer to the table.
+ */
+void free_mcro_templates(McroTemplateTable *table);
+
+#endif /* MCRO_TEMPLATE_H */
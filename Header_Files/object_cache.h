@@ -0,0 +1,61 @@
+/* Header_Files/object_cache.h */
+#ifndef OBJECT_CACHE_H
+#define OBJECT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "context.h"
+
+/*
+ * Cache entries live in <cache dir>/<16 hex digit key>/ and hold a copy of
+ * every output of a successful assembly ("am", "ob", "ent", "ext", "obb",
+ * "obz"), the diagnostics it reported ("diagnostics") and, written last,
+ * the status of every output ("manifest"). An entry is built in a temporary
+ * directory and renamed into place, so a visible entry is always complete.
+ */
+
+/**
+ * @brief Computes the 64-bit hash used for cache keys (the XXH64 algorithm).
+ *
+ * @param data Bytes to hash.
+ * @param length Number of bytes.
+ * @param seed Starting value, different seeds give unrelated hashes.
+ * @return The hash.
+ */
+uint64_t hash_bytes(const void *data, size_t length, uint64_t seed);
+
+/**
+ * @brief Computes the cache key of the source file of a context.
+ *
+ * The key covers the bytes of filename.as, the assembler version and the
+ * options that change which outputs are written. On success the key is
+ * stored in the context.
+ *
+ * @param context Pointer to the context (filename and options are used).
+ * @return TRUE (1) on success, FALSE (0) if the source could not be read.
+ */
+int compute_cache_key(AssemblyContext *context);
+
+/**
+ * @brief Restores the outputs of a context from the cache.
+ *
+ * On a hit the cached files are copied (or reflinked) next to the source,
+ * the -MD dependency file is written (the preprocessor that would write it
+ * does not run), the cached diagnostics are replayed into the current sink and the output
+ * statuses of the context are filled in, ready for report_output.
+ *
+ * @param context Pointer to the context, with its cache key computed.
+ * @return TRUE (1) on a hit, FALSE (0) on a miss (nothing was changed).
+ */
+int restore_cached_outputs(AssemblyContext *context);
+
+/**
+ * @brief Stores the outputs and diagnostics of a successfully assembled context.
+ *
+ * Failures are silent: the cache is only an optimization.
+ *
+ * @param context Pointer to the context, after all its writers finished.
+ */
+void store_cached_outputs(const AssemblyContext *context);
+
+#endif /* OBJECT_CACHE_H */
@@ -0,0 +1,77 @@
+/* options.h */
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "diagnostics.h"
+#include "include_files.h"
+
+/**
+ * @enum RunMode
+ * @brief Selects what the program does with the file names it was given.
+ */
+typedef enum
+{
+    MODE_ASSEMBLE,    /* assemble .as files (default) */
+    MODE_OBB_TO_TEXT, /* convert .obb binary objects to .ob/.ent/.ext */
+    MODE_TEXT_TO_OBB, /* convert .ob/.ent/.ext text outputs to .obb */
+    MODE_EXPAND_OBZ,  /* expand run-length compressed .obz files to .ob */
+    MODE_COMPILE_MLIB /* compile the macros of .as files into .mlib macro libraries */
+} RunMode;
+
+/**
+ * @struct AssemblerOptions
+ * @brief Holds the command line options and the list of input file names.
+ */
+typedef struct
+{
+    RunMode mode;
+    int binary_object;     /* also write the .obb binary object when assembling */
+    int compressed_object; /* also write the run-length compressed .obz object */
+    int jobs;              /* number of files assembled at the same time (-j) */
+    int max_errors;        /* errors reported before a file is abandoned, 0 for no limit */
+    int fail_fast;         /* stop a file at its first error, skipping the second pass and outputs */
+    DiagnosticFormat diagnostics_format; /* text, jsonl or sarif (--diagnostics-format) */
+    const char *cache_dir; /* directory of cached outputs (--cache-dir), NULL for none */
+    int write_if_changed;  /* leave output files whose contents did not change untouched */
+    int batch_output;      /* write the outputs of a file together, through io_uring where available */
+    int fsync;             /* sync every output file once, at the end of the run */
+    int watch;             /* assemble again whenever a source changes (--watch) */
+    int serve;             /* run as a server on a UNIX domain socket (--serve) */
+    int client;            /* hand the command line to a running server (--client) */
+    const char *socket_path; /* socket of --serve/--client, NULL for the default */
+    int stats;             /* print instrumentation counters after each run (--stats) */
+    IncludeOptions includes; /* the -I directories and -MD */
+    char **mlibs;          /* macro libraries (--mlib), searched in order */
+    int mlib_count;
+    char **files;          /* input file names (point into argv or lists), or directories with --watch */
+    int file_count;
+    int file_capacity;
+    char **lists;          /* contents of the @listfile and --files0-from files, owning their names */
+    int list_count;
+} AssemblerOptions;
+
+/**
+ * @brief Parses the command line into an options structure.
+ *
+ * Arguments starting with '-' are treated as options, everything else is an
+ * input file name. An argument "@listfile" adds the names listed in
+ * listfile, one per line, and "--files0-from=FILE" the NUL-separated names
+ * in FILE ("-" for stdin), so batches of any size fit on the command line.
+ * Unknown options, invalid option values and unreadable lists are reported
+ * and make the parse fail.
+ *
+ * @param argc Argument count as received by main.
+ * @param argv Argument vector as received by main.
+ * @param options Pointer to the options structure to fill.
+ * @return TRUE (1) if the command line is valid, FALSE (0) otherwise.
+ */
+int parse_options(int argc, char *argv[], AssemblerOptions *options);
+
+/**
+ * @brief Releases memory owned by an options structure.
+ *
+ * @param options Pointer to the options structure.
+ */
+void free_options(AssemblerOptions *options);
+
+#endif /* OPTIONS_H */
@@ -1,8 +1,34 @@
 #ifndef OUTPUT_BUILDER_H
 #define OUTPUT_BUILDER_H
 
+#include <stdio.h>
 #include "structs.h"
 
+/**
+ * @enum OutputKind
+ * @brief The output files that can be generated from an assembled image.
+ */
+typedef enum
+{
+    OUTPUT_OBJECT,     /* .ob */
+    OUTPUT_ENTRY,      /* .ent */
+    OUTPUT_EXTERNALS,  /* .ext */
+    OUTPUT_BINARY,     /* .obb */
+    OUTPUT_COMPRESSED, /* .obz */
+    OUTPUT_KIND_COUNT
+} OutputKind;
+
+/**
+ * @enum OutputStatus
+ * @brief The result of writing one output file.
+ */
+typedef enum
+{
+    OUTPUT_FAILED,     /* the file could not be written (error already printed) */
+    OUTPUT_WRITTEN,    /* the file was written */
+    OUTPUT_NOT_NEEDED  /* nothing to write, the file was not created */
+} OutputStatus;
+
 /**
  * @brief Writes the assembled machine code into a .ob file.
  *
@@ -12,8 +38,35 @@
  *
  * @param vpc Pointer to the VirtualPC structure containing the machine code.
  * @param filename The name of the .am file (without extension).
+ * @return OUTPUT_WRITTEN on success, OUTPUT_FAILED otherwise.
  */
-void generate_object_file(VirtualPC *vpc, const char *filename);
+OutputStatus generate_object_file(VirtualPC *vpc, const char *filename);
+
+/**
+ * @brief Writes the machine code into a run-length compressed .obz file.
+ *
+ * The first line is the same as in the .ob file. Every following line is a
+ * record "address value" for a single word, or "address value *length" for a
+ * run of length equal words starting at address, so long zeroed buffers and
+ * repeated data collapse into one line.
+ *
+ * @param vpc Pointer to the VirtualPC structure containing the machine code.
+ * @param filename The name of the source file (without extension).
+ * @return OUTPUT_WRITTEN on success, OUTPUT_FAILED otherwise.
+ */
+OutputStatus generate_compressed_object_file(VirtualPC *vpc, const char *filename);
+
+/**
+ * @brief Expands filename.obz into the equivalent filename.ob.
+ *
+ * The .ob file is written as filename.ob.tmp and renamed over filename.ob
+ * once the whole .obz file decoded, so a malformed .obz file leaves an
+ * existing .ob file untouched.
+ *
+ * @param filename The base name of the files (without extension).
+ * @return TRUE (1) on success, FALSE (0) if the .obz file is missing or malformed.
+ */
+int expand_compressed_object_file(const char *filename);
 
 /**
  * @brief Comparison function for sorting labels by address.
@@ -29,8 +82,9 @@ int compare_labels_by_address(const void *a, const void *b);
  *
  * @param label_table Pointer to the LabelTable structure containing label data.
  * @param filename The name of the .am file (without extension).
+ * @return OUTPUT_WRITTEN, OUTPUT_NOT_NEEDED if there are no entry labels, or OUTPUT_FAILED.
  */
-void generate_entry_file(LabelTable *label_table, const char *filename);
+OutputStatus generate_entry_file(LabelTable *label_table, const char *filename);
 
 /**
  * @brief Writes the external labels into a .ext file.
@@ -43,14 +97,73 @@ void generate_entry_file(LabelTable *label_table, const char *filename);
  * @param vpc Pointer to the VirtualPC structure containing machine code.
  * @param label_table Pointer to the LabelTable structure containing labels.
  * @param filename The name of the .am file (without extension).
+ * @return OUTPUT_WRITTEN, OUTPUT_NOT_NEEDED if there are no extern references, or OUTPUT_FAILED.
+ */
+OutputStatus generate_externals_file(VirtualPC *vpc, LabelTable *label_table, const char *filename);
+
+/**
+ * @brief Writes one kind of output file from the assembled image.
+ *
+ * The writers only read the VirtualPC and the LabelTable, so once
+ * fill_addresses_words has finished any number of them can run at the same
+ * time. They print errors but leave the success messages to report_output,
+ * so the messages can be printed in a fixed order.
+ *
+ * @param kind The output file to write.
+ * @param vpc Pointer to the VirtualPC structure containing the machine code.
+ * @param label_table Pointer to the LabelTable structure containing labels.
+ * @param filename The name of the source file (without extension).
+ * @return The status of the written file.
+ */
+OutputStatus generate_output(OutputKind kind, VirtualPC *vpc, LabelTable *label_table, const char *filename);
+
+/**
+ * @brief Prints the result of writing one kind of output file.
+ *
+ * @param kind The output file that was written.
+ * @param status The status returned by generate_output.
+ * @param filename The name of the source file (without extension).
+ */
+void report_output(OutputKind kind, OutputStatus status, const char *filename);
+
+/**
+ * @brief Returns the file extension of one kind of output file, without the dot.
+ *
+ * @param kind The output file.
+ * @return The extension ("ob", "ent", ...).
+ */
+const char *output_extension(OutputKind kind);
+
+/**
+ * @brief Finds the operands of a command line, as the address words are laid out.
+ *
+ * @param line The source line (a label before the command is skipped).
+ * @param params Receives the operands, as written.
+ * @return The number of operands, or -1 if the line is not a command.
+ */
+int split_command_operands(char *line, char params[2][MAX_LINE_LENGTH]);
+
+/**
+ * @brief Resolves the word of one operand against the label table.
+ *
+ * A direct label operand becomes the label address with its A/R/E bits, a
+ * relative one (&label) the distance from the command; other operands and
+ * unknown labels leave the word as it is.
+ *
+ * @param word The operand word, as encoded by the first pass.
+ * @param param The operand.
+ * @param address Address of the operand word.
+ * @param label_table Pointer to the label table.
  */
-void generate_externals_file(VirtualPC *vpc, LabelTable *label_table, const char *filename);
+void resolve_operand_word(Word *word, const char *param, int address, LabelTable *label_table);
 
 /**
  * @brief fills address words for label operands in the virtual pc.
  *
  * processes the .am file, resolves direct and relative label references,
- * and updates instruction words in the virtual pc accordingly.
+ * and updates instruction words in the virtual pc accordingly. the body of
+ * a .rept block is read once per iteration, as the first pass laid out its
+ * copies one after the other.
  *
  * @param am_file pointer to the .am file
  * @param label_table pointer to the label table
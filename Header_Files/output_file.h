@@ -0,0 +1,152 @@
+/* Header_Files/output_file.h */
+#ifndef OUTPUT_FILE_H
+#define OUTPUT_FILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "globals.h"
+#include "batch_io.h"
+
+#define OUTPUT_BATCH_CAPACITY 8 /* files one assembly context writes */
+
+/**
+ * @struct OutputFile
+ * @brief An output file being written, directly or rendered in memory first.
+ *
+ * Writers print into fp either way. In write-if-changed mode fp is a memory
+ * stream, and closing the file compares the rendering with the file on disk:
+ * an identical file is left untouched (keeping its timestamp), a different
+ * one is replaced atomically by writing a temporary file and renaming it.
+ * Files closed while the thread has an output batch are also rendered in
+ * memory, and written together when the batch is flushed.
+ */
+typedef struct
+{
+    FILE *fp;                              /* the stream the writer prints to */
+    char path[MAX_FILENAME_LENGTH + 5];    /* the file being written */
+    char *buffer;                          /* the rendering, when in memory */
+    size_t size;
+    int in_memory;
+} OutputFile;
+
+/**
+ * @struct OutputBatch
+ * @brief The rendered output files of one assembly context, written together.
+ */
+typedef struct
+{
+    BatchedWrite files[OUTPUT_BATCH_CAPACITY];
+    char paths[OUTPUT_BATCH_CAPACITY][MAX_FILENAME_LENGTH + 5];
+    int count;
+    pthread_mutex_t lock;                  /* the writers of a context close their files concurrently */
+} OutputBatch;
+
+/**
+ * @brief Selects whether output files are only replaced when their contents change.
+ *
+ * Called once, before any file is written.
+ *
+ * @param enabled TRUE to render outputs in memory and compare them with the existing files.
+ */
+void set_write_if_changed(int enabled);
+
+/**
+ * @brief Selects whether the output writers of a context hand their files to one batch.
+ *
+ * Called once, before any file is written.
+ *
+ * @param enabled TRUE to write the outputs of each context together (io_uring where available).
+ */
+void set_batched_output(int enabled);
+
+/**
+ * @brief Selects whether the files written are remembered for sync_output_files.
+ *
+ * Called once, before any file is written.
+ *
+ * @param enabled TRUE to sync every output at the end of the run.
+ */
+void set_sync_outputs(int enabled);
+
+/**
+ * @brief Records that an output file was written outside of OutputFile (such as a cache copy).
+ *
+ * @param path Path of the file.
+ */
+void note_output_written(const char *path);
+
+/**
+ * @brief Flushes every output file written so far to stable storage, as one barrier.
+ *
+ * @return TRUE (1) if every file was synced (or syncing is off), FALSE (0) otherwise.
+ */
+int sync_output_files(void);
+
+/**
+ * @brief Initializes a batch once, before its first use.
+ *
+ * @param batch Pointer to the batch.
+ */
+void init_output_batch(OutputBatch *batch);
+
+/**
+ * @brief Empties a batch for the outputs of a new file.
+ *
+ * @param batch Pointer to the batch.
+ */
+void clear_output_batch(OutputBatch *batch);
+
+/**
+ * @brief Releases the resources of a batch.
+ *
+ * @param batch Pointer to the batch.
+ */
+void destroy_output_batch(OutputBatch *batch);
+
+/**
+ * @brief Makes a batch the destination of the output files closed by the calling thread.
+ *
+ * @param batch Pointer to the batch, or NULL to write files as they are closed.
+ */
+void set_current_output_batch(OutputBatch *batch);
+
+/**
+ * @brief Writes every file of a batch and frees their renderings.
+ *
+ * A file that could not be written is reported with ERROR_FILE_WRITE; the
+ * result of each file stays available to output_batch_wrote until the batch
+ * is cleared.
+ *
+ * @param batch Pointer to the batch.
+ * @return TRUE (1) if every file was written, FALSE (0) otherwise.
+ */
+int flush_output_batch(OutputBatch *batch);
+
+/**
+ * @brief Checks whether the last flush of a batch failed to write the given file.
+ *
+ * @param batch Pointer to the batch.
+ * @param path Path of the file.
+ * @return TRUE (1) if the file was in the batch and not written, FALSE (0) otherwise.
+ */
+int output_batch_failed(const OutputBatch *batch, const char *path);
+
+/**
+ * @brief Starts writing an output file.
+ *
+ * @param file Pointer to the output file.
+ * @param path Path of the file.
+ * @return TRUE (1) on success, FALSE (0) if the file or memory stream could not be opened.
+ */
+int open_output_file(OutputFile *file, const char *path);
+
+/**
+ * @brief Finishes an output file, writing it out if needed.
+ *
+ * @param file Pointer to the output file.
+ * @return TRUE (1) if the file on disk now holds what was written, FALSE (0) otherwise.
+ */
+int close_output_file(OutputFile *file);
+
+#endif /* OUTPUT_FILE_H */
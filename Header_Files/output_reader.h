@@ -0,0 +1,117 @@
+/* Header_Files/output_reader.h */
+#ifndef OUTPUT_READER_H
+#define OUTPUT_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "structs.h"
+
+/**
+ * @struct MappedText
+ * @brief A read-only mapping of a text output file and a cursor into it.
+ *
+ * The mapping is not null terminated, every parser is bounded by end.
+ */
+typedef struct
+{
+    void *base;
+    size_t size;
+    const char *cursor; /* start of the next unread line */
+    const char *end;    /* one past the last byte */
+    int line_number;    /* number of the last line read */
+    int error;          /* TRUE once a malformed line was found */
+} MappedText;
+
+/**
+ * @struct ObjectReader
+ * @brief Streams the words of a .ob file one at a time.
+ */
+typedef struct
+{
+    MappedText text;
+    uint32_t code_words;   /* IC - 100, from the first line */
+    uint32_t data_words;   /* DC, from the first line */
+    uint32_t next_address; /* address expected on the next line */
+} ObjectReader;
+
+/**
+ * @enum SymbolFileKind
+ * @brief Which symbol file a SymbolReader reads.
+ */
+typedef enum
+{
+    SYMBOLS_ENTRY,   /* .ent: entry label and its address */
+    SYMBOLS_EXTERNAL /* .ext: external label and the address that uses it */
+} SymbolFileKind;
+
+/**
+ * @struct SymbolReader
+ * @brief Streams the "name address" lines of a .ent or .ext file.
+ */
+typedef struct
+{
+    MappedText text;
+    SymbolFileKind kind;
+} SymbolReader;
+
+/**
+ * @brief Maps a .ob file and reads its first line (code and data word counts).
+ *
+ * @param path Path of the .ob file.
+ * @param reader Pointer to the reader to initialize.
+ * @return TRUE (1) on success, FALSE (0) if the file is missing or its first line is malformed.
+ */
+int open_object_reader(const char *path, ObjectReader *reader);
+
+/**
+ * @brief Reads the next word of a .ob file.
+ *
+ * Lines written by generate_object_file ("%07d %06x") are decoded several
+ * bytes at a time; any other spelling of the same numbers is accepted by a
+ * slower byte-by-byte path. Addresses must be consecutive from 100.
+ *
+ * @param reader Pointer to the reader.
+ * @param address Pointer filled with the address of the word.
+ * @param word Pointer filled with the word, in the VirtualPC representation.
+ * @return TRUE (1) if a word was read, FALSE (0) at the end of the image or on a
+ *         malformed line (reader->text.error tells them apart).
+ */
+int next_object_word(ObjectReader *reader, uint32_t *address, Word *word);
+
+/**
+ * @brief Releases the mapping of a .ob reader.
+ *
+ * @param reader Pointer to the reader.
+ */
+void close_object_reader(ObjectReader *reader);
+
+/**
+ * @brief Maps a .ent or .ext file for reading.
+ *
+ * @param path Path of the file.
+ * @param kind Whether the file holds entry labels or extern references.
+ * @param reader Pointer to the reader to initialize.
+ * @return TRUE (1) on success, FALSE (0) if the file could not be mapped.
+ */
+int open_symbol_reader(const char *path, SymbolFileKind kind, SymbolReader *reader);
+
+/**
+ * @brief Reads the next symbol of a .ent or .ext file.
+ *
+ * The label type is set to "entry" or "external" according to the file kind.
+ *
+ * @param reader Pointer to the reader.
+ * @param label Pointer filled with the label name and address.
+ * @return TRUE (1) if a symbol was read, FALSE (0) at the end of the file or on a
+ *         malformed line (reader->text.error tells them apart).
+ */
+int next_symbol(SymbolReader *reader, Label *label);
+
+/**
+ * @brief Releases the mapping of a symbol reader.
+ *
+ * @param reader Pointer to the reader.
+ */
+void close_symbol_reader(SymbolReader *reader);
+
+#endif /* OUTPUT_READER_H */
@@ -6,6 +6,7 @@
 #include "errors.h"
 #include "globals.h"
 #include "structs.h"
+#include "include_files.h"
 
 /**
  * @brief Processes the macros in the given assembly file.
@@ -18,9 +19,10 @@
  * @param fp File pointer to the assembly source file.
  * @param file_path Path to the source file.
  * @param mcro_table Pointer to the macro table.
+ * @param included The source with its includes expanded, mapping its lines to .as lines, or NULL.
  * @return TRUE (1) if the file is valid and processed successfully, FALSE (0) otherwise.
  */
-int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table);
+int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table, const IncludedSource *included);
 
 /**
  * @brief Preprocesses the given assembly file.
@@ -28,12 +30,23 @@ int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table);
  * This function checks the validity of the given filepath, constructs the full source path,
  * and processes the assembly file by reading its content and handling macro definitions.
  * It also handles memory allocation for paths and ensures proper cleanup.
+ * When the bytes of the file were already read they are processed from
+ * memory instead of opening the file again, with their .include
+ * directives expanded (see include_files.h). A source without macro
+ * definitions, .rept blocks or library macros skips expansion: its .am
+ * file is the source with comments and blank lines stripped, or the
+ * source itself when there is nothing to strip.
  *
  * @param filepath Path to the file.
+ * @param source The bytes of filepath.as, or NULL to read the file.
+ * @param source_size Number of bytes in source.
  * @param mcro_table Pointer to the macro table.
+ * @param includes The include path, and whether to write filepath.d.
+ * @param am_is_source Receives TRUE (1) if the .am file holds the bytes of source unchanged,
+ *                     so they may be read instead of the .am file, FALSE (0) otherwise.
  * @return TRUE (1) if processing is successful, FALSE (0) otherwise.
  */
-int process_file(const char* filepath, McroTable *mcro_table);
+int process_file(const char* filepath, const char *source, size_t source_size, McroTable *mcro_table, const IncludeOptions *includes, int *am_is_source);
 
 
 #endif /* PREPROCESSOR_H */
\ No newline at end of file
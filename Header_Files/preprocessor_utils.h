@@ -7,6 +7,20 @@
 #include "errors.h"
 #include "preprocessor.h"
 
+#define MAX_PARAM_REFERENCES (MAX_LINE_LENGTH / 2) /* whole names a body line can hold */
+#define MAX_REPT_COUNT 100000                      /* iterations of a .rept block */
+
+/**
+ * @struct ParamReference
+ * @brief Where a parameter name appears in a macro body line.
+ */
+typedef struct
+{
+    int start;  /* offset of the name in the line */
+    int length; /* length of the name */
+    int param;  /* index of the parameter */
+} ParamReference;
+
 /**
  * @brief Initializes the macro table to an empty state.
  *
@@ -17,6 +31,20 @@
  */
 void init_mcro_table(McroTable *table);
 
+/**
+ * @brief Empties an initialized macro table, touching only the macros it holds.
+ *
+ * @param table Pointer to the macro table to reset.
+ */
+void reset_mcro_table(McroTable *table);
+
+/**
+ * @brief Releases the expansions a macro table holds.
+ *
+ * @param table Pointer to the macro table.
+ */
+void free_mcro_table(McroTable *table);
+
 /**
  * @brief Validates if a given name is a legal macro name.
  *
@@ -51,19 +79,126 @@ ErrorCode add_mcro(McroTable *table, const char *name);
  */
 ErrorCode add_line_to_mcro(McroTable *table, const char *line);
 
+/**
+ * @brief Reads the comma separated parameter names that follow a macro name.
+ *
+ * @param text The text after the macro name (blank for a macro without parameters).
+ * @param params Receives the names, MAX_MCRO_PARAMS of them at most.
+ * @param count Receives the number of names.
+ * @return ERROR_SUCCESS, ERROR_MCRO_INVALID_PARAM, ERROR_MCRO_TOO_MANY_PARAMS or ERROR_MCRO_UNEXPECTED_TEXT.
+ */
+ErrorCode read_mcro_params(const char *text, char params[][MAX_MCRO_NAME_LENGTH], int *count);
+
+/**
+ * @brief Sets the parameters of the most recently added macro from the text after its name.
+ *
+ * The parameters are names separated by commas ("mcro name a, b"); a
+ * comment may follow them. Inside the body every whole parameter name is
+ * replaced by the argument of the call.
+ *
+ * @param table Pointer to the macro table.
+ * @param text The text after the macro name (blank for a macro without parameters).
+ * @return ERROR_SUCCESS if successful, error code otherwise.
+ */
+ErrorCode add_mcro_params(McroTable *table, const char *text);
+
+/**
+ * @brief Finds the whole parameter names of a macro body line.
+ *
+ * Names inside a string or a comment are not parameters.
+ *
+ * @param params The parameter names.
+ * @param param_count Number of parameters.
+ * @param line The body line.
+ * @param references Receives the references in order, room for MAX_PARAM_REFERENCES.
+ * @return The number of references.
+ */
+int find_param_references(const char params[][MAX_MCRO_NAME_LENGTH], int param_count, const char *line, ParamReference *references);
+
+/**
+ * @brief Finds a macro by name, in the file first and then in the libraries.
+ *
+ * @param table Pointer to the macro table.
+ * @param name The name.
+ * @param library Receives the library defining the macro, NULL for a macro of the file.
+ * @return The index of the macro (in its library for a library macro), or -1 if there is none.
+ */
+int find_mcro(const McroTable *table, const char *name, const MacroLibrary **library);
+
+/**
+ * @brief Finds or makes the expansion of a macro call.
+ *
+ * Calls of a macro with the same arguments share one expansion, so its
+ * body is substituted once, and the first pass encodes it once (see
+ * mcro_template.h). A macro without parameters has a single expansion,
+ * its content (for a library macro, the lines of the mapped library).
+ *
+ * @param table Pointer to the macro table.
+ * @param library The library defining the macro, NULL for a macro of the file.
+ * @param mcro Index of the called macro.
+ * @param text The text after the macro name in the call: the arguments, separated by commas.
+ * @param expansion Receives the index of the expansion.
+ * @return ERROR_SUCCESS, ERROR_MACRO_CALL_EXTRA_TEXT, ERROR_MCRO_ARG_COUNT,
+ *         ERROR_LINE_TOO_LONG, ERROR_MLIB_INVALID or ERROR_MEMORY_ALLOCATION.
+ */
+ErrorCode expand_mcro_call(McroTable *table, const MacroLibrary *library, int mcro, const char *text, int *expansion);
+
+/**
+ * @brief Returns a line of a macro expansion.
+ *
+ * @param table Pointer to the macro table.
+ * @param expansion Index of the expansion.
+ * @param line Index of the line in the macro body.
+ * @return The line, with the arguments substituted.
+ */
+const char *get_expansion_line(const McroTable *table, int expansion, int line);
+
 /**
  * @brief Processes the content as it would appear in the .am file and writes it to the target file.
  *
  * This function reads the source file line by line, expands macros when called, and removes macro
- * declarations and calls from the output. It creates a new file with the .am extension and writes
- * the processed content to it.
+ * declarations and calls from the output. A `.rept N` ... `.endr` block is written once, as
+ * `.rept N`, its body and `.endr` (the first pass repeats what the body encodes), and a block of
+ * 0 is left out. It creates a new file with the .am extension and writes the processed content to it.
  *
  * @param source_fp Pointer to the source file.
  * @param source_filepath Path to the source file.
  * @param mcro_table Pointer to the macro table containing defined macros.
+ * @param included The source with its includes expanded, mapping its lines to .as lines, or NULL.
  * @param is_valid Pointer to the is_valid file flag.
  * @return TRUE (1) if processing is successful, FALSE (0) otherwise.
  */
-int expand_macros_to_am_file (FILE *source_fp, const char *source_filepath, const McroTable *mcro_table, int *is_valid);
+int expand_macros_to_am_file (FILE *source_fp, const char *source_filepath, McroTable *mcro_table, const IncludedSource *included, int *is_valid);
+
+/**
+ * @brief Checks quickly whether a source can skip macro expansion.
+ *
+ * A source is plain when no line starts with mcro, .rept or .endr, and no
+ * line is long enough for the full preprocessor to split or reject it. The
+ * lines are found with memchr, without tokenizing them.
+ *
+ * @param data The bytes of the source.
+ * @param size Number of bytes.
+ * @param verbatim Receives TRUE (1) if no comment or blank line needs stripping either,
+ *                 so the .am file is the source unchanged.
+ * @return TRUE (1) if the source is plain, FALSE (0) otherwise.
+ */
+int is_plain_source(const char *data, size_t size, int *verbatim);
+
+/**
+ * @brief Writes the .am file of a plain source: its lines with comments and blank lines stripped.
+ *
+ * The lines are those expand_macros_to_am_file writes for the source, each
+ * recorded as a line origin.
+ *
+ * @param source The bytes of the source, checked by is_plain_source.
+ * @param size Number of bytes.
+ * @param source_filepath Path to the source file.
+ * @param mcro_table Pointer to the macro table (it holds no expansions).
+ * @param included The source with its includes expanded, mapping its lines to .as lines, or NULL.
+ * @param verbatim Whether is_plain_source found nothing to strip: the bytes are written as they are.
+ * @return TRUE (1) if the file is written, FALSE (0) otherwise.
+ */
+int write_plain_am_file(const char *source, size_t size, const char *source_filepath, const McroTable *mcro_table, const IncludedSource *included, int verbatim);
 
 #endif /* PREPROCESSOR_UTILS_H */
@@ -30,6 +30,19 @@
  * @return int Returns TRUE if the file was processed successfully, FALSE if errors occurred.
  */
  int second_pass(FILE *am_file, LabelTable *label_table, VirtualPC *vpc);
+
+/**
+ * @brief Checks the label references and the .entry directive of one line.
+ *
+ * The body of second_pass, also used to recheck single lines after an edit.
+ * A valid .entry marks its label in the table.
+ *
+ * @param line The line, as read from the .am file.
+ * @param line_number The line number in the source file.
+ * @param label_table Pointer to the LabelTable structure containing symbol information.
+ * @return TRUE if the line is valid, FALSE if an error was reported.
+ */
+int second_pass_line(char *line, int line_number, LabelTable *label_table);
  
 /**
  * @brief Processes a command line to validate operands and check for undefined labels.
@@ -0,0 +1,61 @@
+/* Header_Files/server.h */
+#ifndef SERVER_H
+#define SERVER_H
+
+#define SOCKET_PATH_SIZE 108 /* sun_path of struct sockaddr_un on Linux */
+
+/*
+ * A request is the client's command line, its working directory and umask,
+ * sent over a UNIX domain stream socket together with the client's stdin,
+ * stdout and stderr descriptors (SCM_RIGHTS). The server runs the request
+ * with those descriptors in place of its own, so the output, diagnostics
+ * and written files are exactly those of a local run, and answers with a
+ * single byte: the exit status.
+ */
+
+/**
+ * @brief Runs one request: the command line of a client, minus the program name.
+ *
+ * @return The exit status of the request (EXIT_SUCCESS or EXIT_FAILURE).
+ */
+typedef int (*RequestHandler)(int argc, char *argv[]);
+
+/**
+ * @brief Builds the socket path used when none is given, in a directory only we can enter.
+ *
+ * The directory is $XDG_RUNTIME_DIR, or else /tmp/assembler-<uid>, made
+ * with mode 0700 by the server. It must be owned by our uid and closed to
+ * group and others, or no socket is used there.
+ *
+ * @param buffer Receives the path, at least SOCKET_PATH_SIZE bytes.
+ * @param create Whether to make the /tmp directory if it does not exist (for the server).
+ * @return buffer, or NULL if the directory is missing or not private (the latter is reported).
+ */
+char *default_socket_path(char *buffer, int create);
+
+/**
+ * @brief Listens on a UNIX domain socket and runs the requests of clients, one at a time.
+ *
+ * The socket file of a server that is no longer running is replaced; any
+ * other file at path is an error. Connections from other uids are refused.
+ * Only returns if the socket could not be set up.
+ *
+ * @param path Path of the socket.
+ * @param handler Runs each request.
+ * @return FALSE (0), the socket could not be set up (the error is printed).
+ */
+int run_server(const char *path, RequestHandler handler);
+
+/**
+ * @brief Sends a command line to a running server and waits for its exit status.
+ *
+ * @param path Path of the socket.
+ * @param argc Argument count as received by main.
+ * @param argv Argument vector as received by main.
+ * @param status Receives the exit status of the request.
+ * @return TRUE (1) if a server ran the request, FALSE (0) if no server is listening
+ *         or it runs as another uid (reported).
+ */
+int run_client(const char *path, int argc, char *argv[], int *status);
+
+#endif /* SERVER_H */
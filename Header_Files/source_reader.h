@@ -0,0 +1,78 @@
+/* Header_Files/source_reader.h */
+#ifndef SOURCE_READER_H
+#define SOURCE_READER_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define SOURCE_READ_AHEAD 4 /* files read before the assembler asks for them */
+
+/**
+ * @struct SourceBuffer
+ * @brief The bytes of one .as file, read ahead of its assembly.
+ *
+ * data is NULL if the file could not be read; the preprocessor then opens
+ * it itself and reports the error as usual.
+ */
+typedef struct
+{
+    char *data;
+    size_t size;
+} SourceBuffer;
+
+/**
+ * @struct SourceReader
+ * @brief A thread reading the .as files of a run ahead of the assembler.
+ *
+ * Read files wait in a ring of at most depth buffers, so the memory held
+ * by the reader stays bounded however many files are given.
+ */
+typedef struct
+{
+    char **files;              /* base names, in assembly order */
+    int file_count;
+    int next_read;             /* index of the next file to read */
+    int next_taken;            /* index of the next file handed out */
+    SourceBuffer *ring;        /* read files waiting to be taken */
+    int depth;
+    int stopping;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;   /* signalled when a buffer is taken */
+    pthread_cond_t not_empty;  /* signalled when a file was read */
+} SourceReader;
+
+/**
+ * @brief Starts reading the given files in the background.
+ *
+ * @param reader Pointer to the reader to initialize.
+ * @param files Base names of the .as files (without extension).
+ * @param file_count Number of files.
+ * @param depth Number of files read ahead at most (at least 1).
+ * @return TRUE (1) on success, FALSE (0) if the reader could not be started.
+ */
+int start_source_reader(SourceReader *reader, char **files, int file_count, int depth);
+
+/**
+ * @brief Takes the next file, in order, waiting until it was read.
+ *
+ * @param reader Pointer to the reader.
+ * @param buffer Receives the bytes of the file; the caller frees them with release_source.
+ */
+void next_source(SourceReader *reader, SourceBuffer *buffer);
+
+/**
+ * @brief Frees the bytes of a file taken from a reader.
+ *
+ * @param buffer Pointer to the buffer (left empty, safe to release twice).
+ */
+void release_source(SourceBuffer *buffer);
+
+/**
+ * @brief Stops the reader thread and frees whatever it still holds.
+ *
+ * @param reader Pointer to the reader.
+ */
+void stop_source_reader(SourceReader *reader);
+
+#endif /* SOURCE_READER_H */
@@ -32,21 +32,46 @@ typedef struct {
 
 /**
  * @struct Mcro
- * @brief Represents a macro with its name and content lines.
+ * @brief Represents a macro with its name, parameters and content lines.
  */
 typedef struct {
     char name[MAX_MCRO_NAME_LENGTH];
     char content[100][MAX_LINE_LENGTH];
     int line_count;
+    char params[MAX_MCRO_PARAMS][MAX_MCRO_NAME_LENGTH];
+    int param_count;
 } Mcro;
 
+/* a mapped .mlib macro library, see macro_library.h */
+typedef struct MacroLibrary MacroLibrary;
+
+/**
+ * @struct McroExpansion
+ * @brief The body of a macro as called with one list of arguments.
+ */
+typedef struct {
+    int mcro;                       /* index of the macro, in its library for a library macro */
+    const MacroLibrary *library;    /* the library defining the macro, NULL for a macro of the file */
+    int line_count;                 /* lines of the body */
+    char *arguments;                /* the arguments, joined by commas ("" without parameters) */
+    char (*lines)[MAX_LINE_LENGTH]; /* the body with the arguments substituted, NULL to use the content */
+    unsigned long hash;
+} McroExpansion;
+
 /**
  * @struct McroTable
- * @brief Holds all the macros defined in the source file.
+ * @brief Holds all the macros defined in the source file, and their expansions.
  */
 typedef struct {
     Mcro mcros[50];
     int count;
+    McroExpansion *expansions; /* one per macro and distinct argument list called */
+    int expansion_count;
+    int expansion_capacity;
+    int *expansion_index;      /* open addressing index of the expansions, -1 for a free slot */
+    int index_capacity;        /* a power of two, or 0 */
+    const MacroLibrary *libraries; /* the --mlib libraries, looked up after the macros of the file */
+    int library_count;
 } McroTable;
 
 /**
@@ -0,0 +1,88 @@
+/* Header_Files/task_pool.h */
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <pthread.h>
+
+/**
+ * @brief A unit of work run by one of the pool threads.
+ */
+typedef void (*TaskFunction)(void *arg);
+
+/**
+ * @struct Task
+ * @brief A queued task (function and its argument).
+ */
+typedef struct Task
+{
+    TaskFunction function;
+    void *arg;
+    struct Task *next;
+} Task;
+
+/**
+ * @struct TaskPool
+ * @brief A fixed set of worker threads draining a shared FIFO task queue.
+ */
+typedef struct
+{
+    pthread_t *threads;
+    int thread_count;
+    Task *head;              /* next task to run */
+    Task *tail;              /* last queued task */
+    int pending;             /* tasks queued or running */
+    int shutting_down;
+    pthread_mutex_t lock;
+    pthread_cond_t task_ready; /* signalled when a task is queued or on shutdown */
+    pthread_cond_t all_done;   /* signalled when pending drops to zero */
+} TaskPool;
+
+/**
+ * @brief Starts a task pool with the given number of worker threads.
+ *
+ * @param pool Pointer to the pool to initialize.
+ * @param thread_count Number of worker threads (at least 1).
+ * @return TRUE (1) on success, FALSE (0) if the threads could not be created.
+ */
+int init_task_pool(TaskPool *pool, int thread_count);
+
+/**
+ * @brief Queues a task at the back of the queue.
+ *
+ * May be called from inside a running task.
+ *
+ * @param pool Pointer to the pool.
+ * @param function The function to run.
+ * @param arg The argument passed to the function.
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+int submit_task(TaskPool *pool, TaskFunction function, void *arg);
+
+/**
+ * @brief Queues a task at the front of the queue.
+ *
+ * Used for work that releases resources (such as output writers, which free
+ * their assembly context when done) so it runs before new work is started.
+ *
+ * @param pool Pointer to the pool.
+ * @param function The function to run.
+ * @param arg The argument passed to the function.
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+int submit_urgent_task(TaskPool *pool, TaskFunction function, void *arg);
+
+/**
+ * @brief Blocks until every queued and running task has finished.
+ *
+ * @param pool Pointer to the pool.
+ */
+void wait_task_pool(TaskPool *pool);
+
+/**
+ * @brief Waits for all tasks, stops the worker threads and frees the pool.
+ *
+ * @param pool Pointer to the pool.
+ */
+void destroy_task_pool(TaskPool *pool);
+
+#endif /* TASK_POOL_H */
@@ -115,4 +115,24 @@ void init_label_table(LabelTable *label_table);
  */
 void init_virtual_pc(VirtualPC *vpc);
 
+/**
+ * @brief Empties a label table that was initialized before, touching only the labels it used.
+ *
+ * The slot after the last label is cleared too, since adding a label may write past its name.
+ *
+ * @param label_table Pointer to the LabelTable structure to be reset.
+ */
+void reset_label_table(LabelTable *label_table);
+
+/**
+ * @brief Empties a virtual PC that was initialized before, touching only the words it used.
+ *
+ * Words are only ever stored below the high-water mark max(IC, last_adress),
+ * so clearing up to it leaves the storage as init_virtual_pc does. A zeroed
+ * (calloc'd) VirtualPC counts as initialized.
+ *
+ * @param vpc Pointer to the VirtualPC structure to be reset.
+ */
+void reset_virtual_pc(VirtualPC *vpc);
+
 #endif /* UTILS_H */
\ No newline at end of file
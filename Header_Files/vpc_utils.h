@@ -4,6 +4,20 @@
 
 #include "structs.h"
 
+#define MAX_COMMAND_WORDS 3 /* the command word and up to two operand words */
+
+/**
+ * @brief Encodes the values of a data directive into consecutive words.
+ *
+ * Handles .data, .string, .fill, .space and .incbin. Only value and encoded
+ * are set, so the words are expected to start zeroed.
+ *
+ * @param ptr Pointer to the input string containing the directive.
+ * @param words Where the words go, or NULL to only count them.
+ * @return The number of words (numbers, characters plus the terminator, the
+ *         .fill count, or the .incbin bytes divided by INCBIN_WORD_BYTES, rounded up).
+ */
+int encode_data_or_string(char *ptr, Word *words);
 
 /**
  * @brief Processes a .data or .string directive and stores the values in the VirtualPC storage.
@@ -20,6 +34,30 @@
  */
 int process_data_or_string_directive(char *ptr, VirtualPC *vpc, int *storage_full);
 
+/**
+ * @brief Stores data words encoded in advance, as process_data_or_string_directive stores its values.
+ *
+ * @param words The words.
+ * @param count Number of words.
+ * @param vpc Pointer to the VirtualPC structure where the words will be stored.
+ * @param storage_full Pointer to an integer flag that will be set to if the storage is full.
+ * @return The number of words.
+ */
+int store_data_words(const Word *words, int count, VirtualPC *vpc, int *storage_full);
+
+/**
+ * @brief Encodes a valid command line into its first word and operand words.
+ *
+ * Label operands get placeholder words that fill_addresses_words resolves later.
+ * With a current encode cache (see encode_cache.h) a command seen before is
+ * copied from the cache instead of being encoded again.
+ *
+ * @param line Pointer to the input string containing the command line.
+ * @param words Receives the words.
+ * @return The number of words (1 to MAX_COMMAND_WORDS), 0 if the command is unknown.
+ */
+int encode_command(const char *line, Word words[MAX_COMMAND_WORDS]);
+
 /**
  * @brief Generates words from a command from a valid line of command and stores it in the VirtualPC storage.
  *
@@ -34,6 +72,19 @@ int process_data_or_string_directive(char *ptr, VirtualPC *vpc, int *storage_ful
  */
 int process_and_store_command(const char *line, VirtualPC *vpc, int *storage_full);
 
+/**
+ * @brief Stores command words encoded in advance at IC, as process_and_store_command does.
+ *
+ * A block that fits is copied at once.
+ *
+ * @param words The words.
+ * @param count Number of words.
+ * @param vpc Pointer to the VirtualPC structure where the words will be stored.
+ * @param storage_full Pointer to an integer flag that will be set to if the storage is full.
+ * @return The number of words.
+ */
+int store_command_words(const Word *words, int count, VirtualPC *vpc, int *storage_full);
+
 /**
  * @brief Processes an operand and updates the binary representation in the provided words.
  *
@@ -0,0 +1,31 @@
+/* Header_Files/watch.h */
+#ifndef WATCH_H
+#define WATCH_H
+
+#define WATCH_DEBOUNCE_MS 50 /* quiet time that ends a burst of file events */
+
+/**
+ * @brief Assembles a batch of files (base names, without .as).
+ *
+ * @return TRUE (1) if the batch succeeded, FALSE (0) otherwise.
+ */
+typedef int (*WatchHandler)(char **files, int count);
+
+/**
+ * @brief Assembles the given sources, then again whenever their contents change.
+ *
+ * Each path is either the base name of a source (file.as is watched) or a
+ * directory (every .as file in it is watched, including ones created
+ * later). The directories are watched with inotify, so editors that
+ * replace a file by renaming over it are seen too. Events are collected
+ * until WATCH_DEBOUNCE_MS pass without one, and only the files whose bytes
+ * differ from what was last assembled are handed to the handler.
+ *
+ * @param paths Base names and directories, as given on the command line.
+ * @param count Number of paths.
+ * @param handler Assembles each batch.
+ * @return FALSE (0), the files could not be watched (the error is printed). Does not return otherwise.
+ */
+int run_watch(char **paths, int count, WatchHandler handler);
+
+#endif /* WATCH_H */
@@ -0,0 +1,398 @@
+/* Source_Files/am_builder.c */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../Header_Files/am_builder.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/preprocessor_utils.h"
+
+/* threads per .am file, set once per run */
+static int expansion_threads = 1;
+
+/**
+ * @struct AmShare
+ * @brief The part of a plan one thread measures or copies.
+ */
+typedef struct
+{
+    const AmPlan *plan;
+    char *const *expansion_texts;   /* each expansion, rendered */
+    const size_t *expansion_lengths;
+    size_t *offsets;                /* offset of each piece in the file */
+    int first;                      /* pieces first..last - 1, when measuring */
+    int last;
+    size_t size;                    /* bytes of those pieces */
+    size_t base;                    /* offset of the first of them */
+    size_t start;                   /* bytes start..end - 1 of the file, when copying */
+    size_t end;
+    char *buffer;
+} AmShare;
+
+/**
+ * @brief Returns the number of bytes a piece writes.
+ */
+static size_t piece_size(const AmShare *share, const AmPiece *piece)
+{
+    if (piece->expansion < 0)
+    {
+        return piece->length;
+    }
+    return share->expansion_lengths[piece->expansion] * (size_t)piece->repeat;
+}
+
+/**
+ * @brief Adds up the sizes of the pieces of a share.
+ */
+static void *measure_share(void *arg)
+{
+    AmShare *share = (AmShare *)arg;
+    int i;
+
+    share->size = 0;
+    for (i = share->first; i < share->last; i++)
+    {
+        share->size += piece_size(share, &share->plan->pieces[i]);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Gives each piece of a share its offset, from the offset of the share.
+ */
+static void *place_share(void *arg)
+{
+    AmShare *share = (AmShare *)arg;
+    size_t offset = share->base;
+    int i;
+
+    for (i = share->first; i < share->last; i++)
+    {
+        share->offsets[i] = offset;
+        offset += piece_size(share, &share->plan->pieces[i]);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Copies bytes from..to - 1 of a piece to out.
+ */
+static void copy_piece_bytes(const AmShare *share, const AmPiece *piece, size_t from, size_t to, char *out)
+{
+    const char *text;
+    size_t length, position, count;
+
+    if (piece->expansion < 0)
+    {
+        memcpy(out, share->plan->text + piece->offset + from, to - from);
+        return;
+    }
+
+    /* the copies of an expansion, the first and last possibly in part */
+    text = share->expansion_texts[piece->expansion];
+    length = share->expansion_lengths[piece->expansion];
+    while (from < to)
+    {
+        position = from % length;
+        count = length - position < to - from ? length - position : to - from;
+        memcpy(out, text + position, count);
+        out += count;
+        from += count;
+    }
+}
+
+/**
+ * @brief Copies the bytes of the file in the range of a share.
+ */
+static void *copy_share(void *arg)
+{
+    AmShare *share = (AmShare *)arg;
+    const AmPlan *plan = share->plan;
+    int low = 0, high = plan->piece_count - 1, middle, i;
+    size_t piece_start, piece_end, from, to;
+
+    if (share->start >= share->end)
+    {
+        return NULL;
+    }
+
+    /* the last piece starting at or before the range (empty pieces start where the next one does) */
+    while (low < high)
+    {
+        middle = low + (high - low + 1) / 2;
+        if (share->offsets[middle] <= share->start)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    for (i = low; i < plan->piece_count && share->offsets[i] < share->end; i++)
+    {
+        piece_start = share->offsets[i];
+        piece_end = piece_start + piece_size(share, &plan->pieces[i]);
+        from = piece_start > share->start ? piece_start : share->start;
+        to = piece_end < share->end ? piece_end : share->end;
+        if (from < to)
+        {
+            copy_piece_bytes(share, &plan->pieces[i], from - piece_start, to - piece_start, share->buffer + from);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs a function on every share, on threads of its own when parallel.
+ *
+ * A share whose thread could not be started runs on the calling thread.
+ */
+static void run_shares(void *(*function)(void *), AmShare *shares, int count, int parallel)
+{
+    pthread_t threads[MAX_EXPANSION_THREADS];
+    int started[MAX_EXPANSION_THREADS];
+    int i;
+
+    for (i = 1; i < count; i++)
+    {
+        started[i] = parallel && pthread_create(&threads[i], NULL, function, &shares[i]) == 0;
+    }
+    function(&shares[0]);
+    for (i = 1; i < count; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+        else
+        {
+            function(&shares[i]);
+        }
+    }
+}
+
+/**
+ * @brief Renders every expansion of a macro table once: its lines, each followed by a newline.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int render_expansions(const McroTable *mcro_table, char ***texts, size_t **lengths)
+{
+    int count = mcro_table->expansion_count, i, j;
+    const char *line;
+    size_t size, line_length;
+
+    *texts = (char **)calloc(count > 0 ? count : 1, sizeof(char *));
+    *lengths = (size_t *)calloc(count > 0 ? count : 1, sizeof(size_t));
+    if (!*texts || !*lengths)
+    {
+        return FALSE;
+    }
+    for (i = 0; i < count; i++)
+    {
+        size = 0;
+        for (j = 0; j < mcro_table->expansions[i].line_count; j++)
+        {
+            size += strlen(get_expansion_line(mcro_table, i, j)) + 1;
+        }
+        (*texts)[i] = (char *)malloc(size > 0 ? size : 1);
+        if (!(*texts)[i])
+        {
+            return FALSE;
+        }
+        size = 0;
+        for (j = 0; j < mcro_table->expansions[i].line_count; j++)
+        {
+            line = get_expansion_line(mcro_table, i, j);
+            line_length = strlen(line);
+            memcpy((*texts)[i] + size, line, line_length);
+            size += line_length;
+            (*texts)[i][size++] = '\n';
+        }
+        (*lengths)[i] = size;
+    }
+    return TRUE;
+}
+
+/* Shares the processors among the files assembled at the same time. */
+void set_expansion_threads(int jobs)
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+    expansion_threads = processors > 0 && jobs > 0 ? (int)(processors / jobs) : 1;
+    if (expansion_threads < 1)
+    {
+        expansion_threads = 1;
+    }
+    if (expansion_threads > MAX_EXPANSION_THREADS)
+    {
+        expansion_threads = MAX_EXPANSION_THREADS;
+    }
+}
+
+/* Prepares an empty plan. */
+void init_am_plan(AmPlan *plan)
+{
+    memset(plan, 0, sizeof(*plan));
+}
+
+/**
+ * @brief Makes room for one more piece.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int reserve_piece(AmPlan *plan)
+{
+    if (plan->piece_count == plan->piece_capacity)
+    {
+        int capacity = plan->piece_capacity ? plan->piece_capacity * 2 : 256;
+        AmPiece *grown = (AmPiece *)realloc(plan->pieces, capacity * sizeof(AmPiece));
+        if (!grown)
+        {
+            return FALSE;
+        }
+        plan->pieces = grown;
+        plan->piece_capacity = capacity;
+    }
+    return TRUE;
+}
+
+/* Appends the text of a source line. */
+int add_am_line(AmPlan *plan, const char *line, size_t length)
+{
+    AmPiece *last = plan->piece_count > 0 ? &plan->pieces[plan->piece_count - 1] : NULL;
+
+    if (plan->text_size + length > plan->text_capacity)
+    {
+        size_t capacity = plan->text_capacity ? plan->text_capacity : 4096;
+        char *grown;
+        while (capacity < plan->text_size + length)
+        {
+            capacity *= 2;
+        }
+        grown = (char *)realloc(plan->text, capacity);
+        if (!grown)
+        {
+            return FALSE;
+        }
+        plan->text = grown;
+        plan->text_capacity = capacity;
+    }
+    memcpy(plan->text + plan->text_size, line, length);
+
+    /* consecutive source lines make one piece */
+    if (last && last->expansion < 0)
+    {
+        last->length += length;
+    }
+    else
+    {
+        if (!reserve_piece(plan))
+        {
+            return FALSE;
+        }
+        last = &plan->pieces[plan->piece_count++];
+        last->offset = plan->text_size;
+        last->length = length;
+        last->expansion = -1;
+        last->repeat = 1;
+    }
+    plan->text_size += length;
+    return TRUE;
+}
+
+/* Appends copies of a macro expansion. */
+int add_am_expansion(AmPlan *plan, int expansion, long repeat)
+{
+    AmPiece *piece;
+
+    if (!reserve_piece(plan))
+    {
+        return FALSE;
+    }
+    piece = &plan->pieces[plan->piece_count++];
+    piece->offset = 0;
+    piece->length = 0;
+    piece->expansion = expansion;
+    piece->repeat = repeat;
+    return TRUE;
+}
+
+/* Builds the bytes of a plan and writes them. */
+int write_am_plan(FILE *fp, const AmPlan *plan, const McroTable *mcro_table)
+{
+    AmShare shares[MAX_EXPANSION_THREADS];
+    char **texts = NULL;
+    size_t *lengths = NULL;
+    size_t *offsets;
+    size_t total = 0;
+    char *buffer = NULL;
+    int share_count, i, ok = FALSE;
+
+    offsets = (size_t *)malloc((plan->piece_count > 0 ? plan->piece_count : 1) * sizeof(size_t));
+    if (offsets && render_expansions(mcro_table, &texts, &lengths))
+    {
+        /* the lengths of the pieces, and their offsets through a prefix sum */
+        share_count = plan->piece_count >= PARALLEL_AM_MIN_PIECES ? expansion_threads : 1;
+        for (i = 0; i < share_count; i++)
+        {
+            shares[i].plan = plan;
+            shares[i].expansion_texts = texts;
+            shares[i].expansion_lengths = lengths;
+            shares[i].offsets = offsets;
+            shares[i].first = (int)((long)plan->piece_count * i / share_count);
+            shares[i].last = (int)((long)plan->piece_count * (i + 1) / share_count);
+        }
+        run_shares(measure_share, shares, share_count, share_count > 1);
+        for (i = 0; i < share_count; i++)
+        {
+            shares[i].base = total;
+            total += shares[i].size;
+        }
+        run_shares(place_share, shares, share_count, share_count > 1);
+
+        /* every thread copies an equal range of the file */
+        share_count = total >= PARALLEL_AM_MIN_BYTES ? expansion_threads : 1;
+        buffer = (char *)malloc(total > 0 ? total : 1);
+        if (buffer)
+        {
+            for (i = 0; i < share_count; i++)
+            {
+                shares[i].plan = plan;
+                shares[i].expansion_texts = texts;
+                shares[i].expansion_lengths = lengths;
+                shares[i].offsets = offsets;
+                shares[i].start = total / share_count * i;
+                shares[i].end = i == share_count - 1 ? total : total / share_count * (i + 1);
+                shares[i].buffer = buffer;
+            }
+            run_shares(copy_share, shares, share_count, share_count > 1);
+            ok = fwrite(buffer, 1, total, fp) == total;
+        }
+    }
+
+    if (texts)
+    {
+        for (i = 0; i < mcro_table->expansion_count; i++)
+        {
+            free(texts[i]);
+        }
+    }
+    free(texts);
+    free(lengths);
+    free(offsets);
+    free(buffer);
+    return ok;
+}
+
+/* Releases a plan. */
+void free_am_plan(AmPlan *plan)
+{
+    free(plan->pieces);
+    free(plan->text);
+    init_am_plan(plan);
+}
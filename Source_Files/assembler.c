@@ -4,114 +4,632 @@
  * This is the main file for the assembler program. It processes
  * assembly files, performs first and second passes, and generates the
  * necessary output files (.ob, .ent, .ext).
+ *
+ * Every file is assembled as a task of a thread pool. Once a file is
+ * assembled its image and label table are read-only, so its output
+ * writers are queued as separate tasks on the same pool and run at the
+ * same time. With -j N up to N files are assembled at once.
+ *
+ * A reader thread reads the sources ahead of the assembly tasks, so the
+ * run is a pipeline: reading, assembling and writing different files
+ * overlap, and each stage holds a bounded number of files.
+ *
+ * With --serve the process stays up: the contexts and threads are kept
+ * warm and each client command line (--client) is run on them in turn.
+ * --watch keeps them the same way and reassembles the sources that change.
  */
+#define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
 #include <stdlib.h>
-#include "../Header_Files/preprocessor.h"      
-#include "../Header_Files/preprocessor_utils.h" 
-#include "../Header_Files/first_pass.h"     
-#include "../Header_Files/second_pass.h"       
-#include "../Header_Files/errors.h"           
-#include "../Header_Files/globals.h"          
-#include "../Header_Files/structs.h"        
-#include "../Header_Files/utils.h"             
-#include "../Header_Files/output_builder.h"     
+#include "../Header_Files/preprocessor.h"
+#include "../Header_Files/preprocessor_utils.h"
+#include "../Header_Files/first_pass.h"
+#include "../Header_Files/second_pass.h"
+#include "../Header_Files/errors.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/structs.h"
+#include "../Header_Files/utils.h"
+#include "../Header_Files/output_builder.h"
+#include "../Header_Files/binary_object.h"
+#include "../Header_Files/options.h"
+#include "../Header_Files/context.h"
+#include "../Header_Files/task_pool.h"
+#include "../Header_Files/diagnostics.h"
+#include "../Header_Files/object_cache.h"
+#include "../Header_Files/output_file.h"
+#include "../Header_Files/source_reader.h"
+#include "../Header_Files/server.h"
+#include "../Header_Files/watch.h"
+#include "../Header_Files/encode_cache.h"
+#include "../Header_Files/include_files.h"
+#include "../Header_Files/macro_library.h"
+#include "../Header_Files/am_builder.h"
 
 /* prototype */
 void delete_file_if_needed(const char *filename, int success);
 
-int main(int argc, char *argv[])
+/* the pool running both the assembly tasks and the output writer tasks */
+static TaskPool task_pool;
+
+/* the contexts of the files assembled at the same time */
+static ContextPool context_pool;
+static int pools_started = FALSE;
+
+/* with --serve, the options of the request being run: every context points here */
+static AssemblerOptions request_options;
+
+/* with --watch, the options of the command line */
+static const AssemblerOptions *watch_options;
+
+/* the --mlib libraries, mapped for the batch being assembled */
+static MacroLibrary *macro_libraries;
+static int macro_library_count;
+
+/**
+ * @brief Records the result of a file and returns its context to the pool.
+ */
+static void finish_file(AssemblyContext *context)
 {
-    int i;
-    int success;
-    FILE *am_file;
-    char am_filename[MAX_FILENAME_LENGTH];
-    LabelTable label_table;
-    McroTable mcro_table;
+    flush_diagnostics(&context->diagnostics);
+    set_current_sink(NULL);
+    release_source(&context->source);
+    *context->result = context->success;
+    release_context(context);
+}
+
+/**
+ * @brief Checks that no output writer of a context failed.
+ */
+static int all_outputs_written(const AssemblyContext *context)
+{
+    int kind;
 
-    /* allocate memory for VirtualPC */
-    VirtualPC *vpc = (VirtualPC *)malloc(sizeof(VirtualPC));
-    if (!vpc) 
+    for (kind = 0; kind < OUTPUT_KIND_COUNT; kind++)
     {
-        print_error_no_line(ERROR_MEMORY_ALLOCATION);
-        exit(EXIT_FAILURE); /* ensures no memory leak */
+        if (context->output_requested[kind] && context->output_status[kind] == OUTPUT_FAILED)
+        {
+            return FALSE;
+        }
     }
-    
+    return TRUE;
+}
 
-    /* ensure at least one assembly file is provided */
-    if (argc < 2)
+/**
+ * @brief Writes the rendered outputs of a context together and updates their statuses.
+ */
+static void write_output_batch(AssemblyContext *context)
+{
+    char path[MAX_FILENAME_LENGTH + 5];
+    int kind;
+
+    flush_output_batch(&context->outputs);
+    for (kind = 0; kind < OUTPUT_KIND_COUNT; kind++)
     {
-        print_error(ERROR_MISSING_AS_FILE, 0);
-        free(vpc);
-        return EXIT_FAILURE;
+        if (context->output_requested[kind] && context->output_status[kind] == OUTPUT_WRITTEN)
+        {
+            sprintf(path, "%s.%s", context->filename, output_extension((OutputKind)kind));
+            if (output_batch_failed(&context->outputs, path))
+            {
+                context->output_status[kind] = OUTPUT_FAILED; /* flush_output_batch printed the error */
+            }
+        }
     }
+}
 
+/**
+ * @brief Reports the outputs restored from the cache and finishes the file.
+ */
+static void finish_cached_file(AssemblyContext *context)
+{
+    int kind;
 
-    /* iterate over each provided assembly file */
-    for (i = 1; i < argc; i++)
+    flush_diagnostics(&context->diagnostics); /* the replayed warnings */
+    for (kind = 0; kind < OUTPUT_KIND_COUNT; kind++)
     {
-        success = TRUE;
-        printf("\n==================== Assembling File: %s ====================\n", argv[i]);
+        if (context->output_requested[kind])
+        {
+            report_output((OutputKind)kind, context->output_status[kind], context->filename);
+        }
+    }
+    finish_file(context);
+}
 
+/**
+ * @brief Pool task: writes one output file of an assembled context.
+ *
+ * The last writer to finish prints the results of all writers in a fixed
+ * order and releases the context.
+ */
+static void output_task(void *arg)
+{
+    OutputJob *job = (OutputJob *)arg;
+    AssemblyContext *context = job->context;
+    int kind;
+
+    set_current_sink(&context->diagnostics);
+    set_current_output_batch(&context->outputs);
+    context->output_status[job->kind] = generate_output(job->kind, context->vpc, &context->label_table, context->filename);
+    set_current_output_batch(NULL);
+
+    if (finish_output_job(context))
+    {
+        if (context->options->batch_output)
+        {
+            write_output_batch(context);
+        }
+        if (context->options->cache_dir && all_outputs_written(context))
+        {
+            store_cached_outputs(context);
+        }
+        for (kind = 0; kind < OUTPUT_KIND_COUNT; kind++)
+        {
+            if (context->output_requested[kind])
+            {
+                report_output((OutputKind)kind, context->output_status[kind], context->filename);
+            }
+        }
+        finish_file(context);
+    }
+    else
+    {
+        set_current_sink(NULL);
+    }
+}
 
-        /* initialize structures */
-        init_virtual_pc(vpc);
-        init_label_table(&label_table);
-        init_mcro_table(&mcro_table);
+/**
+ * @brief Queues the output writers of an assembled context.
+ */
+static void submit_outputs(AssemblyContext *context)
+{
+    OutputJob *jobs[OUTPUT_KIND_COUNT];
+    int kind, job_count = 0, i;
 
-        /* generate .am filename for preprocessed file */
-        sprintf(am_filename, "%s.am", argv[i]);
+    context->output_requested[OUTPUT_OBJECT] = TRUE;
+    context->output_requested[OUTPUT_ENTRY] = TRUE;
+    context->output_requested[OUTPUT_EXTERNALS] = TRUE;
+    context->output_requested[OUTPUT_BINARY] = context->options->binary_object;
+    context->output_requested[OUTPUT_COMPRESSED] = context->options->compressed_object;
 
-        /* preprocess the input file (macro expansion)*/
-        if (!process_file(argv[i], &mcro_table))
+    /* count every writer, and prepare its job, before the first one can finish */
+    context->pending_outputs = 0;
+    for (kind = 0; kind < OUTPUT_KIND_COUNT; kind++)
+    {
+        context->pending_outputs += context->output_requested[kind];
+        if (context->output_requested[kind])
         {
-            print_error_no_line(ERROR_FILE_PROCESSING);
-            continue; /* skip this file and move to the next */
+            jobs[job_count] = &context->output_jobs[kind];
+            jobs[job_count]->context = context;
+            jobs[job_count]->kind = (OutputKind)kind;
+            job_count++;
         }
+    }
 
-        /* open the preprocessed file for further processing */
+    /* the last writer to finish releases the context: it is not touched once the jobs are handed out */
+    for (i = 0; i < job_count; i++)
+    {
+        /* writers go first: they free a context for the next file */
+        if (!submit_urgent_task(&task_pool, output_task, jobs[i]))
+        {
+            output_task(jobs[i]); /* run it here rather than losing the output */
+        }
+    }
+}
+
+/**
+ * @brief Pool task: preprocesses and assembles one source file.
+ */
+static void assemble_task(void *arg)
+{
+    AssemblyContext *context = (AssemblyContext *)arg;
+    char am_filename[MAX_FILENAME_LENGTH];
+    FILE *am_file;
+    int am_is_source;
+
+    set_current_sink(&context->diagnostics);
+    context->diagnostics.file = context->filename;
+    context->mcro_table.libraries = macro_libraries;
+    context->mcro_table.library_count = macro_library_count;
+
+    printf("\n==================== Assembling File: %s ====================\n", context->filename);
+
+    /* an unchanged source assembled before: copy its outputs instead */
+    if (context->options->cache_dir && compute_cache_key(context) && restore_cached_outputs(context))
+    {
+        finish_cached_file(context);
+        return;
+    }
+
+    /* generate .am filename for preprocessed file */
+    sprintf(am_filename, "%s.am", context->filename);
+
+    /* preprocess the input file (macro expansion)*/
+    if (!process_file(context->filename, context->source.data, context->source.size, &context->mcro_table, &context->options->includes, &am_is_source))
+    {
+        print_error_no_line(ERROR_FILE_PROCESSING);
+        finish_file(context); /* skip this file and move to the next */
+        return;
+    }
+
+    use_line_origins(); /* the passes report .am lines from here on */
+
+    /* open the preprocessed file for further processing, or the source already in memory when they are the same */
+    if (am_is_source)
+    {
+        am_file = fmemopen(context->source.data, context->source.size, "r");
+    }
+    else
+    {
+        release_source(&context->source); /* the passes read the .am file */
         am_file = fopen(am_filename, "r");
-        if (!am_file)
+    }
+    if (!am_file)
+    {
+        print_error_no_line(ERROR_FILE_READ);
+        context->success = FALSE;
+    }
+    else
+    {
+        rewind(am_file); /* ensure reading from the start */
+
+        /* the context's encodings stay cached from file to file */
+        set_current_encode_cache(&context->encode_cache);
+        if (!first_pass(am_file, context->vpc, &context->label_table, &context->mcro_table))
         {
-            print_error_no_line(ERROR_FILE_READ);
-            success = FALSE;
+            context->success = FALSE;
+        }
+        set_current_encode_cache(NULL);
+        /* past the error limit, or on any error with --fail-fast, the second pass is skipped */
+        if (diagnostics_stopped() || (!context->success && context->options->fail_fast))
+        {
+            context->success = FALSE;
         }
-        else
+        else if (!second_pass(am_file, &context->label_table, context->vpc))
         {
-            rewind(am_file); /* ensure reading from the start */
+            context->success = FALSE;
+        }
+        if (context->success)
+        {
+            fill_addresses_words(am_file, &context->label_table, context->vpc);
+        }
+        fclose(am_file);
+    }
+    release_source(&context->source);
 
-            if (!first_pass(am_file, vpc, &label_table, &mcro_table))
-            { 
-                success = FALSE;
-            }
-            if (!second_pass(am_file, &label_table, vpc))
-            {
-                success = FALSE;
-            }
-            if (success)
-            {
-                fill_addresses_words(am_file, &label_table, vpc);
-            }
-            fclose(am_file);
+    /* report failure if either pass encountered an error */
+    if (!context->success)
+    {
+        print_error_no_line(ERROR_ASSEMBLY_FAILED);
+        finish_file(context);
+    }
+    else /* only generate output files if no errors occurred */
+    {
+        flush_diagnostics(&context->diagnostics); /* warnings come before the writers' results */
+        set_current_sink(NULL);
+        submit_outputs(context); /* the image is frozen from here on */
+    }
+}
+
+/**
+ * @brief Converts every file between the binary, compressed and text object forms.
+ *
+ * @return TRUE (1) if every file was converted, FALSE (0) otherwise.
+ */
+static int convert_files(const AssemblerOptions *options)
+{
+    int i, success = TRUE;
+
+    for (i = 0; i < options->file_count; i++)
+    {
+        if (options->mode == MODE_OBB_TO_TEXT && !convert_binary_to_text(options->files[i]))
+        {
+            success = FALSE;
+        }
+        else if (options->mode == MODE_TEXT_TO_OBB && !convert_text_to_binary(options->files[i]))
+        {
+            success = FALSE;
+        }
+        else if (options->mode == MODE_EXPAND_OBZ && !expand_compressed_object_file(options->files[i]))
+        {
+            success = FALSE;
+        }
+        else if (options->mode == MODE_COMPILE_MLIB && !compile_macro_library(options->files[i]))
+        {
+            success = FALSE;
         }
+    }
+    return success;
+}
+
+/**
+ * @brief Allocates the contexts and starts the worker threads, once per process.
+ *
+ * @param jobs Number of files assembled at the same time.
+ * @param options The options every context points at.
+ * @return TRUE (1) on success, FALSE (0) otherwise (the error is printed).
+ */
+static int start_pools(int jobs, const AssemblerOptions *options)
+{
+    if (pools_started)
+    {
+        return TRUE; /* a server keeps them from request to request */
+    }
+
+    /* one context (and VirtualPC) per file assembled at the same time */
+    if (!init_context_pool(&context_pool, jobs, options))
+    {
+        return FALSE;
+    }
+
+    /* the threads expanding the macros of a file share the processors with the other files */
+    set_expansion_threads(jobs);
+
+    /* enough threads for every writer of a file to run at once */
+    if (!init_task_pool(&task_pool, jobs > OUTPUT_KIND_COUNT ? jobs : OUTPUT_KIND_COUNT))
+    {
+        destroy_context_pool(&context_pool);
+        return FALSE;
+    }
+    pools_started = TRUE;
+    return TRUE;
+}
+
+/**
+ * @brief Waits for the running tasks, stops the worker threads and frees the contexts.
+ */
+static void stop_pools(void)
+{
+    if (pools_started)
+    {
+        destroy_task_pool(&task_pool);
+        destroy_context_pool(&context_pool);
+        pools_started = FALSE;
+    }
+}
+
+/**
+ * @brief Assembles every file of the options on the pools.
+ *
+ * @return TRUE (1) if the last file was assembled and every output synced, FALSE (0) otherwise.
+ */
+static int assemble_files(const AssemblerOptions *options)
+{
+    int i;
+    int success;
+    int *results;
+    AssemblyContext *context;
+    SourceReader source_reader;
+
+    /* the libraries are mapped once for the batch: startup does not grow with their size */
+    if (!map_macro_libraries(options->mlibs, options->mlib_count, &macro_libraries))
+    {
+        return FALSE;
+    }
+    macro_library_count = options->mlib_count;
 
-        /* report failure if either pass encountered an error */
-        if (!success)
+    results = (int *)malloc(options->file_count * sizeof(int));
+    if (!results)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        unmap_macro_libraries(macro_libraries, macro_library_count);
+        macro_libraries = NULL;
+        macro_library_count = 0;
+        return FALSE;
+    }
+
+    /* the first stage of the pipeline: sources are read ahead on their own thread */
+    if (!start_source_reader(&source_reader, options->files, options->file_count, SOURCE_READ_AHEAD))
+    {
+        free(results);
+        unmap_macro_libraries(macro_libraries, macro_library_count);
+        macro_libraries = NULL;
+        macro_library_count = 0;
+        return FALSE;
+    }
+
+    /* iterate over each provided assembly file */
+    for (i = 0; i < options->file_count; i++)
+    {
+        context = acquire_context(&context_pool); /* waits for a previous file to finish */
+        next_source(&source_reader, &context->source); /* waits for the reader */
+        context->filename = options->files[i];
+        context->result = &results[i];
+
+        if (!submit_task(&task_pool, assemble_task, context))
         {
-            print_error_no_line(ERROR_ASSEMBLY_FAILED);
+            assemble_task(context);
         }
-        else /* only generate output files if no errors occurred */
+    }
+
+    /* wait for every file and its outputs */
+    wait_task_pool(&task_pool);
+    stop_source_reader(&source_reader);
+    release_included_files(); /* shared by the files of this batch only */
+    unmap_macro_libraries(macro_libraries, macro_library_count);
+    macro_libraries = NULL;
+    macro_library_count = 0;
+
+    /* the exit status follows the last file, as when files were assembled one at a time */
+    success = results[options->file_count - 1];
+
+    /* one durability barrier for the whole run rather than one per file */
+    if (options->fsync && !sync_output_files())
+    {
+        success = FALSE;
+    }
+
+    free(results);
+    return success;
+}
+
+/**
+ * @brief Prints the instrumentation counters of the contexts (--stats).
+ *
+ * The contexts keep their counters from run to run, so under --serve and
+ * --watch the counts cover everything assembled since the pools started.
+ */
+static void print_stats(void)
+{
+    int i;
+    unsigned long lookups = 0, hits = 0;
+
+    for (i = 0; i < context_pool.count; i++)
+    {
+        lookups += context_pool.contexts[i].encode_cache.lookups;
+        hits += context_pool.contexts[i].encode_cache.hits;
+    }
+    printf("\nInstruction encoding cache: %lu lookups, %lu hits (%.1f%%), %d entries per context\n",
+           lookups, hits, lookups > 0 ? 100.0 * hits / lookups : 0.0, ENCODE_CACHE_SIZE);
+}
+
+/**
+ * @brief Runs the files of a parsed command line: assembles or converts them.
+ *
+ * @return TRUE (1) on success, FALSE (0) otherwise.
+ */
+static int run_files(const AssemblerOptions *options)
+{
+    int success;
+
+    /* ensure at least one assembly file is provided */
+    if (options->file_count == 0)
+    {
+        print_error(ERROR_MISSING_AS_FILE, 0);
+        return FALSE;
+    }
+
+    /* conversion between the binary, compressed and text object forms */
+    if (options->mode != MODE_ASSEMBLE)
+    {
+        return convert_files(options);
+    }
+
+    if (!start_pools(options->jobs, options))
+    {
+        return FALSE;
+    }
+    success = assemble_files(options);
+    if (options->stats)
+    {
+        print_stats();
+    }
+    return success;
+}
+
+/**
+ * @brief Watch handler: assembles the changed sources on the warm contexts.
+ */
+static int assemble_changed(char **files, int count)
+{
+    AssemblerOptions batch;
+    int success;
+
+    batch = *watch_options;
+    batch.files = files;
+    batch.file_count = count;
+    success = assemble_files(&batch);
+
+    /* every batch is a complete report, for SARIF a log of its own */
+    close_diagnostics_output();
+    set_diagnostics_format(watch_options->diagnostics_format);
+    return success;
+}
+
+/**
+ * @brief Server request handler: runs a client's command line on the warm contexts.
+ *
+ * The contexts point at request_options, so each request parses into it.
+ * Their number was fixed by --serve, a -j of the request is not applied.
+ */
+static int serve_request(int argc, char *argv[])
+{
+    int success;
+
+    set_diagnostics_format(DIAGNOSTICS_TEXT); /* for errors in the command line */
+    if (!parse_options(argc, argv, &request_options))
+    {
+        close_diagnostics_output();
+        return EXIT_FAILURE;
+    }
+    if (request_options.serve || request_options.watch)
+    {
+        print_error_no_line(ERROR_INVALID_OPTION_VALUE); /* a request must end */
+        close_diagnostics_output();
+        free_options(&request_options);
+        return EXIT_FAILURE;
+    }
+
+    set_diagnostics_format(request_options.diagnostics_format);
+    set_write_if_changed(request_options.write_if_changed);
+    set_batched_output(request_options.batch_output);
+    set_sync_outputs(request_options.fsync);
+
+    success = run_files(&request_options);
+
+    close_diagnostics_output();
+    free_options(&request_options);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    int success;
+    int status;
+    AssemblerOptions options;
+    char socket_path[SOCKET_PATH_SIZE];
+
+    if (!parse_options(argc, argv, &options))
+    {
+        return EXIT_FAILURE;
+    }
+    if (options.socket_path == NULL && (options.client || options.serve))
+    {
+        options.socket_path = default_socket_path(socket_path, options.serve);
+    }
+
+    /* a running server does the work; without one the client assembles here */
+    if (options.client && !options.serve && options.socket_path && run_client(options.socket_path, argc, argv, &status))
+    {
+        free_options(&options);
+        return status;
+    }
+
+    /* every exit path writes out (and for SARIF, closes) the buffered diagnostics */
+    set_diagnostics_format(options.diagnostics_format);
+    atexit(close_diagnostics_output);
+    set_write_if_changed(options.write_if_changed);
+    set_batched_output(options.batch_output);
+    set_sync_outputs(options.fsync);
+
+    /* the contexts and threads stay warm from one request to the next */
+    if (options.serve)
+    {
+        if (options.socket_path && start_pools(options.jobs, &request_options))
         {
-            generate_object_file(vpc, argv[i]);
-            generate_entry_file(&label_table, argv[i]);
-            generate_externals_file(vpc, &label_table, argv[i]);
+            run_server(options.socket_path, serve_request);
         }
+        stop_pools();
+        free_options(&options);
+        return EXIT_FAILURE; /* the server only returns if it could not listen */
+    }
 
+    /* the contexts and threads stay warm from one batch of changes to the next */
+    if (options.watch && options.mode == MODE_ASSEMBLE && options.file_count > 0)
+    {
+        if (start_pools(options.jobs, &options))
+        {
+            watch_options = &options;
+            run_watch(options.files, options.file_count, assemble_changed);
+        }
+        stop_pools();
+        free_options(&options);
+        return EXIT_FAILURE; /* watching only ends if the files could not be watched */
     }
 
+    success = run_files(&options);
+
     /* free allocated memory before program exits */
-    free(vpc); 
+    stop_pools();
+    free_options(&options);
     return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
-
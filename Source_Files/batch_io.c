@@ -0,0 +1,501 @@
+/* Source_Files/batch_io.c */
+#define _POSIX_C_SOURCE 200809L
+#ifdef __linux__
+#define _DEFAULT_SOURCE /* syscall(), io_uring has no libc wrapper */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../Header_Files/batch_io.h"
+#include "../Header_Files/globals.h"
+
+#if defined(__linux__) && defined(__GNUC__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HAVE_IO_URING
+#endif
+#endif
+
+#define OUTPUT_FILE_FLAGS (O_WRONLY | O_CREAT | O_TRUNC)
+#define OUTPUT_FILE_MODE 0666
+
+/**
+ * @brief Writes all of data to a descriptor, starting at offset.
+ *
+ * @return TRUE (1) on success, FALSE (0) otherwise.
+ */
+static int write_all(int fd, const char *data, size_t size, size_t offset)
+{
+    ssize_t written;
+
+    while (offset < size)
+    {
+        written = pwrite(fd, data + offset, size - offset, (off_t)offset);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return FALSE;
+        }
+        offset += (size_t)written;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Writes one file with plain system calls.
+ */
+static void write_file_directly(BatchedWrite *file)
+{
+    int fd = open(file->path, OUTPUT_FILE_FLAGS, OUTPUT_FILE_MODE);
+
+    file->written = FALSE;
+    if (fd < 0)
+    {
+        return;
+    }
+    file->written = write_all(fd, file->data, file->size, 0);
+    if (close(fd) != 0)
+    {
+        file->written = FALSE;
+    }
+}
+
+/**
+ * @brief Syncs one file with plain system calls.
+ */
+static int sync_file_directly(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    int ok;
+
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+    ok = fsync(fd) == 0;
+    if (close(fd) != 0)
+    {
+        ok = FALSE;
+    }
+    return ok;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * @struct Ring
+ * @brief The submission and completion rings shared with the kernel.
+ */
+typedef struct
+{
+    int fd;
+    unsigned int *sq_tail, *sq_mask, *sq_array, sq_entries;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+} Ring;
+
+typedef enum
+{
+    RING_UNTRIED,
+    RING_READY,
+    RING_UNAVAILABLE
+} RingState;
+
+/* one ring for the process, batches from different threads take turns */
+static Ring ring;
+static RingState ring_state = RING_UNTRIED;
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Creates the ring and maps it.
+ *
+ * @return TRUE (1) if io_uring is usable, FALSE (0) otherwise.
+ */
+static int setup_ring(void)
+{
+    struct io_uring_params params;
+    size_t sq_size, cq_size;
+    char *sq_ring, *cq_ring;
+    void *sqes;
+    long fd;
+
+    memset(&params, 0, sizeof(params));
+    fd = syscall(__NR_io_uring_setup, BATCH_IO_RING_SIZE, &params);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+
+    sq_ring = (char *)mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED, (int)fd, IORING_OFF_SQ_RING);
+    cq_ring = sq_ring;
+    if (sq_ring != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        cq_ring = (char *)mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED, (int)fd, IORING_OFF_CQ_RING);
+    }
+    sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED,
+                (int)fd, IORING_OFF_SQES);
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        close((int)fd); /* the process keeps the few mapped pages, it falls back for good */
+        return FALSE;
+    }
+
+    ring.fd = (int)fd;
+    ring.sq_tail = (unsigned int *)(sq_ring + params.sq_off.tail);
+    ring.sq_mask = (unsigned int *)(sq_ring + params.sq_off.ring_mask);
+    ring.sq_array = (unsigned int *)(sq_ring + params.sq_off.array);
+    ring.sq_entries = params.sq_entries;
+    ring.cq_head = (unsigned int *)(cq_ring + params.cq_off.head);
+    ring.cq_tail = (unsigned int *)(cq_ring + params.cq_off.tail);
+    ring.cq_mask = (unsigned int *)(cq_ring + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(cq_ring + params.cq_off.cqes);
+    ring.sqes = (struct io_uring_sqe *)sqes;
+    return TRUE;
+}
+
+/**
+ * @brief Submits up to sq_entries prepared operations and waits for all of them.
+ *
+ * results[i] receives the result of ops[i] (a value or -errno).
+ *
+ * @return TRUE (1) if every operation completed, FALSE (0) if the ring failed.
+ */
+static int run_chunk(const struct io_uring_sqe *ops, int count, int *results)
+{
+    unsigned int tail = *ring.sq_tail, head, index;
+    int i, done = 0, submitted = 0;
+    long result;
+
+    for (i = 0; i < count; i++)
+    {
+        index = tail & *ring.sq_mask;
+        ring.sqes[index] = ops[i];
+        ring.sqes[index].user_data = (unsigned long)i;
+        ring.sq_array[index] = index;
+        tail++;
+    }
+    __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+
+    while (done < count)
+    {
+        /* submit what is left and wait for completions in the same call */
+        result = syscall(__NR_io_uring_enter, ring.fd, (unsigned int)(count - submitted),
+                         (unsigned int)(count - done), IORING_ENTER_GETEVENTS, NULL, 0);
+        if (result < 0 && errno != EINTR)
+        {
+            return FALSE;
+        }
+        if (result > 0)
+        {
+            submitted += (int)result;
+        }
+
+        head = *ring.cq_head;
+        while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE))
+        {
+            const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+            results[cqe->user_data] = cqe->res;
+            head++;
+            done++;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Runs prepared operations through the ring, in chunks of the ring size.
+ *
+ * Called with ring_lock held.
+ *
+ * @return TRUE (1) if every operation completed, FALSE (0) if the ring failed.
+ */
+static int run_ops(const struct io_uring_sqe *ops, int count, int *results)
+{
+    int start, chunk;
+
+    for (start = 0; start < count; start += chunk)
+    {
+        chunk = count - start < (int)ring.sq_entries ? count - start : (int)ring.sq_entries;
+        if (!run_chunk(ops + start, chunk, results + start))
+        {
+            ring_state = RING_UNAVAILABLE;
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Takes the ring for one batch, setting it up on first use.
+ *
+ * @return TRUE (1) with ring_lock held, FALSE (0) if io_uring is unavailable.
+ */
+static int acquire_ring(void)
+{
+    pthread_mutex_lock(&ring_lock);
+    if (ring_state == RING_UNTRIED)
+    {
+        ring_state = setup_ring() ? RING_READY : RING_UNAVAILABLE;
+    }
+    if (ring_state != RING_READY)
+    {
+        pthread_mutex_unlock(&ring_lock);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Prepares an operation on a path or descriptor.
+ */
+static void prepare_op(struct io_uring_sqe *sqe, int opcode, int fd, const void *addr, unsigned int len)
+{
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (unsigned char)opcode;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long)addr;
+    sqe->len = len;
+}
+
+/**
+ * @brief Opens every path with one submission per ring full.
+ *
+ * An opcode the kernel does not know (before 5.6) fails with -EINVAL; the
+ * ring is then given up and every descriptor it opened is closed.
+ *
+ * @return TRUE (1) if the ring ran the opens, FALSE (0) to fall back.
+ */
+static int ring_open(const char *const *paths, int count, int flags, struct io_uring_sqe *ops, int *fds)
+{
+    int i, unsupported = FALSE;
+
+    for (i = 0; i < count; i++)
+    {
+        prepare_op(&ops[i], IORING_OP_OPENAT, AT_FDCWD, paths[i], OUTPUT_FILE_MODE);
+        ops[i].open_flags = (unsigned int)flags;
+    }
+    if (!run_ops(ops, count, fds))
+    {
+        return FALSE;
+    }
+    for (i = 0; i < count; i++)
+    {
+        unsupported |= fds[i] == -EINVAL;
+    }
+    if (unsupported)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (fds[i] >= 0)
+            {
+                close(fds[i]);
+            }
+        }
+        ring_state = RING_UNAVAILABLE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Runs one operation (write or fsync) on every open descriptor, then closes them all.
+ *
+ * ok[i] is cleared for every file whose operation or close failed.
+ */
+static void ring_apply_and_close(int opcode, const int *fds, const BatchedWrite *files, int count,
+                                 struct io_uring_sqe *ops, int *results, int *ok)
+{
+    int i, j, n = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (fds[i] < 0 || (files && files[i].size == 0))
+        {
+            continue;
+        }
+        prepare_op(&ops[n], opcode, fds[i], files ? files[i].data : NULL,
+                   files ? (unsigned int)files[i].size : 0);
+        ops[n].user_data = (unsigned long)i;
+        n++;
+    }
+    if (n > 0 && !run_ops(ops, n, results))
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (fds[i] >= 0)
+            {
+                ok[i] = opcode == IORING_OP_WRITE ? write_all(fds[i], files[i].data, files[i].size, 0)
+                                                  : fsync(fds[i]) == 0;
+            }
+        }
+    }
+    else
+    {
+        /* results are numbered by position, user_data of the op names the file */
+        for (j = 0; j < n; j++)
+        {
+            i = (int)ops[j].user_data;
+            if (opcode == IORING_OP_WRITE)
+            {
+                /* a short write is finished with plain writes */
+                ok[i] = results[j] >= 0 && write_all(fds[i], files[i].data, files[i].size, (size_t)results[j]);
+            }
+            else
+            {
+                ok[i] = results[j] == 0;
+            }
+        }
+    }
+
+    n = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (fds[i] >= 0)
+        {
+            prepare_op(&ops[n++], IORING_OP_CLOSE, fds[i], NULL, 0);
+        }
+    }
+    if (ring_state != RING_READY || !run_ops(ops, n, results))
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (fds[i] >= 0 && close(fds[i]) != 0)
+            {
+                ok[i] = FALSE;
+            }
+        }
+        return;
+    }
+    n = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (fds[i] >= 0 && results[n++] != 0)
+        {
+            ok[i] = FALSE;
+        }
+    }
+}
+
+/**
+ * @brief Writes or syncs a batch through the ring.
+ *
+ * @return TRUE (1) if the ring handled the batch (ok[] is filled in), FALSE (0) to fall back.
+ */
+static int ring_batch(int opcode, const char *const *paths, const BatchedWrite *files, int count, int *ok)
+{
+    struct io_uring_sqe *ops;
+    int *fds, *results, i, handled = FALSE;
+
+    if (!acquire_ring())
+    {
+        return FALSE;
+    }
+
+    ops = (struct io_uring_sqe *)malloc(count * sizeof(struct io_uring_sqe));
+    fds = (int *)malloc(count * sizeof(int));
+    results = (int *)malloc(count * sizeof(int));
+    if (ops && fds && results &&
+        ring_open(paths, count, opcode == IORING_OP_WRITE ? OUTPUT_FILE_FLAGS : O_RDONLY, ops, fds))
+    {
+        for (i = 0; i < count; i++)
+        {
+            ok[i] = fds[i] >= 0;
+        }
+        ring_apply_and_close(opcode, fds, files, count, ops, results, ok);
+        handled = TRUE;
+    }
+    pthread_mutex_unlock(&ring_lock);
+
+    free(ops);
+    free(fds);
+    free(results);
+    return handled;
+}
+
+#endif /* HAVE_IO_URING */
+
+/* Creates (truncates) and writes every file of a batch. */
+int write_files(BatchedWrite *files, int count)
+{
+    int i, all = TRUE;
+
+#ifdef HAVE_IO_URING
+    const char **paths = (const char **)malloc((count > 0 ? count : 1) * sizeof(char *));
+    int *ok = (int *)malloc((count > 0 ? count : 1) * sizeof(int));
+    int handled = FALSE;
+
+    if (paths && ok)
+    {
+        for (i = 0; i < count; i++)
+        {
+            paths[i] = files[i].path;
+        }
+        handled = ring_batch(IORING_OP_WRITE, paths, files, count, ok);
+        for (i = 0; handled && i < count; i++)
+        {
+            files[i].written = ok[i];
+        }
+    }
+    free(paths);
+    free(ok);
+    if (!handled)
+#endif
+    {
+        for (i = 0; i < count; i++)
+        {
+            write_file_directly(&files[i]);
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        all &= files[i].written;
+    }
+    return all;
+}
+
+/* Flushes the given files to stable storage, as one barrier. */
+int sync_files(const char *const *paths, int count)
+{
+    int i, all = TRUE;
+
+#ifdef HAVE_IO_URING
+    int *ok = (int *)malloc((count > 0 ? count : 1) * sizeof(int));
+
+    if (ok && ring_batch(IORING_OP_FSYNC, paths, NULL, count, ok))
+    {
+        for (i = 0; i < count; i++)
+        {
+            all &= ok[i];
+        }
+        free(ok);
+        return all;
+    }
+    free(ok);
+#endif
+
+    for (i = 0; i < count; i++)
+    {
+        all &= sync_file_directly(paths[i]);
+    }
+    return all;
+}
@@ -0,0 +1,477 @@
+/* Source_Files/binary_object.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../Header_Files/binary_object.h"
+#include "../Header_Files/output_builder.h"
+#include "../Header_Files/output_reader.h"
+#include "../Header_Files/output_file.h"
+#include "../Header_Files/label_utils.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+/**
+ * @brief Writes a 16-bit value in little-endian byte order.
+ */
+static void put_u16(FILE *fp, uint16_t value)
+{
+    fputc(value & 0xFF, fp);
+    fputc((value >> 8) & 0xFF, fp);
+}
+
+/**
+ * @brief Writes a 32-bit value in little-endian byte order.
+ */
+static void put_u32(FILE *fp, uint32_t value)
+{
+    fputc(value & 0xFF, fp);
+    fputc((value >> 8) & 0xFF, fp);
+    fputc((value >> 16) & 0xFF, fp);
+    fputc((value >> 24) & 0xFF, fp);
+}
+
+/**
+ * @brief Reads a 16-bit little-endian value.
+ */
+static uint16_t get_u16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief Reads a 32-bit little-endian value.
+ */
+static uint32_t get_u32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Decodes the header at the start of a .obb file, in the order the writer puts its fields.
+ */
+static void read_header(const unsigned char *p, BinaryObjectHeader *header)
+{
+    memcpy(header->magic, p, 4);
+    header->version = get_u16(p + 4);
+    header->header_size = get_u16(p + 6);
+    header->load_address = get_u32(p + 8);
+    header->code_words = get_u32(p + 12);
+    header->data_words = get_u32(p + 16);
+    header->entry_count = get_u32(p + 20);
+    header->extern_count = get_u32(p + 24);
+    header->image_offset = get_u32(p + 28);
+    header->entries_offset = get_u32(p + 32);
+    header->externs_offset = get_u32(p + 36);
+}
+
+/**
+ * @brief Writes a table of symbol records.
+ */
+static void put_symbols(FILE *fp, const BinaryObjectSymbol *symbols, uint32_t count)
+{
+    uint32_t i;
+    for (i = 0; i < count; i++)
+    {
+        fwrite(symbols[i].name, 1, OBB_SYMBOL_NAME_SIZE, fp);
+        put_u32(fp, symbols[i].address);
+    }
+}
+
+/**
+ * @brief Fills a symbol record, padding the name with null bytes.
+ */
+static void set_symbol(BinaryObjectSymbol *symbol, const char *name, uint32_t address)
+{
+    memset(symbol->name, 0, OBB_SYMBOL_NAME_SIZE);
+    strncpy(symbol->name, name, OBB_SYMBOL_NAME_SIZE - 1);
+    symbol->address = address;
+}
+
+/**
+ * @brief Writes a complete .obb file from an image and its symbol tables.
+ *
+ * @return TRUE (1) if the file was written, FALSE (0) otherwise.
+ */
+static int write_binary_object(const char *path, uint32_t code_words, uint32_t data_words, const uint32_t *words,
+                               const BinaryObjectSymbol *entries, uint32_t entry_count,
+                               const BinaryObjectSymbol *externs, uint32_t extern_count)
+{
+    OutputFile file;
+    FILE *fp;
+    uint32_t word_count = code_words + data_words;
+    uint32_t image_end = OBB_HEADER_SIZE + word_count * OBB_WORD_SIZE;
+    uint32_t entries_offset = (image_end + 3) & ~(uint32_t)3; /* align the tables to 4 bytes */
+    uint32_t externs_offset = entries_offset + entry_count * OBB_SYMBOL_SIZE;
+    uint32_t i;
+
+    if (!open_output_file(&file, path))
+    {
+        print_error_no_line(ERROR_BINARY_FILE_CREATE);
+        return FALSE;
+    }
+    fp = file.fp;
+
+    /* header */
+    fwrite(OBB_MAGIC, 1, 4, fp);
+    put_u16(fp, OBB_VERSION);
+    put_u16(fp, OBB_HEADER_SIZE);
+    put_u32(fp, 100);
+    put_u32(fp, code_words);
+    put_u32(fp, data_words);
+    put_u32(fp, entry_count);
+    put_u32(fp, extern_count);
+    put_u32(fp, OBB_HEADER_SIZE);
+    put_u32(fp, entries_offset);
+    put_u32(fp, externs_offset);
+
+    /* packed 24-bit image */
+    for (i = 0; i < word_count; i++)
+    {
+        fputc(words[i] & 0xFF, fp);
+        fputc((words[i] >> 8) & 0xFF, fp);
+        fputc((words[i] >> 16) & 0xFF, fp);
+    }
+    for (i = image_end; i < entries_offset; i++)
+    {
+        fputc(0, fp);
+    }
+
+    put_symbols(fp, entries, entry_count);
+    put_symbols(fp, externs, extern_count);
+
+    if (!close_output_file(&file))
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Writes the assembled image and its symbol tables into a .obb file. */
+OutputStatus generate_binary_object_file(VirtualPC *vpc, LabelTable *label_table, const char *filename)
+{
+    char obb_filename[MAX_FILENAME_LENGTH + 5]; /* +5 for ".obb\0" */
+    uint32_t start_addr = 100;
+    uint32_t end_addr = vpc->IC + vpc->DC;
+    uint32_t *words;
+    BinaryObjectSymbol entries[MAX_LABELS];
+    BinaryObjectSymbol *externs;
+    Label sorted_labels[MAX_LABELS];
+    uint32_t entry_count = 0, extern_count = 0, i;
+    int result;
+
+    sprintf(obb_filename, "%s.obb", filename);
+
+    words = (uint32_t *)malloc((end_addr - start_addr + 1) * sizeof(uint32_t));
+    externs = (BinaryObjectSymbol *)malloc((end_addr - start_addr + 1) * sizeof(BinaryObjectSymbol));
+    if (!words || !externs)
+    {
+        free(words);
+        free(externs);
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return OUTPUT_FAILED;
+    }
+
+    for (i = start_addr; i < end_addr; i++)
+    {
+        Label *label_ptr;
+        words[i - start_addr] = vpc->storage[i].value & 0xFFFFFF;
+
+        /* a word holding an external label reference, as in the .ext file */
+        label_ptr = get_label_by_name(label_table, vpc->storage[i].encoded);
+        if (label_ptr != NULL && label_ptr->address == 0)
+        {
+            set_symbol(&externs[extern_count++], vpc->storage[i].encoded, i);
+        }
+    }
+
+    /* entry labels sorted by address, as in the .ent file */
+    memcpy(sorted_labels, label_table->labels, label_table->count * sizeof(Label));
+    qsort(sorted_labels, label_table->count, sizeof(Label), compare_labels_by_address);
+    for (i = 0; i < (uint32_t)label_table->count; i++)
+    {
+        if (strstr(sorted_labels[i].type, "entry") != NULL)
+        {
+            set_symbol(&entries[entry_count++], sorted_labels[i].name, sorted_labels[i].address);
+        }
+    }
+
+    result = write_binary_object(obb_filename, vpc->IC - 100, vpc->DC, words,
+                                 entries, entry_count, externs, extern_count);
+    free(words);
+    free(externs);
+    return result ? OUTPUT_WRITTEN : OUTPUT_FAILED;
+}
+
+/* Maps a .obb file into memory and validates its header and tables. */
+int map_binary_object(const char *path, BinaryObjectView *view)
+{
+    struct stat st;
+    BinaryObjectHeader *header = &view->header;
+    uint32_t word_count, image_end;
+    int fd;
+
+    memset(view, 0, sizeof(*view));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < OBB_HEADER_SIZE)
+    {
+        close(fd);
+        print_error_no_line(ERROR_BINARY_FILE_INVALID);
+        return FALSE;
+    }
+
+    view->size = (size_t)st.st_size;
+    view->base = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); /* the mapping stays valid after closing the descriptor */
+    if (view->base == MAP_FAILED)
+    {
+        view->base = NULL;
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+
+    /* the sections follow each other exactly as the writer lays them out, up to the end of the file */
+    read_header((const unsigned char *)view->base, header);
+    word_count = header->code_words + header->data_words;
+    image_end = OBB_HEADER_SIZE + word_count * OBB_WORD_SIZE;
+    if (memcmp(header->magic, OBB_MAGIC, 4) != 0 ||
+        header->version != OBB_VERSION ||
+        header->header_size != OBB_HEADER_SIZE ||
+        header->image_offset != OBB_HEADER_SIZE ||
+        word_count < header->code_words || word_count > STORAGE_SIZE ||
+        header->entries_offset != ((image_end + 3) & ~(uint32_t)3) ||
+        header->entries_offset > view->size ||
+        header->entry_count > (view->size - header->entries_offset) / OBB_SYMBOL_SIZE ||
+        header->externs_offset != header->entries_offset + header->entry_count * OBB_SYMBOL_SIZE ||
+        header->extern_count > (view->size - header->externs_offset) / OBB_SYMBOL_SIZE ||
+        view->size != (size_t)header->externs_offset + (size_t)header->extern_count * OBB_SYMBOL_SIZE)
+    {
+        unmap_binary_object(view);
+        print_error_no_line(ERROR_BINARY_FILE_INVALID);
+        return FALSE;
+    }
+
+    view->image = (const unsigned char *)view->base + header->image_offset;
+    view->entries = (const unsigned char *)view->base + header->entries_offset;
+    view->externs = (const unsigned char *)view->base + header->externs_offset;
+    return TRUE;
+}
+
+/* Releases a mapping created by map_binary_object. */
+void unmap_binary_object(BinaryObjectView *view)
+{
+    if (view->base)
+    {
+        munmap(view->base, view->size);
+    }
+    memset(view, 0, sizeof(*view));
+}
+
+/* Returns the image word at the given index of a mapped binary object. */
+uint32_t binary_object_word(const BinaryObjectView *view, uint32_t index)
+{
+    const unsigned char *p = view->image + index * OBB_WORD_SIZE;
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+/* Decodes a record of the entry or extern table of a mapped binary object. */
+void binary_object_symbol(const unsigned char *table, uint32_t index, BinaryObjectSymbol *symbol)
+{
+    const unsigned char *p = table + (size_t)index * OBB_SYMBOL_SIZE;
+
+    memcpy(symbol->name, p, OBB_SYMBOL_NAME_SIZE);
+    symbol->name[OBB_SYMBOL_NAME_SIZE - 1] = '\0';
+    symbol->address = get_u32(p + OBB_SYMBOL_NAME_SIZE);
+}
+
+/**
+ * @brief Writes a symbol table as a text file, one "name address" per line.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the file could not be created.
+ */
+static int write_symbol_text(const char *path, const unsigned char *table, uint32_t count, ErrorCode create_error)
+{
+    BinaryObjectSymbol symbol;
+    FILE *fp;
+    uint32_t i;
+
+    fp = fopen(path, "w");
+    if (!fp)
+    {
+        print_error_no_line(create_error);
+        return FALSE;
+    }
+    for (i = 0; i < count; i++)
+    {
+        binary_object_symbol(table, i, &symbol);
+        fprintf(fp, "%s %07u\n", symbol.name, (unsigned int)symbol.address);
+    }
+    fclose(fp);
+    return TRUE;
+}
+
+/* Converts filename.obb into filename.ob, filename.ent and filename.ext. */
+int convert_binary_to_text(const char *filename)
+{
+    char path[MAX_FILENAME_LENGTH + 5];
+    BinaryObjectView view;
+    FILE *ob_file;
+    uint32_t i, word_count;
+    int result = TRUE;
+
+    sprintf(path, "%s.obb", filename);
+    if (!map_binary_object(path, &view))
+    {
+        return FALSE;
+    }
+
+    sprintf(path, "%s.ob", filename);
+    ob_file = fopen(path, "w");
+    if (!ob_file)
+    {
+        unmap_binary_object(&view);
+        print_error_no_line(ERROR_OBJECT_FILE_CREATE);
+        return FALSE;
+    }
+    fprintf(ob_file, "%7d %d\n", (int)view.header.code_words, (int)view.header.data_words);
+    word_count = view.header.code_words + view.header.data_words;
+    for (i = 0; i < word_count; i++)
+    {
+        fprintf(ob_file, "%07d %06x\n", (int)(view.header.load_address + i), (unsigned int)binary_object_word(&view, i));
+    }
+    fclose(ob_file);
+
+    if (view.header.entry_count > 0)
+    {
+        sprintf(path, "%s.ent", filename);
+        result &= write_symbol_text(path, view.entries, view.header.entry_count, ERROR_ENTRY_FILE_CREATE);
+    }
+    if (view.header.extern_count > 0)
+    {
+        sprintf(path, "%s.ext", filename);
+        result &= write_symbol_text(path, view.externs, view.header.extern_count, ERROR_EXTERNAL_FILE_CREATE);
+    }
+
+    unmap_binary_object(&view);
+    return result;
+}
+
+/**
+ * @brief Reads a .ent or .ext file into a growing symbol array.
+ *
+ * A missing file is not an error, it stands for an empty table.
+ *
+ * @return TRUE (1) on success, FALSE (0) on a malformed file or allocation failure.
+ */
+static int read_symbol_text(const char *path, SymbolFileKind kind, BinaryObjectSymbol **symbols, uint32_t *count)
+{
+    SymbolReader reader;
+    Label label;
+    uint32_t capacity = 0;
+    int malformed;
+
+    *symbols = NULL;
+    *count = 0;
+
+    if (!open_symbol_reader(path, kind, &reader))
+    {
+        return TRUE;
+    }
+
+    while (next_symbol(&reader, &label))
+    {
+        if (*count == capacity)
+        {
+            BinaryObjectSymbol *grown;
+            capacity = capacity ? capacity * 2 : 16;
+            grown = (BinaryObjectSymbol *)realloc(*symbols, capacity * sizeof(BinaryObjectSymbol));
+            if (!grown)
+            {
+                close_symbol_reader(&reader);
+                print_error_no_line(ERROR_MEMORY_ALLOCATION);
+                return FALSE;
+            }
+            *symbols = grown;
+        }
+        set_symbol(&(*symbols)[(*count)++], label.name, label.address);
+    }
+    malformed = reader.text.error;
+    close_symbol_reader(&reader);
+
+    if (malformed)
+    {
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Converts filename.ob, filename.ent and filename.ext into filename.obb. */
+int convert_text_to_binary(const char *filename)
+{
+    char path[MAX_FILENAME_LENGTH + 5];
+    ObjectReader ob_reader;
+    uint32_t address;
+    Word word;
+    uint32_t *words = NULL;
+    uint32_t i = 0, entry_count = 0, extern_count = 0;
+    BinaryObjectSymbol *entries = NULL, *externs = NULL;
+    int result = FALSE;
+
+    sprintf(path, "%s.ob", filename);
+    if (!open_object_reader(path, &ob_reader))
+    {
+        return FALSE;
+    }
+
+    words = (uint32_t *)malloc((ob_reader.code_words + ob_reader.data_words + 1) * sizeof(uint32_t));
+    if (!words)
+    {
+        close_object_reader(&ob_reader);
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+
+    /* the reader checks that every line holds the next consecutive address */
+    while (next_object_word(&ob_reader, &address, &word))
+    {
+        words[i++] = (uint32_t)word.value & 0xFFFFFF;
+    }
+
+    if (i != ob_reader.code_words + ob_reader.data_words)
+    {
+        print_error_no_line(ERROR_FILE_READ);
+    }
+    else
+    {
+        sprintf(path, "%s.ent", filename);
+        if (read_symbol_text(path, SYMBOLS_ENTRY, &entries, &entry_count))
+        {
+            sprintf(path, "%s.ext", filename);
+            if (read_symbol_text(path, SYMBOLS_EXTERNAL, &externs, &extern_count))
+            {
+                sprintf(path, "%s.obb", filename);
+                result = write_binary_object(path, ob_reader.code_words, ob_reader.data_words, words,
+                                             entries, entry_count, externs, extern_count);
+            }
+        }
+    }
+
+    close_object_reader(&ob_reader);
+    free(words);
+    free(entries);
+    free(externs);
+    return result;
+}
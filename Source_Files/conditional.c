@@ -0,0 +1,531 @@
+/* Source_Files/conditional.c */
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../Header_Files/conditional.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+#define MAX_SYMBOL_VALUE 100000000L /* larger integers are not accepted */
+
+/**
+ * @enum DirectiveKind
+ * @brief The conditional directives.
+ */
+typedef enum
+{
+    DIRECTIVE_NONE,
+    DIRECTIVE_IF,
+    DIRECTIVE_IFDEF,
+    DIRECTIVE_IFNDEF,
+    DIRECTIVE_ELIF,
+    DIRECTIVE_ELSE,
+    DIRECTIVE_ENDIF,
+    DIRECTIVE_DEFINE,
+    DIRECTIVE_UNDEF
+} DirectiveKind;
+
+/* the directive names, in the order of DirectiveKind */
+static const char *directive_names[] = {
+    "", ".if", ".ifdef", ".ifndef", ".elif", ".else", ".endif", ".define", ".undef"
+};
+
+/**
+ * @brief Checks whether a position ends a word: the end of the line, a blank or a comment.
+ */
+static int ends_word(const char *ptr, const char *end)
+{
+    return ptr == end || *ptr == ' ' || *ptr == '\t' || *ptr == ';' || *ptr == '\n' || *ptr == '\r';
+}
+
+/**
+ * @brief Recognizes the directive a '.' starts, advancing past its name.
+ */
+static DirectiveKind directive_kind(const char **ptr, const char *end)
+{
+    size_t length;
+    int kind;
+
+    for (kind = DIRECTIVE_IF; kind <= DIRECTIVE_UNDEF; kind++)
+    {
+        length = strlen(directive_names[kind]);
+        if ((size_t)(end - *ptr) >= length && strncmp(*ptr, directive_names[kind], length) == 0 &&
+            ends_word(*ptr + length, end))
+        {
+            *ptr += length;
+            return (DirectiveKind)kind;
+        }
+    }
+    return DIRECTIVE_NONE;
+}
+
+/**
+ * @brief Skips blanks.
+ */
+static const char *skip_blanks(const char *ptr, const char *end)
+{
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+    {
+        ptr++;
+    }
+    return ptr;
+}
+
+/**
+ * @brief Checks that nothing but blanks and a comment is left on a line.
+ */
+static int at_line_end(const char *ptr, const char *end)
+{
+    ptr = skip_blanks(ptr, end);
+    return ptr == end || *ptr == ';' || *ptr == '\n' || *ptr == '\r';
+}
+
+/**
+ * @brief Reads a symbol name.
+ *
+ * @param name Receives the name, MAX_SYMBOL_LENGTH + 1 bytes.
+ * @return TRUE (1) for a valid name, FALSE (0) otherwise.
+ */
+static int read_symbol_name(const char **ptr, const char *end, char *name)
+{
+    const char *start = *ptr;
+
+    if (start == end || !(isalpha((unsigned char)*start) || *start == '_'))
+    {
+        return FALSE;
+    }
+    while (*ptr < end && (isalnum((unsigned char)**ptr) || **ptr == '_'))
+    {
+        (*ptr)++;
+    }
+    if (*ptr - start > MAX_SYMBOL_LENGTH)
+    {
+        return FALSE;
+    }
+    memcpy(name, start, (size_t)(*ptr - start));
+    name[*ptr - start] = '\0';
+    return TRUE;
+}
+
+/**
+ * @brief Reads an integer, optionally signed, without reading past the line.
+ *
+ * @return TRUE (1) for a valid integer, FALSE (0) otherwise.
+ */
+static int read_integer(const char **ptr, const char *end, long *value)
+{
+    int negative = FALSE;
+
+    if (*ptr < end && (**ptr == '+' || **ptr == '-'))
+    {
+        negative = **ptr == '-';
+        (*ptr)++;
+    }
+    if (*ptr == end || !isdigit((unsigned char)**ptr))
+    {
+        return FALSE;
+    }
+    *value = 0;
+    while (*ptr < end && isdigit((unsigned char)**ptr))
+    {
+        *value = *value * 10 + (**ptr - '0');
+        if (*value > MAX_SYMBOL_VALUE)
+        {
+            return FALSE;
+        }
+        (*ptr)++;
+    }
+    if (negative)
+    {
+        *value = -*value;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Finds a symbol by name.
+ *
+ * @return The symbol, or NULL if it is not defined.
+ */
+static ConditionalSymbol *find_symbol(const Conditions *conditions, const char *name)
+{
+    int i;
+
+    for (i = 0; i < conditions->symbol_count; i++)
+    {
+        if (strcmp(conditions->symbols[i].name, name) == 0)
+        {
+            return &conditions->symbols[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Defines a symbol, or changes its value.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int define_symbol(Conditions *conditions, const char *name, long value)
+{
+    ConditionalSymbol *symbol = find_symbol(conditions, name);
+
+    if (!symbol)
+    {
+        if (conditions->symbol_count == conditions->symbol_capacity)
+        {
+            int capacity = conditions->symbol_capacity ? conditions->symbol_capacity * 2 : 16;
+            ConditionalSymbol *grown = (ConditionalSymbol *)realloc(conditions->symbols, capacity * sizeof(ConditionalSymbol));
+            if (!grown)
+            {
+                return FALSE;
+            }
+            conditions->symbols = grown;
+            conditions->symbol_capacity = capacity;
+        }
+        symbol = &conditions->symbols[conditions->symbol_count++];
+        strcpy(symbol->name, name);
+    }
+    symbol->value = value;
+    return TRUE;
+}
+
+/**
+ * @brief Removes a symbol, if it is defined.
+ */
+static void undefine_symbol(Conditions *conditions, const char *name)
+{
+    ConditionalSymbol *symbol = find_symbol(conditions, name);
+
+    if (symbol)
+    {
+        *symbol = conditions->symbols[--conditions->symbol_count];
+    }
+}
+
+/**
+ * @brief Reads an operand of an expression: an integer, or a symbol (0 if undefined).
+ *
+ * @return TRUE (1) for a valid operand, FALSE (0) otherwise.
+ */
+static int read_operand(const Conditions *conditions, const char **ptr, const char *end, long *value)
+{
+    char name[MAX_SYMBOL_LENGTH + 1];
+    const ConditionalSymbol *symbol;
+
+    *ptr = skip_blanks(*ptr, end);
+    if (*ptr < end && (isdigit((unsigned char)**ptr) || **ptr == '+' || **ptr == '-'))
+    {
+        return read_integer(ptr, end, value);
+    }
+    if (!read_symbol_name(ptr, end, name))
+    {
+        return FALSE;
+    }
+    symbol = find_symbol(conditions, name);
+    *value = symbol ? symbol->value : 0;
+    return TRUE;
+}
+
+/**
+ * @brief Evaluates the expression of an .if or .elif: [!]operand [op operand].
+ *
+ * @return TRUE (1) for a valid expression, FALSE (0) otherwise.
+ */
+static int evaluate_expression(const Conditions *conditions, const char *ptr, const char *end, int *result)
+{
+    long left, right;
+    char op[3];
+    size_t op_length = 0;
+
+    ptr = skip_blanks(ptr, end);
+    if (ptr < end && *ptr == '!' && (ptr + 1 == end || ptr[1] != '='))
+    {
+        ptr++;
+        if (!read_operand(conditions, &ptr, end, &left) || !at_line_end(ptr, end))
+        {
+            return FALSE;
+        }
+        *result = left == 0;
+        return TRUE;
+    }
+    if (!read_operand(conditions, &ptr, end, &left))
+    {
+        return FALSE;
+    }
+    if (at_line_end(ptr, end))
+    {
+        *result = left != 0;
+        return TRUE;
+    }
+
+    /* a comparison */
+    ptr = skip_blanks(ptr, end);
+    while (ptr < end && op_length < 2 && *ptr && strchr("=!<>", *ptr))
+    {
+        op[op_length++] = *ptr++;
+    }
+    op[op_length] = '\0';
+    if (!read_operand(conditions, &ptr, end, &right) || !at_line_end(ptr, end))
+    {
+        return FALSE;
+    }
+    if (strcmp(op, "==") == 0)
+        *result = left == right;
+    else if (strcmp(op, "!=") == 0)
+        *result = left != right;
+    else if (strcmp(op, "<") == 0)
+        *result = left < right;
+    else if (strcmp(op, "<=") == 0)
+        *result = left <= right;
+    else if (strcmp(op, ">") == 0)
+        *result = left > right;
+    else if (strcmp(op, ">=") == 0)
+        *result = left >= right;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+/**
+ * @brief Evaluates the condition of an .if, .ifdef, .ifndef or .elif.
+ *
+ * @return The condition; a malformed one is reported and is false.
+ */
+static int evaluate_condition(Conditions *conditions, DirectiveKind kind, const char *ptr, const char *end, int source_line)
+{
+    char name[MAX_SYMBOL_LENGTH + 1];
+    int result = FALSE;
+
+    if (kind == DIRECTIVE_IFDEF || kind == DIRECTIVE_IFNDEF)
+    {
+        ptr = skip_blanks(ptr, end);
+        if (read_symbol_name(&ptr, end, name) && at_line_end(ptr, end))
+        {
+            return (find_symbol(conditions, name) != NULL) == (kind == DIRECTIVE_IFDEF);
+        }
+    }
+    else if (evaluate_expression(conditions, ptr, end, &result))
+    {
+        return result;
+    }
+    print_error(ERROR_COND_SYNTAX, source_line);
+    conditions->valid = FALSE;
+    return FALSE;
+}
+
+/**
+ * @brief Handles a .define or .undef of an assembled block.
+ */
+static void handle_definition(Conditions *conditions, DirectiveKind kind, const char *ptr, const char *end, int source_line)
+{
+    char name[MAX_SYMBOL_LENGTH + 1];
+    long value = 1;
+
+    ptr = skip_blanks(ptr, end);
+    if (!read_symbol_name(&ptr, end, name))
+    {
+        print_error(ERROR_DEFINE_SYNTAX, source_line);
+        conditions->valid = FALSE;
+        return;
+    }
+    if (kind == DIRECTIVE_UNDEF)
+    {
+        if (!at_line_end(ptr, end))
+        {
+            print_error(ERROR_DEFINE_SYNTAX, source_line);
+            conditions->valid = FALSE;
+            return;
+        }
+        undefine_symbol(conditions, name);
+        return;
+    }
+
+    /* an optional value */
+    if (!at_line_end(ptr, end))
+    {
+        ptr = skip_blanks(ptr, end);
+        if (!read_integer(&ptr, end, &value) || !at_line_end(ptr, end))
+        {
+            print_error(ERROR_DEFINE_SYNTAX, source_line);
+            conditions->valid = FALSE;
+            return;
+        }
+    }
+    if (!define_symbol(conditions, name, value))
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        conditions->valid = FALSE;
+    }
+}
+
+/* Parses a -D value, NAME or NAME=value. */
+int parse_symbol_definition(const char *text, char *name, long *value)
+{
+    const char *end = text + strlen(text);
+
+    *value = 1;
+    if (!read_symbol_name(&text, end, name))
+    {
+        return FALSE;
+    }
+    if (text == end)
+    {
+        return TRUE;
+    }
+    return *text++ == '=' && read_integer(&text, end, value) && text == end;
+}
+
+/* Checks quickly whether a source may hold a conditional directive. */
+int has_conditional_directive(const char *data, size_t size)
+{
+    const char *ptr = data, *end = data + size, *name;
+
+    while (ptr < end && (ptr = (const char *)memchr(ptr, '.', (size_t)(end - ptr))) != NULL)
+    {
+        name = ptr;
+        if (directive_kind(&name, end) != DIRECTIVE_NONE)
+        {
+            return TRUE;
+        }
+        ptr++;
+    }
+    return FALSE;
+}
+
+/* Prepares the conditions of a source, with the -D symbols defined. */
+int init_conditions(Conditions *conditions, char *const *defines, int define_count)
+{
+    char name[MAX_SYMBOL_LENGTH + 1];
+    long value;
+    int i;
+
+    conditions->symbols = NULL;
+    conditions->symbol_count = 0;
+    conditions->symbol_capacity = 0;
+    conditions->depth = 0;
+    conditions->floor = 0;
+    conditions->active = TRUE;
+    conditions->valid = TRUE;
+
+    for (i = 0; i < define_count; i++)
+    {
+        if (parse_symbol_definition(defines[i], name, &value) && !define_symbol(conditions, name, value))
+        {
+            free_conditions(conditions);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Handles a line if it is a conditional directive. */
+int handle_conditional_directive(Conditions *conditions, const char *line, const char *end, int source_line)
+{
+    const char *ptr = skip_blanks(line, end);
+    ConditionalBlock *block;
+    DirectiveKind kind;
+
+    /* most lines, and every line of a skipped block but its directives, stop here */
+    if (ptr == end || *ptr != '.' || (kind = directive_kind(&ptr, end)) == DIRECTIVE_NONE)
+    {
+        return FALSE;
+    }
+
+    if (kind == DIRECTIVE_DEFINE || kind == DIRECTIVE_UNDEF)
+    {
+        if (conditions->active)
+        {
+            handle_definition(conditions, kind, ptr, end, source_line);
+        }
+        return TRUE;
+    }
+
+    if (kind == DIRECTIVE_IF || kind == DIRECTIVE_IFDEF || kind == DIRECTIVE_IFNDEF)
+    {
+        if (conditions->depth == MAX_CONDITION_DEPTH)
+        {
+            print_error(ERROR_COND_TOO_DEEP, source_line);
+            conditions->valid = FALSE;
+            return TRUE;
+        }
+        block = &conditions->blocks[conditions->depth++];
+        block->parent_active = conditions->active;
+        block->in_else = FALSE;
+        block->line = source_line;
+
+        /* the condition of a block inside a skipped one is not even read */
+        block->taken = conditions->active && evaluate_condition(conditions, kind, ptr, end, source_line);
+        conditions->active = block->taken;
+        return TRUE;
+    }
+
+    /* .elif, .else and .endif continue the innermost block of this file */
+    if (conditions->depth == conditions->floor)
+    {
+        print_error(ERROR_COND_WITHOUT_IF, source_line);
+        conditions->valid = FALSE;
+        return TRUE;
+    }
+    block = &conditions->blocks[conditions->depth - 1];
+    if (kind != DIRECTIVE_ENDIF && block->in_else)
+    {
+        print_error(ERROR_COND_AFTER_ELSE, source_line);
+        conditions->valid = FALSE;
+        return TRUE;
+    }
+    if (kind != DIRECTIVE_ELIF && block->parent_active && !at_line_end(ptr, end))
+    {
+        print_error(ERROR_COND_SYNTAX, source_line);
+        conditions->valid = FALSE;
+    }
+
+    if (kind == DIRECTIVE_ELIF)
+    {
+        conditions->active = block->parent_active && !block->taken && evaluate_condition(conditions, kind, ptr, end, source_line);
+        block->taken = block->taken || conditions->active;
+    }
+    else if (kind == DIRECTIVE_ELSE)
+    {
+        conditions->active = block->parent_active && !block->taken;
+        block->taken = TRUE;
+        block->in_else = TRUE;
+    }
+    else
+    {
+        conditions->active = block->parent_active;
+        conditions->depth--;
+    }
+    return TRUE;
+}
+
+/* Starts reading a file: the blocks open so far cannot be closed in it. */
+int begin_conditional_file(Conditions *conditions)
+{
+    int floor = conditions->floor;
+
+    conditions->floor = conditions->depth;
+    return floor;
+}
+
+/* Ends a file: reports and closes the blocks it left open. */
+void end_conditional_file(Conditions *conditions, int floor, int source_line)
+{
+    while (conditions->depth > conditions->floor)
+    {
+        conditions->depth--;
+        print_error(ERROR_COND_UNTERMINATED, source_line ? source_line : conditions->blocks[conditions->depth].line);
+        conditions->valid = FALSE;
+        conditions->active = conditions->blocks[conditions->depth].parent_active;
+    }
+    conditions->floor = floor;
+}
+
+/* Releases the symbols of the conditions. */
+void free_conditions(Conditions *conditions)
+{
+    free(conditions->symbols);
+    conditions->symbols = NULL;
+    conditions->symbol_count = 0;
+    conditions->symbol_capacity = 0;
+}
@@ -0,0 +1,131 @@
+/* Source_Files/context.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include "../Header_Files/context.h"
+#include "../Header_Files/preprocessor_utils.h"
+#include "../Header_Files/utils.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+/* Allocates a pool of assembly contexts, each with its own VirtualPC. */
+int init_context_pool(ContextPool *pool, int count, const AssemblerOptions *options)
+{
+    int i;
+
+    pool->count = 0;
+    pool->free_list = NULL;
+    pool->contexts = (AssemblyContext *)calloc(count, sizeof(AssemblyContext));
+    if (!pool->contexts)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->available, NULL);
+
+    for (i = 0; i < count; i++)
+    {
+        AssemblyContext *context = &pool->contexts[i];
+
+        /* zeroed pages come from the system untouched; resets only clear what a file used */
+        context->vpc = (VirtualPC *)calloc(1, sizeof(VirtualPC));
+        if (!context->vpc)
+        {
+            destroy_context_pool(pool);
+            print_error_no_line(ERROR_MEMORY_ALLOCATION);
+            return FALSE;
+        }
+        reset_virtual_pc(context->vpc);
+        init_label_table(&context->label_table);
+        init_mcro_table(&context->mcro_table);
+        init_diagnostic_sink(&context->diagnostics);
+        init_output_batch(&context->outputs);
+        init_encode_cache(&context->encode_cache);
+        context->options = options;
+        context->owner = pool;
+        context->next_free = pool->free_list;
+        pool->free_list = context;
+        pool->count++;
+    }
+    return TRUE;
+}
+
+/* Takes a free context from the pool, waiting until one is released. */
+AssemblyContext *acquire_context(ContextPool *pool)
+{
+    AssemblyContext *context;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->free_list)
+    {
+        pthread_cond_wait(&pool->available, &pool->lock);
+    }
+    context = pool->free_list;
+    pool->free_list = context->next_free;
+    pthread_mutex_unlock(&pool->lock);
+
+    /* empty what the previous file used, up to its high-water marks */
+    reset_virtual_pc(context->vpc);
+    reset_label_table(&context->label_table);
+    reset_mcro_table(&context->mcro_table);
+    context->filename = NULL;
+    context->success = TRUE;
+    reset_diagnostic_sink(&context->diagnostics, NULL, context->options->fail_fast ? 1 : context->options->max_errors);
+    if (context->options->cache_dir)
+    {
+        keep_diagnostic_history(&context->diagnostics); /* stored with the outputs */
+    }
+    context->has_cache_key = FALSE;
+    clear_output_batch(&context->outputs);
+    context->result = NULL;
+    context->pending_outputs = 0;
+    memset(context->output_requested, 0, sizeof(context->output_requested));
+    return context;
+}
+
+/* Marks one output writer of a context as finished. */
+int finish_output_job(AssemblyContext *context)
+{
+    int is_last;
+
+    pthread_mutex_lock(&context->owner->lock);
+    is_last = (--context->pending_outputs == 0);
+    pthread_mutex_unlock(&context->owner->lock);
+    return is_last;
+}
+
+/* Returns a context to its pool. */
+void release_context(AssemblyContext *context)
+{
+    ContextPool *pool = context->owner;
+
+    pthread_mutex_lock(&pool->lock);
+    context->next_free = pool->free_list;
+    pool->free_list = context;
+    pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Frees every context of the pool. */
+void destroy_context_pool(ContextPool *pool)
+{
+    int i;
+
+    for (i = 0; i < pool->count; i++)
+    {
+        free(pool->contexts[i].vpc);
+        destroy_diagnostic_sink(&pool->contexts[i].diagnostics);
+        destroy_output_batch(&pool->contexts[i].outputs);
+        free_encode_cache(&pool->contexts[i].encode_cache);
+        free_mcro_table(&pool->contexts[i].mcro_table);
+    }
+    free(pool->contexts);
+    pool->contexts = NULL;
+    pool->free_list = NULL;
+    pool->count = 0;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->available);
+}
@@ -0,0 +1,685 @@
+/* Source_Files/diagnostics.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Header_Files/diagnostics.h"
+#include "../Header_Files/errors.h"
+#include "../Header_Files/globals.h"
+
+/* the sink of each thread, set by the task working on a file */
+static pthread_key_t current_sink_key;
+static pthread_once_t current_sink_once = PTHREAD_ONCE_INIT;
+
+/* the process-wide writer every sink flushes into */
+static struct
+{
+    DiagnosticFormat format;
+    char buffer[DIAGNOSTIC_WRITER_SIZE];
+    size_t length;
+    int result_count; /* SARIF results written, for the separating commas */
+    pthread_mutex_t lock;
+} writer = {DIAGNOSTICS_TEXT, {0}, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @brief Creates the thread-specific key of the current sink (runs once).
+ */
+static void create_current_sink_key(void)
+{
+    pthread_key_create(&current_sink_key, NULL);
+}
+
+/**
+ * @brief Writes the writer buffer to stderr, the writer lock must be held.
+ */
+static void write_out_locked(void)
+{
+    if (writer.length > 0)
+    {
+        fwrite(writer.buffer, 1, writer.length, stderr);
+        fflush(stderr);
+        writer.length = 0;
+    }
+}
+
+/**
+ * @brief Appends text to the writer buffer, the writer lock must be held.
+ */
+static void append_text_locked(const char *text, size_t length)
+{
+    if (writer.length + length > sizeof(writer.buffer))
+    {
+        write_out_locked();
+    }
+    if (length > sizeof(writer.buffer))
+    {
+        fwrite(text, 1, length, stderr);
+        return;
+    }
+    memcpy(writer.buffer + writer.length, text, length);
+    writer.length += length;
+}
+
+/**
+ * @brief Appends a JSON string literal (quotes and escapes included) to out.
+ *
+ * @return Number of characters written.
+ */
+static int append_json_string(char *out, const char *text)
+{
+    int length = 0;
+    const unsigned char *p;
+
+    out[length++] = '"';
+    for (p = (const unsigned char *)text; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+        {
+            out[length++] = '\\';
+            out[length++] = (char)*p;
+        }
+        else if (*p == '\t')
+        {
+            out[length++] = '\\';
+            out[length++] = 't';
+        }
+        else if (*p < 0x20)
+        {
+            length += sprintf(out + length, "\\u%04x", *p);
+        }
+        else
+        {
+            out[length++] = (char)*p;
+        }
+    }
+    out[length++] = '"';
+    out[length] = '\0';
+    return length;
+}
+
+/**
+ * @brief Returns the name of the code of a record.
+ */
+static const char *diagnostic_name(const Diagnostic *diagnostic)
+{
+    return diagnostic->severity == DIAGNOSTIC_WARNING ? get_warning_name((WarningCode)diagnostic->code)
+                                                      : get_error_name((ErrorCode)diagnostic->code);
+}
+
+/**
+ * @brief Returns the message of the code of a record.
+ */
+static const char *diagnostic_message(const Diagnostic *diagnostic)
+{
+    return diagnostic->severity == DIAGNOSTIC_WARNING ? get_warning_message((WarningCode)diagnostic->code)
+                                                      : get_error_message((ErrorCode)diagnostic->code);
+}
+
+/**
+ * @brief Formats a record the way it is shown on the terminal.
+ *
+ * @return Number of characters written.
+ */
+static int format_text(const Diagnostic *diagnostic, char *out)
+{
+    if (diagnostic->severity == DIAGNOSTIC_WARNING)
+    {
+        if (diagnostic->line_number == DIAGNOSTIC_NO_LINE)
+        {
+            return sprintf(out, "%sWarning: [%s] %s%s\n",
+                           COLOR_YELLOW, diagnostic_name(diagnostic), diagnostic_message(diagnostic), COLOR_RESET);
+        }
+        return sprintf(out, "%sWarning at line %d: [%s] %s%s\n",
+                       COLOR_YELLOW, diagnostic->line_number, diagnostic_name(diagnostic),
+                       diagnostic_message(diagnostic), COLOR_RESET);
+    }
+
+    if (diagnostic->line_number == DIAGNOSTIC_NO_LINE)
+    {
+        return sprintf(out, "%sError: [%s] %s%s\n",
+                       COLOR_RED, diagnostic_name(diagnostic), diagnostic_message(diagnostic), COLOR_RESET);
+    }
+    if (diagnostic->has_excerpt)
+    {
+        return sprintf(out, "%sError at line %d: [%s] %s \n       %s <<<-- ERROR HERE%s\n",
+                       COLOR_RED, diagnostic->line_number, diagnostic_name(diagnostic),
+                       diagnostic_message(diagnostic), diagnostic->excerpt, COLOR_RESET);
+    }
+    return sprintf(out, COLOR_RED "Error at line %d: [%s] %s" COLOR_RESET "\n",
+                   diagnostic->line_number, diagnostic_name(diagnostic), diagnostic_message(diagnostic));
+}
+
+/**
+ * @brief Appends "null" or a number to out.
+ */
+static int append_json_number(char *out, int value, int known)
+{
+    return known ? sprintf(out, "%d", value) : sprintf(out, "null");
+}
+
+/**
+ * @brief Formats a record as one JSON Lines object.
+ *
+ * file and line point at the .as source. am_line is the line of the .am
+ * file the pass read (null for preprocessor diagnostics); the columns are
+ * columns of the line that was read.
+ *
+ * @return Number of characters written.
+ */
+static int format_jsonl(const Diagnostic *diagnostic, char *out)
+{
+    char source_file[MAX_FILENAME_LENGTH + 4];
+    int length = 0;
+
+    length += sprintf(out + length, "{\"severity\":\"%s\",\"code\":\"%s\",\"message\":",
+                      diagnostic->severity == DIAGNOSTIC_WARNING ? "warning" : "error", diagnostic_name(diagnostic));
+    length += append_json_string(out + length, diagnostic_message(diagnostic));
+    length += sprintf(out + length, ",\"file\":");
+    if (diagnostic->file)
+    {
+        sprintf(source_file, "%.*s.as", MAX_FILENAME_LENGTH - 1, diagnostic->file);
+        length += append_json_string(out + length, source_file);
+    }
+    else
+    {
+        length += sprintf(out + length, "null");
+    }
+    length += sprintf(out + length, ",\"line\":");
+    length += append_json_number(out + length, diagnostic->source_line, diagnostic->source_line > 0);
+    length += sprintf(out + length, ",\"am_line\":");
+    length += append_json_number(out + length, diagnostic->am_line, diagnostic->am_line > 0);
+    length += sprintf(out + length, ",\"expanded\":%s,\"column_start\":", diagnostic->expanded ? "true" : "false");
+    length += append_json_number(out + length, diagnostic->column_start, diagnostic->column_start > 0);
+    length += sprintf(out + length, ",\"column_end\":");
+    length += append_json_number(out + length, diagnostic->column_end, diagnostic->column_start > 0);
+    length += sprintf(out + length, "}\n");
+    return length;
+}
+
+/**
+ * @brief Formats a record as one SARIF result, preceded by a comma if needed.
+ *
+ * Columns are only given for lines that appear as is in the .as file.
+ *
+ * @return Number of characters written.
+ */
+static int format_sarif(const Diagnostic *diagnostic, char *out, int is_first)
+{
+    char source_file[MAX_FILENAME_LENGTH + 4];
+    int length = 0;
+
+    length += sprintf(out + length, "%s{\"ruleId\":\"%s\",\"level\":\"%s\",\"message\":{\"text\":",
+                      is_first ? "" : ",", diagnostic_name(diagnostic),
+                      diagnostic->severity == DIAGNOSTIC_WARNING ? "warning" : "error");
+    length += append_json_string(out + length, diagnostic_message(diagnostic));
+    length += sprintf(out + length, "}");
+
+    if (diagnostic->file)
+    {
+        sprintf(source_file, "%.*s.as", MAX_FILENAME_LENGTH - 1, diagnostic->file);
+        length += sprintf(out + length, ",\"locations\":[{\"physicalLocation\":{\"artifactLocation\":{\"uri\":");
+        length += append_json_string(out + length, source_file);
+        length += sprintf(out + length, "}");
+        if (diagnostic->source_line > 0)
+        {
+            length += sprintf(out + length, ",\"region\":{\"startLine\":%d", diagnostic->source_line);
+            if (diagnostic->column_start > 0 && !diagnostic->expanded)
+            {
+                length += sprintf(out + length, ",\"startColumn\":%d,\"endColumn\":%d",
+                                  diagnostic->column_start, diagnostic->column_end + 1); /* SARIF end is exclusive */
+            }
+            length += sprintf(out + length, "}");
+        }
+        length += sprintf(out + length, "}}]");
+    }
+    length += sprintf(out + length, "}\n");
+    return length;
+}
+
+/**
+ * @brief Formats a record in the current format and appends it to the writer.
+ */
+static void write_diagnostic(const Diagnostic *diagnostic)
+{
+    char text[DIAGNOSTIC_TEXT_SIZE];
+    int length;
+
+    pthread_mutex_lock(&writer.lock);
+    if (writer.format == DIAGNOSTICS_JSONL)
+    {
+        length = format_jsonl(diagnostic, text);
+    }
+    else if (writer.format == DIAGNOSTICS_SARIF)
+    {
+        length = format_sarif(diagnostic, text, writer.result_count++ == 0);
+    }
+    else
+    {
+        length = format_text(diagnostic, text);
+    }
+    append_text_locked(text, length);
+    pthread_mutex_unlock(&writer.lock);
+}
+
+/**
+ * @brief Lets the writer go out after a batch, immediately only in text mode.
+ */
+static void end_batch(void)
+{
+    pthread_mutex_lock(&writer.lock);
+    if (writer.format == DIAGNOSTICS_TEXT)
+    {
+        write_out_locked();
+    }
+    pthread_mutex_unlock(&writer.lock);
+}
+
+/**
+ * @brief Hands the collected records of a sink to the writer, the sink lock must be held.
+ */
+static void flush_locked(DiagnosticSink *sink)
+{
+    int i;
+
+    for (i = 0; i < sink->count; i++)
+    {
+        write_diagnostic(&sink->records[i]);
+    }
+    if (sink->count > 0)
+    {
+        end_batch();
+    }
+    sink->count = 0;
+}
+
+/**
+ * @brief Appends a record to a sink, writing the batch out first if it is full.
+ */
+static void append_locked(DiagnosticSink *sink, const Diagnostic *diagnostic)
+{
+    if (!sink->silent)
+    {
+        if (sink->count == DIAGNOSTIC_BATCH_SIZE)
+        {
+            flush_locked(sink);
+        }
+        sink->records[sink->count++] = *diagnostic;
+    }
+
+    if (sink->keep_history)
+    {
+        if (sink->history_count == sink->history_capacity)
+        {
+            int capacity = sink->history_capacity ? sink->history_capacity * 2 : 16;
+            Diagnostic *grown = (Diagnostic *)realloc(sink->history, capacity * sizeof(Diagnostic));
+            if (!grown)
+            {
+                sink->keep_history = FALSE; /* an incomplete history must not be cached */
+                sink->history_count = 0;
+                return;
+            }
+            sink->history = grown;
+            sink->history_capacity = capacity;
+        }
+        sink->history[sink->history_count++] = *diagnostic;
+    }
+}
+
+/**
+ * @brief Fills in the .as line of a record, the sink lock must be held.
+ */
+static void locate_source_line(DiagnosticSink *sink, Diagnostic *diagnostic)
+{
+    int index = diagnostic->line_number - 1;
+
+    if (diagnostic->line_number == DIAGNOSTIC_NO_LINE || !sink->use_line_origins)
+    {
+        return; /* the preprocessor reports .as lines already */
+    }
+    diagnostic->am_line = diagnostic->line_number;
+    if (index >= 0 && index < sink->line_origin_count)
+    {
+        diagnostic->source_line = sink->line_origins[index].source_line;
+        diagnostic->expanded = sink->line_origins[index].expanded;
+    }
+    else
+    {
+        diagnostic->source_line = 0; /* unknown */
+    }
+}
+
+/* Initializes a sink once, before its first use. */
+void init_diagnostic_sink(DiagnosticSink *sink)
+{
+    pthread_mutex_init(&sink->lock, NULL);
+    sink->line_origins = NULL;
+    sink->line_origin_capacity = 0;
+    sink->history = NULL;
+    sink->history_capacity = 0;
+    reset_diagnostic_sink(sink, NULL, 0);
+}
+
+/* Prepares a sink for a new file. */
+void reset_diagnostic_sink(DiagnosticSink *sink, const char *file, int max_errors)
+{
+    sink->file = file;
+    sink->count = 0;
+    sink->error_count = 0;
+    sink->warning_count = 0;
+    sink->max_errors = max_errors;
+    sink->stopped = FALSE;
+    sink->suppressed = 0;
+    sink->line = NULL;
+    sink->line_origin_count = 0; /* the array is kept for the next file */
+    sink->use_line_origins = FALSE;
+    sink->keep_history = FALSE;
+    sink->silent = FALSE;
+    sink->history_count = 0;
+}
+
+/* Makes a sink keep every record of the current file in its history. */
+void keep_diagnostic_history(DiagnosticSink *sink)
+{
+    sink->keep_history = TRUE;
+}
+
+/* Makes a sink collect the records of the current file in its history only. */
+void capture_diagnostics(DiagnosticSink *sink)
+{
+    sink->keep_history = TRUE;
+    sink->silent = TRUE;
+}
+
+/* Releases the resources of a sink. */
+void destroy_diagnostic_sink(DiagnosticSink *sink)
+{
+    free(sink->line_origins);
+    sink->line_origins = NULL;
+    sink->line_origin_capacity = 0;
+    free(sink->history);
+    sink->history = NULL;
+    sink->history_capacity = 0;
+    pthread_mutex_destroy(&sink->lock);
+}
+
+/* Selects the output format of every diagnostic written from now on. */
+void set_diagnostics_format(DiagnosticFormat format)
+{
+    static const char sarif_header[] =
+        "{\"version\":\"2.1.0\","
+        "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+        "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"assembler\"}},\"results\":[\n";
+
+    pthread_mutex_lock(&writer.lock);
+    writer.format = format;
+    writer.result_count = 0;
+    if (format == DIAGNOSTICS_SARIF)
+    {
+        append_text_locked(sarif_header, sizeof(sarif_header) - 1);
+    }
+    pthread_mutex_unlock(&writer.lock);
+}
+
+/* Writes whatever the diagnostics writer still buffers. */
+void close_diagnostics_output(void)
+{
+    static const char sarif_footer[] = "]}]}\n";
+
+    pthread_mutex_lock(&writer.lock);
+    if (writer.format == DIAGNOSTICS_SARIF)
+    {
+        append_text_locked(sarif_footer, sizeof(sarif_footer) - 1);
+        writer.format = DIAGNOSTICS_TEXT; /* the log is closed */
+    }
+    write_out_locked();
+    pthread_mutex_unlock(&writer.lock);
+}
+
+/* Makes a sink the destination of the diagnostics reported by the calling thread. */
+void set_current_sink(DiagnosticSink *sink)
+{
+    pthread_once(&current_sink_once, create_current_sink_key);
+    pthread_setspecific(current_sink_key, sink);
+}
+
+/* Returns the sink of the calling thread, or NULL. */
+DiagnosticSink *get_current_sink(void)
+{
+    pthread_once(&current_sink_once, create_current_sink_key);
+    return (DiagnosticSink *)pthread_getspecific(current_sink_key);
+}
+
+/**
+ * @brief Locates, counts and collects a record in a sink, enforcing the error limit.
+ *
+ * @param start Start of the highlighted text, for its columns, or NULL.
+ */
+static void deliver_diagnostic(DiagnosticSink *sink, Diagnostic *diagnostic, const char *start)
+{
+    /* outside of a file: no batch to wait for */
+    if (!sink)
+    {
+        write_diagnostic(diagnostic);
+        end_batch();
+        return;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+
+    locate_source_line(sink, diagnostic);
+
+    /* the span is known when the text lies inside the line being processed */
+    if (start && diagnostic->has_excerpt && sink->line && start >= sink->line && start <= sink->line + strlen(sink->line))
+    {
+        diagnostic->column_start = (int)(start - sink->line) + 1;
+        diagnostic->column_end = diagnostic->column_start + (int)strlen(diagnostic->excerpt) - 1;
+    }
+
+    if (diagnostic->severity == DIAGNOSTIC_WARNING)
+    {
+        sink->warning_count++;
+        append_locked(sink, diagnostic);
+    }
+    else if (diagnostic->line_number == DIAGNOSTIC_NO_LINE)
+    {
+        /* file and summary errors are always shown, and not counted against the limit */
+        sink->error_count++;
+        append_locked(sink, diagnostic);
+    }
+    else if (sink->stopped)
+    {
+        sink->suppressed++;
+    }
+    else
+    {
+        sink->error_count++;
+        append_locked(sink, diagnostic);
+
+        if (sink->max_errors > 0 && sink->error_count >= sink->max_errors)
+        {
+            sink->stopped = TRUE;
+            diagnostic->code = ERROR_TOO_MANY_ERRORS;
+            diagnostic->line_number = DIAGNOSTIC_NO_LINE;
+            diagnostic->source_line = 0;
+            diagnostic->am_line = 0;
+            diagnostic->expanded = FALSE;
+            diagnostic->has_excerpt = FALSE;
+            diagnostic->column_start = diagnostic->column_end = 0;
+            append_locked(sink, diagnostic);
+        }
+    }
+
+    pthread_mutex_unlock(&sink->lock);
+}
+
+/* Records a diagnostic in the sink of the calling thread. */
+void report_diagnostic(DiagnosticSeverity severity, int code, int line_number, const char *start, const char *end)
+{
+    DiagnosticSink *sink = get_current_sink();
+    Diagnostic diagnostic;
+    size_t length;
+
+    diagnostic.severity = severity;
+    diagnostic.code = code;
+    diagnostic.line_number = line_number;
+    diagnostic.source_line = line_number == DIAGNOSTIC_NO_LINE ? 0 : line_number;
+    diagnostic.am_line = 0;
+    diagnostic.expanded = FALSE;
+    diagnostic.column_start = 0;
+    diagnostic.column_end = 0;
+    diagnostic.file = sink ? sink->file : NULL;
+    diagnostic.has_excerpt = (start != NULL && end != NULL);
+    diagnostic.excerpt[0] = '\0';
+    if (diagnostic.has_excerpt)
+    {
+        length = end > start ? (size_t)(end - start) : 0;
+        if (length > sizeof(diagnostic.excerpt) - 1)
+        {
+            length = sizeof(diagnostic.excerpt) - 1;
+        }
+        memcpy(diagnostic.excerpt, start, length);
+        diagnostic.excerpt[length] = '\0';
+    }
+
+    deliver_diagnostic(sink, &diagnostic, start);
+}
+
+/* Records a diagnostic saved by an earlier run, as it was reported then. */
+void replay_diagnostic(const Diagnostic *diagnostic)
+{
+    DiagnosticSink *sink = get_current_sink();
+    Diagnostic copy = *diagnostic;
+
+    copy.file = sink ? sink->file : NULL;
+    if (!sink)
+    {
+        write_diagnostic(&copy);
+        end_batch();
+        return;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    if (copy.severity == DIAGNOSTIC_WARNING)
+        sink->warning_count++;
+    else
+        sink->error_count++;
+    append_locked(sink, &copy);
+    pthread_mutex_unlock(&sink->lock);
+}
+
+/* Reports a diagnostic recorded on its own line as found on another line. */
+void report_recorded_diagnostic(const Diagnostic *diagnostic, int line_number)
+{
+    DiagnosticSink *sink = get_current_sink();
+    Diagnostic copy = *diagnostic;
+
+    if (copy.line_number != DIAGNOSTIC_NO_LINE)
+    {
+        copy.line_number = line_number;
+        copy.source_line = line_number;
+    }
+    copy.am_line = 0;
+    copy.expanded = FALSE;
+    copy.file = sink ? sink->file : NULL;
+    deliver_diagnostic(sink, &copy, NULL);
+}
+
+/* Tells the sink of the calling thread which line is being processed. */
+void set_diagnostic_line(const char *line)
+{
+    DiagnosticSink *sink = get_current_sink();
+
+    if (sink)
+    {
+        pthread_mutex_lock(&sink->lock);
+        sink->line = line;
+        pthread_mutex_unlock(&sink->lock);
+    }
+}
+
+/* Records where the next line written to the .am file comes from. */
+void add_line_origin(int source_line, int expansion, int mcro_line)
+{
+    DiagnosticSink *sink = get_current_sink();
+
+    if (!sink)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    if (sink->line_origin_count == sink->line_origin_capacity)
+    {
+        int capacity = sink->line_origin_capacity ? sink->line_origin_capacity * 2 : 256;
+        LineOrigin *grown = (LineOrigin *)realloc(sink->line_origins, capacity * sizeof(LineOrigin));
+        if (!grown)
+        {
+            pthread_mutex_unlock(&sink->lock);
+            return; /* later lines are reported without their .as line */
+        }
+        sink->line_origins = grown;
+        sink->line_origin_capacity = capacity;
+    }
+    sink->line_origins[sink->line_origin_count].source_line = source_line;
+    sink->line_origins[sink->line_origin_count].expanded = expansion >= 0;
+    sink->line_origins[sink->line_origin_count].expansion = expansion;
+    sink->line_origins[sink->line_origin_count].mcro_line = mcro_line;
+    sink->line_origin_count++;
+    pthread_mutex_unlock(&sink->lock);
+}
+
+/* Tells which macro body line an .am line was expanded from. */
+int get_line_expansion(int line_number, int *mcro_line)
+{
+    DiagnosticSink *sink = get_current_sink();
+    int index = line_number - 1, expansion = -1;
+
+    if (sink)
+    {
+        pthread_mutex_lock(&sink->lock);
+        if (sink->use_line_origins && index >= 0 && index < sink->line_origin_count)
+        {
+            expansion = sink->line_origins[index].expansion;
+            *mcro_line = sink->line_origins[index].mcro_line;
+        }
+        pthread_mutex_unlock(&sink->lock);
+    }
+    return expansion;
+}
+
+/* Marks that line numbers reported from now on are .am lines. */
+void use_line_origins(void)
+{
+    DiagnosticSink *sink = get_current_sink();
+
+    if (sink)
+    {
+        pthread_mutex_lock(&sink->lock);
+        sink->use_line_origins = TRUE;
+        pthread_mutex_unlock(&sink->lock);
+    }
+}
+
+/* Checks whether the sink of the calling thread reached its error limit. */
+int diagnostics_stopped(void)
+{
+    DiagnosticSink *sink = get_current_sink();
+    int stopped = FALSE;
+
+    if (sink)
+    {
+        pthread_mutex_lock(&sink->lock);
+        stopped = sink->stopped;
+        pthread_mutex_unlock(&sink->lock);
+    }
+    return stopped;
+}
+
+/* Hands every collected record of a sink to the diagnostics writer. */
+void flush_diagnostics(DiagnosticSink *sink)
+{
+    pthread_mutex_lock(&sink->lock);
+    flush_locked(sink);
+    pthread_mutex_unlock(&sink->lock);
+}
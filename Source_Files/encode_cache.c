@@ -0,0 +1,101 @@
+/* Source_Files/encode_cache.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Header_Files/encode_cache.h"
+
+/* the cache of each thread, set by the task working on a file */
+static pthread_key_t current_cache_key;
+static pthread_once_t current_cache_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Creates the thread-specific key of the current cache (runs once).
+ */
+static void create_current_cache_key(void)
+{
+    pthread_key_create(&current_cache_key, NULL);
+}
+
+/**
+ * @brief Returns the slot of a key (FNV-1a over its bytes).
+ */
+static unsigned long slot_of(const char *key)
+{
+    unsigned long hash = 2166136261UL;
+
+    while (*key)
+    {
+        hash ^= (unsigned char)*key++;
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash & (ENCODE_CACHE_SIZE - 1);
+}
+
+/* Prepares an empty cache. */
+void init_encode_cache(EncodeCache *cache)
+{
+    cache->entries = NULL;
+    cache->lookups = 0;
+    cache->hits = 0;
+}
+
+/* Makes a cache the one encode_command uses on the calling thread. */
+void set_current_encode_cache(EncodeCache *cache)
+{
+    pthread_once(&current_cache_once, create_current_cache_key);
+    pthread_setspecific(current_cache_key, cache);
+}
+
+/* Returns the cache of the calling thread, or NULL. */
+EncodeCache *get_current_encode_cache(void)
+{
+    pthread_once(&current_cache_once, create_current_cache_key);
+    return (EncodeCache *)pthread_getspecific(current_cache_key);
+}
+
+/* Looks a normalized command up, counting the lookup. */
+const EncodeCacheEntry *find_encoding(EncodeCache *cache, const char *key)
+{
+    const EncodeCacheEntry *entry;
+
+    cache->lookups++;
+    if (!cache->entries)
+    {
+        return NULL;
+    }
+    entry = &cache->entries[slot_of(key)];
+    if (strcmp(entry->key, key) != 0)
+    {
+        return NULL;
+    }
+    cache->hits++;
+    return entry;
+}
+
+/* Keeps the words of a normalized command, replacing the entry in its slot. */
+void store_encoding(EncodeCache *cache, const char *key, const Word *words, int count)
+{
+    EncodeCacheEntry *entry;
+
+    if (!cache->entries)
+    {
+        cache->entries = (EncodeCacheEntry *)calloc(ENCODE_CACHE_SIZE, sizeof(EncodeCacheEntry));
+        if (!cache->entries)
+        {
+            return; /* encoding goes on without the cache */
+        }
+    }
+    entry = &cache->entries[slot_of(key)];
+    strcpy(entry->key, key);
+    memcpy(entry->words, words, sizeof(entry->words));
+    entry->count = count;
+}
+
+/* Releases the entries of a cache. */
+void free_encode_cache(EncodeCache *cache)
+{
+    free(cache->entries);
+    cache->entries = NULL;
+}
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include "../Header_Files/first_pass.h"
 #include "../Header_Files/errors.h"
+#include "../Header_Files/diagnostics.h"
 #include "../Header_Files/globals.h"
 #include "../Header_Files/first_pass_utils.h"
 #include "../Header_Files/label_utils.h"
@@ -12,6 +13,191 @@
 #include "../Header_Files/structs.h"
 #include "../Header_Files/vpc_utils.h"
 #include "../Header_Files/utils.h"
+#include "../Header_Files/mcro_template.h"
+
+/**
+ * @struct DeferredData
+ * @brief A .data or .string line, stored after the commands.
+ */
+typedef struct
+{
+    char *text;               /* the directive, or NULL for an encoded macro body line */
+    const LineRecord *record; /* the encoded macro body line */
+    long repeat;              /* with neither: copies of the last words stored */
+    int words;                /* how many words each copy takes */
+} DeferredData;
+
+/**
+ * @struct ReptState
+ * @brief The .rept block being read, and where its body starts.
+ */
+typedef struct
+{
+    long count;     /* iterations, 0 outside a block */
+    int ic;         /* IC at the .rept */
+    int dc;         /* DC at the .rept */
+    int labels;     /* labels in the table at the .rept */
+} ReptState;
+
+/**
+ * @brief Adds a macro body line encoded in advance at one of its call sites.
+ *
+ * The diagnostics recorded with the line are reported at this line, its
+ * label is added to the table here, and its command words are copied into
+ * the image in one block.
+ *
+ * @return TRUE (1) if the line is valid, FALSE (0) otherwise.
+ */
+static int add_template_line(const LineRecord *record, int line_number, VirtualPC *vpc, LabelTable *label_table, const McroTable *mcro_table, int *storage_full)
+{
+    ErrorCode err;
+    int i, is_valid = TRUE;
+
+    for (i = 0; i <= record->first_pass_count; i++)
+    {
+        if (i == record->label_slot) /* the label's own result comes where the first pass reports it */
+        {
+            err = add_label(record->label, line_number, "", record->label_type, vpc, label_table, mcro_table);
+            if (err != ERROR_SUCCESS)
+            {
+                print_error(err, line_number);
+                is_valid = FALSE;
+            }
+            else if (record->register_warning)
+            {
+                print_warning(WARNING_LABEL_RESEMBLES_INVALID_REGISTER, line_number);
+            }
+        }
+        if (i < record->first_pass_count)
+        {
+            report_recorded_diagnostic(&record->first_pass_diagnostics[i], line_number);
+            if (record->first_pass_diagnostics[i].severity == DIAGNOSTIC_ERROR)
+            {
+                is_valid = FALSE;
+            }
+        }
+    }
+
+    if (record->kind == LINE_CODE)
+    {
+        store_command_words(record->words, record->word_count, vpc, storage_full);
+    }
+    else if (record->kind == LINE_DATA)
+    {
+        vpc->DC += record->data_count;
+    }
+    return is_valid;
+}
+
+/**
+ * @brief Appends a line to the data stored after the commands.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int defer_data(DeferredData **data_lines, int *count, const char *text, const LineRecord *record)
+{
+    DeferredData *temp = (DeferredData *)realloc(*data_lines, (*count + 1) * sizeof(DeferredData));
+
+    if (!temp)
+    {
+        return FALSE;
+    }
+    *data_lines = temp;
+    temp[*count].text = NULL;
+    temp[*count].record = record;
+    temp[*count].repeat = 0;
+    temp[*count].words = 0;
+    if (text)
+    {
+        temp[*count].text = (char *)malloc(strlen(text) + 1);
+        if (!temp[*count].text)
+        {
+            return FALSE;
+        }
+        strcpy(temp[*count].text, text);
+    }
+    (*count)++;
+    return TRUE;
+}
+
+/**
+ * @brief Reads a .rept or .endr line of the .am file.
+ *
+ * The preprocessor writes these lines itself, as ".rept N" and ".endr", so
+ * the count is a valid one.
+ *
+ * @param count Receives the count of a .rept, 0 for an .endr.
+ * @return TRUE (1) if the line is one of the two directives, FALSE (0) otherwise.
+ */
+static int read_rept_directive(const char *line, long *count)
+{
+    if (strncmp(line, ".rept ", 6) == 0)
+    {
+        *count = atol(line + 6);
+        return TRUE;
+    }
+    if (strncmp(line, ".endr", 5) == 0 && (line[5] == '\n' || line[5] == '\0'))
+    {
+        *count = 0;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Repeats the body of a finished .rept block.
+ *
+ * The body was read once, as any other lines. Its command words are copied
+ * count - 1 more times after it, DC grows by count times what the body
+ * stores, and the copies of its data are stored after the commands with the
+ * data it follows. A label the body defines would be defined again by the
+ * second iteration, so it is reported once, at its line.
+ *
+ * @return TRUE (1) if the block is valid, FALSE (0) otherwise.
+ */
+static int finish_rept_block(const ReptState *block, VirtualPC *vpc, LabelTable *label_table, const McroTable *mcro_table,
+                             DeferredData **data_lines, int *data_line_count, int *storage_full)
+{
+    int code_words = vpc->IC - block->ic;
+    int data_words = vpc->DC - block->dc;
+    int i, is_valid = TRUE;
+    long copy;
+    ErrorCode err;
+
+    if (block->count < 2)
+    {
+        return TRUE;
+    }
+    for (i = block->labels; i < label_table->count; i++)
+    {
+        err = add_label(label_table->labels[i].name, label_table->labels[i].line_number, "", label_table->labels[i].type, vpc, label_table, mcro_table);
+        print_error(err, label_table->labels[i].line_number);
+        is_valid = FALSE;
+    }
+
+    for (copy = 1; copy < block->count && code_words > 0 && !*storage_full; copy++)
+    {
+        store_command_words(&vpc->storage[block->ic], code_words, vpc, storage_full);
+    }
+
+    if (data_words > 0)
+    {
+        if (data_words > (STORAGE_SIZE - vpc->IC - vpc->DC) / (block->count - 1))
+        {
+            *storage_full = TRUE;
+            return is_valid;
+        }
+        vpc->DC += data_words * (int)(block->count - 1);
+        if (!defer_data(data_lines, data_line_count, NULL, NULL))
+        {
+            print_error_no_line(ERROR_MEMORY_ALLOCATION);
+            return FALSE;
+        }
+        (*data_lines)[*data_line_count - 1].repeat = block->count - 1;
+        (*data_lines)[*data_line_count - 1].words = data_words;
+    }
+    return is_valid;
+}
 
 /* Performs the first pass on an assembly source file to identify and process labels, directives, and commands. */
 int first_pass(FILE *fp, VirtualPC *vpc, LabelTable *label_table, const McroTable *mcro_table)
@@ -20,11 +206,15 @@ int first_pass(FILE *fp, VirtualPC *vpc, LabelTable *label_table, const McroTabl
     char original_line[MAX_LINE_LENGTH]; /* Ccpy of the original line */
     char label[MAX_LINE_LENGTH];
     char *colon_pos, *quote_pos;
-    char **data_lines = NULL;  /* dynamic array to store .data/.string lines to add to the vpc after commands */
+    DeferredData *data_lines = NULL; /* dynamic array to store .data/.string lines to add to the vpc after commands */
+    McroTemplateTable templates;     /* macro bodies, encoded once per file */
+    ReptState rept = {0, 0, 0, 0};
+    const LineRecord *record;
     int data_line_count = 0;   /* number of data lines to store */
     char *content_after_label; /* pointer to the content after the label (if no label, points to the start of the line) */
     char *ptr_line;
-    int line_number = 0, i;
+    int line_number = 0, i, start;
+    long count, copy;
     int is_valid_file = TRUE;
     int storage_full = FALSE;
     size_t label_length;
@@ -53,11 +243,55 @@ int first_pass(FILE *fp, VirtualPC *vpc, LabelTable *label_table, const McroTabl
     }
 
     rewind(fp);
+    init_mcro_templates(&templates, mcro_table);
 
     /* process the source file line by line */
     while (fgets(line, MAX_LINE_LENGTH, fp))
     {
+        if (diagnostics_stopped())
+        {
+            is_valid_file = FALSE; /* error limit reached, give up on the file */
+            break;
+        }
         line_number++;
+
+        /* a line of a macro body: encoded at the first call, copied at the others */
+        record = find_mcro_template_line(&templates, line_number, line);
+        if (record)
+        {
+            if (!add_template_line(record, line_number, vpc, label_table, mcro_table, &storage_full))
+            {
+                is_valid_file = FALSE;
+            }
+            if (record->kind == LINE_DATA && !defer_data(&data_lines, &data_line_count, NULL, record))
+            {
+                print_error_no_line(ERROR_MEMORY_ALLOCATION);
+                is_valid_file = FALSE;
+            }
+            continue;
+        }
+
+        /* a .rept block: its body is read once and repeated at its .endr */
+        if (read_rept_directive(line, &count))
+        {
+            if (count > 0)
+            {
+                rept.count = count;
+                rept.ic = vpc->IC;
+                rept.dc = vpc->DC;
+                rept.labels = label_table->count;
+            }
+            else if (rept.count > 0)
+            {
+                if (!finish_rept_block(&rept, vpc, label_table, mcro_table, &data_lines, &data_line_count, &storage_full))
+                {
+                    is_valid_file = FALSE;
+                }
+                rept.count = 0;
+            }
+            continue;
+        }
+
         strncpy(original_line, line, MAX_LINE_LENGTH - 1);
         original_line[MAX_LINE_LENGTH - 1] = '\0'; /* eesure null-termination */
         ptr_line = advance_to_next_token(line);    /* skip leading spaces */
@@ -181,29 +415,13 @@ int first_pass(FILE *fp, VirtualPC *vpc, LabelTable *label_table, const McroTabl
             }
             else
             {
-                /* allocate memory for a new line */
-                char **temp = realloc(data_lines, (data_line_count + 1) * sizeof(char *));
                 vpc->DC += count_data_or_string_elements(content_after_label);
-                if (!temp)
+                /* add the line that will be proccesed after the commands */
+                if (!defer_data(&data_lines, &data_line_count, content_after_label, NULL))
                 {
                     print_error_no_line(ERROR_MEMORY_ALLOCATION);
                     is_valid_file = FALSE;
                 }
-                else /* add the line that will be proccesed after the commands */
-                {
-                    data_lines = temp;
-                    data_lines[data_line_count] = (char *)malloc(strlen(content_after_label) + 1);
-                    if (!data_lines[data_line_count])
-                    {
-                        print_error_no_line(ERROR_MEMORY_ALLOCATION);
-                        is_valid_file = FALSE;
-                    }
-                    else
-                    {
-                        strcpy(data_lines[data_line_count], content_after_label);
-                        data_line_count++;
-                    }
-                }
             }
             continue;
         }
@@ -258,7 +476,22 @@ int first_pass(FILE *fp, VirtualPC *vpc, LabelTable *label_table, const McroTabl
     /* proccess all the data that didn't proccessed because commands first*/
     for (i = 0; i < data_line_count; i++)
     {
-        process_data_or_string_directive(data_lines[i], vpc, &storage_full);
+        if (data_lines[i].text)
+        {
+            process_data_or_string_directive(data_lines[i].text, vpc, &storage_full);
+        }
+        else if (data_lines[i].record)
+        {
+            store_data_words(data_lines[i].record->words, data_lines[i].record->word_count, vpc, &storage_full);
+        }
+        else if (vpc->last_adress - data_lines[i].words >= vpc->IC) /* the words of a .rept body, stored again */
+        {
+            start = vpc->last_adress - data_lines[i].words;
+            for (copy = 0; copy < data_lines[i].repeat; copy++)
+            {
+                store_data_words(&vpc->storage[start], data_lines[i].words, vpc, &storage_full);
+            }
+        }
     }
 
     /* add the final IC to the data labels*/
@@ -272,9 +505,10 @@ int first_pass(FILE *fp, VirtualPC *vpc, LabelTable *label_table, const McroTabl
     /* free all stored data/string lines */
     for (i = 0; i < data_line_count; i++)
     {
-        free(data_lines[i]);
+        free(data_lines[i].text);
     }
     free(data_lines);
+    free_mcro_templates(&templates);
 
     if (storage_full)
     {
@@ -12,6 +12,7 @@
 #include "../Header_Files/globals.h"
 #include "../Header_Files/utils.h"
 #include "../Header_Files/errors.h"
+#include "../Header_Files/include_files.h"
 
 /*  Validates if a given line is a proper data storage directive (.data or .string) and checks its syntax correctness.*/
 ErrorCode is_data_storage_instruction(char *line)
@@ -154,10 +155,94 @@ ErrorCode is_data_storage_instruction(char *line)
         return ERROR_SUCCESS;
     }
 
+    /* a run of equal words, read in constant time whatever its length */
+    else if ((strncmp(line, ".fill", 5) == 0 && isspace((unsigned char)line[5])) ||
+             (strncmp(line, ".space", 6) == 0 && isspace((unsigned char)line[6])))
+    {
+        long count, value;
+        return parse_fill_directive(line, &count, &value);
+    }
+    else if (strncmp(line, ".incbin", 7) == 0 && (isspace((unsigned char)line[7]) || line[7] == '"'))
+    {
+        const char *data;
+        size_t size;
+        return read_incbin_directive(line, &data, &size);
+    }
+
     /* if the directive is neither .data nor .string, return invalid directive error */
     return ERROR_INVALID_STORAGE_DIRECTIVE;
 }
 
+/* Reads the count and value of a .fill or .space directive. */
+ErrorCode parse_fill_directive(const char *line, long *count, long *value)
+{
+    char *ptr = advance_to_next_token((char *)line);
+    char *endptr;
+    int is_space = strncmp(ptr, ".space", 6) == 0;
+
+    ptr = advance_to_next_token(ptr + (is_space ? 6 : 5));
+    if (!isdigit((unsigned char)*ptr))
+    {
+        return ERROR_INVALID_FILL;
+    }
+    *count = strtol(ptr, &endptr, 10);
+    if (*count > STORAGE_SIZE)
+    {
+        return ERROR_INVALID_FILL;
+    }
+    ptr = advance_to_next_token(endptr);
+
+    *value = 0;
+    if (!is_space)
+    {
+        if (*ptr != ',')
+        {
+            return ERROR_INVALID_FILL;
+        }
+        ptr = advance_to_next_token(ptr + 1);
+        *value = strtol(ptr, &endptr, 10);
+        if (endptr == ptr)
+        {
+            return ERROR_INVALID_FILL;
+        }
+        /* the same range as a .data value */
+        if (*value > INT_MAX || *value < INT_MIN)
+        {
+            return ERROR_INVALID_DATA_TOO_LARGE;
+        }
+        ptr = advance_to_next_token(endptr);
+    }
+    return *ptr == '\0' ? ERROR_SUCCESS : ERROR_INVALID_FILL;
+}
+
+/* Finds the bytes of the file of an .incbin directive. */
+ErrorCode read_incbin_directive(const char *line, const char **data, size_t *size)
+{
+    char path[INCLUDE_PATH_SIZE];
+    char *ptr = advance_to_next_token((char *)line);
+    char *close_quote;
+
+    ptr = advance_to_next_token(ptr + 7);
+    if (*ptr != '"' || (close_quote = strchr(ptr + 1, '"')) == NULL ||
+        close_quote == ptr + 1 || close_quote - ptr - 1 >= INCLUDE_PATH_SIZE ||
+        *advance_to_next_token(close_quote + 1) != '\0')
+    {
+        return ERROR_INCBIN_SYNTAX;
+    }
+    memcpy(path, ptr + 1, (size_t)(close_quote - ptr - 1));
+    path[close_quote - ptr - 1] = '\0';
+
+    if (!load_binary_file(path, data, size))
+    {
+        return ERROR_INCLUDE_NOT_FOUND;
+    }
+    if (*size > (size_t)STORAGE_SIZE * INCBIN_WORD_BYTES)
+    {
+        return ERROR_VPC_STORAGE_FULL;
+    }
+    return ERROR_SUCCESS;
+}
+
 /* The number of elements specified in a data (.data) or string (.string) directive. */
 int count_data_or_string_elements(char *line)
 {
@@ -201,5 +286,24 @@ int count_data_or_string_elements(char *line)
             count++; /* null termination is also counting*/
         }
     }
+    /* check for .fill and .space directives */
+    else if (strncmp(line, ".fill", 5) == 0 || strncmp(line, ".space", 6) == 0)
+    {
+        long fill_count, value;
+        if (parse_fill_directive(line, &fill_count, &value) == ERROR_SUCCESS)
+        {
+            count = (int)fill_count;
+        }
+    }
+    /* check for .incbin directive */
+    else if (strncmp(line, ".incbin", 7) == 0)
+    {
+        const char *data;
+        size_t size;
+        if (read_incbin_directive(line, &data, &size) == ERROR_SUCCESS)
+        {
+            count = (int)((size + INCBIN_WORD_BYTES - 1) / INCBIN_WORD_BYTES);
+        }
+    }
     return count;
 }
@@ -0,0 +1,675 @@
+/* Source_Files/include_files.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../Header_Files/include_files.h"
+#include "../Header_Files/conditional.h"
+#include "../Header_Files/output_file.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+/**
+ * @struct SharedFile
+ * @brief An included file, mapped once for every source of the batch.
+ */
+typedef struct
+{
+    char *path;   /* the path it was first found at */
+    char *data;   /* the mapping, NULL for an empty file */
+    size_t size;
+    dev_t device;
+    ino_t inode;
+} SharedFile;
+
+/* the files included during the batch, found by device and inode */
+static struct
+{
+    SharedFile **files;
+    int count;
+    int capacity;
+    pthread_mutex_t lock;
+} shared = {NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @struct Expander
+ * @brief The state of expanding the includes of one source.
+ */
+typedef struct
+{
+    IncludedSource *out;
+    const IncludeOptions *options;
+    const SharedFile *stack[MAX_INCLUDE_DEPTH]; /* the files being included, outermost first */
+    int depth;
+    dev_t root_device;   /* the .as file, which may not include itself either */
+    ino_t root_inode;
+    int has_root;
+    int valid;
+    Conditions conditions; /* the symbols and open .if blocks */
+} Expander;
+
+/* Checks quickly whether a source may hold an .include or .incbin directive. */
+int has_include_directive(const char *data, size_t size)
+{
+    const char *ptr = data, *end = data + size;
+
+    while (ptr < end && (ptr = (const char *)memchr(ptr, '.', (size_t)(end - ptr))) != NULL)
+    {
+        if ((size_t)(end - ptr) >= 4 && strncmp(ptr, ".inc", 4) == 0)
+        {
+            return TRUE;
+        }
+        ptr++;
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Maps an included file, or finds it mapped earlier in the batch.
+ *
+ * @return The shared file, or NULL if it could not be read.
+ */
+static const SharedFile *load_shared_file(const char *path, const struct stat *st)
+{
+    SharedFile *file = NULL;
+    SharedFile **grown;
+    int i, fd;
+
+    pthread_mutex_lock(&shared.lock);
+    for (i = 0; i < shared.count; i++)
+    {
+        if (shared.files[i]->device == st->st_dev && shared.files[i]->inode == st->st_ino)
+        {
+            file = shared.files[i];
+            pthread_mutex_unlock(&shared.lock);
+            return file;
+        }
+    }
+
+    if (shared.count == shared.capacity)
+    {
+        int capacity = shared.capacity ? shared.capacity * 2 : 16;
+        grown = (SharedFile **)realloc(shared.files, capacity * sizeof(SharedFile *));
+        if (!grown)
+        {
+            pthread_mutex_unlock(&shared.lock);
+            return NULL;
+        }
+        shared.files = grown;
+        shared.capacity = capacity;
+    }
+
+    file = (SharedFile *)calloc(1, sizeof(SharedFile));
+    if (file && (file->path = (char *)malloc(strlen(path) + 1)) != NULL)
+    {
+        strcpy(file->path, path);
+        file->device = st->st_dev;
+        file->inode = st->st_ino;
+        file->size = (size_t)st->st_size;
+        fd = open(path, O_RDONLY);
+        if (fd >= 0 && file->size > 0)
+        {
+            file->data = (char *)mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (file->data == (char *)MAP_FAILED)
+            {
+                file->data = NULL;
+            }
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (fd >= 0 && (file->size == 0 || file->data))
+        {
+            shared.files[shared.count++] = file;
+            pthread_mutex_unlock(&shared.lock);
+            return file;
+        }
+        free(file->path);
+    }
+    free(file);
+    pthread_mutex_unlock(&shared.lock);
+    return NULL;
+}
+
+/**
+ * @brief Finds an included file: next to the file including it, then in the -I directories.
+ *
+ * @param found Receives the path, INCLUDE_PATH_SIZE bytes.
+ * @return TRUE (1) if a regular file was found, FALSE (0) otherwise.
+ */
+static int find_include(const Expander *expander, const char *including, const char *name, char *found, struct stat *st)
+{
+    const char *slash = strrchr(including, '/');
+    size_t dir_length = slash ? (size_t)(slash - including) + 1 : 0;
+    int i;
+
+    if (name[0] == '/')
+    {
+        strcpy(found, name);
+        return stat(found, st) == 0 && S_ISREG(st->st_mode);
+    }
+
+    /* the directory of the including file */
+    if (dir_length + strlen(name) < INCLUDE_PATH_SIZE)
+    {
+        memcpy(found, including, dir_length);
+        strcpy(found + dir_length, name);
+        if (stat(found, st) == 0 && S_ISREG(st->st_mode))
+        {
+            return TRUE;
+        }
+    }
+
+    /* the include path, in order */
+    for (i = 0; i < expander->options->dir_count; i++)
+    {
+        if (strlen(expander->options->dirs[i]) + 1 + strlen(name) < INCLUDE_PATH_SIZE)
+        {
+            sprintf(found, "%s/%s", expander->options->dirs[i], name);
+            if (stat(found, st) == 0 && S_ISREG(st->st_mode))
+            {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Reads the quoted file name of a directive, which only a comment may follow.
+ *
+ * @param ptr The first character after the directive and its blanks.
+ * @param name Receives the name, INCLUDE_PATH_SIZE bytes.
+ * @return 1 for a valid name, -1 otherwise.
+ */
+static int read_quoted_name(const char *ptr, const char *end, char *name)
+{
+    const char *close_quote;
+
+    if (ptr == end || *ptr != '"')
+    {
+        return -1;
+    }
+    ptr++;
+    close_quote = ptr;
+    while (close_quote < end && *close_quote != '"' && *close_quote != '\n')
+    {
+        close_quote++;
+    }
+    if (close_quote == end || *close_quote != '"' || close_quote == ptr || close_quote - ptr >= INCLUDE_PATH_SIZE)
+    {
+        return -1;
+    }
+    memcpy(name, ptr, (size_t)(close_quote - ptr));
+    name[close_quote - ptr] = '\0';
+
+    for (ptr = close_quote + 1; ptr < end && *ptr != ';'; ptr++)
+    {
+        if (*ptr != ' ' && *ptr != '\t' && *ptr != '\n' && *ptr != '\r')
+        {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Recognizes an .include directive and extracts the quoted file name.
+ *
+ * @param name Receives the name, INCLUDE_PATH_SIZE bytes.
+ * @return 1 for a directive, 0 for any other line, -1 for a malformed directive.
+ */
+static int parse_include(const char *line, const char *end, char *name)
+{
+    const char *ptr = line;
+
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+    {
+        ptr++;
+    }
+    if ((size_t)(end - ptr) < 8 || strncmp(ptr, ".include", 8) != 0 ||
+        (ptr + 8 < end && ptr[8] != ' ' && ptr[8] != '\t' && ptr[8] != '"' && ptr[8] != '\n' && ptr[8] != '\r'))
+    {
+        return 0;
+    }
+    ptr += 8;
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+    {
+        ptr++;
+    }
+    return read_quoted_name(ptr, end, name);
+}
+
+/**
+ * @brief Recognizes an .incbin directive, after an optional label, and extracts the quoted file name.
+ *
+ * @param name Receives the name, INCLUDE_PATH_SIZE bytes.
+ * @param open_quote Receives the position of the opening quote.
+ * @return 1 for a directive, 0 for any other line, -1 for a malformed directive.
+ */
+static int parse_incbin(const char *line, const char *end, char *name, const char **open_quote)
+{
+    const char *ptr = line, *token;
+
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+    {
+        ptr++;
+    }
+
+    /* a label, checked by the first pass */
+    for (token = ptr; ptr < end && *ptr != ':' && *ptr != ' ' && *ptr != '\t' && *ptr != '\n' && *ptr != '"'; ptr++)
+    {
+    }
+    if (ptr < end && *ptr == ':')
+    {
+        for (ptr++; ptr < end && (*ptr == ' ' || *ptr == '\t'); ptr++)
+        {
+        }
+    }
+    else
+    {
+        ptr = token;
+    }
+
+    if ((size_t)(end - ptr) < 7 || strncmp(ptr, ".incbin", 7) != 0 ||
+        (ptr + 7 < end && ptr[7] != ' ' && ptr[7] != '\t' && ptr[7] != '"' && ptr[7] != '\n' && ptr[7] != '\r'))
+    {
+        return 0;
+    }
+    ptr += 7;
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+    {
+        ptr++;
+    }
+    *open_quote = ptr;
+    return read_quoted_name(ptr, end, name);
+}
+
+/**
+ * @brief Appends a line to the expanded source, ending it with a newline if asked.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int append_line(IncludedSource *out, const char *line, size_t length, int add_newline, int source_line)
+{
+    size_t needed = out->size + length + 2;
+
+    if (needed > out->capacity)
+    {
+        size_t capacity = out->capacity ? out->capacity : 4096;
+        char *grown;
+        while (capacity < needed)
+        {
+            capacity *= 2;
+        }
+        grown = (char *)realloc(out->text, capacity);
+        if (!grown)
+        {
+            return FALSE;
+        }
+        out->text = grown;
+        out->capacity = capacity;
+    }
+    if (out->line_count == out->line_capacity)
+    {
+        int capacity = out->line_capacity ? out->line_capacity * 2 : 256;
+        int *grown = (int *)realloc(out->lines, capacity * sizeof(int));
+        if (!grown)
+        {
+            return FALSE;
+        }
+        out->lines = grown;
+        out->line_capacity = capacity;
+    }
+
+    memcpy(out->text + out->size, line, length);
+    out->size += length;
+    if (add_newline && (length == 0 || line[length - 1] != '\n'))
+    {
+        out->text[out->size++] = '\n';
+    }
+    out->text[out->size] = '\0';
+    out->lines[out->line_count++] = source_line;
+    return TRUE;
+}
+
+/**
+ * @brief Records an included file as a dependency, once.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int add_dependency(IncludedSource *out, const char *path)
+{
+    int i;
+
+    for (i = 0; i < out->file_count; i++)
+    {
+        if (out->files[i] == path)
+        {
+            return TRUE;
+        }
+    }
+    if (out->file_count == out->file_capacity)
+    {
+        int capacity = out->file_capacity ? out->file_capacity * 2 : 8;
+        const char **grown = (const char **)realloc((void *)out->files, capacity * sizeof(const char *));
+        if (!grown)
+        {
+            return FALSE;
+        }
+        out->files = grown;
+        out->file_capacity = capacity;
+    }
+    out->files[out->file_count++] = path;
+    return TRUE;
+}
+
+/**
+ * @brief Writes an .incbin line with the path its file was found at.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int append_incbin_line(Expander *expander, const char *line, const char *open_quote, const char *path, int source_line)
+{
+    char text[MAX_LINE_LENGTH + INCLUDE_PATH_SIZE + 2];
+    size_t prefix = (size_t)(open_quote - line) + 1;
+
+    /* the line as the first pass reads it: the label and directive, then the quoted path */
+    if (prefix + strlen(path) + 2 > MAX_LINE_LENGTH - 1)
+    {
+        print_error(ERROR_LINE_TOO_LONG, source_line);
+        expander->valid = FALSE;
+        return TRUE;
+    }
+    memcpy(text, line, prefix);
+    sprintf(text + prefix, "%s\"\n", path);
+    return append_line(expander->out, text, strlen(text), FALSE, source_line) &&
+           add_dependency(expander->out, path);
+}
+
+/**
+ * @brief Checks whether a file is already being included (or is the .as file).
+ */
+static int is_being_included(const Expander *expander, const struct stat *st)
+{
+    int i;
+
+    if (expander->has_root && expander->root_device == st->st_dev && expander->root_inode == st->st_ino)
+    {
+        return TRUE;
+    }
+    for (i = 0; i < expander->depth; i++)
+    {
+        if (expander->stack[i]->device == st->st_dev && expander->stack[i]->inode == st->st_ino)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Copies the lines of a file, replacing its .include directives by the included lines.
+ *
+ * @param include_line The .as line of the outermost .include, 0 for the .as file itself.
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int expand_text(Expander *expander, const char *path, const char *data, size_t size, int include_line)
+{
+    char name[INCLUDE_PATH_SIZE];
+    char found[INCLUDE_PATH_SIZE];
+    const char *line = data, *end = data + size, *next, *open_quote;
+    const SharedFile *file;
+    struct stat st;
+    int line_number = 0, source_line, kind;
+    int floor = begin_conditional_file(&expander->conditions);
+
+    while (line < end)
+    {
+        next = (const char *)memchr(line, '\n', (size_t)(end - line));
+        next = next ? next + 1 : end;
+        line_number++;
+        source_line = include_line ? include_line : line_number;
+
+        /* a skipped block costs a newline scan and a look at the first character of each line */
+        if (handle_conditional_directive(&expander->conditions, line, next, source_line) || !expander->conditions.active)
+        {
+            line = next;
+            continue;
+        }
+
+        /* a binary file is looked up now and read by the first pass */
+        kind = parse_incbin(line, next, name, &open_quote);
+        if (kind != 0)
+        {
+            if (kind < 0)
+            {
+                print_error(ERROR_INCBIN_SYNTAX, source_line);
+                expander->valid = FALSE;
+            }
+            else if (!find_include(expander, path, name, found, &st) || !(file = load_shared_file(found, &st)))
+            {
+                print_error(ERROR_INCLUDE_NOT_FOUND, source_line);
+                expander->valid = FALSE;
+            }
+            else if (!append_incbin_line(expander, line, open_quote, file->path, source_line))
+            {
+                return FALSE;
+            }
+            line = next;
+            continue;
+        }
+
+        kind = parse_include(line, next, name);
+        if (kind == 0)
+        {
+            /* included files may end without a newline, their lines still do */
+            if (!append_line(expander->out, line, (size_t)(next - line), include_line != 0, source_line))
+            {
+                return FALSE;
+            }
+        }
+        else if (kind < 0)
+        {
+            print_error(ERROR_INCLUDE_SYNTAX, source_line);
+            expander->valid = FALSE;
+        }
+        else if (!find_include(expander, path, name, found, &st))
+        {
+            print_error(ERROR_INCLUDE_NOT_FOUND, source_line);
+            expander->valid = FALSE;
+        }
+        else if (is_being_included(expander, &st))
+        {
+            print_error(ERROR_INCLUDE_CYCLE, source_line);
+            expander->valid = FALSE;
+        }
+        else if (expander->depth == MAX_INCLUDE_DEPTH)
+        {
+            print_error(ERROR_INCLUDE_TOO_DEEP, source_line);
+            expander->valid = FALSE;
+        }
+        else if (!(file = load_shared_file(found, &st)))
+        {
+            print_error(ERROR_INCLUDE_NOT_FOUND, source_line);
+            expander->valid = FALSE;
+        }
+        else
+        {
+            if (!add_dependency(expander->out, file->path))
+            {
+                return FALSE;
+            }
+            expander->stack[expander->depth++] = file;
+            if (!expand_text(expander, file->path, file->data, file->size, source_line))
+            {
+                return FALSE;
+            }
+            expander->depth--;
+        }
+        line = next;
+    }
+    end_conditional_file(&expander->conditions, floor, include_line);
+    return TRUE;
+}
+
+/* Replaces every .include directive of a source by the lines of the included file. */
+int expand_includes(const char *path, const char *data, size_t size, const IncludeOptions *options, IncludedSource *out)
+{
+    Expander expander;
+    struct stat st;
+
+    memset(out, 0, sizeof(*out));
+    if (!init_conditions(&expander.conditions, options->defines, options->define_count))
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+    expander.out = out;
+    expander.options = options;
+    expander.depth = 0;
+    expander.valid = TRUE;
+    expander.has_root = stat(path, &st) == 0;
+    if (expander.has_root)
+    {
+        expander.root_device = st.st_dev;
+        expander.root_inode = st.st_ino;
+    }
+
+    /* a source of nothing but empty includes still has a line to read */
+    if (!expand_text(&expander, path, data, size, 0) || (out->size == 0 && !append_line(out, "\n", 1, TRUE, 1)))
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        free_included_source(out);
+        free_conditions(&expander.conditions);
+        return FALSE;
+    }
+    free_conditions(&expander.conditions);
+    if (!expander.valid || !expander.conditions.valid)
+    {
+        free_included_source(out);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Returns the .as line a line of an expanded source comes from. */
+int included_source_line(const IncludedSource *source, int line)
+{
+    if (!source || line < 1 || source->line_count == 0)
+    {
+        return line;
+    }
+    return source->lines[line <= source->line_count ? line - 1 : source->line_count - 1];
+}
+
+/* Releases an expanded source. */
+void free_included_source(IncludedSource *source)
+{
+    free(source->text);
+    free(source->lines);
+    free((void *)source->files);
+    memset(source, 0, sizeof(*source));
+}
+
+/**
+ * @brief Writes a path for make, escaping its spaces.
+ */
+static void write_make_path(FILE *fp, const char *path)
+{
+    for (; *path; path++)
+    {
+        if (*path == ' ')
+        {
+            fputc('\\', fp);
+        }
+        fputc(*path, fp);
+    }
+}
+
+/* Writes the make dependencies of a source to base.d. */
+int write_dependency_file(const char *base, const IncludedSource *source)
+{
+    char path[MAX_FILENAME_LENGTH + 5];
+    OutputFile file;
+    int i, count = source ? source->file_count : 0;
+
+    sprintf(path, "%s.d", base);
+    if (!open_output_file(&file, path))
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+        return FALSE;
+    }
+
+    write_make_path(file.fp, base);
+    fputs(".am ", file.fp);
+    write_make_path(file.fp, base);
+    fputs(".ob: ", file.fp);
+    write_make_path(file.fp, base);
+    fputs(".as", file.fp);
+    for (i = 0; i < count; i++)
+    {
+        fputs(" \\\n  ", file.fp);
+        write_make_path(file.fp, source->files[i]);
+    }
+    fputc('\n', file.fp);
+
+    /* an empty rule per included file, as gcc -MP writes */
+    for (i = 0; i < count; i++)
+    {
+        fputc('\n', file.fp);
+        write_make_path(file.fp, source->files[i]);
+        fputs(":\n", file.fp);
+    }
+
+    if (!close_output_file(&file))
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Reads the bytes of an .incbin file, mapped once per batch. */
+int load_binary_file(const char *path, const char **data, size_t *size)
+{
+    const SharedFile *file;
+    struct stat st;
+
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) || !(file = load_shared_file(path, &st)))
+    {
+        return FALSE;
+    }
+    *data = file->data;
+    *size = file->size;
+    return TRUE;
+}
+
+/* Unmaps the files included during a batch. */
+void release_included_files(void)
+{
+    int i;
+
+    pthread_mutex_lock(&shared.lock);
+    for (i = 0; i < shared.count; i++)
+    {
+        if (shared.files[i]->data)
+        {
+            munmap(shared.files[i]->data, shared.files[i]->size);
+        }
+        free(shared.files[i]->path);
+        free(shared.files[i]);
+    }
+    free(shared.files);
+    shared.files = NULL;
+    shared.count = 0;
+    shared.capacity = 0;
+    pthread_mutex_unlock(&shared.lock);
+}
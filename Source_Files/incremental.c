@@ -0,0 +1,830 @@
+/* Source_Files/incremental.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../Header_Files/incremental.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+#include "../Header_Files/diagnostics.h"
+#include "../Header_Files/first_pass_utils.h"
+#include "../Header_Files/label_utils.h"
+#include "../Header_Files/command_utils.h"
+#include "../Header_Files/vpc_utils.h"
+#include "../Header_Files/second_pass.h"
+#include "../Header_Files/output_builder.h"
+#include "../Header_Files/utils.h"
+
+#define FIRST_ADDRESS 100
+
+/**
+ * @struct ChangedLabel
+ * @brief A label that differs between the tables before and after an edit.
+ */
+typedef struct
+{
+    char name[MAX_LABEL_LENGTH];
+    int checked; /* TRUE if added, removed or retyped: the label checks of its users may change */
+} ChangedLabel;
+
+/**
+ * @brief Makes a sink, emptied, the destination of the diagnostics.
+ *
+ * @return The sink that was current before.
+ */
+static DiagnosticSink *begin_capture(DiagnosticSink *sink, const char *file)
+{
+    DiagnosticSink *previous = get_current_sink();
+
+    reset_diagnostic_sink(sink, file, 0);
+    capture_diagnostics(sink);
+    set_current_sink(sink);
+    return previous;
+}
+
+/**
+ * @brief Restores the previous sink and moves what was captured into a list.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int end_capture(DiagnosticSink *sink, DiagnosticSink *previous, Diagnostic **list, int *count)
+{
+    Diagnostic *copy = NULL;
+    int captured = sink->history_count;
+
+    set_diagnostic_line(NULL);
+    set_current_sink(previous);
+
+    if (captured > 0)
+    {
+        copy = (Diagnostic *)malloc(captured * sizeof(Diagnostic));
+        if (!copy)
+        {
+            return FALSE;
+        }
+        memcpy(copy, sink->history, captured * sizeof(Diagnostic));
+    }
+    free(*list);
+    *list = copy;
+    *count = captured;
+    return TRUE;
+}
+
+/* Releases what a line record holds. */
+void free_line_record(LineRecord *record)
+{
+    free(record->words);
+    free(record->first_pass_diagnostics);
+    free(record->second_pass_diagnostics);
+    record->words = NULL;
+    record->first_pass_diagnostics = NULL;
+    record->second_pass_diagnostics = NULL;
+}
+
+/**
+ * @brief Records the label a line defines, and where its add_label result belongs among the diagnostics.
+ */
+static void set_record_label(DiagnosticSink *sink, LineRecord *record, const char *label, const char *type)
+{
+    strcpy(record->label, label);
+    record->label_type = type;
+    record->label_slot = sink->history_count;
+}
+
+/**
+ * @brief Keeps a copy of the encoded words of a line.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int keep_words(LineRecord *record, const Word *words, int count)
+{
+    if (count == 0)
+    {
+        return TRUE;
+    }
+    record->words = (Word *)malloc(count * sizeof(Word));
+    if (!record->words)
+    {
+        return FALSE;
+    }
+    memcpy(record->words, words, count * sizeof(Word));
+    record->word_count = count;
+    return TRUE;
+}
+
+/**
+ * @brief Checks the label of a .data, .string or command line, as the first pass does.
+ */
+static void check_line_label(DiagnosticSink *sink, LineRecord *record, const char *label, const char *type, int line_number)
+{
+    ErrorCode error = is_valid_label(label);
+
+    if (error != ERROR_SUCCESS)
+    {
+        print_error(error, line_number);
+        return;
+    }
+    if (is_non_existing_register(label))
+    {
+        print_warning(WARNING_LABEL_RESEMBLES_INVALID_REGISTER, line_number);
+    }
+    set_record_label(sink, record, label, type);
+}
+
+/**
+ * @brief Classifies the content of a line (after its label), encoding its words as the first pass does.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int classify_content(DiagnosticSink *sink, LineRecord *record, char *content, int has_label, char *label, int line_number)
+{
+    Word words[MAX_COMMAND_WORDS];
+    Word *data_words;
+    ErrorCode err;
+    int count;
+
+    if (strncmp(content, ".extern", 7) == 0)
+    {
+        if (has_label)
+        {
+            print_warning(WARNING_LABEL_BEFORE_EXTERN, line_number);
+        }
+        if (!isspace((unsigned char)content[7]) && content[7] != '\0')
+        {
+            print_error(ERROR_MAYBE_MEANT_EXTERN, line_number);
+            return TRUE;
+        }
+        err = is_valid_extern_label(content);
+        if (err != ERROR_SUCCESS)
+        {
+            print_error(err, line_number);
+            return TRUE;
+        }
+        content = advance_to_next_token(content);
+        content += 7; /* move past ".extern" */
+        content = advance_to_next_token(content);
+        sscanf(content, "%s", label);
+        set_record_label(sink, record, label, "external");
+        record->kind = LINE_EXTERN;
+        record->register_warning = is_non_existing_register(label);
+        return TRUE;
+    }
+    if (strncmp(content, ".entry", 6) == 0)
+    {
+        record->kind = LINE_ENTRY;
+        return TRUE;
+    }
+
+    err = is_data_storage_instruction(content);
+    if (err != ERROR_INVALID_STORAGE_DIRECTIVE)
+    {
+        if (has_label)
+        {
+            check_line_label(sink, record, label, "data", line_number);
+        }
+        if (err != ERROR_SUCCESS)
+        {
+            print_error(err, line_number);
+            return TRUE;
+        }
+        record->kind = LINE_DATA;
+        record->data_count = count_data_or_string_elements(content);
+        count = encode_data_or_string(content, NULL);
+        if (count == 0)
+        {
+            return TRUE;
+        }
+        data_words = (Word *)calloc(count, sizeof(Word));
+        if (!data_words)
+        {
+            return FALSE;
+        }
+        record->word_count = encode_data_or_string(content, data_words);
+        record->words = data_words;
+        return TRUE;
+    }
+
+    err = is_valid_command(content);
+    if (err != ERROR_UNKNOWN_COMMAND)
+    {
+        if (has_label)
+        {
+            check_line_label(sink, record, label, "code", line_number);
+        }
+        if (err != ERROR_SUCCESS)
+        {
+            print_error(err, line_number);
+            return TRUE;
+        }
+        record->kind = LINE_CODE;
+        return keep_words(record, words, encode_command(content, words));
+    }
+
+    print_error(err, line_number);
+    return TRUE;
+}
+
+/* Parses and encodes one line on its own, collecting its first pass diagnostics. */
+int analyze_line_record(LineRecord *record, DiagnosticSink *sink, const char *file, int line_number)
+{
+    char line[MAX_LINE_LENGTH];
+    char label[MAX_LINE_LENGTH];
+    char *colon_pos, *quote_pos, *content, *ptr_line;
+    DiagnosticSink *previous;
+    size_t label_length;
+    int ok = TRUE;
+
+    record->kind = LINE_NONE;
+    record->label[0] = '\0';
+    record->label_type = NULL;
+    record->label_slot = -1;
+    record->register_warning = FALSE;
+    record->label_error = ERROR_SUCCESS;
+    record->second_pass_valid = TRUE;
+
+    strcpy(line, record->text);
+    record->operand_count = split_command_operands(line, record->operands);
+
+    previous = begin_capture(sink, file);
+    strcpy(line, record->text);
+    ptr_line = advance_to_next_token(line);
+    colon_pos = strchr(ptr_line, ':');
+    quote_pos = strchr(ptr_line, '"');
+
+    /* the same checks, in the same order, as the first pass */
+    if (strncmp(ptr_line, ".string", 7) != 0 && colon_pos && quote_pos && quote_pos - line < colon_pos - ptr_line)
+    {
+        print_error(ERROR_ILLEGAL_LABEL, line_number);
+    }
+    else
+    {
+        if (colon_pos)
+        {
+            label_length = colon_pos - ptr_line;
+            strncpy(label, ptr_line, label_length);
+            label[label_length] = '\0';
+            content = advance_to_next_token(colon_pos + 1);
+        }
+        else
+        {
+            content = advance_to_next_token(line);
+        }
+        ok = classify_content(sink, record, content, colon_pos != NULL, label, line_number);
+    }
+
+    return end_capture(sink, previous, &record->first_pass_diagnostics, &record->first_pass_count) && ok;
+}
+
+/**
+ * @brief Runs the label checks of the second pass on one line.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int check_line(IncrementalAssembly *state, int index)
+{
+    LineRecord *record = &state->lines[index];
+    char line[MAX_LINE_LENGTH];
+    DiagnosticSink *previous;
+
+    strcpy(line, record->text);
+    previous = begin_capture(&state->sink, state->file);
+    record->second_pass_valid = second_pass_line(line, index + 1, &state->label_table);
+    state->lines_checked++;
+    return end_capture(&state->sink, previous, &record->second_pass_diagnostics, &record->second_pass_count);
+}
+
+/**
+ * @brief Splits text into lines as fgets reads them from a file.
+ *
+ * @return The number of lines; with records, the lines are copied into them.
+ */
+static int split_text(const char *text, size_t length, LineRecord *records)
+{
+    size_t start = 0, end;
+    int count = 0;
+
+    while (start < length)
+    {
+        end = start;
+        while (end < length && end - start < MAX_LINE_LENGTH - 1 && text[end] != '\n')
+        {
+            end++;
+        }
+        if (end < length && end - start < MAX_LINE_LENGTH - 1)
+        {
+            end++; /* the newline stays with its line */
+        }
+        if (records)
+        {
+            memcpy(records[count].text, text + start, end - start);
+            records[count].text[end - start] = '\0';
+        }
+        count++;
+        start = end;
+    }
+    return count;
+}
+
+/**
+ * @brief Lays out one line after the one before it.
+ */
+static void place_after(LineRecord *record, const LineRecord *before)
+{
+    if (!before)
+    {
+        record->code_offset = 0;
+        record->data_offset = 0;
+        record->data_word_offset = 0;
+        return;
+    }
+    record->code_offset = before->code_offset + (before->kind == LINE_CODE ? before->word_count : 0);
+    record->data_offset = before->data_offset + before->data_count;
+    record->data_word_offset = before->data_word_offset + (before->kind == LINE_DATA ? before->word_count : 0);
+}
+
+/**
+ * @brief Adds the labels of every line to an empty table, as the first pass does.
+ */
+static void rebuild_labels(IncrementalAssembly *state)
+{
+    LineRecord *record;
+    int i;
+
+    reset_label_table(&state->label_table);
+    for (i = 0; i < state->line_count; i++)
+    {
+        record = &state->lines[i];
+        if (record->label_type)
+        {
+            state->vpc->IC = FIRST_ADDRESS + record->code_offset;
+            state->vpc->DC = record->data_offset;
+            record->label_error = add_label(record->label, i + 1, "", record->label_type, state->vpc, &state->label_table, state->mcro_table);
+        }
+    }
+
+    /* add the final IC to the data labels */
+    for (i = 0; i < state->label_table.count; i++)
+    {
+        if (strstr(state->label_table.labels[i].type, "data") != NULL)
+        {
+            state->label_table.labels[i].address += FIRST_ADDRESS + state->code_words;
+        }
+    }
+}
+
+/**
+ * @brief Adds a label to the list of changed labels.
+ */
+static void add_changed(ChangedLabel *changed, int *count, const char *name, int checked)
+{
+    strncpy(changed[*count].name, name, MAX_LABEL_LENGTH - 1);
+    changed[*count].name[MAX_LABEL_LENGTH - 1] = '\0';
+    changed[*count].checked = checked;
+    (*count)++;
+}
+
+/**
+ * @brief Collects the labels that were added, removed, moved or retyped.
+ *
+ * @return The number of changed labels.
+ */
+static int collect_changed_labels(LabelTable *old_table, LabelTable *new_table, ChangedLabel *changed)
+{
+    Label *label, *other;
+    int i, count = 0;
+
+    for (i = 0; i < new_table->count; i++)
+    {
+        label = &new_table->labels[i];
+        other = get_label_by_name(old_table, label->name);
+        if (!other || strcmp(other->type, label->type) != 0)
+        {
+            add_changed(changed, &count, label->name, TRUE);
+        }
+        else if (other->address != label->address)
+        {
+            add_changed(changed, &count, label->name, FALSE);
+        }
+    }
+    for (i = 0; i < old_table->count; i++)
+    {
+        if (!get_label_by_name(new_table, old_table->labels[i].name))
+        {
+            add_changed(changed, &count, old_table->labels[i].name, TRUE);
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Tells whether a line may name one of the changed labels.
+ *
+ * @param checked_only TRUE to consider only the labels whose checks may change.
+ * @return TRUE (1) if it may, FALSE (0) otherwise.
+ */
+static int names_changed_label(const LineRecord *record, const ChangedLabel *changed, int count, int checked_only)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if ((changed[i].checked || !checked_only) && strstr(record->text, changed[i].name) != NULL)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Tells whether an operand names one of the changed labels.
+ *
+ * @return TRUE (1) if it does, FALSE (0) otherwise.
+ */
+static int operand_changed(const char *operand, const ChangedLabel *changed, int count)
+{
+    int i;
+
+    if (operand[0] == '&')
+    {
+        operand++;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (strcmp(operand, changed[i].name) == 0)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Copies the encoded words of a line into the image.
+ */
+static void write_words(IncrementalAssembly *state, const LineRecord *record, int address)
+{
+    int i;
+
+    for (i = 0; i < record->word_count && address + i < STORAGE_SIZE; i++)
+    {
+        state->vpc->storage[address + i] = record->words[i];
+    }
+}
+
+/**
+ * @brief Resolves the operand words of a command line, as fill_addresses_words does.
+ */
+static void resolve_line(IncrementalAssembly *state, const LineRecord *record)
+{
+    int i, word = 1;
+    int address = FIRST_ADDRESS + record->code_offset + 1;
+
+    for (i = 0; i < record->operand_count && word < record->word_count; i++)
+    {
+        if (!validate_register_operand(record->operands[i])) /* non register operands give a word */
+        {
+            if (address < STORAGE_SIZE)
+            {
+                state->vpc->storage[address] = record->words[word];
+                resolve_operand_word(&state->vpc->storage[address], record->operands[i], address, &state->label_table);
+                state->operands_resolved++;
+            }
+            address++;
+            word++;
+        }
+    }
+}
+
+/**
+ * @brief Tells whether a diagnostic list holds an error.
+ *
+ * @return TRUE (1) if it does, FALSE (0) otherwise.
+ */
+static int has_error(const Diagnostic *diagnostics, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (diagnostics[i].severity == DIAGNOSTIC_ERROR)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Replays the diagnostics of one line, numbered by its current position.
+ */
+static void replay_line(const Diagnostic *diagnostics, int count, int line_number)
+{
+    Diagnostic diagnostic;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        diagnostic = diagnostics[i];
+        if (diagnostic.line_number != DIAGNOSTIC_NO_LINE)
+        {
+            diagnostic.line_number = line_number;
+            diagnostic.source_line = line_number;
+        }
+        replay_diagnostic(&diagnostic);
+    }
+}
+
+/**
+ * @brief Reports the result of adding a line's label, as the first pass does.
+ */
+static void report_label(const LineRecord *record, int line_number)
+{
+    if (record->label_error != ERROR_SUCCESS)
+    {
+        print_error(record->label_error, line_number);
+    }
+    else if (record->register_warning)
+    {
+        print_warning(WARNING_LABEL_RESEMBLES_INVALID_REGISTER, line_number);
+    }
+}
+
+/* Starts an empty incremental assembly. */
+void init_incremental(IncrementalAssembly *state, VirtualPC *vpc, const McroTable *mcro_table, const char *file)
+{
+    state->lines = NULL;
+    state->line_count = 0;
+    state->line_capacity = 0;
+    state->vpc = vpc;
+    state->mcro_table = mcro_table;
+    state->file = file;
+    state->code_words = 0;
+    state->data_count = 0;
+    state->data_words = 0;
+    state->storage_full = FALSE;
+    state->success = TRUE;
+    state->lines_parsed = 0;
+    state->lines_checked = 0;
+    state->operands_resolved = 0;
+    init_diagnostic_sink(&state->sink);
+    init_virtual_pc(vpc);
+    init_label_table(&state->label_table);
+}
+
+/* Replaces a range of lines and updates the image, the labels and the diagnostics. */
+int edit_incremental(IncrementalAssembly *state, int first_line, int removed, const char *text, size_t length)
+{
+    LabelTable old_table;
+    ChangedLabel changed[2 * MAX_LABELS];
+    LineRecord *added, *lines, *record, *next;
+    int first = first_line - 1;
+    int added_count, changed_count, end, i, ok = TRUE;
+    int code_delta = 0, data_delta = 0, word_delta = 0;
+    int old_last = state->vpc->last_adress, was_full = state->storage_full;
+    int rewrite_code, rewrite_data, data_address;
+
+    if (first < 0 || removed < 0 || first + removed > state->line_count)
+    {
+        return FALSE;
+    }
+
+    /* parse the new lines on their own, so a failure leaves the state as it was */
+    added_count = split_text(text, length, NULL);
+    added = (LineRecord *)calloc(added_count > 0 ? added_count : 1, sizeof(LineRecord));
+    if (!added)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+    split_text(text, length, added);
+    for (i = 0; i < added_count && ok; i++)
+    {
+        ok = analyze_line_record(&added[i], &state->sink, state->file, first + i + 1);
+    }
+    if (ok && state->line_count - removed + added_count > state->line_capacity)
+    {
+        int capacity = state->line_capacity ? state->line_capacity : 64;
+        while (capacity < state->line_count - removed + added_count)
+        {
+            capacity *= 2;
+        }
+        lines = (LineRecord *)realloc(state->lines, capacity * sizeof(LineRecord));
+        if (!lines)
+        {
+            ok = FALSE;
+        }
+        else
+        {
+            state->lines = lines;
+            state->line_capacity = capacity;
+        }
+    }
+    if (!ok)
+    {
+        for (i = 0; i < added_count; i++)
+        {
+            free_line_record(&added[i]);
+        }
+        free(added);
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+    state->lines_parsed = added_count;
+    state->lines_checked = 0;
+    state->operands_resolved = 0;
+
+    /* splice the new records in place of the removed ones */
+    old_table = state->label_table;
+    for (i = first; i < first + removed; i++)
+    {
+        free_line_record(&state->lines[i]);
+    }
+    memmove(&state->lines[first + added_count], &state->lines[first + removed],
+            (state->line_count - first - removed) * sizeof(LineRecord));
+    memcpy(&state->lines[first], added, added_count * sizeof(LineRecord));
+    free(added);
+    state->line_count += added_count - removed;
+    end = first + added_count;
+
+    /* lay out the new lines; the lines after them move by the same amount */
+    for (i = first; i < end; i++)
+    {
+        place_after(&state->lines[i], i > 0 ? &state->lines[i - 1] : NULL);
+    }
+    if (end < state->line_count)
+    {
+        next = &state->lines[end];
+        code_delta = next->code_offset;
+        data_delta = next->data_offset;
+        word_delta = next->data_word_offset;
+        place_after(next, end > 0 ? &state->lines[end - 1] : NULL);
+        code_delta = next->code_offset - code_delta;
+        data_delta = next->data_offset - data_delta;
+        word_delta = next->data_word_offset - word_delta;
+        for (i = end + 1; (code_delta || data_delta || word_delta) && i < state->line_count; i++)
+        {
+            state->lines[i].code_offset += code_delta;
+            state->lines[i].data_offset += data_delta;
+            state->lines[i].data_word_offset += word_delta;
+        }
+        state->code_words += code_delta;
+        state->data_count += data_delta;
+        state->data_words += word_delta;
+    }
+    else
+    {
+        LineRecord last;
+        place_after(&last, state->line_count > 0 ? &state->lines[state->line_count - 1] : NULL);
+        word_delta = last.data_word_offset - state->data_words;
+        code_delta = last.code_offset - state->code_words;
+        state->code_words = last.code_offset;
+        state->data_count = last.data_offset;
+        state->data_words = last.data_word_offset;
+    }
+
+    /* the labels, in order, then the .entry directives that mark them */
+    rebuild_labels(state);
+    for (i = 0; i < state->line_count && ok; i++)
+    {
+        if (strstr(state->lines[i].text, ".entry") != NULL)
+        {
+            ok = check_line(state, i);
+        }
+    }
+    changed_count = collect_changed_labels(&old_table, &state->label_table, changed);
+
+    /* the label checks of the edited lines and of the users of changed labels */
+    for (i = 0; i < state->line_count && ok; i++)
+    {
+        record = &state->lines[i];
+        if (strstr(record->text, ".entry") == NULL &&
+            ((i >= first && i < end) || names_changed_label(record, changed, changed_count, TRUE)))
+        {
+            ok = check_line(state, i);
+        }
+    }
+
+    /* the image: moved words are copied again from their lines */
+    state->storage_full = FIRST_ADDRESS + state->code_words > STORAGE_SIZE ||
+                          (state->data_words > 0 && FIRST_ADDRESS + state->code_words + state->data_count >= STORAGE_SIZE);
+    data_address = FIRST_ADDRESS + state->code_words;
+    for (i = first; i < state->line_count; i++)
+    {
+        record = &state->lines[i];
+        rewrite_code = i < end || code_delta != 0;
+        rewrite_data = i < end || code_delta != 0 || word_delta != 0 || was_full;
+        if (record->kind == LINE_CODE && rewrite_code)
+        {
+            write_words(state, record, FIRST_ADDRESS + record->code_offset);
+        }
+        else if (record->kind == LINE_DATA && rewrite_data && !state->storage_full)
+        {
+            write_words(state, record, data_address + record->data_word_offset);
+        }
+    }
+    if (code_delta != 0 || was_full) /* the data moved as a whole, including lines before the edit */
+    {
+        for (i = 0; i < first && !state->storage_full; i++)
+        {
+            record = &state->lines[i];
+            if (record->kind == LINE_DATA)
+            {
+                write_words(state, record, data_address + record->data_word_offset);
+            }
+        }
+    }
+    state->vpc->IC = FIRST_ADDRESS + state->code_words;
+    state->vpc->DC = state->data_count;
+    state->vpc->last_adress = state->vpc->IC + (state->storage_full ? 0 : state->data_words);
+    if (state->vpc->last_adress < old_last)
+    {
+        memset(&state->vpc->storage[state->vpc->last_adress], 0, (old_last - state->vpc->last_adress) * sizeof(Word));
+    }
+
+    /* the operand words of rewritten lines and of users of changed labels */
+    for (i = 0; i < state->line_count; i++)
+    {
+        record = &state->lines[i];
+        if (record->kind == LINE_CODE && record->operand_count > 0)
+        {
+            int rewritten = i >= first && (i < end || code_delta != 0);
+            int uses_changed = FALSE, j;
+            for (j = 0; j < record->operand_count && !rewritten && !uses_changed; j++)
+            {
+                uses_changed = operand_changed(record->operands[j], changed, changed_count);
+            }
+            if (rewritten || uses_changed)
+            {
+                resolve_line(state, record);
+            }
+        }
+    }
+
+    /* the source is valid if no line reported an error */
+    state->success = !state->storage_full;
+    for (i = 0; i < state->line_count; i++)
+    {
+        record = &state->lines[i];
+        if (has_error(record->first_pass_diagnostics, record->first_pass_count) ||
+            record->label_error != ERROR_SUCCESS || !record->second_pass_valid)
+        {
+            state->success = FALSE;
+        }
+    }
+    if (!ok)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        state->success = FALSE;
+    }
+    return TRUE;
+}
+
+/* Reports the diagnostics of the whole source, in the order of a full build. */
+void report_incremental_diagnostics(const IncrementalAssembly *state)
+{
+    const LineRecord *record;
+    int i, j;
+
+    for (i = 0; i < state->line_count; i++)
+    {
+        record = &state->lines[i];
+        for (j = 0; j < record->first_pass_count; j++)
+        {
+            if (j == record->label_slot)
+            {
+                report_label(record, i + 1);
+            }
+            replay_line(&record->first_pass_diagnostics[j], 1, i + 1);
+        }
+        if (record->label_slot == record->first_pass_count)
+        {
+            report_label(record, i + 1);
+        }
+    }
+    if (state->storage_full)
+    {
+        print_error_no_line(ERROR_VPC_STORAGE_FULL);
+    }
+    for (i = 0; i < state->line_count; i++)
+    {
+        record = &state->lines[i];
+        replay_line(record->second_pass_diagnostics, record->second_pass_count, i + 1);
+    }
+}
+
+/* Releases the lines and the sink of an incremental assembly. */
+void free_incremental(IncrementalAssembly *state)
+{
+    int i;
+
+    for (i = 0; i < state->line_count; i++)
+    {
+        free_line_record(&state->lines[i]);
+    }
+    free(state->lines);
+    state->lines = NULL;
+    state->line_count = 0;
+    state->line_capacity = 0;
+    destroy_diagnostic_sink(&state->sink);
+}
@@ -8,6 +8,7 @@
 #include "../Header_Files/utils.h"
 #include "../Header_Files/errors.h"
 #include "../Header_Files/structs.h"
+#include "../Header_Files/preprocessor_utils.h"
 #include "../Header_Files/errors.h"
 
 /* Validates whether a given string is a valid label name. */
@@ -225,6 +226,7 @@ ErrorCode is_valid_entry_label(const char *line, LabelTable *label_table)
 ErrorCode add_label(const char *name, int line_number, const char *line, const char *type, VirtualPC *vpc, LabelTable *label_table, const McroTable *mcro_table)
 {
     int i;
+    const MacroLibrary *library;
     ErrorCode err = ERROR_SUCCESS;
 
     /* check if label table is full */
@@ -246,14 +248,11 @@ ErrorCode add_label(const char *name, int line_number, const char *line, const c
         }
     }
 
-    /* check if label name conflicts with a macro name */
-    for (i = 0; i < mcro_table->count; i++)
+    /* check if label name conflicts with a macro name, of the file or of a library */
+    if (find_mcro(mcro_table, name, &library) >= 0)
     {
-        if (strcmp(name, mcro_table->mcros[i].name) == 0)
-        {
-            err = ERROR_LABEL_IS_MCRO_NAME;
-            return err;
-        }
+        err = ERROR_LABEL_IS_MCRO_NAME;
+        return err;
     }
 
     /* copy label name */
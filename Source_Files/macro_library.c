@@ -0,0 +1,878 @@
+/* Source_Files/macro_library.c */
+#define _POSIX_C_SOURCE 200809L /* getline, strtok_r */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../Header_Files/macro_library.h"
+#include "../Header_Files/preprocessor_utils.h"
+#include "../Header_Files/object_cache.h"
+#include "../Header_Files/output_file.h"
+#include "../Header_Files/diagnostics.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+#include "../Header_Files/utils.h"
+
+#define MLIB_MACRO_SIZE 20
+#define MLIB_LINE_SIZE 12
+#define MLIB_REFERENCE_SIZE 4
+
+/**
+ * @struct LibraryBuilder
+ * @brief The tables of a library being compiled.
+ */
+typedef struct
+{
+    MacroLibraryMacro *macros;
+    uint32_t macro_count;
+    uint32_t macro_capacity;
+    uint32_t *index;         /* open addressing index of the names */
+    uint32_t index_capacity; /* a power of two */
+    MacroLibraryLine *lines;
+    uint32_t line_count;
+    uint32_t line_capacity;
+    MacroLibraryReference *references;
+    uint32_t reference_count;
+    uint32_t reference_capacity;
+    char *strings;
+    uint32_t strings_size;
+    uint32_t strings_capacity;
+} LibraryBuilder;
+
+/**
+ * @brief Hashes a macro name (FNV-1a).
+ */
+static uint32_t hash_name(const char *name)
+{
+    unsigned long hash = 2166136261UL;
+
+    while (*name)
+    {
+        hash ^= (unsigned char)*name++;
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return (uint32_t)hash;
+}
+
+/**
+ * @brief Makes room for one more element of a builder table, doubling it when full.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int reserve(void **array, uint32_t count, uint32_t *capacity, size_t size)
+{
+    void *grown;
+    uint32_t new_capacity;
+
+    if (count < *capacity)
+    {
+        return TRUE;
+    }
+    new_capacity = *capacity ? *capacity * 2 : 64;
+    grown = realloc(*array, new_capacity * size);
+    if (!grown)
+    {
+        return FALSE;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return TRUE;
+}
+
+/**
+ * @brief Appends a null terminated string to the strings of a builder.
+ *
+ * @return The offset of the string, or MLIB_EMPTY_SLOT on allocation failure.
+ */
+static uint32_t add_string(LibraryBuilder *builder, const char *text)
+{
+    uint32_t length = (uint32_t)strlen(text) + 1, offset = builder->strings_size;
+    char *grown;
+
+    while (builder->strings_size + length > builder->strings_capacity)
+    {
+        grown = (char *)realloc(builder->strings, builder->strings_capacity * 2);
+        if (!grown)
+        {
+            return (uint32_t)MLIB_EMPTY_SLOT;
+        }
+        builder->strings = grown;
+        builder->strings_capacity *= 2;
+    }
+    memcpy(builder->strings + offset, text, length);
+    builder->strings_size += length;
+    return offset;
+}
+
+/**
+ * @brief Looks a name up in the index of a builder.
+ *
+ * @return The slot holding the macro, or the free slot where it belongs.
+ */
+static uint32_t find_slot(const LibraryBuilder *builder, const char *name, uint32_t hash)
+{
+    uint32_t slot = hash & (builder->index_capacity - 1);
+    const MacroLibraryMacro *macro;
+
+    while (builder->index[slot] != MLIB_EMPTY_SLOT)
+    {
+        macro = &builder->macros[builder->index[slot]];
+        if (macro->hash == hash && strcmp(builder->strings + macro->name, name) == 0)
+        {
+            break;
+        }
+        slot = (slot + 1) & (builder->index_capacity - 1);
+    }
+    return slot;
+}
+
+/**
+ * @brief Rebuilds the index of a builder with twice the slots.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int grow_index(LibraryBuilder *builder)
+{
+    uint32_t *old = builder->index, i;
+
+    builder->index_capacity *= 2;
+    builder->index = (uint32_t *)malloc(builder->index_capacity * sizeof(uint32_t));
+    if (!builder->index)
+    {
+        builder->index = old;
+        builder->index_capacity /= 2;
+        return FALSE;
+    }
+    memset(builder->index, 0xFF, builder->index_capacity * sizeof(uint32_t));
+    for (i = 0; i < builder->macro_count; i++)
+    {
+        builder->index[find_slot(builder, builder->strings + builder->macros[i].name, builder->macros[i].hash)] = i;
+    }
+    free(old);
+    return TRUE;
+}
+
+/**
+ * @brief Adds a macro to a builder.
+ *
+ * @return ERROR_SUCCESS, ERROR_MCRO_DUPLICATE or ERROR_MEMORY_ALLOCATION.
+ */
+static ErrorCode add_library_mcro(LibraryBuilder *builder, const char *name, int param_count)
+{
+    MacroLibraryMacro *macro;
+    uint32_t hash = hash_name(name), slot;
+
+    if (builder->index[find_slot(builder, name, hash)] != MLIB_EMPTY_SLOT)
+    {
+        return ERROR_MCRO_DUPLICATE;
+    }
+    if ((builder->macro_count + 1) * 2 > builder->index_capacity && !grow_index(builder))
+    {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    if (!reserve((void **)&builder->macros, builder->macro_count, &builder->macro_capacity, sizeof(MacroLibraryMacro)))
+    {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    macro = &builder->macros[builder->macro_count];
+    macro->name = add_string(builder, name);
+    if (macro->name == MLIB_EMPTY_SLOT)
+    {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    macro->hash = hash;
+    macro->param_count = (uint32_t)param_count;
+    macro->first_line = builder->line_count;
+    macro->line_count = 0;
+
+    slot = find_slot(builder, name, hash);
+    builder->index[slot] = builder->macro_count++;
+    return ERROR_SUCCESS;
+}
+
+/**
+ * @brief Adds a body line to the last macro of a builder, with its parameter names.
+ *
+ * @return ERROR_SUCCESS or ERROR_MEMORY_ALLOCATION.
+ */
+static ErrorCode add_library_line(LibraryBuilder *builder, const char *text, char params[][MAX_MCRO_NAME_LENGTH], int param_count)
+{
+    ParamReference found[MAX_PARAM_REFERENCES];
+    MacroLibraryLine *line;
+    MacroLibraryReference *reference;
+    int i, count;
+
+    if (!reserve((void **)&builder->lines, builder->line_count, &builder->line_capacity, sizeof(MacroLibraryLine)))
+    {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    line = &builder->lines[builder->line_count];
+    line->text = add_string(builder, text);
+    if (line->text == MLIB_EMPTY_SLOT)
+    {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    line->first_reference = builder->reference_count;
+
+    /* the parameter names are found here, once, instead of at every expansion */
+    count = find_param_references((const char (*)[MAX_MCRO_NAME_LENGTH])params, param_count, text, found);
+    for (i = 0; i < count; i++)
+    {
+        if (!reserve((void **)&builder->references, builder->reference_count, &builder->reference_capacity, sizeof(MacroLibraryReference)))
+        {
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        reference = &builder->references[builder->reference_count++];
+        reference->start = (uint16_t)found[i].start;
+        reference->length = (uint8_t)found[i].length;
+        reference->param = (uint8_t)found[i].param;
+    }
+    line->reference_count = (uint32_t)count;
+
+    builder->line_count++;
+    builder->macros[builder->macro_count - 1].line_count++;
+    return ERROR_SUCCESS;
+}
+
+/**
+ * @brief Prepares an empty builder.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int init_builder(LibraryBuilder *builder)
+{
+    memset(builder, 0, sizeof(*builder));
+    builder->index_capacity = 64;
+    builder->index = (uint32_t *)malloc(builder->index_capacity * sizeof(uint32_t));
+    builder->strings_capacity = 4096;
+    builder->strings = (char *)malloc(builder->strings_capacity);
+    if (!builder->index || !builder->strings)
+    {
+        return FALSE;
+    }
+    memset(builder->index, 0xFF, builder->index_capacity * sizeof(uint32_t));
+    builder->strings[0] = '\0'; /* offset 0 is the empty string */
+    builder->strings_size = 1;
+    return TRUE;
+}
+
+/**
+ * @brief Releases the tables of a builder.
+ */
+static void free_builder(LibraryBuilder *builder)
+{
+    free(builder->macros);
+    free(builder->index);
+    free(builder->lines);
+    free(builder->references);
+    free(builder->strings);
+}
+
+/**
+ * @brief Stores a 16-bit value in little-endian byte order.
+ */
+static void put_u16(unsigned char *p, uint16_t value)
+{
+    p[0] = (unsigned char)(value & 0xFF);
+    p[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+/**
+ * @brief Stores a 32-bit value in little-endian byte order.
+ */
+static void put_u32(unsigned char *p, uint32_t value)
+{
+    p[0] = (unsigned char)(value & 0xFF);
+    p[1] = (unsigned char)((value >> 8) & 0xFF);
+    p[2] = (unsigned char)((value >> 16) & 0xFF);
+    p[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+/**
+ * @brief Reads a 16-bit little-endian value.
+ */
+static uint16_t get_u16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * @brief Reads a 32-bit little-endian value.
+ */
+static uint32_t get_u32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Writes the tables of a builder as a .mlib file.
+ *
+ * The file is encoded in memory first, so the content hash covers its
+ * little-endian bytes whatever the host.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the file could not be written.
+ */
+static int write_library(const LibraryBuilder *builder, const char *path)
+{
+    OutputFile file;
+    unsigned char *bytes, *p;
+    uint32_t index_offset, macros_offset, lines_offset, references_offset, strings_offset, i;
+    size_t size;
+    uint64_t hash;
+
+    index_offset = MLIB_HEADER_SIZE;
+    macros_offset = index_offset + builder->index_capacity * 4;
+    lines_offset = macros_offset + builder->macro_count * MLIB_MACRO_SIZE;
+    references_offset = lines_offset + builder->line_count * MLIB_LINE_SIZE;
+    strings_offset = references_offset + builder->reference_count * MLIB_REFERENCE_SIZE;
+    size = (size_t)strings_offset + builder->strings_size;
+
+    bytes = (unsigned char *)malloc(size);
+    if (!bytes)
+    {
+        return FALSE;
+    }
+
+    p = bytes + index_offset;
+    for (i = 0; i < builder->index_capacity; i++, p += 4)
+    {
+        put_u32(p, builder->index[i]);
+    }
+    for (i = 0; i < builder->macro_count; i++, p += MLIB_MACRO_SIZE)
+    {
+        put_u32(p, builder->macros[i].name);
+        put_u32(p + 4, builder->macros[i].hash);
+        put_u32(p + 8, builder->macros[i].param_count);
+        put_u32(p + 12, builder->macros[i].first_line);
+        put_u32(p + 16, builder->macros[i].line_count);
+    }
+    for (i = 0; i < builder->line_count; i++, p += MLIB_LINE_SIZE)
+    {
+        put_u32(p, builder->lines[i].text);
+        put_u32(p + 4, builder->lines[i].first_reference);
+        put_u32(p + 8, builder->lines[i].reference_count);
+    }
+    for (i = 0; i < builder->reference_count; i++, p += MLIB_REFERENCE_SIZE)
+    {
+        put_u16(p, builder->references[i].start);
+        p[2] = builder->references[i].length;
+        p[3] = builder->references[i].param;
+    }
+    memcpy(p, builder->strings, builder->strings_size);
+
+    hash = hash_bytes(bytes + index_offset, macros_offset - index_offset, 0);
+    hash = hash_bytes(bytes + macros_offset, lines_offset - macros_offset, hash);
+    hash = hash_bytes(bytes + lines_offset, references_offset - lines_offset, hash);
+    hash = hash_bytes(bytes + references_offset, strings_offset - references_offset, hash);
+    hash = hash_bytes(bytes + strings_offset, builder->strings_size, hash);
+
+    memcpy(bytes, MLIB_MAGIC, 4);
+    put_u16(bytes + 4, MLIB_VERSION);
+    put_u16(bytes + 6, MLIB_HEADER_SIZE);
+    put_u32(bytes + 8, builder->macro_count);
+    put_u32(bytes + 12, builder->index_capacity);
+    put_u32(bytes + 16, index_offset);
+    put_u32(bytes + 20, macros_offset);
+    put_u32(bytes + 24, lines_offset);
+    put_u32(bytes + 28, builder->line_count);
+    put_u32(bytes + 32, references_offset);
+    put_u32(bytes + 36, builder->reference_count);
+    put_u32(bytes + 40, strings_offset);
+    put_u32(bytes + 44, builder->strings_size);
+    put_u32(bytes + 48, (uint32_t)(hash & 0xFFFFFFFFUL));
+    put_u32(bytes + 52, (uint32_t)(hash >> 32));
+
+    if (!open_output_file(&file, path))
+    {
+        free(bytes);
+        return FALSE;
+    }
+    fwrite(bytes, 1, size, file.fp);
+    free(bytes);
+    return close_output_file(&file);
+}
+
+/**
+ * @brief Reads the macros of a library source into a builder, as the preprocessor reads them.
+ *
+ * @return TRUE (1) if every line is valid, FALSE (0) if an error was reported.
+ */
+static int read_library_source(FILE *fp, LibraryBuilder *builder)
+{
+    char params[MAX_MCRO_PARAMS][MAX_MCRO_NAME_LENGTH];
+    char *line = NULL, *temp_line, *token, *saveptr, *next_char;
+    size_t buffer_size = 0;
+    ssize_t length;
+    int in_mcro = FALSE, has_mcro = FALSE, line_number = 0, is_valid = TRUE, param_count = 0;
+    ErrorCode error;
+
+    while ((length = getline(&line, &buffer_size, fp)) != -1)
+    {
+        line_number++;
+        if (length > 0 && line[length - 1] == '\n')
+        {
+            line[--length] = '\0';
+        }
+        if (length >= MAX_LINE_LENGTH)
+        {
+            print_error(ERROR_LINE_TOO_LONG, line_number);
+            is_valid = FALSE;
+            continue;
+        }
+
+        temp_line = (char *)malloc((size_t)length + 1);
+        if (!temp_line)
+        {
+            print_error_no_line(ERROR_MEMORY_ALLOCATION);
+            free(line);
+            return FALSE;
+        }
+        strcpy(temp_line, line);
+
+        token = strtok_r(temp_line, " \t\n", &saveptr);
+        error = ERROR_SUCCESS;
+        if (!token)
+        {
+            /* a blank line */
+        }
+        else if (strncmp(token, "mcroend", 7) == 0)
+        {
+            /* only a comment may follow */
+            next_char = advance_to_next_token(advance_to_next_token(line) + 7);
+            if (*next_char == '\0' || *next_char == ';')
+            {
+                in_mcro = FALSE;
+            }
+            else
+            {
+                error = ERROR_EXTRA_TEXT_AFTER_COMMAND;
+            }
+        }
+        else if (strcmp(token, "mcro") == 0)
+        {
+            in_mcro = TRUE;
+            has_mcro = FALSE; /* until the definition proves valid */
+            token = strtok_r(NULL, " \t\n", &saveptr);
+            if (!token)
+            {
+                error = ERROR_MCRO_NO_NAME;
+            }
+            else if ((error = is_valid_mcro_name(token)) == ERROR_SUCCESS &&
+                     (error = read_mcro_params(line + (token - temp_line) + strlen(token), params, &param_count)) == ERROR_SUCCESS &&
+                     (error = add_library_mcro(builder, token, param_count)) == ERROR_SUCCESS)
+            {
+                has_mcro = TRUE;
+            }
+        }
+        else if (in_mcro)
+        {
+            /* the body of an invalid definition is dropped, its error was reported */
+            if (has_mcro)
+            {
+                error = add_library_line(builder, advance_to_next_token(line), params, param_count);
+            }
+        }
+        else if (token[0] != ';')
+        {
+            error = ERROR_MLIB_STRAY_LINE;
+        }
+        free(temp_line);
+
+        if (error == ERROR_MEMORY_ALLOCATION)
+        {
+            print_error_no_line(error);
+            free(line);
+            return FALSE;
+        }
+        if (error != ERROR_SUCCESS)
+        {
+            print_error(error, line_number);
+            is_valid = FALSE;
+        }
+    }
+
+    free(line);
+    return is_valid;
+}
+
+/* Compiles the macros of a source into a macro library. */
+int compile_macro_library(const char *filename)
+{
+    char path[MAX_FILENAME_LENGTH + 6];
+    DiagnosticSink sink;
+    LibraryBuilder builder;
+    FILE *fp;
+    int result = FALSE;
+
+    if (strlen(filename) > MAX_FILENAME_LENGTH - 4)
+    {
+        print_error_no_line(ERROR_FILENAME_TOO_LONG);
+        return FALSE;
+    }
+
+    /* the errors of the source are reported against it, as when assembling */
+    init_diagnostic_sink(&sink);
+    reset_diagnostic_sink(&sink, filename, 0);
+    set_current_sink(&sink);
+
+    sprintf(path, "%s.as", filename);
+    fp = fopen(path, "r");
+    if (!fp)
+    {
+        print_error(ERROR_FILE_NOT_EXIST, 0);
+    }
+    else if (!init_builder(&builder))
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        free_builder(&builder);
+        fclose(fp);
+    }
+    else
+    {
+        if (read_library_source(fp, &builder))
+        {
+            sprintf(path, "%s.mlib", filename);
+            result = write_library(&builder, path);
+            if (!result)
+            {
+                print_error_no_line(ERROR_FILE_WRITE);
+            }
+        }
+        free_builder(&builder);
+        fclose(fp);
+    }
+
+    flush_diagnostics(&sink);
+    set_current_sink(NULL);
+    destroy_diagnostic_sink(&sink);
+    if (result)
+    {
+        printf("Macro library %s.mlib created\n", filename);
+    }
+    return result;
+}
+
+/**
+ * @brief Decodes the header at the start of a .mlib file, in the order the writer puts its fields.
+ */
+static void read_header(const unsigned char *p, MacroLibraryHeader *header)
+{
+    memcpy(header->magic, p, 4);
+    header->version = get_u16(p + 4);
+    header->header_size = get_u16(p + 6);
+    header->macro_count = get_u32(p + 8);
+    header->index_capacity = get_u32(p + 12);
+    header->index_offset = get_u32(p + 16);
+    header->macros_offset = get_u32(p + 20);
+    header->lines_offset = get_u32(p + 24);
+    header->line_count = get_u32(p + 28);
+    header->references_offset = get_u32(p + 32);
+    header->reference_count = get_u32(p + 36);
+    header->strings_offset = get_u32(p + 40);
+    header->strings_size = get_u32(p + 44);
+    header->content_hash[0] = get_u32(p + 48);
+    header->content_hash[1] = get_u32(p + 52);
+}
+
+/**
+ * @brief Decodes a macro record of a mapped library.
+ */
+static void read_macro(const MacroLibrary *library, uint32_t mcro, MacroLibraryMacro *macro)
+{
+    const unsigned char *p = library->macros + (size_t)mcro * MLIB_MACRO_SIZE;
+
+    macro->name = get_u32(p);
+    macro->hash = get_u32(p + 4);
+    macro->param_count = get_u32(p + 8);
+    macro->first_line = get_u32(p + 12);
+    macro->line_count = get_u32(p + 16);
+}
+
+/**
+ * @brief Decodes a line record of a mapped library.
+ */
+static void read_line(const MacroLibrary *library, uint32_t index, MacroLibraryLine *line)
+{
+    const unsigned char *p = library->lines + (size_t)index * MLIB_LINE_SIZE;
+
+    line->text = get_u32(p);
+    line->first_reference = get_u32(p + 4);
+    line->reference_count = get_u32(p + 8);
+}
+
+/**
+ * @brief Decodes a reference record of a mapped library.
+ */
+static void read_reference(const MacroLibrary *library, uint32_t index, MacroLibraryReference *reference)
+{
+    const unsigned char *p = library->references + (size_t)index * MLIB_REFERENCE_SIZE;
+
+    reference->start = get_u16(p);
+    reference->length = p[2];
+    reference->param = p[3];
+}
+
+/**
+ * @brief Checks that a table starts where the one before it ends, at a multiple of 4, and that its records fit in the file.
+ */
+static int table_at(const MacroLibrary *library, uint32_t offset, uint64_t expected, uint32_t count, size_t size)
+{
+    return (uint64_t)offset == expected && offset % 4 == 0 && offset <= library->size &&
+           (uint64_t)count * size <= (uint64_t)(library->size - offset);
+}
+
+/**
+ * @brief Maps and validates one .mlib file.
+ *
+ * @return TRUE (1) on success, FALSE (0) otherwise (the error is printed).
+ */
+static int map_macro_library(const char *path, MacroLibrary *library)
+{
+    struct stat st;
+    const MacroLibraryHeader *header = &library->header;
+    const unsigned char *base;
+    int fd;
+
+    memset(library, 0, sizeof(*library));
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < MLIB_HEADER_SIZE)
+    {
+        close(fd);
+        print_error_no_line(ERROR_MLIB_INVALID);
+        return FALSE;
+    }
+
+    library->size = (size_t)st.st_size;
+    library->base = mmap(NULL, library->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); /* the mapping stays valid after closing the descriptor */
+    if (library->base == MAP_FAILED)
+    {
+        library->base = NULL;
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+    base = (const unsigned char *)library->base;
+    read_header(base, &library->header);
+
+    /* the tables follow each other in a fixed order, the strings end the file */
+    if (memcmp(header->magic, MLIB_MAGIC, 4) != 0 ||
+        header->version != MLIB_VERSION ||
+        header->header_size != MLIB_HEADER_SIZE ||
+        header->index_capacity == 0 || (header->index_capacity & (header->index_capacity - 1)) != 0 ||
+        header->macro_count >= header->index_capacity ||
+        !table_at(library, header->index_offset, MLIB_HEADER_SIZE, header->index_capacity, 4) ||
+        !table_at(library, header->macros_offset, (uint64_t)header->index_offset + (uint64_t)header->index_capacity * 4,
+                  header->macro_count, MLIB_MACRO_SIZE) ||
+        !table_at(library, header->lines_offset, (uint64_t)header->macros_offset + (uint64_t)header->macro_count * MLIB_MACRO_SIZE,
+                  header->line_count, MLIB_LINE_SIZE) ||
+        !table_at(library, header->references_offset, (uint64_t)header->lines_offset + (uint64_t)header->line_count * MLIB_LINE_SIZE,
+                  header->reference_count, MLIB_REFERENCE_SIZE) ||
+        (uint64_t)header->strings_offset != (uint64_t)header->references_offset + (uint64_t)header->reference_count * MLIB_REFERENCE_SIZE ||
+        header->strings_size == 0 ||
+        (uint64_t)header->strings_offset + header->strings_size != (uint64_t)library->size ||
+        base[library->size - 1] != '\0')
+    {
+        munmap(library->base, library->size);
+        library->base = NULL;
+        print_error_no_line(ERROR_MLIB_INVALID);
+        return FALSE;
+    }
+
+    library->index = base + header->index_offset;
+    library->macros = base + header->macros_offset;
+    library->lines = base + header->lines_offset;
+    library->references = base + header->references_offset;
+    library->strings = (const char *)base + header->strings_offset;
+    return TRUE;
+}
+
+/* Maps macro libraries for a batch of files. */
+int map_macro_libraries(char *const *paths, int count, MacroLibrary **libraries)
+{
+    int i;
+
+    *libraries = NULL;
+    if (count == 0)
+    {
+        return TRUE;
+    }
+    *libraries = (MacroLibrary *)calloc(count, sizeof(MacroLibrary));
+    if (!*libraries)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (!map_macro_library(paths[i], &(*libraries)[i]))
+        {
+            unmap_macro_libraries(*libraries, i);
+            *libraries = NULL;
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Unmaps libraries mapped by map_macro_libraries. */
+void unmap_macro_libraries(MacroLibrary *libraries, int count)
+{
+    int i;
+
+    for (i = 0; i < count && libraries; i++)
+    {
+        if (libraries[i].base)
+        {
+            munmap(libraries[i].base, libraries[i].size);
+            libraries[i].base = NULL;
+        }
+    }
+    free(libraries);
+}
+
+/* Looks a macro up by name in a list of libraries. */
+int find_library_mcro(const MacroLibrary *libraries, int count, const char *name, const MacroLibrary **library)
+{
+    const MacroLibraryHeader *header;
+    MacroLibraryMacro macro;
+    uint32_t hash, slot, probes, mcro;
+    int i;
+
+    if (count == 0)
+    {
+        return -1;
+    }
+    hash = hash_name(name);
+    for (i = 0; i < count; i++)
+    {
+        header = &libraries[i].header;
+        slot = hash & (header->index_capacity - 1);
+        for (probes = 0; probes < header->index_capacity; probes++)
+        {
+            mcro = get_u32(libraries[i].index + (size_t)slot * 4);
+            if (mcro == MLIB_EMPTY_SLOT || mcro >= header->macro_count)
+            {
+                break;
+            }
+            read_macro(&libraries[i], mcro, &macro);
+            if (macro.hash == hash && macro.name < header->strings_size &&
+                strcmp(libraries[i].strings + macro.name, name) == 0)
+            {
+                *library = &libraries[i];
+                return (int)mcro;
+            }
+            slot = (slot + 1) & (header->index_capacity - 1);
+        }
+    }
+    return -1;
+}
+
+/* Checks that the lines and references of a library macro lie inside its file. */
+int check_library_mcro(const MacroLibrary *library, int mcro)
+{
+    const MacroLibraryHeader *header = &library->header;
+    MacroLibraryMacro macro;
+    MacroLibraryLine line;
+    MacroLibraryReference reference;
+    uint32_t i, j, end;
+    size_t length;
+
+    read_macro(library, (uint32_t)mcro, &macro);
+    if (macro.param_count > MAX_MCRO_PARAMS ||
+        macro.first_line > header->line_count ||
+        macro.line_count > header->line_count - macro.first_line)
+    {
+        return FALSE;
+    }
+    for (i = 0; i < macro.line_count; i++)
+    {
+        read_line(library, macro.first_line + i, &line);
+        if (line.text >= header->strings_size ||
+            (length = strlen(library->strings + line.text)) >= MAX_LINE_LENGTH ||
+            line.reference_count > MAX_PARAM_REFERENCES ||
+            line.first_reference > header->reference_count ||
+            line.reference_count > header->reference_count - line.first_reference)
+        {
+            return FALSE;
+        }
+
+        /* the references of a line are in order and do not overlap */
+        end = 0;
+        for (j = 0; j < line.reference_count; j++)
+        {
+            read_reference(library, line.first_reference + j, &reference);
+            if (reference.start < end || reference.start + reference.length > length ||
+                reference.param >= macro.param_count)
+            {
+                return FALSE;
+            }
+            end = reference.start + reference.length;
+        }
+    }
+    return TRUE;
+}
+
+/* Returns the number of parameters of a library macro. */
+int library_mcro_param_count(const MacroLibrary *library, int mcro)
+{
+    MacroLibraryMacro macro;
+
+    read_macro(library, (uint32_t)mcro, &macro);
+    return (int)macro.param_count;
+}
+
+/* Returns the number of body lines of a library macro. */
+int library_mcro_line_count(const MacroLibrary *library, int mcro)
+{
+    MacroLibraryMacro macro;
+
+    read_macro(library, (uint32_t)mcro, &macro);
+    return (int)macro.line_count;
+}
+
+/* Returns a body line of a library macro, in the mapping. */
+const char *library_mcro_line(const MacroLibrary *library, int mcro, int line)
+{
+    MacroLibraryMacro macro;
+    MacroLibraryLine record;
+
+    read_macro(library, (uint32_t)mcro, &macro);
+    read_line(library, macro.first_line + (uint32_t)line, &record);
+    return library->strings + record.text;
+}
+
+/* Reads the parameter references of a body line of a library macro. */
+int library_line_references(const MacroLibrary *library, int mcro, int line, ParamReference *references)
+{
+    MacroLibraryMacro macro;
+    MacroLibraryLine record;
+    MacroLibraryReference reference;
+    uint32_t i;
+
+    read_macro(library, (uint32_t)mcro, &macro);
+    read_line(library, macro.first_line + (uint32_t)line, &record);
+    for (i = 0; i < record.reference_count; i++)
+    {
+        read_reference(library, record.first_reference + i, &reference);
+        references[i].start = reference.start;
+        references[i].length = reference.length;
+        references[i].param = reference.param;
+    }
+    return (int)record.reference_count;
+}
+
+/* Returns the hash of the contents of a library, for cache keys. */
+uint64_t macro_library_hash(const MacroLibrary *library)
+{
+    return ((uint64_t)library->header.content_hash[1] << 32) | library->header.content_hash[0];
+}
@@ -0,0 +1,109 @@
+/* Source_Files/mcro_template.c */
+#include <stdlib.h>
+#include <string.h>
+#include "../Header_Files/mcro_template.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/preprocessor_utils.h"
+
+/**
+ * @brief Parses and encodes every line of a macro expansion.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int build_template(McroTemplateTable *table, int expansion)
+{
+    int line_count = table->mcro_table->expansions[expansion].line_count;
+    McroTemplate *entry;
+    int i;
+
+    /* room for a template per expansion up to this one */
+    if (expansion >= table->template_count)
+    {
+        int count = table->mcro_table->expansion_count;
+        McroTemplate *grown = (McroTemplate *)realloc(table->templates, count * sizeof(McroTemplate));
+        if (!grown)
+        {
+            return FALSE;
+        }
+        memset(grown + table->template_count, 0, (count - table->template_count) * sizeof(McroTemplate));
+        table->templates = grown;
+        table->template_count = count;
+    }
+    entry = &table->templates[expansion];
+
+    entry->lines = (LineRecord *)calloc(line_count > 0 ? line_count : 1, sizeof(LineRecord));
+    if (!entry->lines)
+    {
+        return FALSE;
+    }
+    for (i = 0; i < line_count; i++)
+    {
+        /* the line as the preprocessor writes it */
+        strncpy(entry->lines[i].text, get_expansion_line(table->mcro_table, expansion, i), MAX_LINE_LENGTH - 2);
+        entry->lines[i].text[MAX_LINE_LENGTH - 2] = '\0';
+        strcat(entry->lines[i].text, "\n");
+        entry->line_count = i + 1;
+        if (!analyze_line_record(&entry->lines[i], &table->sink, table->file, i + 1))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Prepares an empty template table. */
+void init_mcro_templates(McroTemplateTable *table, const McroTable *mcro_table)
+{
+    DiagnosticSink *sink = get_current_sink();
+
+    table->templates = NULL;
+    table->template_count = 0;
+    table->mcro_table = mcro_table;
+    table->file = sink ? sink->file : NULL;
+    table->failed = FALSE;
+    init_diagnostic_sink(&table->sink);
+}
+
+/* Finds the encoded body line an .am line was expanded from. */
+const LineRecord *find_mcro_template_line(McroTemplateTable *table, int line_number, const char *line)
+{
+    McroTemplate *entry;
+    int expansion, mcro_line = 0;
+
+    expansion = get_line_expansion(line_number, &mcro_line);
+    if (expansion < 0 || expansion >= table->mcro_table->expansion_count || table->failed)
+    {
+        return NULL;
+    }
+    if ((expansion >= table->template_count || !table->templates[expansion].lines) && !build_template(table, expansion))
+    {
+        table->failed = TRUE; /* out of memory: every line takes the usual way */
+        return NULL;
+    }
+    entry = &table->templates[expansion];
+    if (mcro_line >= entry->line_count || strcmp(entry->lines[mcro_line].text, line) != 0)
+    {
+        return NULL;
+    }
+    return &entry->lines[mcro_line];
+}
+
+/* Releases the templates. */
+void free_mcro_templates(McroTemplateTable *table)
+{
+    int i, j;
+
+    for (i = 0; i < table->template_count; i++)
+    {
+        for (j = 0; j < table->templates[i].line_count; j++)
+        {
+            free_line_record(&table->templates[i].lines[j]);
+        }
+        free(table->templates[i].lines);
+        table->templates[i].lines = NULL;
+    }
+    free(table->templates);
+    table->templates = NULL;
+    table->template_count = 0;
+    destroy_diagnostic_sink(&table->sink);
+}
@@ -0,0 +1,580 @@
+/* Source_Files/object_cache.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h> /* FICLONE */
+#endif
+#include "../Header_Files/object_cache.h"
+#include "../Header_Files/output_builder.h"
+#include "../Header_Files/output_file.h"
+#include "../Header_Files/diagnostics.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/macro_library.h"
+
+#define COPY_BUFFER_SIZE 16384
+
+/* XXH64 primes */
+#define PRIME64_1 UINT64_C(0x9E3779B185EBCA87)
+#define PRIME64_2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define PRIME64_3 UINT64_C(0x165667B19E3779F9)
+#define PRIME64_4 UINT64_C(0x85EBCA77C2B2AE63)
+#define PRIME64_5 UINT64_C(0x27D4EB2F165667C5)
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/**
+ * @brief Reads 8 bytes as a little-endian value.
+ */
+static uint64_t read_u64(const unsigned char *p)
+{
+    uint64_t value = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Reads 4 bytes as a little-endian value.
+ */
+static uint32_t read_u32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Mixes one 8-byte lane into an accumulator.
+ */
+static uint64_t hash_round(uint64_t accumulator, uint64_t lane)
+{
+    accumulator += lane * PRIME64_2;
+    accumulator = ROTL64(accumulator, 31);
+    return accumulator * PRIME64_1;
+}
+
+/**
+ * @brief Folds one of the four accumulators into the hash.
+ */
+static uint64_t merge_round(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= hash_round(0, accumulator);
+    return hash * PRIME64_1 + PRIME64_4;
+}
+
+/* Computes the 64-bit hash used for cache keys (the XXH64 algorithm). */
+uint64_t hash_bytes(const void *data, size_t length, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + length;
+    uint64_t hash;
+
+    if (length >= 32)
+    {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+
+        /* four independent lanes of 8 bytes per 32-byte stripe */
+        while (end - p >= 32)
+        {
+            v1 = hash_round(v1, read_u64(p));
+            v2 = hash_round(v2, read_u64(p + 8));
+            v3 = hash_round(v3, read_u64(p + 16));
+            v4 = hash_round(v4, read_u64(p + 24));
+            p += 32;
+        }
+        hash = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+        hash = merge_round(hash, v1);
+        hash = merge_round(hash, v2);
+        hash = merge_round(hash, v3);
+        hash = merge_round(hash, v4);
+    }
+    else
+    {
+        hash = seed + PRIME64_5;
+    }
+    hash += (uint64_t)length;
+
+    while (end - p >= 8)
+    {
+        hash ^= hash_round(0, read_u64(p));
+        hash = ROTL64(hash, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (end - p >= 4)
+    {
+        hash ^= (uint64_t)read_u32(p) * PRIME64_1;
+        hash = ROTL64(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end)
+    {
+        hash ^= (uint64_t)*p * PRIME64_5;
+        hash = ROTL64(hash, 11) * PRIME64_1;
+        p++;
+    }
+
+    /* final avalanche */
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * @brief Builds "<cache dir>/<key>/<name>" (or the entry directory if name is NULL).
+ *
+ * @return A malloc'd path, or NULL on allocation failure.
+ */
+static char *entry_path(const char *cache_dir, uint64_t key, const char *name)
+{
+    char *path = (char *)malloc(strlen(cache_dir) + (name ? strlen(name) : 0) + 20);
+
+    if (path)
+    {
+        sprintf(path, "%s/%08lx%08lx", cache_dir,
+                (unsigned long)(key >> 32), (unsigned long)(key & 0xFFFFFFFFUL));
+        if (name)
+        {
+            strcat(path, "/");
+            strcat(path, name);
+        }
+    }
+    return path;
+}
+
+/**
+ * @brief Copies a file, as a reflink when the file system supports it.
+ *
+ * @return TRUE (1) on success, FALSE (0) otherwise.
+ */
+static int copy_file(const char *source, const char *target)
+{
+    char buffer[COPY_BUFFER_SIZE];
+    ssize_t count, written, offset;
+    int in, out, result = TRUE;
+
+    in = open(source, O_RDONLY);
+    if (in < 0)
+    {
+        return FALSE;
+    }
+    out = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out < 0)
+    {
+        close(in);
+        return FALSE;
+    }
+
+#ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0)
+    {
+        close(in);
+        return close(out) == 0;
+    }
+#endif
+
+    while (result && (count = read(in, buffer, sizeof(buffer))) != 0)
+    {
+        if (count < 0)
+        {
+            result = FALSE;
+            break;
+        }
+        for (offset = 0; offset < count; offset += written)
+        {
+            written = write(out, buffer + offset, count - offset);
+            if (written <= 0)
+            {
+                result = FALSE;
+                break;
+            }
+        }
+    }
+
+    close(in);
+    if (close(out) != 0)
+    {
+        result = FALSE;
+    }
+    return result;
+}
+
+/**
+ * @brief Checks whether a file exists.
+ */
+static int file_exists(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+/**
+ * @brief Hashes everything besides the source bytes that changes the outputs.
+ */
+static uint64_t source_key_seed(const AssemblyContext *context)
+{
+    char config[128];
+
+    uint64_t seed, library_hash;
+    int i;
+
+    sprintf(config, "assembler %s binary=%d compress=%d", ASSEMBLER_VERSION,
+            context->options->binary_object, context->options->compressed_object);
+    seed = hash_bytes(config, strlen(config), 0);
+
+    /* the -D symbols select the conditional blocks that are assembled */
+    for (i = 0; i < context->options->includes.define_count; i++)
+    {
+        seed = hash_bytes(context->options->includes.defines[i], strlen(context->options->includes.defines[i]) + 1, seed);
+    }
+
+    /* the macros a source calls may come from the --mlib libraries */
+    for (i = 0; i < context->mcro_table.library_count; i++)
+    {
+        library_hash = macro_library_hash(&context->mcro_table.libraries[i]);
+        seed = hash_bytes(&library_hash, sizeof(library_hash), seed);
+    }
+    return seed;
+}
+
+/* Computes the cache key of the source file of a context. */
+int compute_cache_key(AssemblyContext *context)
+{
+    char path[MAX_FILENAME_LENGTH + 5];
+    struct stat st;
+    void *source = NULL;
+    int fd;
+
+    context->has_cache_key = FALSE;
+    if (context->source.data) /* already read ahead */
+    {
+        if (has_include_directive(context->source.data, context->source.size))
+        {
+            return FALSE; /* the outputs depend on more than the source */
+        }
+        context->cache_key = hash_bytes(context->source.data, context->source.size, source_key_seed(context));
+        context->has_cache_key = TRUE;
+        return TRUE;
+    }
+    if (strlen(context->filename) > MAX_FILENAME_LENGTH - 4)
+    {
+        return FALSE; /* the preprocessor reports it */
+    }
+    sprintf(path, "%s.as", context->filename);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return FALSE;
+    }
+    if (st.st_size > 0)
+    {
+        source = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (source == MAP_FAILED)
+        {
+            close(fd);
+            return FALSE;
+        }
+    }
+    close(fd);
+
+    if (!has_include_directive((const char *)source, (size_t)st.st_size))
+    {
+        context->cache_key = hash_bytes(source, (size_t)st.st_size, source_key_seed(context));
+        context->has_cache_key = TRUE;
+    }
+
+    if (source)
+    {
+        munmap(source, (size_t)st.st_size);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Replays the diagnostics file of a cache entry into the current sink.
+ */
+static void replay_cached_diagnostics(const char *path)
+{
+    char line[DIAGNOSTIC_TEXT_SIZE];
+    Diagnostic diagnostic;
+    int severity, consumed;
+    size_t length;
+    FILE *fp = fopen(path, "r");
+
+    if (!fp)
+    {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "%d %d %d %d %d %d %d %d %d%n", &severity, &diagnostic.code, &diagnostic.line_number,
+                   &diagnostic.source_line, &diagnostic.am_line, &diagnostic.expanded,
+                   &diagnostic.column_start, &diagnostic.column_end, &diagnostic.has_excerpt, &consumed) != 9)
+        {
+            break;
+        }
+        diagnostic.severity = severity == DIAGNOSTIC_WARNING ? DIAGNOSTIC_WARNING : DIAGNOSTIC_ERROR;
+
+        /* the excerpt is the rest of the line after one space */
+        length = 0;
+        if (line[consumed] == ' ')
+        {
+            consumed++;
+            length = strcspn(line + consumed, "\n");
+            if (length > sizeof(diagnostic.excerpt) - 1)
+            {
+                length = sizeof(diagnostic.excerpt) - 1;
+            }
+        }
+        memcpy(diagnostic.excerpt, line + consumed, length);
+        diagnostic.excerpt[length] = '\0';
+        replay_diagnostic(&diagnostic);
+    }
+    fclose(fp);
+}
+
+/* Restores the outputs of a context from the cache. */
+int restore_cached_outputs(AssemblyContext *context)
+{
+    const char *cache_dir = context->options->cache_dir;
+    char target[MAX_FILENAME_LENGTH + 5];
+    int requested[OUTPUT_KIND_COUNT], status[OUTPUT_KIND_COUNT];
+    int kind, has_am, hit = TRUE;
+    char *path;
+    FILE *fp;
+
+    if (!context->has_cache_key)
+    {
+        return FALSE;
+    }
+
+    /* the manifest is written last, so an entry without it does not exist */
+    path = entry_path(cache_dir, context->cache_key, "manifest");
+    fp = path ? fopen(path, "r") : NULL;
+    free(path);
+    if (!fp)
+    {
+        return FALSE;
+    }
+    if (fscanf(fp, "am %d", &has_am) != 1)
+    {
+        hit = FALSE;
+    }
+    for (kind = 0; hit && kind < OUTPUT_KIND_COUNT; kind++)
+    {
+        if (fscanf(fp, " %*s %d %d", &requested[kind], &status[kind]) != 2 ||
+            (requested[kind] && status[kind] != OUTPUT_WRITTEN && status[kind] != OUTPUT_NOT_NEEDED))
+        {
+            hit = FALSE;
+        }
+    }
+    fclose(fp);
+
+    /* copy the files next to the source, as the writers would have */
+    if (hit && has_am)
+    {
+        sprintf(target, "%s.am", context->filename);
+        path = entry_path(cache_dir, context->cache_key, "am");
+        hit = path && copy_file(path, target);
+        free(path);
+        if (hit)
+        {
+            note_output_written(target);
+        }
+    }
+
+    /* the preprocessor writes the -MD rules, and a cached source includes nothing */
+    if (hit && context->options->includes.dependency_file)
+    {
+        hit = write_dependency_file(context->filename, NULL);
+    }
+    for (kind = 0; hit && kind < OUTPUT_KIND_COUNT; kind++)
+    {
+        if (!requested[kind])
+        {
+            continue;
+        }
+        sprintf(target, "%s.%s", context->filename, output_extension((OutputKind)kind));
+        if (status[kind] == OUTPUT_WRITTEN)
+        {
+            path = entry_path(cache_dir, context->cache_key, output_extension((OutputKind)kind));
+            hit = path && copy_file(path, target);
+            free(path);
+            if (hit)
+            {
+                note_output_written(target);
+            }
+        }
+        else
+        {
+            remove(target); /* no stale file from an older run */
+        }
+    }
+    if (!hit)
+    {
+        return FALSE; /* assembling again rewrites anything copied so far */
+    }
+
+    path = entry_path(cache_dir, context->cache_key, "diagnostics");
+    if (path)
+    {
+        replay_cached_diagnostics(path);
+        free(path);
+    }
+
+    for (kind = 0; kind < OUTPUT_KIND_COUNT; kind++)
+    {
+        context->output_requested[kind] = requested[kind];
+        context->output_status[kind] = (OutputStatus)status[kind];
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Removes a partially built entry directory.
+ */
+static void remove_entry_directory(const char *directory)
+{
+    static const char *names[] = {"am", "ob", "ent", "ext", "obb", "obz", "diagnostics", "manifest"};
+    char *path = (char *)malloc(strlen(directory) + 16);
+    size_t i;
+
+    if (path)
+    {
+        for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        {
+            sprintf(path, "%s/%s", directory, names[i]);
+            remove(path);
+        }
+        free(path);
+    }
+    rmdir(directory);
+}
+
+/**
+ * @brief Writes the diagnostics history of a context into a cache file.
+ *
+ * @return TRUE (1) on success, FALSE (0) otherwise.
+ */
+static int write_cached_diagnostics(const DiagnosticSink *sink, const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    int i;
+
+    if (!fp)
+    {
+        return FALSE;
+    }
+    for (i = 0; i < sink->history_count; i++)
+    {
+        const Diagnostic *diagnostic = &sink->history[i];
+        fprintf(fp, "%d %d %d %d %d %d %d %d %d %s\n", (int)diagnostic->severity, diagnostic->code,
+                diagnostic->line_number, diagnostic->source_line, diagnostic->am_line, diagnostic->expanded,
+                diagnostic->column_start, diagnostic->column_end, diagnostic->has_excerpt,
+                diagnostic->has_excerpt ? diagnostic->excerpt : "");
+    }
+    return fclose(fp) == 0;
+}
+
+/* Stores the outputs and diagnostics of a successfully assembled context. */
+void store_cached_outputs(const AssemblyContext *context)
+{
+    const char *cache_dir = context->options->cache_dir;
+    char source[MAX_FILENAME_LENGTH + 5];
+    char *directory, *path, *entry;
+    int kind, has_am, ok = TRUE;
+    FILE *fp;
+
+    if (!context->has_cache_key || !context->diagnostics.keep_history)
+    {
+        return;
+    }
+
+    mkdir(cache_dir, 0777); /* usually exists already */
+
+    directory = (char *)malloc(strlen(cache_dir) + 16);
+    path = (char *)malloc(strlen(cache_dir) + 32);
+    if (!directory || !path)
+    {
+        free(directory);
+        free(path);
+        return;
+    }
+    sprintf(directory, "%s/tmp-XXXXXX", cache_dir);
+    if (!mkdtemp(directory))
+    {
+        free(directory);
+        free(path);
+        return;
+    }
+
+    sprintf(source, "%s.am", context->filename);
+    has_am = file_exists(source);
+    if (has_am)
+    {
+        sprintf(path, "%s/am", directory);
+        ok = copy_file(source, path);
+    }
+    for (kind = 0; ok && kind < OUTPUT_KIND_COUNT; kind++)
+    {
+        if (context->output_requested[kind] && context->output_status[kind] == OUTPUT_WRITTEN)
+        {
+            sprintf(source, "%s.%s", context->filename, output_extension((OutputKind)kind));
+            sprintf(path, "%s/%s", directory, output_extension((OutputKind)kind));
+            ok = copy_file(source, path);
+        }
+    }
+    if (ok)
+    {
+        sprintf(path, "%s/diagnostics", directory);
+        ok = write_cached_diagnostics(&context->diagnostics, path);
+    }
+    if (ok)
+    {
+        sprintf(path, "%s/manifest", directory);
+        fp = fopen(path, "w");
+        ok = fp != NULL;
+        if (fp)
+        {
+            fprintf(fp, "am %d\n", has_am);
+            for (kind = 0; kind < OUTPUT_KIND_COUNT; kind++)
+            {
+                fprintf(fp, "%s %d %d\n", output_extension((OutputKind)kind),
+                        context->output_requested[kind], (int)context->output_status[kind]);
+            }
+            ok = fclose(fp) == 0;
+        }
+    }
+
+    /* publish the entry; if another run stored the same key first, keep theirs */
+    entry = ok ? entry_path(cache_dir, context->cache_key, NULL) : NULL;
+    if (!entry || rename(directory, entry) != 0)
+    {
+        remove_entry_directory(directory);
+    }
+
+    free(entry);
+    free(directory);
+    free(path);
+}
@@ -0,0 +1,536 @@
+/* Source_Files/options.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Header_Files/options.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+#include "../Header_Files/conditional.h"
+
+#define MAX_JOBS 64
+#define MAX_ERROR_LIMIT 100000
+
+/**
+ * @brief Reads the value of an option given either attached ("-j4") or as the next argument ("-j 4").
+ *
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @param i Pointer to the index of the option, advanced past a separate value.
+ * @param name_length Length of the option name.
+ * @return Pointer to the value, or NULL if it is missing.
+ */
+static const char *get_option_value(int argc, char *argv[], int *i, size_t name_length)
+{
+    if (argv[*i][name_length] != '\0')
+    {
+        return argv[*i] + name_length;
+    }
+    if (*i + 1 < argc)
+    {
+        return argv[++(*i)];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parses a positive integer option value within the given range.
+ *
+ * @return TRUE (1) if the value is a valid number in range, FALSE (0) otherwise.
+ */
+static int parse_count(const char *value, int max, int *out)
+{
+    char *endptr;
+    long number;
+
+    if (!value)
+    {
+        return FALSE;
+    }
+    number = strtol(value, &endptr, 10);
+    if (endptr == value || *endptr != '\0' || number < 1 || number > max)
+    {
+        return FALSE;
+    }
+    *out = (int)number;
+    return TRUE;
+}
+
+/**
+ * @brief Appends an input file name, growing the array as needed.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int add_file(AssemblerOptions *options, char *name)
+{
+    char **files;
+
+    if (options->file_count == options->file_capacity)
+    {
+        files = (char **)realloc(options->files, options->file_capacity * 2 * sizeof(char *));
+        if (!files)
+        {
+            return FALSE;
+        }
+        options->files = files;
+        options->file_capacity *= 2;
+    }
+    options->files[options->file_count++] = name;
+    return TRUE;
+}
+
+/**
+ * @brief Appends an include directory (-I), in the order given.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int add_include_dir(AssemblerOptions *options, char *dir, int argc)
+{
+    if (!options->includes.dirs)
+    {
+        /* there are fewer -I options than arguments */
+        options->includes.dirs = (char **)malloc(argc * sizeof(char *));
+        if (!options->includes.dirs)
+        {
+            return FALSE;
+        }
+    }
+    options->includes.dirs[options->includes.dir_count++] = dir;
+    return TRUE;
+}
+
+/**
+ * @brief Appends a symbol definition (-D), in the order given.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int add_define(AssemblerOptions *options, char *definition, int argc)
+{
+    if (!options->includes.defines)
+    {
+        /* there are fewer -D options than arguments */
+        options->includes.defines = (char **)malloc(argc * sizeof(char *));
+        if (!options->includes.defines)
+        {
+            return FALSE;
+        }
+    }
+    options->includes.defines[options->includes.define_count++] = definition;
+    return TRUE;
+}
+
+/**
+ * @brief Appends a macro library (--mlib), in the order given.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int add_mlib(AssemblerOptions *options, char *path, int argc)
+{
+    if (!options->mlibs)
+    {
+        /* there are fewer --mlib options than arguments */
+        options->mlibs = (char **)malloc(argc * sizeof(char *));
+        if (!options->mlibs)
+        {
+            return FALSE;
+        }
+    }
+    options->mlibs[options->mlib_count++] = path;
+    return TRUE;
+}
+
+/**
+ * @brief Reads a whole file ("-" for stdin) into a null terminated buffer.
+ *
+ * @return The malloc'd contents, or NULL if the file could not be read.
+ */
+static char *read_list(const char *path, size_t *size)
+{
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    size_t capacity = 4096, count;
+    char *data, *grown;
+
+    if (!fp)
+    {
+        return NULL;
+    }
+
+    *size = 0;
+    data = (char *)malloc(capacity);
+    while (data && (count = fread(data + *size, 1, capacity - *size - 1, fp)) > 0)
+    {
+        *size += count;
+        if (*size == capacity - 1)
+        {
+            grown = (char *)realloc(data, capacity * 2);
+            if (!grown)
+            {
+                free(data);
+                data = NULL;
+                break;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+    }
+    if (data && ferror(fp))
+    {
+        free(data);
+        data = NULL;
+    }
+    if (fp != stdin)
+    {
+        fclose(fp);
+    }
+    if (data)
+    {
+        data[*size] = '\0';
+    }
+    return data;
+}
+
+/**
+ * @brief Adds the file names of a list file, split at separator.
+ *
+ * Empty names are skipped; with '\n' as separator a trailing '\r' is dropped.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the list could not be read (the error is printed).
+ */
+static int add_file_list(AssemblerOptions *options, const char *path, char separator)
+{
+    char **lists;
+    char *data, *name, *end;
+    size_t size, length;
+
+    data = read_list(path, &size);
+    if (!data)
+    {
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+    lists = (char **)realloc(options->lists, (options->list_count + 1) * sizeof(char *));
+    if (!lists)
+    {
+        free(data);
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+    options->lists = lists;
+    options->lists[options->list_count++] = data; /* the names point into it */
+
+    for (name = data; name < data + size; name = end + 1)
+    {
+        end = memchr(name, separator, (size_t)(data + size - name));
+        if (!end)
+        {
+            end = data + size; /* the terminating null */
+        }
+        *end = '\0';
+        length = (size_t)(end - name);
+        if (separator == '\n' && length > 0 && name[length - 1] == '\r')
+        {
+            name[--length] = '\0';
+        }
+        if (length > 0 && !add_file(options, name))
+        {
+            print_error_no_line(ERROR_MEMORY_ALLOCATION);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Parses the value of --diagnostics-format.
+ *
+ * @return TRUE (1) if the value names a known format, FALSE (0) otherwise.
+ */
+static int parse_diagnostics_format(const char *value, DiagnosticFormat *out)
+{
+    if (strcmp(value, "text") == 0)
+        *out = DIAGNOSTICS_TEXT;
+    else if (strcmp(value, "jsonl") == 0)
+        *out = DIAGNOSTICS_JSONL;
+    else if (strcmp(value, "sarif") == 0)
+        *out = DIAGNOSTICS_SARIF;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+/* Parses the command line into an options structure. */
+int parse_options(int argc, char *argv[], AssemblerOptions *options)
+{
+    int i;
+
+    options->mode = MODE_ASSEMBLE;
+    options->binary_object = FALSE;
+    options->compressed_object = FALSE;
+    options->jobs = 1;
+    options->max_errors = 0;
+    options->fail_fast = FALSE;
+    options->diagnostics_format = DIAGNOSTICS_TEXT;
+    options->cache_dir = NULL;
+    options->write_if_changed = FALSE;
+    options->batch_output = FALSE;
+    options->fsync = FALSE;
+    options->watch = FALSE;
+    options->serve = FALSE;
+    options->client = FALSE;
+    options->socket_path = NULL;
+    options->stats = FALSE;
+    options->includes.dirs = NULL;
+    options->includes.dir_count = 0;
+    options->includes.dependency_file = FALSE;
+    options->includes.defines = NULL;
+    options->includes.define_count = 0;
+    options->mlibs = NULL;
+    options->mlib_count = 0;
+    options->file_count = 0;
+    options->file_capacity = argc > 0 ? argc : 1;
+    options->lists = NULL;
+    options->list_count = 0;
+    options->files = (char **)malloc(options->file_capacity * sizeof(char *));
+    if (!options->files)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+
+    for (i = 1; i < argc; i++)
+    {
+        if (argv[i][0] == '@')
+        {
+            if (!add_file_list(options, argv[i] + 1, '\n'))
+            {
+                free_options(options);
+                return FALSE;
+            }
+        }
+        else if (argv[i][0] != '-')
+        {
+            if (!add_file(options, argv[i])) /* input file name */
+            {
+                print_error_no_line(ERROR_MEMORY_ALLOCATION);
+                free_options(options);
+                return FALSE;
+            }
+        }
+        else if (strncmp(argv[i], "--files0-from=", 14) == 0)
+        {
+            if (!add_file_list(options, argv[i] + 14, '\0'))
+            {
+                free_options(options);
+                return FALSE;
+            }
+        }
+        else if (strncmp(argv[i], "-j", 2) == 0)
+        {
+            if (!parse_count(get_option_value(argc, argv, &i, 2), MAX_JOBS, &options->jobs))
+            {
+                print_error_no_line(ERROR_INVALID_OPTION_VALUE);
+                free_options(options);
+                return FALSE;
+            }
+        }
+        else if (strncmp(argv[i], "-I", 2) == 0)
+        {
+            const char *value = get_option_value(argc, argv, &i, 2);
+            if (!value || *value == '\0')
+            {
+                print_error_no_line(ERROR_INVALID_OPTION_VALUE);
+                free_options(options);
+                return FALSE;
+            }
+            if (!add_include_dir(options, (char *)value, argc))
+            {
+                print_error_no_line(ERROR_MEMORY_ALLOCATION);
+                free_options(options);
+                return FALSE;
+            }
+        }
+        else if (strncmp(argv[i], "-D", 2) == 0)
+        {
+            char name[MAX_SYMBOL_LENGTH + 1];
+            long value;
+            const char *definition = get_option_value(argc, argv, &i, 2);
+            if (!definition || !parse_symbol_definition(definition, name, &value))
+            {
+                print_error_no_line(ERROR_INVALID_OPTION_VALUE);
+                free_options(options);
+                return FALSE;
+            }
+            if (!add_define(options, (char *)definition, argc))
+            {
+                print_error_no_line(ERROR_MEMORY_ALLOCATION);
+                free_options(options);
+                return FALSE;
+            }
+        }
+        else if (strcmp(argv[i], "-MD") == 0)
+        {
+            options->includes.dependency_file = TRUE;
+        }
+        else if (strncmp(argv[i], "--mlib", 6) == 0 && (argv[i][6] == '\0' || argv[i][6] == '='))
+        {
+            const char *value = get_option_value(argc, argv, &i, 6);
+            if (value && *value == '=')
+            {
+                value++; /* --mlib=FILE */
+            }
+            if (!value || *value == '\0')
+            {
+                print_error_no_line(ERROR_INVALID_OPTION_VALUE);
+                free_options(options);
+                return FALSE;
+            }
+            if (!add_mlib(options, (char *)value, argc))
+            {
+                print_error_no_line(ERROR_MEMORY_ALLOCATION);
+                free_options(options);
+                return FALSE;
+            }
+        }
+        else if (strcmp(argv[i], "--compile-mlib") == 0)
+        {
+            options->mode = MODE_COMPILE_MLIB;
+        }
+        else if (strncmp(argv[i], "--max-errors", 12) == 0)
+        {
+            const char *value = get_option_value(argc, argv, &i, 12);
+            if (value && *value == '=')
+            {
+                value++; /* --max-errors=N */
+            }
+            if (!parse_count(value, MAX_ERROR_LIMIT, &options->max_errors))
+            {
+                print_error_no_line(ERROR_INVALID_OPTION_VALUE);
+                free_options(options);
+                return FALSE;
+            }
+        }
+        else if (strcmp(argv[i], "--fail-fast") == 0)
+        {
+            options->fail_fast = TRUE;
+        }
+        else if (strncmp(argv[i], "--diagnostics-format=", 21) == 0)
+        {
+            if (!parse_diagnostics_format(argv[i] + 21, &options->diagnostics_format))
+            {
+                print_error_no_line(ERROR_INVALID_OPTION_VALUE);
+                free_options(options);
+                return FALSE;
+            }
+        }
+        else if (strncmp(argv[i], "--cache-dir", 11) == 0)
+        {
+            const char *value = get_option_value(argc, argv, &i, 11);
+            if (value && *value == '=')
+            {
+                value++; /* --cache-dir=DIR */
+            }
+            if (!value || *value == '\0')
+            {
+                print_error_no_line(ERROR_INVALID_OPTION_VALUE);
+                free_options(options);
+                return FALSE;
+            }
+            options->cache_dir = value;
+        }
+        else if (strcmp(argv[i], "--write-if-changed") == 0)
+        {
+            options->write_if_changed = TRUE;
+        }
+        else if (strcmp(argv[i], "--batch-output") == 0)
+        {
+            options->batch_output = TRUE;
+        }
+        else if (strcmp(argv[i], "--fsync") == 0)
+        {
+            options->fsync = TRUE;
+        }
+        else if (strcmp(argv[i], "--watch") == 0)
+        {
+            options->watch = TRUE;
+        }
+        else if (strncmp(argv[i], "--serve", 7) == 0 || strncmp(argv[i], "--client", 8) == 0)
+        {
+            size_t length = argv[i][2] == 's' ? 7 : 8;
+            if (argv[i][length] == '=' && argv[i][length + 1] != '\0')
+            {
+                options->socket_path = argv[i] + length + 1; /* --serve=PATH, --client=PATH */
+            }
+            else if (argv[i][length] != '\0')
+            {
+                print_error_no_line(argv[i][length] == '=' ? ERROR_INVALID_OPTION_VALUE : ERROR_UNKNOWN_OPTION);
+                free_options(options);
+                return FALSE;
+            }
+            if (length == 7)
+            {
+                options->serve = TRUE;
+            }
+            else
+            {
+                options->client = TRUE;
+            }
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            options->stats = TRUE;
+        }
+        else if (strcmp(argv[i], "--binary") == 0)
+        {
+            options->binary_object = TRUE;
+        }
+        else if (strcmp(argv[i], "--compress") == 0)
+        {
+            options->compressed_object = TRUE;
+        }
+        else if (strcmp(argv[i], "--expand") == 0)
+        {
+            options->mode = MODE_EXPAND_OBZ;
+        }
+        else if (strcmp(argv[i], "--obb-to-text") == 0)
+        {
+            options->mode = MODE_OBB_TO_TEXT;
+        }
+        else if (strcmp(argv[i], "--text-to-obb") == 0)
+        {
+            options->mode = MODE_TEXT_TO_OBB;
+        }
+        else
+        {
+            print_error_no_line(ERROR_UNKNOWN_OPTION);
+            free_options(options);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Releases memory owned by an options structure. */
+void free_options(AssemblerOptions *options)
+{
+    int i;
+
+    for (i = 0; i < options->list_count; i++)
+    {
+        free(options->lists[i]);
+    }
+    free(options->lists);
+    options->lists = NULL;
+    options->list_count = 0;
+    free(options->files);
+    options->files = NULL;
+    options->file_count = 0;
+    free(options->includes.dirs);
+    options->includes.dirs = NULL;
+    options->includes.dir_count = 0;
+    free(options->includes.defines);
+    options->includes.defines = NULL;
+    options->includes.define_count = 0;
+    free(options->mlibs);
+    options->mlibs = NULL;
+    options->mlib_count = 0;
+}
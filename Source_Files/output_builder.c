@@ -10,12 +10,14 @@
 #include "../Header_Files/first_pass_utils.h"
 #include "../Header_Files/label_utils.h"
 #include "../Header_Files/command_utils.h"
+#include "../Header_Files/binary_object.h"
+#include "../Header_Files/output_file.h"
 
 /* Writes the assembled machine code into a .ob file. */
-void generate_object_file(VirtualPC *vpc, const char *filename)
+OutputStatus generate_object_file(VirtualPC *vpc, const char *filename)
 {
     char ob_filename[MAX_FILENAME_LENGTH + 4]; /* +4 for ".ob\0" */
-    FILE *ob_file;
+    OutputFile ob_file;
     uint32_t start_addr = 100;
     uint32_t end_addr = vpc->IC + vpc->DC;
     int i;
@@ -24,25 +26,162 @@ void generate_object_file(VirtualPC *vpc, const char *filename)
     sprintf(ob_filename, "%s.ob", filename);
 
     /* open the .ob file for writing */
-    ob_file = fopen(ob_filename, "w");
-    if (!ob_file)
+    if (!open_output_file(&ob_file, ob_filename))
     {
         print_error_no_line(ERROR_OBJECT_FILE_CREATE);
-        return;
+        return OUTPUT_FAILED;
     }
 
     /* write IC - 100 and DC in the first line */
-    fprintf(ob_file, "%7d %d\n", vpc->IC - 100, vpc->DC);
+    fprintf(ob_file.fp, "%7d %d\n", vpc->IC - 100, vpc->DC);
 
     /* write the memory content */
     for (i = start_addr; i < end_addr; i++)
     {
-        fprintf(ob_file, "%07d %06x\n", i, vpc->storage[i].value & 0xFFFFFF);
+        fprintf(ob_file.fp, "%07d %06x\n", i, vpc->storage[i].value & 0xFFFFFF);
         /* ensure 24-bit representation */
     }
 
-    fclose(ob_file);
-    printf("Object file '%s' generated successfully.\n", ob_filename);
+    if (!close_output_file(&ob_file))
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+        return OUTPUT_FAILED;
+    }
+    return OUTPUT_WRITTEN;
+}
+
+/* Writes the machine code into a .obz file, folding runs of equal words into one record. */
+OutputStatus generate_compressed_object_file(VirtualPC *vpc, const char *filename)
+{
+    char obz_filename[MAX_FILENAME_LENGTH + 5]; /* +5 for ".obz\0" */
+    OutputFile obz_file;
+    uint32_t end_addr = vpc->IC + vpc->DC;
+    uint32_t i, run_end;
+    int32_t value;
+
+    sprintf(obz_filename, "%s.obz", filename);
+
+    if (!open_output_file(&obz_file, obz_filename))
+    {
+        print_error_no_line(ERROR_OBJECT_FILE_CREATE);
+        return OUTPUT_FAILED;
+    }
+
+    /* same first line as the .ob file */
+    fprintf(obz_file.fp, "%7d %d\n", vpc->IC - 100, vpc->DC);
+
+    for (i = 100; i < end_addr; i = run_end)
+    {
+        value = vpc->storage[i].value & 0xFFFFFF;
+
+        /* find the end of the run of words equal to this one */
+        run_end = i + 1;
+        while (run_end < end_addr && (vpc->storage[run_end].value & 0xFFFFFF) == value)
+        {
+            run_end++;
+        }
+
+        if (run_end - i == 1)
+        {
+            fprintf(obz_file.fp, "%07d %06x\n", (int)i, (unsigned int)value); /* single word, as in the .ob file */
+        }
+        else
+        {
+            fprintf(obz_file.fp, "%07d %06x *%d\n", (int)i, (unsigned int)value, (int)(run_end - i)); /* start, value, length */
+        }
+    }
+
+    if (!close_output_file(&obz_file))
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+        return OUTPUT_FAILED;
+    }
+    return OUTPUT_WRITTEN;
+}
+
+/* Expands a .obz file back into the equivalent .ob file. */
+int expand_compressed_object_file(const char *filename)
+{
+    char path[MAX_FILENAME_LENGTH + 5];
+    char ob_path[MAX_FILENAME_LENGTH + 4];
+    char temp_path[MAX_FILENAME_LENGTH + 8];
+    char line[MAX_LINE_LENGTH];
+    FILE *obz_file, *ob_file;
+    int code_words, data_words, address, count, fields, next_address = 100, end_address;
+    unsigned int value;
+    int is_valid = TRUE;
+
+    sprintf(path, "%s.obz", filename);
+    obz_file = fopen(path, "r");
+    if (!obz_file)
+    {
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+
+    if (!fgets(line, sizeof(line), obz_file) || sscanf(line, "%d %d", &code_words, &data_words) != 2 ||
+        code_words < 0 || data_words < 0 || code_words + data_words > STORAGE_SIZE)
+    {
+        fclose(obz_file);
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+    end_address = 100 + code_words + data_words;
+
+    /* the .ob file is written aside and only replaces an existing one once the whole .obz decoded */
+    sprintf(ob_path, "%s.ob", filename);
+    sprintf(temp_path, "%s.ob.tmp", filename);
+    ob_file = fopen(temp_path, "w");
+    if (!ob_file)
+    {
+        fclose(obz_file);
+        print_error_no_line(ERROR_OBJECT_FILE_CREATE);
+        return FALSE;
+    }
+    fprintf(ob_file, "%7d %d\n", code_words, data_words);
+
+    while (is_valid && fgets(line, sizeof(line), obz_file))
+    {
+        count = 1;
+        fields = sscanf(line, "%d %x *%d", &address, &value, &count);
+
+        /* records must cover consecutive addresses, within the sizes of the header */
+        if (fields < 2 || count < 1 || address != next_address || count > end_address - next_address)
+        {
+            is_valid = FALSE;
+            break;
+        }
+        for (; count > 0; count--)
+        {
+            fprintf(ob_file, "%07d %06x\n", next_address++, value & 0xFFFFFF);
+        }
+    }
+
+    if (next_address != end_address)
+    {
+        is_valid = FALSE;
+    }
+
+    fclose(obz_file);
+    if (fclose(ob_file) != 0 && is_valid)
+    {
+        remove(temp_path);
+        print_error_no_line(ERROR_OBJECT_FILE_CREATE);
+        return FALSE;
+    }
+    if (!is_valid)
+    {
+        remove(temp_path);
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+    if (rename(temp_path, ob_path) != 0)
+    {
+        remove(temp_path);
+        print_error_no_line(ERROR_OBJECT_FILE_CREATE);
+        return FALSE;
+    }
+    return TRUE;
 }
 
 /**
@@ -54,10 +193,10 @@ int compare_labels_by_address(const void *a, const void *b)
 }
 
 /* Writes the entry labels into a .ent file. */
-void generate_entry_file(LabelTable *label_table, const char *filename)
+OutputStatus generate_entry_file(LabelTable *label_table, const char *filename)
 {
     char ent_filename[MAX_FILENAME_LENGTH + 4]; /* +4 for ".ent\0" */
-    FILE *ent_file;
+    OutputFile ent_file;
     int i;
     Label sorted_labels[100];
     int entry_count = 0;
@@ -78,19 +217,17 @@ void generate_entry_file(LabelTable *label_table, const char *filename)
     /* if no entry labels, do not create the file */
     if (entry_count == 0)
     {
-        printf("No entry labels found. Entry file not created.\n");
-        return;
+        return OUTPUT_NOT_NEEDED;
     }
 
     /* construct the .ent filename */
     sprintf(ent_filename, "%s.ent", filename);
 
     /* open the .ent file for writing */
-    ent_file = fopen(ent_filename, "w");
-    if (!ent_file)
+    if (!open_output_file(&ent_file, ent_filename))
     {
         print_error_no_line(ERROR_ENTRY_FILE_CREATE);
-        return;
+        return OUTPUT_FAILED;
     }
 
     /* write the labels marked as "entry" */
@@ -98,19 +235,23 @@ void generate_entry_file(LabelTable *label_table, const char *filename)
     {
         if (strstr(sorted_labels[i].type, "entry") != NULL)
         {
-            fprintf(ent_file, "%s %07u\n", sorted_labels[i].name, sorted_labels[i].address);
+            fprintf(ent_file.fp, "%s %07u\n", sorted_labels[i].name, sorted_labels[i].address);
         }
     }
 
-    fclose(ent_file);
-    printf("Entry file '%s' generated successfully.\n", ent_filename);
+    if (!close_output_file(&ent_file))
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+        return OUTPUT_FAILED;
+    }
+    return OUTPUT_WRITTEN;
 }
 
 /* Writes the external labels into a .ext file. */
-void generate_externals_file(VirtualPC *vpc, LabelTable *label_table, const char *filename)
+OutputStatus generate_externals_file(VirtualPC *vpc, LabelTable *label_table, const char *filename)
 {
     char ext_filename[MAX_FILENAME_LENGTH + 5]; /* +4 for ".ext\0" */
-    FILE *ext_file;
+    OutputFile ext_file;
     uint32_t start_addr = 100;
     uint32_t end_addr = vpc->IC + vpc->DC;
     int i;
@@ -119,14 +260,6 @@ void generate_externals_file(VirtualPC *vpc, LabelTable *label_table, const char
     /* construct the .ext filename */
     sprintf(ext_filename, "%s.ext", filename);
 
-    /* open the .ext file for writing */
-    ext_file = fopen(ext_filename, "w");
-    if (!ext_file)
-    {
-        print_error_no_line(ERROR_EXTERNAL_FILE_CREATE);
-        return;
-    }
-
     /* scan through VirtualPC storage */
     for (i = start_addr; i < end_addr; i++)
     {
@@ -136,166 +269,271 @@ void generate_externals_file(VirtualPC *vpc, LabelTable *label_table, const char
         Label *label_ptr = get_label_by_name(label_table, encoded_str);
         if (label_ptr != NULL && label_ptr->address == 0)
         {
+                /* the file is only created once there is something to write */
+                if (extern_count == 0 && !open_output_file(&ext_file, ext_filename))
+                {
+                    print_error_no_line(ERROR_EXTERNAL_FILE_CREATE);
+                    return OUTPUT_FAILED;
+                }
+
                 /* write to file: label name and address in 7-digit format */
-                fprintf(ext_file, "%s %07u\n", encoded_str, i);
+                fprintf(ext_file.fp, "%s %07u\n", encoded_str, i);
                 extern_count++;
         }
     }
 
-    /* if no extern labels, do not create the file */
+    /* if no extern labels, do not create the file (and drop one left by an earlier run) */
     if (extern_count == 0)
     {
-        fclose(ext_file);
         remove(ext_filename);
-        printf("No extern labels found. Externals file not created.\n");
-        return;
+        return OUTPUT_NOT_NEEDED;
     }
 
-    fclose(ext_file);
-    printf("Externals file '%s' generated successfully.\n", ext_filename);
+    if (!close_output_file(&ext_file))
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+        return OUTPUT_FAILED;
+    }
+    return OUTPUT_WRITTEN;
 }
 
-/* Fills address words for label operands in the virtual pc. */
-void fill_addresses_words(FILE *am_file, LabelTable *label_table, VirtualPC *vpc)
+/* Writes one kind of output file from the assembled image. */
+OutputStatus generate_output(OutputKind kind, VirtualPC *vpc, LabelTable *label_table, const char *filename)
 {
-    /* variable Declarations */
-    char line[MAX_LINE_LENGTH];
-    char params[2][MAX_LINE_LENGTH], command_name[10];
-    char *ptr, *ptr_scan, *colon_pos;
+    switch (kind)
+    {
+    case OUTPUT_OBJECT:
+        return generate_object_file(vpc, filename);
+    case OUTPUT_ENTRY:
+        return generate_entry_file(label_table, filename);
+    case OUTPUT_EXTERNALS:
+        return generate_externals_file(vpc, label_table, filename);
+    case OUTPUT_BINARY:
+        return generate_binary_object_file(vpc, label_table, filename);
+    case OUTPUT_COMPRESSED:
+        return generate_compressed_object_file(vpc, filename);
+    default:
+        return OUTPUT_FAILED;
+    }
+}
+
+/* Prints the result of writing one kind of output file. */
+void report_output(OutputKind kind, OutputStatus status, const char *filename)
+{
+    if (status == OUTPUT_FAILED)
+    {
+        return; /* the writer already printed the error */
+    }
+
+    switch (kind)
+    {
+    case OUTPUT_OBJECT:
+        printf("Object file '%s.ob' generated successfully.\n", filename);
+        break;
+    case OUTPUT_ENTRY:
+        if (status == OUTPUT_NOT_NEEDED)
+            printf("No entry labels found. Entry file not created.\n");
+        else
+            printf("Entry file '%s.ent' generated successfully.\n", filename);
+        break;
+    case OUTPUT_EXTERNALS:
+        if (status == OUTPUT_NOT_NEEDED)
+            printf("No extern labels found. Externals file not created.\n");
+        else
+            printf("Externals file '%s.ext' generated successfully.\n", filename);
+        break;
+    case OUTPUT_BINARY:
+        printf("Binary object file '%s.obb' generated successfully.\n", filename);
+        break;
+    case OUTPUT_COMPRESSED:
+        printf("Compressed object file '%s.obz' generated successfully.\n", filename);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Returns the file extension of one kind of output file, without the dot. */
+const char *output_extension(OutputKind kind)
+{
+    static const char *extensions[OUTPUT_KIND_COUNT] = {"ob", "ent", "ext", "obb", "obz"};
+
+    return (unsigned int)kind < OUTPUT_KIND_COUNT ? extensions[kind] : "";
+}
+
+/* Finds the operands of a command line, as the address words are laid out. */
+int split_command_operands(char *line, char params[2][MAX_LINE_LENGTH])
+{
+    char command_name[MAX_LINE_LENGTH];
+    char *ptr, *ptr_scan, *colon_pos = NULL;
     int param_count = 0;
-    int address = 100; /* initial address */
     int i;
     int inside_string = FALSE;
-    int label_address = 0, value = 0;
 
-    rewind(am_file); /* ensure reading from the beginning */
+    memset(params, 0, 2 * MAX_LINE_LENGTH);
 
-    while (fgets(line, MAX_LINE_LENGTH, am_file))
+    ptr = advance_to_next_token(line); /* skip leading spaces */
+    ptr_scan = ptr;
+
+    /* scan through the line to find a colon that is not inside a string */
+    while (*ptr_scan)
     {
-        memset(params, 0, sizeof(params));
-        param_count = 0;
-        colon_pos = NULL;
-        inside_string = FALSE;
-        
-        ptr = advance_to_next_token(line); /* skip leading spaces */
-        ptr_scan = ptr;
+        if (*ptr_scan == '"')
+        {
+            inside_string = !inside_string; /* toggle string state */
+        }
+        else if (*ptr_scan == ':' && !inside_string)
+        {
+            colon_pos = ptr_scan; /* valid colon found */
+            break;
+        }
+        ptr_scan++;
+    }
 
-        /* scan through the line to find a colon that is not inside a string */
-        while (*ptr_scan)
+    /* if a valid colon was found, move past it */
+    if (colon_pos)
+    {
+        ptr = advance_to_next_token(colon_pos + 1);
+    }
+
+    /* .data or .string directives give no command words */
+    if (strncmp(ptr, ".data", 5) == 0 || strncmp(ptr, ".string", 5) == 0 ||
+        strncmp(ptr, ".entry", 5) == 0 || strncmp(ptr, ".extern", 5) == 0)
+    {
+        return -1;
+    }
+
+    command_name[0] = '\0';
+    sscanf(ptr, "%s", command_name);
+    if (!is_valid_command_name(command_name))
+    {
+        return -1;
+    }
+    ptr = advance_past_token(ptr);
+    ptr = advance_to_next_token(ptr);
+
+    /* check if there is at least 1 operand*/
+    if (*ptr != '\n' && *ptr != '\0' && *ptr != '\r')
+    {
+        i = 0;
+
+        /* save the first operand*/
+        while (*ptr && !isspace((unsigned char)*ptr) && *ptr != ',')
         {
-            if (*ptr_scan == '"')
-            {
-                inside_string = !inside_string; /* toggle string state */
-            }
-            else if (*ptr_scan == ':' && !inside_string)
+            params[param_count][i++] = *ptr++;
+        }
+        params[param_count][i] = '\0';
+        i = 0;
+        param_count++;
+
+        /* if there is another operand*/
+        if (*ptr != '\n' && *ptr != '\0' && *ptr != '\r')
+        {
+            ptr++;
+            ptr = advance_to_next_token(ptr);
+            while (*ptr && !isspace((unsigned char)*ptr) && *ptr != ',')
             {
-                colon_pos = ptr_scan; /* valid colon found */
-                break;
+                params[param_count][i++] = *ptr++;
             }
-            ptr_scan++;
+            params[param_count][i] = '\0';
+            param_count++;
         }
+    }
+    return param_count;
+}
 
-        /* if a valid colon was found, move past it */
-        if (colon_pos)
+/* Resolves the word of one operand against the label table. */
+void resolve_operand_word(Word *word, const char *param, int address, LabelTable *label_table)
+{
+    int32_t word_value = word->value;
+    int label_address = 0, value = 0;
+
+    if (param[0] == '&')
+    {
+        Label *label_ptr = get_label_by_name(label_table, param + 1);
+        if (label_ptr != NULL)
         {
-            ptr = advance_to_next_token(colon_pos + 1);
+            label_address = label_ptr->address;
+            value = label_address - (address - 1); /* calculate relative address (-1 to reach command address) */
+
+            word_value &= ~(0x1FFFFF << 3);        /* clear bits 3-23 */
+            word_value |= (value & 0x1FFFFF) << 3; /* set bits 3-23 with the value*/
+            word->value = word_value;
         }
+    }
+
+    else if (label_exists(param, label_table))
+    {
+        Label *label_ptr = get_label_by_name(label_table, param);
+        if (label_ptr != NULL)
+        {
+            label_address = label_ptr->address;
+
+            word->value = 0;                        /* clear the value */
+            word->value |= (label_address & 0x1FFFFF) << 3; /* set bits 3-23 with the value*/
+            word->value &= ~(1 << 2);               /* set bit 2 to 0 */
+
+            /* set the E/R bits based on the label type */
+            if (strcmp(label_ptr->type, "external") == 0)
+            {
+                word->value |= (1 << 0);  /* set bit 0 to 1 */
+                word->value &= ~(1 << 1); /* set bit 1 to 0 */
+            }
+            else
+            {
+                word->value &= ~(1 << 0); /* set bit 0 to 0 */
+                word->value |= (1 << 1);  /* set bit 1 to 1 */
+            }
+        }
+    }
+}
+
+/* Fills address words for label operands in the virtual pc. */
+void fill_addresses_words(FILE *am_file, LabelTable *label_table, VirtualPC *vpc)
+{
+    /* variable Declarations */
+    char line[MAX_LINE_LENGTH];
+    char params[2][MAX_LINE_LENGTH];
+    int param_count = 0;
+    int address = 100; /* initial address */
+    int i;
+    long repeat = 0; /* iterations of the .rept block being read still to come */
+    long body = 0;   /* where its body starts in the file */
+
+    rewind(am_file); /* ensure reading from the beginning */
 
-        /* process .data or .string directives */
-        if (strncmp(ptr, ".data", 5) == 0 || strncmp(ptr, ".string", 5) == 0 ||
-            strncmp(ptr, ".entry", 5) == 0 || strncmp(ptr, ".extern", 5) == 0)
+    while (fgets(line, MAX_LINE_LENGTH, am_file))
+    {
+        /* the body of a .rept block is read again for every iteration, at the next addresses */
+        if (strncmp(line, ".rept ", 6) == 0)
         {
+            repeat = atol(line + 6) - 1;
+            body = ftell(am_file);
             continue;
         }
-        else
+        if (strncmp(line, ".endr", 5) == 0 && (line[5] == '\n' || line[5] == '\0'))
         {
-            sscanf(ptr, "%s", command_name);
-            if (is_valid_command_name(command_name))
+            if (repeat > 0 && body >= 0 && fseek(am_file, body, SEEK_SET) == 0)
             {
-                address += 1; /* count the word of the command name */
-                ptr = advance_past_token(ptr);
-                ptr = advance_to_next_token(ptr);
-
-                /* check if there is at least 1 operand*/
-                if (*ptr != '\n' && *ptr != '\0' && *ptr != '\r')
-                {
-                    i = 0;
-
-                    /* save the first operand*/
-                    while (*ptr && !isspace((unsigned char)*ptr) && *ptr != ',')
-                    {
-                        params[param_count][i++] = *ptr++;
-                    }
-                    params[param_count][i] = '\0';
-                    i = 0;
-                    param_count++;
-
-                    /* if there is another operand*/
-                    if (*ptr != '\n' && *ptr != '\0' && *ptr != '\r')
-                    {
-                        ptr++;
-                        ptr = advance_to_next_token(ptr);
-                        while (*ptr && !isspace((unsigned char)*ptr) && *ptr != ',')
-                        {
-                            params[param_count][i++] = *ptr++;
-                        }
-                        params[param_count][i] = '\0';
-                        param_count++;
-                    }
-                }
-
-                for (i = 0; i < param_count; i++)
-                {
-                    int32_t word_value = vpc->storage[address].value;
-                    label_address = 0;
-                    value = 0;
-                    
-                    if (params[i][0] == '&')
-                    {
-                        Label *label_ptr = get_label_by_name(label_table, params[i] + 1);
-                        if (label_ptr != NULL)
-                        {
-                            label_address = label_ptr->address;
-                            value = label_address - (address - 1); /* calculate relative address (-1 to reach command address) */
-
-                            word_value &= ~(0x1FFFFF << 3);        /* clear bits 3-23 */
-                            word_value |= (value & 0x1FFFFF) << 3; /* set bits 3-23 with the value*/
-                            vpc->storage[address].value = word_value;
-                        }
-                    }
-
-                    else if (label_exists(params[i], label_table))
-                    {
-                        Label *label_ptr = get_label_by_name(label_table, params[i]);
-                        if (label_ptr != NULL)
-                        {
-                            label_address = label_ptr->address;
-
-                            vpc->storage[address].value = 0;                        /* clear the value */
-                            vpc->storage[address].value |= (label_address & 0x1FFFFF) << 3; /* set bits 3-23 with the value*/
-                            vpc->storage[address].value &= ~(1 << 2);               /* set bit 2 to 0 */
-
-                            /* set the E/R bits based on the label type */
-                            if (strcmp(label_ptr->type, "external") == 0)
-                            {
-                                vpc->storage[address].value |= (1 << 0);  /* set bit 0 to 1 */
-                                vpc->storage[address].value &= ~(1 << 1); /* set bit 1 to 0 */
-                            }
-                            else
-                            {
-                                vpc->storage[address].value &= ~(1 << 0); /* set bit 0 to 0 */
-                                vpc->storage[address].value |= (1 << 1);  /* set bit 1 to 1 */
-                            }
-                        }
-                    }
-                    if (!validate_register_operand(params[i])) /* non register operands give a word */
-                    {
-                        address++; 
-                    }
-                }
+                repeat--;
+            }
+            continue;
+        }
 
+        param_count = split_command_operands(line, params);
+        if (param_count < 0)
+        {
+            continue;
+        }
 
+        address += 1; /* count the word of the command name */
+        for (i = 0; i < param_count; i++)
+        {
+            resolve_operand_word(&vpc->storage[address], params[i], address, label_table);
+            if (!validate_register_operand(params[i])) /* non register operands give a word */
+            {
+                address++; 
             }
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,380 @@
+/* Source_Files/output_file.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../Header_Files/output_file.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+/* set once by main, before any writer runs */
+static int write_if_changed = FALSE;
+static int batch_outputs = FALSE;
+static int sync_outputs = FALSE;
+static mode_t creation_mask = 022;
+
+/* the batch of the calling thread */
+static pthread_key_t current_batch_key;
+static pthread_once_t current_batch_once = PTHREAD_ONCE_INIT;
+
+/* every file written, for the barrier of sync_output_files */
+static char **written_paths = NULL;
+static int written_count = 0;
+static int written_capacity = 0;
+static pthread_mutex_t written_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Creates the thread-local key of the current batch, once.
+ */
+static void create_current_batch_key(void)
+{
+    pthread_key_create(&current_batch_key, NULL);
+}
+
+/**
+ * @brief Returns the batch of the calling thread, or NULL.
+ */
+static OutputBatch *get_current_output_batch(void)
+{
+    if (!batch_outputs)
+    {
+        return NULL;
+    }
+    pthread_once(&current_batch_once, create_current_batch_key);
+    return (OutputBatch *)pthread_getspecific(current_batch_key);
+}
+
+/* Selects whether output files are only replaced when their contents change. */
+void set_write_if_changed(int enabled)
+{
+    write_if_changed = enabled;
+
+    /* the temporary files are created private, new outputs get the usual mode */
+    creation_mask = umask(0);
+    umask(creation_mask);
+}
+
+/* Selects whether the output writers of a context hand their files to one batch. */
+void set_batched_output(int enabled)
+{
+    batch_outputs = enabled;
+}
+
+/* Selects whether the files written are remembered for sync_output_files. */
+void set_sync_outputs(int enabled)
+{
+    sync_outputs = enabled;
+}
+
+/* Records that an output file was written outside of OutputFile (such as a cache copy). */
+void note_output_written(const char *path)
+{
+    char **paths;
+    char *copy;
+
+    if (!sync_outputs)
+    {
+        return;
+    }
+
+    copy = strdup(path);
+    pthread_mutex_lock(&written_lock);
+    if (copy && written_count == written_capacity)
+    {
+        paths = (char **)realloc(written_paths, (written_capacity ? written_capacity * 2 : 64) * sizeof(char *));
+        if (paths)
+        {
+            written_paths = paths;
+            written_capacity = written_capacity ? written_capacity * 2 : 64;
+        }
+    }
+    if (copy && written_count < written_capacity)
+    {
+        written_paths[written_count++] = copy;
+        copy = NULL;
+    }
+    pthread_mutex_unlock(&written_lock);
+
+    if (copy)
+    {
+        free(copy);
+        print_error_no_line(ERROR_MEMORY_ALLOCATION); /* the file will not be synced */
+    }
+}
+
+/* Flushes every output file written so far to stable storage, as one barrier. */
+int sync_output_files(void)
+{
+    int i, ok;
+
+    pthread_mutex_lock(&written_lock);
+    ok = sync_files((const char *const *)written_paths, written_count);
+    for (i = 0; i < written_count; i++)
+    {
+        free(written_paths[i]);
+    }
+    free(written_paths);
+    written_paths = NULL;
+    written_count = written_capacity = 0;
+    pthread_mutex_unlock(&written_lock);
+
+    if (!ok)
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+    }
+    return ok;
+}
+
+/* Initializes a batch once, before its first use. */
+void init_output_batch(OutputBatch *batch)
+{
+    batch->count = 0;
+    pthread_mutex_init(&batch->lock, NULL);
+}
+
+/* Empties a batch for the outputs of a new file. */
+void clear_output_batch(OutputBatch *batch)
+{
+    batch->count = 0;
+}
+
+/* Releases the resources of a batch. */
+void destroy_output_batch(OutputBatch *batch)
+{
+    pthread_mutex_destroy(&batch->lock);
+}
+
+/* Makes a batch the destination of the output files closed by the calling thread. */
+void set_current_output_batch(OutputBatch *batch)
+{
+    pthread_once(&current_batch_once, create_current_batch_key);
+    pthread_setspecific(current_batch_key, batch);
+}
+
+/**
+ * @brief Adds a rendered file to a batch, which takes over its buffer.
+ *
+ * A full batch writes the file right away.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the file had to be written and failed.
+ */
+static int add_to_batch(OutputBatch *batch, const char *path, char *data, size_t size)
+{
+    BatchedWrite single;
+
+    pthread_mutex_lock(&batch->lock);
+    if (batch->count < OUTPUT_BATCH_CAPACITY)
+    {
+        BatchedWrite *file = &batch->files[batch->count];
+        strcpy(batch->paths[batch->count], path);
+        file->path = batch->paths[batch->count];
+        file->data = data;
+        file->size = size;
+        file->written = FALSE;
+        batch->count++;
+        pthread_mutex_unlock(&batch->lock);
+        return TRUE;
+    }
+    pthread_mutex_unlock(&batch->lock);
+
+    single.path = path;
+    single.data = data;
+    single.size = size;
+    write_files(&single, 1);
+    free(data);
+    if (single.written)
+    {
+        note_output_written(path);
+    }
+    return single.written;
+}
+
+/* Writes every file of a batch and frees their renderings. */
+int flush_output_batch(OutputBatch *batch)
+{
+    int i, ok;
+
+    pthread_mutex_lock(&batch->lock);
+    ok = write_files(batch->files, batch->count);
+    for (i = 0; i < batch->count; i++)
+    {
+        if (batch->files[i].written)
+        {
+            note_output_written(batch->files[i].path);
+        }
+        else
+        {
+            print_error_no_line(ERROR_FILE_WRITE);
+        }
+        free((char *)batch->files[i].data);
+        batch->files[i].data = NULL;
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return ok;
+}
+
+/* Checks whether the last flush of a batch failed to write the given file. */
+int output_batch_failed(const OutputBatch *batch, const char *path)
+{
+    int i;
+
+    for (i = 0; i < batch->count; i++)
+    {
+        if (strcmp(batch->files[i].path, path) == 0)
+        {
+            return !batch->files[i].written;
+        }
+    }
+    return FALSE; /* written when it was closed */
+}
+
+/* Starts writing an output file. */
+int open_output_file(OutputFile *file, const char *path)
+{
+    strncpy(file->path, path, sizeof(file->path) - 1);
+    file->path[sizeof(file->path) - 1] = '\0';
+    file->buffer = NULL;
+    file->size = 0;
+    file->in_memory = write_if_changed || get_current_output_batch() != NULL;
+
+    if (file->in_memory)
+    {
+        file->fp = open_memstream(&file->buffer, &file->size);
+    }
+    else
+    {
+        file->fp = fopen(file->path, "w");
+    }
+    return file->fp != NULL;
+}
+
+/**
+ * @brief Checks whether a file already holds exactly the given bytes.
+ *
+ * The sizes are compared first, so a changed file usually costs one fstat.
+ */
+static int same_contents(const char *path, const char *data, size_t size)
+{
+    struct stat st;
+    void *old;
+    int fd, same;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size != size)
+    {
+        close(fd);
+        return FALSE;
+    }
+    if (size == 0)
+    {
+        close(fd);
+        return TRUE;
+    }
+
+    old = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (old == MAP_FAILED)
+    {
+        return FALSE;
+    }
+    same = memcmp(old, data, size) == 0;
+    munmap(old, size);
+    return same;
+}
+
+/**
+ * @brief Replaces a file with the given bytes through a temporary file and rename.
+ *
+ * @return TRUE (1) on success, FALSE (0) otherwise (the old file is left as it was).
+ */
+static int replace_file(const char *path, const char *data, size_t size)
+{
+    char temp_path[MAX_FILENAME_LENGTH + 16];
+    struct stat st;
+    mode_t mode = 0666 & ~creation_mask;
+    ssize_t written;
+    size_t offset;
+    int fd, ok = TRUE;
+
+    if (stat(path, &st) == 0)
+    {
+        mode = st.st_mode & 07777; /* a replaced file keeps its permissions */
+    }
+
+    sprintf(temp_path, "%s.XXXXXX", path);
+    fd = mkstemp(temp_path);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+
+    for (offset = 0; ok && offset < size; offset += (size_t)written)
+    {
+        written = write(fd, data + offset, size - offset);
+        if (written <= 0)
+        {
+            ok = FALSE;
+        }
+    }
+    if (fchmod(fd, mode) != 0)
+    {
+        ok = FALSE;
+    }
+    if (close(fd) != 0)
+    {
+        ok = FALSE;
+    }
+
+    if (!ok || rename(temp_path, path) != 0)
+    {
+        remove(temp_path);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Finishes an output file, writing it out if needed. */
+int close_output_file(OutputFile *file)
+{
+    int ok = !ferror(file->fp);
+
+    if (fclose(file->fp) != 0)
+    {
+        ok = FALSE;
+    }
+    file->fp = NULL;
+
+    /* buffer and size are only final once the memory stream is closed */
+    if (ok && file->in_memory)
+    {
+        if (write_if_changed)
+        {
+            if (!same_contents(file->path, file->buffer, file->size))
+            {
+                ok = replace_file(file->path, file->buffer, file->size);
+            }
+        }
+        else
+        {
+            ok = add_to_batch(get_current_output_batch(), file->path, file->buffer, file->size);
+            file->buffer = NULL; /* the batch owns it now and notes the file once written */
+            return ok;
+        }
+    }
+    if (ok)
+    {
+        note_output_written(file->path);
+    }
+    free(file->buffer);
+    file->buffer = NULL;
+    return ok;
+}
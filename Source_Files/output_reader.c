@@ -0,0 +1,371 @@
+/* Source_Files/output_reader.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../Header_Files/output_reader.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+/*
+ * The fixed-width fields of the writers ("%07d", "%06x") are decoded eight
+ * bytes at a time: the bytes are loaded into one 64-bit value, checked with
+ * per-byte masks, and folded pairwise (2 digits, then 4, then 8) with three
+ * multiply-add steps instead of one step per character.
+ */
+#define LANES(byte) (UINT64_C(0x0101010101010101) * (byte))
+
+/**
+ * @brief Loads up to 8 bytes as a little-endian value, padding past end with zeros.
+ */
+static uint64_t load_bytes(const char *p, const char *end)
+{
+    unsigned char bytes[8];
+    uint64_t value = 0;
+    size_t count = (size_t)(end - p) < 8 ? (size_t)(end - p) : 8;
+    int i;
+
+    memset(bytes, 0, sizeof(bytes));
+    memcpy(bytes, p, count);
+    for (i = 7; i >= 0; i--)
+    {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Returns 0x80 in every byte of x that is zero, and 0x00 in the others.
+ */
+static uint64_t zero_bytes(uint64_t x)
+{
+    return ~(((x & LANES(0x7F)) + LANES(0x7F)) | x | LANES(0x7F));
+}
+
+/**
+ * @brief Returns 0x80 in every byte of x that is an ASCII digit.
+ */
+static uint64_t digit_bytes(uint64_t x)
+{
+    return zero_bytes((x & LANES(0xF0)) ^ LANES(0x30)) &
+           zero_bytes(((x + LANES(0x06)) & LANES(0xF0)) ^ LANES(0x30));
+}
+
+/**
+ * @brief Returns 0x80 in every byte of x that is a lowercase hex letter (a-f).
+ */
+static uint64_t hex_letter_bytes(uint64_t x)
+{
+    return zero_bytes((x & LANES(0xF0)) ^ LANES(0x60)) &
+           zero_bytes(((x + LANES(0x09)) & LANES(0xF0)) ^ LANES(0x60)) &
+           ~zero_bytes(x & LANES(0x0F));
+}
+
+/**
+ * @brief Decodes the 7 decimal digits at p (as written by "%07d").
+ *
+ * @return TRUE (1) if all 7 bytes are digits, FALSE (0) otherwise.
+ */
+static int decode_decimal7(const char *p, const char *end, uint32_t *value)
+{
+    uint64_t x = (load_bytes(p, end) << 8) | '0'; /* a leading zero makes 8 digits */
+
+    if (end - p < 7 || digit_bytes(x) != LANES(0x80))
+    {
+        return FALSE;
+    }
+    x -= LANES('0');
+    x = (x * 10 + (x >> 8)) & UINT64_C(0x00FF00FF00FF00FF);
+    x = (x * 100 + (x >> 16)) & UINT64_C(0x0000FFFF0000FFFF);
+    x = (x * 10000 + (x >> 32)) & UINT64_C(0x00000000FFFFFFFF);
+    *value = (uint32_t)x;
+    return TRUE;
+}
+
+/**
+ * @brief Decodes the 6 lowercase hex digits at p (as written by "%06x").
+ *
+ * @return TRUE (1) if all 6 bytes are hex digits, FALSE (0) otherwise.
+ */
+static int decode_hex6(const char *p, const char *end, uint32_t *value)
+{
+    /* two trailing '0' digits make 8, the result is shifted back at the end */
+    uint64_t x = (load_bytes(p, end) & UINT64_C(0x0000FFFFFFFFFFFF)) | UINT64_C(0x3030000000000000);
+    uint64_t letters = hex_letter_bytes(x);
+
+    if (end - p < 6 || (digit_bytes(x) | letters) != LANES(0x80))
+    {
+        return FALSE;
+    }
+    x = (x & LANES(0x0F)) + (letters >> 7) * 9; /* 'a' is 0x61: low nibble + 9 */
+    x = ((x << 4) + (x >> 8)) & UINT64_C(0x00FF00FF00FF00FF);
+    x = ((x << 8) + (x >> 16)) & UINT64_C(0x0000FFFF0000FFFF);
+    x = ((x << 16) + (x >> 32)) & UINT64_C(0x00000000FFFFFFFF);
+    *value = (uint32_t)(x >> 8);
+    return TRUE;
+}
+
+/**
+ * @brief Skips spaces and tabs (not newlines).
+ */
+static const char *skip_blanks(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * @brief Parses an unsigned number in the given base, byte by byte.
+ *
+ * @return Pointer past the number, or NULL if there are no digits.
+ */
+static const char *parse_number(const char *p, const char *end, int base, uint32_t *value)
+{
+    const char *start = p;
+    uint32_t result = 0;
+    int digit;
+
+    while (p < end)
+    {
+        if (*p >= '0' && *p <= '9')
+            digit = *p - '0';
+        else if (base == 16 && *p >= 'a' && *p <= 'f')
+            digit = *p - 'a' + 10;
+        else if (base == 16 && *p >= 'A' && *p <= 'F')
+            digit = *p - 'A' + 10;
+        else
+            break;
+        result = result * base + digit;
+        p++;
+    }
+    *value = result;
+    return p == start ? NULL : p;
+}
+
+/**
+ * @brief Checks that only blanks remain on the line and moves the cursor to the next line.
+ *
+ * @return TRUE (1) if the rest of the line is blank, FALSE (0) otherwise.
+ */
+static int finish_line(MappedText *text, const char *p)
+{
+    p = skip_blanks(p, text->end);
+    if (p < text->end && *p == '\r')
+    {
+        p++;
+    }
+    if (p < text->end && *p != '\n')
+    {
+        return FALSE;
+    }
+    text->cursor = p < text->end ? p + 1 : p;
+    text->line_number++;
+    return TRUE;
+}
+
+/**
+ * @brief Maps a whole file read-only.
+ */
+static int map_text(const char *path, MappedText *text)
+{
+    struct stat st;
+    int fd;
+
+    memset(text, 0, sizeof(*text));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return FALSE;
+    }
+
+    text->size = (size_t)st.st_size;
+    if (text->size > 0)
+    {
+        text->base = mmap(NULL, text->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text->base == MAP_FAILED)
+        {
+            text->base = NULL;
+            close(fd);
+            return FALSE;
+        }
+        posix_madvise(text->base, text->size, POSIX_MADV_SEQUENTIAL);
+    }
+    close(fd); /* the mapping stays valid after closing the descriptor */
+
+    text->cursor = (const char *)text->base;
+    text->end = text->cursor + text->size;
+    return TRUE;
+}
+
+/**
+ * @brief Releases a mapping created by map_text.
+ */
+static void unmap_text(MappedText *text)
+{
+    if (text->base)
+    {
+        munmap(text->base, text->size);
+    }
+    memset(text, 0, sizeof(*text));
+}
+
+/* Maps a .ob file and reads its first line (code and data word counts). */
+int open_object_reader(const char *path, ObjectReader *reader)
+{
+    const char *p;
+
+    if (!map_text(path, &reader->text))
+    {
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+
+    /* first line: "%7d %d" */
+    p = skip_blanks(reader->text.cursor, reader->text.end);
+    p = parse_number(p, reader->text.end, 10, &reader->code_words);
+    if (p)
+    {
+        p = parse_number(skip_blanks(p, reader->text.end), reader->text.end, 10, &reader->data_words);
+    }
+    if (!p || !finish_line(&reader->text, p) ||
+        reader->code_words > STORAGE_SIZE || reader->data_words > STORAGE_SIZE - reader->code_words)
+    {
+        close_object_reader(reader);
+        print_error_no_line(ERROR_FILE_READ);
+        return FALSE;
+    }
+
+    reader->next_address = 100;
+    return TRUE;
+}
+
+/* Reads the next word of a .ob file. */
+int next_object_word(ObjectReader *reader, uint32_t *address, Word *word)
+{
+    MappedText *text = &reader->text;
+    const char *p = text->cursor;
+    uint32_t value;
+
+    if (text->error || reader->next_address == 100 + reader->code_words + reader->data_words)
+    {
+        return FALSE;
+    }
+
+    /* fast path: exactly "AAAAAAA VVVVVV\n" */
+    if (text->end - p >= 15 && p[7] == ' ' && p[14] == '\n' &&
+        decode_decimal7(p, text->end, address) && decode_hex6(p + 8, text->end, &value))
+    {
+        text->cursor = p + 15;
+        text->line_number++;
+    }
+    else
+    {
+        p = parse_number(skip_blanks(p, text->end), text->end, 10, address);
+        if (p)
+        {
+            p = parse_number(skip_blanks(p, text->end), text->end, 16, &value);
+        }
+        if (!p || !finish_line(text, p))
+        {
+            text->error = TRUE;
+            return FALSE;
+        }
+    }
+
+    if (*address != reader->next_address)
+    {
+        text->error = TRUE;
+        return FALSE;
+    }
+    reader->next_address++;
+
+    word->value = value & 0xFFFFFF;
+    word->encoded[0] = '\0';
+    return TRUE;
+}
+
+/* Releases the mapping of a .ob reader. */
+void close_object_reader(ObjectReader *reader)
+{
+    unmap_text(&reader->text);
+}
+
+/* Maps a .ent or .ext file for reading. */
+int open_symbol_reader(const char *path, SymbolFileKind kind, SymbolReader *reader)
+{
+    reader->kind = kind;
+    if (!map_text(path, &reader->text))
+    {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Reads the next symbol of a .ent or .ext file. */
+int next_symbol(SymbolReader *reader, Label *label)
+{
+    MappedText *text = &reader->text;
+    const char *p = skip_blanks(text->cursor, text->end);
+    const char *name_end;
+    uint32_t address;
+
+    if (text->error || p == text->end)
+    {
+        return FALSE;
+    }
+
+    /* label name up to the first blank */
+    name_end = p;
+    while (name_end < text->end && *name_end != ' ' && *name_end != '\t' && *name_end != '\n')
+    {
+        name_end++;
+    }
+    if (name_end == p || name_end - p >= MAX_LABEL_LENGTH)
+    {
+        text->error = TRUE;
+        return FALSE;
+    }
+    memcpy(label->name, p, name_end - p);
+    label->name[name_end - p] = '\0';
+
+    p = skip_blanks(name_end, text->end);
+
+    /* fast path: exactly "AAAAAAA\n" */
+    if (text->end - p >= 8 && p[7] == '\n' && decode_decimal7(p, text->end, &address))
+    {
+        text->cursor = p + 8;
+        text->line_number++;
+    }
+    else
+    {
+        p = parse_number(p, text->end, 10, &address);
+        if (!p || !finish_line(text, p))
+        {
+            text->error = TRUE;
+            return FALSE;
+        }
+    }
+
+    label->address = address;
+    label->line_number = text->line_number;
+    strcpy(label->type, reader->kind == SYMBOLS_ENTRY ? "entry" : "external");
+    return TRUE;
+}
+
+/* Releases the mapping of a symbol reader. */
+void close_symbol_reader(SymbolReader *reader)
+{
+    unmap_text(&reader->text);
+}
@@ -1,4 +1,5 @@
 /* Source_Files/preprocessor.c */
+#define _POSIX_C_SOURCE 200809L /* strtok_r: files may be preprocessed on several threads */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,6 +10,9 @@
 #include "../Header_Files/errors.h"           
 #include "../Header_Files/utils.h"            
 #include "../Header_Files/preprocessor_utils.h" 
+#include "../Header_Files/diagnostics.h"
+#include "../Header_Files/include_files.h"
+#include "../Header_Files/conditional.h"
 
 /**
  * @brief Checks if a given file exists by attempting to open it.
@@ -111,10 +115,10 @@ static char *get_directory_path(const char *filepath)
 }
 
 /* Processes macros in an assembly file. */
-int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table)
+int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table, const IncludedSource *included)
 {
     char *line = NULL, *token, *ptr;
-    char *temp_line = NULL, *extra_text;
+    char *temp_line = NULL, *params, *saveptr;
     size_t buffer_size = MAX_LINE_LENGTH;
     int in_mcro = FALSE, line_number = 0;
     ErrorCode error;
@@ -131,6 +135,11 @@ int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table)
     /* read file line by line */
     while (!feof(fp))
     {
+        if (diagnostics_stopped())
+        {
+            is_valid = FALSE; /* error limit reached, give up on the file */
+            break;
+        }
         pos = 0;
 
         /* read until newline or end of file */
@@ -165,7 +174,7 @@ int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table)
         /* check if line exceeds max length after trimming trailing spaces */
         if (pos >= MAX_LINE_LENGTH)
         {
-            print_error(ERROR_LINE_TOO_LONG, line_number);
+            print_error(ERROR_LINE_TOO_LONG, included_source_line(included, line_number));
             is_valid = FALSE;
             continue;
         }
@@ -182,7 +191,7 @@ int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table)
 
         strcpy(temp_line, line);
 
-        token = strtok(temp_line, " \t\n");
+        token = strtok_r(temp_line, " \t\n", &saveptr);
         if (!token)
         {
             continue;
@@ -205,7 +214,7 @@ int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table)
             }
             else
             {
-                print_error(ERROR_EXTRA_TEXT_AFTER_COMMAND, line_number);
+                print_error(ERROR_EXTRA_TEXT_AFTER_COMMAND, included_source_line(included, line_number));
                 is_valid = FALSE;
                 continue;
             }
@@ -215,40 +224,40 @@ int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table)
         if (strcmp(token, "mcro") == 0)
         {
             in_mcro = TRUE;
-            token = strtok(NULL, " \t\n");
+            token = strtok_r(NULL, " \t\n", &saveptr);
             if (!token)
             {
-                print_error(ERROR_MCRO_NO_NAME, line_number);
+                print_error(ERROR_MCRO_NO_NAME, included_source_line(included, line_number));
                 is_valid = FALSE;
                 continue;
             }
             trim_newline(token);
 
-            /* check for unexpected text after macro name */
-            extra_text = strtok(NULL, " \t\n");
-            if (extra_text && extra_text[0] != ';') /* only allow comments after */
-            {
-                print_error(ERROR_MCRO_UNEXPECTED_TEXT, line_number);
-                is_valid = FALSE;
-                continue;
-            }
+            /* the parameters (or a comment) follow the name */
+            params = line + (token - temp_line) + strlen(token);
 
             error = add_mcro(mcro_table, token);
             if (error != ERROR_SUCCESS && error != ERROR_MEMORY_ALLOCATION)
             {
-                print_error(error, line_number);
+                print_error(error, included_source_line(included, line_number));
                 is_valid = FALSE;
                 continue;
             }
 
             if (error == ERROR_MEMORY_ALLOCATION)
             {
-                print_error(error, line_number);
+                print_error(error, included_source_line(included, line_number));
                 free(line);
                 free(temp_line);
                 return FALSE;
             }
 
+            error = add_mcro_params(mcro_table, params);
+            if (error != ERROR_SUCCESS)
+            {
+                print_error(error, included_source_line(included, line_number));
+                is_valid = FALSE;
+            }
             continue;
         }
 
@@ -261,7 +270,7 @@ int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table)
             error = add_line_to_mcro(mcro_table, ptr);
             if (error != ERROR_SUCCESS)
             {
-                print_error(error, line_number);
+                print_error(error, included_source_line(included, line_number));
                 is_valid = FALSE;
                 continue;
             }
@@ -273,17 +282,25 @@ int process_as_file(FILE *fp, const char *file_path, McroTable *mcro_table)
     free(temp_line);
 
     /* Create .am file */
-    expand_macros_to_am_file (fp, file_path, mcro_table, &is_valid);
+    if (!diagnostics_stopped())
+    {
+        expand_macros_to_am_file (fp, file_path, mcro_table, included, &is_valid);
+    }
     return is_valid;
 }
 
 /* Prepocesses an assembly file. */
-int process_file(const char *filepath, McroTable *mcro_table)
+int process_file(const char *filepath, const char *source, size_t source_size, McroTable *mcro_table, const IncludeOptions *includes, int *am_is_source)
 {
     char *full_source_path;
     char *dir_path;
-    FILE *fp;
+    FILE *fp = NULL;
     int result;
+    IncludedSource included;
+    int has_includes = FALSE;
+    int verbatim = FALSE;
+
+    *am_is_source = FALSE;
 
     /* check filename length after ".as/0"*/
     if (strlen(filepath) > MAX_FILENAME_LENGTH - 4)
@@ -292,8 +309,8 @@ int process_file(const char *filepath, McroTable *mcro_table)
         return FALSE;
     }
 
-    /* verify file exists */
-    if (!check_as_file_exists(filepath))
+    /* verify file exists (a file read ahead exists) */
+    if (!source && !check_as_file_exists(filepath))
     {
         print_error(ERROR_FILE_NOT_EXIST, 0);
         return FALSE;
@@ -318,23 +335,64 @@ int process_file(const char *filepath, McroTable *mcro_table)
         return FALSE;
     }
 
-    /* open the source file for reading */
-    fp = fopen(full_source_path, "r");
+    /* the lines of the included files take the place of the .include directives,
+       and only the assembled blocks of conditionals are kept */
+    if (source && (has_include_directive(source, source_size) || has_conditional_directive(source, source_size)))
+    {
+        if (!expand_includes(full_source_path, source, source_size, includes, &included))
+        {
+            free(full_source_path);
+            free(dir_path);
+            return FALSE;
+        }
+        has_includes = TRUE;
+        source = included.text;
+        source_size = included.size;
+    }
 
-    /* check if the file could not be opened */
-    if (!fp)
+    /* without macros the lines only lose their comments, if they have any */
+    if (source && mcro_table->library_count == 0 && is_plain_source(source, source_size, &verbatim))
     {
-        free(full_source_path);
-        free(dir_path);
-        print_error_no_line(ERROR_FILE_READ);
-        return FALSE;
+        result = write_plain_am_file(source, source_size, full_source_path, mcro_table, has_includes ? &included : NULL, verbatim);
+        *am_is_source = result && verbatim && !has_includes; /* the included text is freed below */
+    }
+    else
+    {
+        /* open the source file for reading, or the bytes already read */
+        fp = source ? fmemopen((void *)source, source_size, "r") : fopen(full_source_path, "r");
+
+        /* check if the file could not be opened */
+        if (!fp)
+        {
+            free(full_source_path);
+            free(dir_path);
+            if (has_includes)
+            {
+                free_included_source(&included);
+            }
+            print_error_no_line(ERROR_FILE_READ);
+            return FALSE;
+        }
+
+        /* process macros */
+        result = process_as_file(fp, full_source_path, mcro_table, has_includes ? &included : NULL);
     }
 
-    /* process macros */
-    result = process_as_file(fp, full_source_path, mcro_table);
+    /* make dependencies, once the included files are known (-MD) */
+    if (result && includes->dependency_file && !write_dependency_file(filepath, has_includes ? &included : NULL))
+    {
+        result = FALSE;
+    }
 
     /* cleanup */
-    fclose(fp);
+    if (fp)
+    {
+        fclose(fp);
+    }
+    if (has_includes)
+    {
+        free_included_source(&included);
+    }
     free(full_source_path);
     free(dir_path);
 
@@ -1,5 +1,7 @@
 /* preprocessor_utils.c */
+#define _POSIX_C_SOURCE 200809L /* strtok_r: files may be preprocessed on several threads */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include "../Header_Files/globals.h"
@@ -7,6 +9,10 @@
 #include "../Header_Files/preprocessor.h"
 #include "../Header_Files/preprocessor_utils.h"
 #include "../Header_Files/utils.h"
+#include "../Header_Files/diagnostics.h"
+#include "../Header_Files/output_file.h"
+#include "../Header_Files/macro_library.h"
+#include "../Header_Files/am_builder.h"
 
 /* Initializes the macro table. */
 void init_mcro_table(McroTable *table)
@@ -18,7 +24,60 @@ void init_mcro_table(McroTable *table)
     for (i = 0; i < MAX_MCROS; i++)
     {
         table->mcros[i].line_count = 0;
+        table->mcros[i].param_count = 0;
     }
+    table->expansions = NULL;
+    table->expansion_count = 0;
+    table->expansion_capacity = 0;
+    table->expansion_index = NULL;
+    table->index_capacity = 0;
+    table->libraries = NULL;
+    table->library_count = 0;
+}
+
+/**
+ * @brief Frees what the expansions of a table hold, keeping the arrays for the next file.
+ */
+static void clear_expansions(McroTable *table)
+{
+    int i;
+
+    for (i = 0; i < table->expansion_count; i++)
+    {
+        free(table->expansions[i].arguments);
+        free(table->expansions[i].lines);
+    }
+    if (table->expansion_count > 0)
+    {
+        memset(table->expansion_index, -1, table->index_capacity * sizeof(int));
+    }
+    table->expansion_count = 0;
+}
+
+/* Empties an initialized macro table, resetting only the macros it holds. */
+void reset_mcro_table(McroTable *table)
+{
+    int i;
+
+    for (i = 0; i < table->count && i < MAX_MCROS; i++)
+    {
+        table->mcros[i].line_count = 0;
+        table->mcros[i].param_count = 0;
+    }
+    table->count = 0;
+    clear_expansions(table);
+}
+
+/* Releases the expansions of a macro table. */
+void free_mcro_table(McroTable *table)
+{
+    clear_expansions(table);
+    free(table->expansions);
+    free(table->expansion_index);
+    table->expansions = NULL;
+    table->expansion_index = NULL;
+    table->expansion_capacity = 0;
+    table->index_capacity = 0;
 }
 
 /* Validates if a given name is a legal macro name. */
@@ -129,16 +188,506 @@ ErrorCode add_line_to_mcro(McroTable *table, const char *line)
     return ERROR_SUCCESS;
 }
 
-/* Processes the content as it would appear in the .am file and writes it to the target file. */
-int expand_macros_to_am_file(FILE *source_fp, const char *source_filepath, const McroTable *mcro_table, int *is_valid)
+/**
+ * @brief Splits a comma separated list (up to a comment) into trimmed items.
+ *
+ * @param items Receives the items, at most max of them.
+ * @param count Receives the number of items (0 for a blank list).
+ * @return ERROR_SUCCESS, ERROR_MCRO_UNEXPECTED_TEXT if an item holds a space,
+ *         ERROR_MCRO_INVALID_PARAM if one is empty, ERROR_MCRO_TOO_MANY_PARAMS past max.
+ */
+static ErrorCode split_list(const char *text, char items[][MAX_LINE_LENGTH], int max, int *count)
+{
+    const char *start, *end, *last;
+    size_t length;
+
+    *count = 0;
+    while (isspace((unsigned char)*text))
+    {
+        text++;
+    }
+    if (*text == '\0' || *text == ';')
+    {
+        return ERROR_SUCCESS;
+    }
+
+    for (;;)
+    {
+        /* one item, up to a comma, a comment or the end */
+        start = text;
+        while (*start == ' ' || *start == '\t')
+        {
+            start++;
+        }
+        end = start;
+        while (*end && *end != ',' && *end != ';' && *end != '\n' && *end != '\r')
+        {
+            end++;
+        }
+        last = end;
+        while (last > start && isspace((unsigned char)last[-1]))
+        {
+            last--;
+        }
+
+        length = (size_t)(last - start);
+        if (length == 0)
+        {
+            return ERROR_MCRO_INVALID_PARAM;
+        }
+        if (*count == max)
+        {
+            return ERROR_MCRO_TOO_MANY_PARAMS;
+        }
+        strncpy(items[*count], start, length);
+        items[*count][length] = '\0';
+        if (strpbrk(items[*count], " \t"))
+        {
+            return ERROR_MCRO_UNEXPECTED_TEXT; /* items are separated by commas */
+        }
+        (*count)++;
+
+        if (*end != ',')
+        {
+            return ERROR_SUCCESS;
+        }
+        text = end + 1;
+    }
+}
+
+/* Reads the comma separated parameter names that follow a macro name. */
+ErrorCode read_mcro_params(const char *text, char params[][MAX_MCRO_NAME_LENGTH], int *count)
+{
+    char items[MAX_MCRO_PARAMS][MAX_LINE_LENGTH];
+    int i, j, item_count;
+    ErrorCode err;
+
+    err = split_list(text, items, MAX_MCRO_PARAMS, &item_count);
+    if (err != ERROR_SUCCESS)
+    {
+        return err;
+    }
+
+    for (i = 0; i < item_count; i++)
+    {
+        /* a parameter follows the rules of a macro name and appears once */
+        if (strlen(items[i]) >= MAX_MCRO_NAME_LENGTH || is_valid_mcro_name(items[i]) != ERROR_SUCCESS)
+        {
+            return ERROR_MCRO_INVALID_PARAM;
+        }
+        for (j = 0; j < i; j++)
+        {
+            if (strcmp(items[i], items[j]) == 0)
+            {
+                return ERROR_MCRO_INVALID_PARAM;
+            }
+        }
+    }
+
+    for (i = 0; i < item_count; i++)
+    {
+        strcpy(params[i], items[i]);
+    }
+    *count = item_count;
+    return ERROR_SUCCESS;
+}
+
+/* Sets the parameters of the most recently added macro from the text after its name. */
+ErrorCode add_mcro_params(McroTable *table, const char *text)
+{
+    Mcro *mcro;
+
+    if (table->count == 0)
+        return ERROR_MCRO_BEFORE_DEF;
+
+    mcro = &table->mcros[table->count - 1];
+    return read_mcro_params(text, mcro->params, &mcro->param_count);
+}
+
+/* Finds the whole parameter names of a macro body line. */
+int find_param_references(const char params[][MAX_MCRO_NAME_LENGTH], int param_count, const char *line, ParamReference *references)
+{
+    const char *ptr = line, *end;
+    int i, count = 0, in_string = FALSE;
+
+    while (*ptr)
+    {
+        end = ptr + 1;
+        if (*ptr == '"')
+        {
+            in_string = !in_string;
+        }
+        else if (!in_string && *ptr == ';')
+        {
+            break; /* nothing is replaced in a comment */
+        }
+        else if (!in_string && (isalpha((unsigned char)*ptr) || *ptr == '_'))
+        {
+            while (isalnum((unsigned char)*end) || *end == '_')
+            {
+                end++; /* a whole name */
+            }
+            for (i = 0; i < param_count; i++)
+            {
+                if (strlen(params[i]) == (size_t)(end - ptr) && strncmp(params[i], ptr, (size_t)(end - ptr)) == 0)
+                {
+                    references[count].start = (int)(ptr - line);
+                    references[count].length = (int)(end - ptr);
+                    references[count].param = i;
+                    count++;
+                    break;
+                }
+            }
+        }
+        ptr = end;
+    }
+    return count;
+}
+
+/**
+ * @brief Writes a body line with every parameter reference replaced by its argument.
+ *
+ * @param references The parameter names of the line, in order.
+ * @param out Receives the line, MAX_LINE_LENGTH bytes.
+ * @return ERROR_SUCCESS, or ERROR_LINE_TOO_LONG if the line outgrows MAX_LINE_LENGTH.
+ */
+static ErrorCode splice_arguments(const char *line, const ParamReference *references, int count, char args[][MAX_LINE_LENGTH], char *out)
+{
+    const char *ptr = line;
+    size_t length = 0, text_length;
+    int i;
+
+    for (i = 0; i <= count; i++)
+    {
+        /* the text up to the next reference, or the rest of the line */
+        text_length = i < count ? (size_t)(line + references[i].start - ptr) : strlen(ptr);
+        if (length + text_length >= MAX_LINE_LENGTH)
+        {
+            return ERROR_LINE_TOO_LONG;
+        }
+        memcpy(out + length, ptr, text_length);
+        length += text_length;
+        if (i == count)
+        {
+            break;
+        }
+
+        text_length = strlen(args[references[i].param]);
+        if (length + text_length >= MAX_LINE_LENGTH)
+        {
+            return ERROR_LINE_TOO_LONG;
+        }
+        memcpy(out + length, args[references[i].param], text_length);
+        length += text_length;
+        ptr = line + references[i].start + references[i].length;
+    }
+    out[length] = '\0';
+    return ERROR_SUCCESS;
+}
+
+/**
+ * @brief Hashes a macro and its arguments (FNV-1a).
+ */
+static unsigned long hash_expansion(int mcro, const char *arguments)
+{
+    unsigned long hash = (2166136261UL ^ (unsigned long)mcro) & 0xFFFFFFFFUL;
+
+    while (*arguments)
+    {
+        hash ^= (unsigned char)*arguments++;
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Rebuilds the index of the expansions with a new capacity.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int grow_expansion_index(McroTable *table, int capacity)
+{
+    int *index = (int *)malloc(capacity * sizeof(int));
+    int i, slot;
+
+    if (!index)
+    {
+        return FALSE;
+    }
+    memset(index, -1, capacity * sizeof(int));
+    for (i = 0; i < table->expansion_count; i++)
+    {
+        slot = (int)(table->expansions[i].hash & (unsigned long)(capacity - 1));
+        while (index[slot] != -1)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        index[slot] = i;
+    }
+    free(table->expansion_index);
+    table->expansion_index = index;
+    table->index_capacity = capacity;
+    return TRUE;
+}
+
+/**
+ * @brief Makes room for one more expansion and its slot in the index.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int reserve_expansion(McroTable *table)
+{
+    if (table->expansion_count == table->expansion_capacity)
+    {
+        int capacity = table->expansion_capacity ? table->expansion_capacity * 2 : 16;
+        McroExpansion *grown = (McroExpansion *)realloc(table->expansions, capacity * sizeof(McroExpansion));
+        if (!grown)
+        {
+            return FALSE;
+        }
+        table->expansions = grown;
+        table->expansion_capacity = capacity;
+    }
+    return (table->expansion_count + 1) * 2 <= table->index_capacity ||
+           grow_expansion_index(table, table->index_capacity ? table->index_capacity * 2 : 64);
+}
+
+/**
+ * @brief Enters the expansion being added (the one past the last) in the index.
+ *
+ * @return The index of the expansion.
+ */
+static int index_expansion(McroTable *table)
+{
+    int slot = (int)(table->expansions[table->expansion_count].hash & (unsigned long)(table->index_capacity - 1));
+
+    while (table->expansion_index[slot] != -1)
+    {
+        slot = (slot + 1) & (table->index_capacity - 1);
+    }
+    table->expansion_index[slot] = table->expansion_count;
+    return table->expansion_count++;
+}
+
+/**
+ * @brief Adds the expansion of a macro for a list of arguments, substituting its body.
+ *
+ * @return ERROR_SUCCESS, ERROR_LINE_TOO_LONG, or ERROR_MEMORY_ALLOCATION.
+ */
+static ErrorCode add_expansion(McroTable *table, const MacroLibrary *library, int mcro, const char *arguments, char args[][MAX_LINE_LENGTH], unsigned long hash, int *expansion)
+{
+    const Mcro *body = library ? NULL : &table->mcros[mcro];
+    ParamReference references[MAX_PARAM_REFERENCES];
+    McroExpansion *entry;
+    const char *text;
+    int i, count, param_count;
+    ErrorCode err;
+
+    /* a library body is checked against its file once, when it is first expanded */
+    if (library && !check_library_mcro(library, mcro))
+    {
+        return ERROR_MLIB_INVALID;
+    }
+    param_count = library ? library_mcro_param_count(library, mcro) : body->param_count;
+
+    if (!reserve_expansion(table))
+    {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    entry = &table->expansions[table->expansion_count];
+    entry->mcro = mcro;
+    entry->library = library;
+    entry->line_count = library ? library_mcro_line_count(library, mcro) : body->line_count;
+    entry->hash = hash;
+    entry->lines = NULL;
+    entry->arguments = (char *)malloc(strlen(arguments) + 1);
+    if (!entry->arguments)
+    {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    strcpy(entry->arguments, arguments);
+
+    /* a macro without parameters expands to its content as it is */
+    if (param_count > 0)
+    {
+        entry->lines = (char (*)[MAX_LINE_LENGTH])malloc((entry->line_count > 0 ? entry->line_count : 1) * MAX_LINE_LENGTH);
+        if (!entry->lines)
+        {
+            free(entry->arguments);
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        for (i = 0; i < entry->line_count; i++)
+        {
+            /* a library line comes with its parameter names already found */
+            if (library)
+            {
+                text = library_mcro_line(library, mcro, i);
+                count = library_line_references(library, mcro, i, references);
+            }
+            else
+            {
+                text = body->content[i];
+                count = find_param_references(body->params, body->param_count, text, references);
+            }
+            err = splice_arguments(text, references, count, args, entry->lines[i]);
+            if (err != ERROR_SUCCESS)
+            {
+                free(entry->lines);
+                free(entry->arguments);
+                return err;
+            }
+        }
+    }
+
+    *expansion = index_expansion(table);
+    return ERROR_SUCCESS;
+}
+
+/* Finds or makes the expansion of a macro call. */
+ErrorCode expand_mcro_call(McroTable *table, const MacroLibrary *library, int mcro, const char *text, int *expansion)
+{
+    char args[MAX_MCRO_PARAMS][MAX_LINE_LENGTH];
+    char arguments[MAX_MCRO_PARAMS * MAX_LINE_LENGTH];
+    const McroExpansion *entry;
+    unsigned long hash;
+    int i, count, slot, param_count;
+    ErrorCode err;
+
+    param_count = library ? library_mcro_param_count(library, mcro) : table->mcros[mcro].param_count;
+    err = split_list(text, args, MAX_MCRO_PARAMS, &count);
+    if (param_count == 0 && (err != ERROR_SUCCESS || count > 0))
+    {
+        return ERROR_MACRO_CALL_EXTRA_TEXT; /* a macro without parameters stands alone */
+    }
+    if (err == ERROR_MCRO_UNEXPECTED_TEXT)
+    {
+        return ERROR_MACRO_CALL_EXTRA_TEXT;
+    }
+    if (err != ERROR_SUCCESS || count != param_count)
+    {
+        return ERROR_MCRO_ARG_COUNT;
+    }
+
+    /* calls with the same arguments share one expansion */
+    arguments[0] = '\0';
+    for (i = 0; i < count; i++)
+    {
+        if (i > 0)
+        {
+            strcat(arguments, ",");
+        }
+        strcat(arguments, args[i]);
+    }
+    hash = hash_expansion(mcro, arguments);
+    if (table->index_capacity > 0)
+    {
+        slot = (int)(hash & (unsigned long)(table->index_capacity - 1));
+        while (table->expansion_index[slot] != -1)
+        {
+            entry = &table->expansions[table->expansion_index[slot]];
+            if (entry->hash == hash && entry->mcro == mcro && entry->library == library && strcmp(entry->arguments, arguments) == 0)
+            {
+                *expansion = table->expansion_index[slot];
+                return ERROR_SUCCESS;
+            }
+            slot = (slot + 1) & (table->index_capacity - 1);
+        }
+    }
+    return add_expansion(table, library, mcro, arguments, args, hash, expansion);
+}
+
+/* Returns a line of a macro expansion. */
+const char *get_expansion_line(const McroTable *table, int expansion, int line)
+{
+    const McroExpansion *entry = &table->expansions[expansion];
+
+    if (entry->lines)
+    {
+        return entry->lines[line];
+    }
+    return entry->library ? library_mcro_line(entry->library, entry->mcro, line) : table->mcros[entry->mcro].content[line];
+}
+
+/* Finds a macro by name, in the file first and then in the libraries. */
+int find_mcro(const McroTable *table, const char *name, const MacroLibrary **library)
+{
+    int i;
+
+    *library = NULL;
+    for (i = 0; i < table->count; i++)
+    {
+        if (strcmp(table->mcros[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return find_library_mcro(table->libraries, table->library_count, name, library);
+}
+
+/**
+ * @struct ReptBlock
+ * @brief The .rept block being read.
+ */
+typedef struct
+{
+    long count; /* iterations, 0 for a block that is not written */
+    int line;   /* the .as line of the .rept, 0 outside a block */
+} ReptBlock;
+
+/**
+ * @brief Reads the count of a .rept directive.
+ *
+ * @param text The text after ".rept".
+ * @return TRUE (1) for a count from 0 to MAX_REPT_COUNT alone on the line (or before a comment), FALSE (0) otherwise.
+ */
+static int parse_rept_count(const char *text, long *count)
+{
+    const char *ptr = advance_to_next_token((char *)text);
+
+    if (!isdigit((unsigned char)*ptr))
+    {
+        return FALSE;
+    }
+    for (*count = 0; isdigit((unsigned char)*ptr); ptr++)
+    {
+        *count = *count * 10 + (*ptr - '0');
+        if (*count > MAX_REPT_COUNT)
+        {
+            return FALSE;
+        }
+    }
+    ptr = advance_to_next_token((char *)ptr);
+    return *ptr == '\0' || *ptr == ';' || *ptr == '\n' || *ptr == '\r';
+}
+
+/**
+ * @brief Writes a .rept or .endr line of a block to the .am plan.
+ *
+ * The block is written once, between its two directives; the first pass
+ * repeats what the body encodes.
+ *
+ * @return TRUE (1) on success, FALSE (0) on allocation failure.
+ */
+static int add_rept_directive(AmPlan *plan, const char *text, int source_line)
+{
+    if (!add_am_line(plan, text, strlen(text)))
+    {
+        return FALSE;
+    }
+    add_line_origin(source_line, -1, 0);
+    return TRUE;
+}
+
+/**
+ * @brief Opens the .am file of a source for writing.
+ *
+ * @return TRUE (1) on success, FALSE (0) after reporting the error.
+ */
+static int open_am_file(OutputFile *target_file, const char *source_filepath)
 {
-    char line[MAX_LINE_LENGTH];
-    char temp_line[MAX_LINE_LENGTH];
-    char clean_macro_name[MAX_MCRO_NAME_LENGTH];
     char target_filename[MAX_FILENAME_LENGTH];
-    char *token, *dot_position; /* dot position for file extension */
-    int i, j, is_macro_call, in_macro_def = 0, line_number = 0;
-    FILE *target_fp;
+    char *dot_position; /* dot position for file extension */
 
     /* create target file name with .am extension */
     strncpy(target_filename, source_filepath, MAX_FILENAME_LENGTH - 1);
@@ -154,12 +703,36 @@ int expand_macros_to_am_file(FILE *source_fp, const char *source_filepath, const
     strcpy(dot_position, ".am"); /* replace the extension with .am */
 
     /* open target file for writing */
-    target_fp = fopen(target_filename, "w");
-    if (!target_fp)
+    if (!open_output_file(target_file, target_filename))
     {
         print_error_no_line(ERROR_FILE_WRITE);
         return FALSE;
     }
+    return TRUE;
+}
+
+/* Processes the content as it would appear in the .am file and writes it to the target file. */
+int expand_macros_to_am_file(FILE *source_fp, const char *source_filepath, McroTable *mcro_table, const IncludedSource *included, int *is_valid)
+{
+    char line[MAX_LINE_LENGTH];
+    char temp_line[MAX_LINE_LENGTH];
+    char *token;
+    char *saveptr;
+    int i, j, is_macro_call, in_macro_def = 0, line_number = 0;
+    int expansion;
+    const MacroLibrary *library;
+    ErrorCode err;
+    OutputFile target_file;
+    ReptBlock rept = {0, 0};
+    char rept_line[MAX_LINE_LENGTH];
+    AmPlan plan; /* the lines to write, built in one buffer once all are known */
+    int written;
+
+    if (!open_am_file(&target_file, source_filepath))
+    {
+        return FALSE;
+    }
+    init_am_plan(&plan);
 
     rewind(source_fp); /* reset the source file pointer to read from the start*/
 
@@ -170,7 +743,7 @@ int expand_macros_to_am_file(FILE *source_fp, const char *source_filepath, const
         strncpy(temp_line, line, MAX_LINE_LENGTH - 1);
         temp_line[MAX_LINE_LENGTH - 1] = '\0';
 
-        token = strtok(temp_line, " \t\n\r"); /* get the first token */
+        token = strtok_r(temp_line, " \t\n\r", &saveptr); /* get the first token */
         if (!token || token[0] == ';')
         {
             continue; /* skip empty lines and comment lines */
@@ -192,39 +765,88 @@ int expand_macros_to_am_file(FILE *source_fp, const char *source_filepath, const
             continue; /* skip this line */
         }
 
+        /* a repetition block is written once, with its count; a block of 0 is dropped */
+        if (strcmp(token, ".rept") == 0)
+        {
+            if (rept.line)
+            {
+                print_error(ERROR_REPT_NESTED, included_source_line(included, line_number));
+                *is_valid = FALSE;
+                continue;
+            }
+            rept.line = line_number;
+            if (!parse_rept_count(line + (token - temp_line) + 5, &rept.count))
+            {
+                print_error(ERROR_REPT_SYNTAX, included_source_line(included, line_number));
+                *is_valid = FALSE;
+                rept.count = 0; /* the body is still read up to its .endr */
+            }
+            sprintf(rept_line, ".rept %ld\n", rept.count);
+            if (rept.count > 0 && !add_rept_directive(&plan, rept_line, included_source_line(included, line_number)))
+            {
+                print_error_no_line(ERROR_MEMORY_ALLOCATION);
+                *is_valid = FALSE;
+            }
+            continue;
+        }
+        if (strcmp(token, ".endr") == 0)
+        {
+            token = strtok_r(NULL, " \t\n\r", &saveptr);
+            if (token && token[0] != ';')
+            {
+                print_error(ERROR_EXTRA_TEXT_AFTER_COMMAND, included_source_line(included, line_number));
+                *is_valid = FALSE;
+            }
+            if (!rept.line)
+            {
+                print_error(ERROR_ENDR_WITHOUT_REPT, included_source_line(included, line_number));
+                *is_valid = FALSE;
+            }
+            else
+            {
+                if (rept.count > 0 && !add_rept_directive(&plan, ".endr\n", included_source_line(included, line_number)))
+                {
+                    print_error_no_line(ERROR_MEMORY_ALLOCATION);
+                    *is_valid = FALSE;
+                }
+                rept.count = 0;
+                rept.line = 0;
+            }
+            continue;
+        }
+
         /* check if the line calls a macro */
         is_macro_call = 0;
         trim_newline(token);
 
-        /* check if the token is a macro name */
-        for (i = 0; i < mcro_table->count; i++)
+        /* check if the token is a macro name, of the file or of a library */
+        i = find_mcro(mcro_table, token, &library);
+        if (i >= 0)
         {
-            strncpy(clean_macro_name, mcro_table->mcros[i].name, MAX_MCRO_NAME_LENGTH - 1);
-            clean_macro_name[MAX_MCRO_NAME_LENGTH - 1] = '\0';
-            trim_newline(clean_macro_name);
-
-            /* check if the token is a macro name */
-            if (strcmp(token, clean_macro_name) == 0)
+            /* the arguments follow the name in the line (none for a macro without parameters) */
+            err = expand_mcro_call(mcro_table, library, i, line + (token - temp_line) + strlen(token), &expansion);
+            if (err == ERROR_SUCCESS)
             {
-                char *next = advance_past_token(token);
-                next = advance_to_next_token(next);
-
-                /* if this is only macro call and not extra text */
-                if (*next == '\0' || *next == ';')
+                /* expand macro correctly */
+                if (rept.line && rept.count == 0)
                 {
-                    /* expand macro correctly */
-                    for (j = 0; j < mcro_table->mcros[i].line_count; j++)
-                    {
-                        fprintf(target_fp, "%s\n", mcro_table->mcros[i].content[j]);
-                    }
-                    is_macro_call = 1;
-                    break;
+                    continue; /* the body of a dropped block */
                 }
-                else
+                if (!add_am_expansion(&plan, expansion, 1))
                 {
-                    print_error(ERROR_MACRO_CALL_EXTRA_TEXT,line_number);
+                    print_error_no_line(ERROR_MEMORY_ALLOCATION);
                     *is_valid = FALSE;
                 }
+                for (j = 0; j < mcro_table->expansions[expansion].line_count; j++)
+                {
+                    add_line_origin(included_source_line(included, line_number), expansion, j); /* every body line comes from the call */
+                }
+                is_macro_call = 1;
+            }
+            else
+            {
+                print_error(err, included_source_line(included, line_number));
+                *is_valid = FALSE;
             }
         }
 
@@ -239,12 +861,151 @@ int expand_macros_to_am_file(FILE *source_fp, const char *source_filepath, const
                 *semicolon_pos = '\0';
                 strcat(line, "\n"); /* add newline character */
             }
-            fprintf(target_fp, "%s", line);
+            if (rept.line && rept.count == 0)
+            {
+                continue; /* the body of a dropped block */
+            }
+            if (!add_am_line(&plan, line, strlen(line)))
+            {
+                print_error_no_line(ERROR_MEMORY_ALLOCATION);
+                *is_valid = FALSE;
+            }
+            add_line_origin(included_source_line(included, line_number), -1, 0);
         }
     }
 
+    /* a block left open fails the file */
+    if (rept.line)
+    {
+        print_error(ERROR_REPT_UNTERMINATED, included_source_line(included, rept.line));
+        *is_valid = FALSE;
+    }
+
+    /* build the lines in one buffer, on several threads for a large file, and write it */
+    written = write_am_plan(target_file.fp, &plan, mcro_table);
+    free_am_plan(&plan);
+
     /* close and flush the target file */
-    fflush(target_fp);
-    fclose(target_fp);
+    if (!close_output_file(&target_file) || !written)
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Finds the first character of a line that is not blank, as strtok would.
+ *
+ * @return The character, or end if the line is blank.
+ */
+static const char *skip_line_blanks(const char *ptr, const char *end)
+{
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r'))
+    {
+        ptr++;
+    }
+    return ptr;
+}
+
+/* Checks quickly whether a source can skip macro expansion. */
+int is_plain_source(const char *data, size_t size, int *verbatim)
+{
+    const char *ptr = data, *end = data + size, *line_end, *first;
+
+    /* a NUL byte ends the lines fgets reads early */
+    if (memchr(data, '\0', size))
+    {
+        return FALSE;
+    }
+    *verbatim = size > 0 && !memchr(data, ';', size);
+
+    while (ptr < end)
+    {
+        line_end = (const char *)memchr(ptr, '\n', (size_t)(end - ptr));
+        if (!line_end)
+        {
+            line_end = end;
+        }
+        /* a long line is split or rejected by the full preprocessor */
+        if (line_end - ptr > MAX_LINE_LENGTH - 2)
+        {
+            return FALSE;
+        }
+
+        first = skip_line_blanks(ptr, line_end);
+        if (first == line_end)
+        {
+            *verbatim = FALSE; /* a blank line is dropped */
+        }
+        else if ((*first == 'm' && line_end - first >= 4 && strncmp(first, "mcro", 4) == 0) ||
+                 (*first == '.' && line_end - first >= 5 && (strncmp(first, ".rept", 5) == 0 || strncmp(first, ".endr", 5) == 0)))
+        {
+            return FALSE;
+        }
+        ptr = line_end + 1;
+    }
+    return TRUE;
+}
+
+/* Writes the .am file of a source without macros: its lines with comments and blank lines stripped. */
+int write_plain_am_file(const char *source, size_t size, const char *source_filepath, const McroTable *mcro_table, const IncludedSource *included, int verbatim)
+{
+    const char *ptr = source, *end = source + size, *line_end, *first, *semicolon;
+    OutputFile target_file;
+    AmPlan plan;
+    int line_number = 0, planned = TRUE, written;
+
+    if (!open_am_file(&target_file, source_filepath))
+    {
+        return FALSE;
+    }
+    init_am_plan(&plan);
+
+    while (ptr < end)
+    {
+        line_end = (const char *)memchr(ptr, '\n', (size_t)(end - ptr));
+        line_end = line_end ? line_end + 1 : end; /* with its newline */
+        line_number++;
+
+        /* every line is kept as it is, and written below in one call */
+        if (!verbatim)
+        {
+            first = skip_line_blanks(ptr, line_end);
+            if (first == line_end || *first == '\n' || *first == ';')
+            {
+                ptr = line_end;
+                continue; /* skip empty lines and comment lines */
+            }
+            semicolon = (const char *)memchr(first, ';', (size_t)(line_end - first));
+            if (semicolon)
+            {
+                planned = planned && add_am_line(&plan, ptr, (size_t)(semicolon - ptr)) && add_am_line(&plan, "\n", 1);
+            }
+            else
+            {
+                planned = planned && add_am_line(&plan, ptr, (size_t)(line_end - ptr));
+            }
+        }
+        add_line_origin(included_source_line(included, line_number), -1, 0);
+        ptr = line_end;
+    }
+
+    if (!planned)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        free_am_plan(&plan);
+        close_output_file(&target_file);
+        return FALSE;
+    }
+
+    written = verbatim ? fwrite(source, 1, size, target_file.fp) == size : write_am_plan(target_file.fp, &plan, mcro_table);
+    free_am_plan(&plan);
+
+    if (!close_output_file(&target_file) || !written)
+    {
+        print_error_no_line(ERROR_FILE_WRITE);
+        return FALSE;
+    }
     return TRUE;
 }
@@ -11,16 +11,13 @@
 #include "../Header_Files/globals.h"
 #include "../Header_Files/utils.h"
 #include "../Header_Files/errors.h"
+#include "../Header_Files/diagnostics.h"
 
 /*Implements the second pass of the assembler. */
 int second_pass(FILE *am_file, LabelTable *label_table, VirtualPC *vpc)
 {
     char line[MAX_LINE_LENGTH];
-    char label[MAX_LABEL_LENGTH];
-    char *ptr;
     int line_number = 0;
-    size_t label_length = 0;
-    ErrorCode err;
     int is_valid_file = TRUE;
 
     if (am_file == NULL)
@@ -34,77 +31,99 @@ int second_pass(FILE *am_file, LabelTable *label_table, VirtualPC *vpc)
     /* read each line */
     while (fgets(line, MAX_LINE_LENGTH, am_file))
     {
-        char *content = line;
-        char *colon_pos = NULL;
-        int inside_string = 0;
+        if (diagnostics_stopped())
+        {
+            is_valid_file = FALSE; /* error limit reached, give up on the file */
+            break;
+        }
         line_number++;
-        /* trim leading spaces */
-        ptr = advance_to_next_token(line);
-
-        /* iterate through the line to find a ':' that is not inside quotes */
-        while (*ptr)
+        if (!second_pass_line(line, line_number, label_table))
         {
-            if (*ptr == '"')
-            {
-                inside_string = !inside_string; /* toggle string tracking */
-            }
-            else if (*ptr == ':' && !inside_string)
-            {
-                colon_pos = ptr;                 /* found a valid label colon */
-                label_length = colon_pos - line; /* set label length */
-                break;
-            }
-            ptr++;
+            is_valid_file = FALSE;
         }
+    }
 
-        /* we are in a label declaration line */
-        if (colon_pos != NULL)
-        {
-            strncpy(label, line, label_length);
-            label[label_length] = '\0';
+    set_diagnostic_line(NULL);
+    return is_valid_file;
+}
+
+/* Checks the label references and the .entry directive of one line. */
+int second_pass_line(char *line, int line_number, LabelTable *label_table)
+{
+    char label[MAX_LABEL_LENGTH];
+    char *ptr;
+    char *content = line;
+    char *colon_pos = NULL;
+    int inside_string = 0;
+    size_t label_length = 0;
+    ErrorCode err;
+    int is_valid_file = TRUE;
+
+    set_diagnostic_line(line); /* highlighted operands get their columns */
+    /* trim leading spaces */
+    ptr = advance_to_next_token(line);
 
-            /* extract content after label */
-            content = colon_pos + 1;
-            content = advance_to_next_token(content);
+    /* iterate through the line to find a ':' that is not inside quotes */
+    while (*ptr)
+    {
+        if (*ptr == '"')
+        {
+            inside_string = !inside_string; /* toggle string tracking */
         }
-        else
+        else if (*ptr == ':' && !inside_string)
         {
-            label[0] = '\0';                       /* no label found */
-            content = advance_to_next_token(line); /* No colon found, content is the entire line */
+            colon_pos = ptr;                 /* found a valid label colon */
+            label_length = colon_pos - line; /* set label length */
+            break;
         }
+        ptr++;
+    }
 
-        validate_labels_and_relative_addresses(content, label_table, line_number, &is_valid_file, label);
+    /* we are in a label declaration line */
+    if (colon_pos != NULL)
+    {
+        strncpy(label, line, label_length);
+        label[label_length] = '\0';
 
-        /* check for directives that has been treeted in the first pass*/
-        if (strncmp(content, ".extern", 7) == 0 ||
-            strncmp(content, ".string", 7) == 0 ||
-            strncmp(content, ".data", 5) == 0)
-        {
-            continue; /* Skip these lines */
-        }
-        else if (strncmp(content, ".entry", 6) == 0)
+        /* extract content after label */
+        content = colon_pos + 1;
+        content = advance_to_next_token(content);
+    }
+    else
+    {
+        label[0] = '\0';                       /* no label found */
+        content = advance_to_next_token(line); /* No colon found, content is the entire line */
+    }
+
+    validate_labels_and_relative_addresses(content, label_table, line_number, &is_valid_file, label);
+
+    /* check for directives that has been treeted in the first pass*/
+    if (strncmp(content, ".extern", 7) == 0 ||
+        strncmp(content, ".string", 7) == 0 ||
+        strncmp(content, ".data", 5) == 0)
+    {
+        return is_valid_file; /* Skip these lines */
+    }
+    else if (strncmp(content, ".entry", 6) == 0)
+    {
+        err = is_valid_entry_label(content, label_table); /* also adding "entry" to the label type */
+        if (err != ERROR_SUCCESS)
         {
-            err = is_valid_entry_label(content, label_table); /* also adding "entry" to the label type */
-            if (err != ERROR_SUCCESS)
+            if (err == ERROR_DUPLICATE_ENTRY_LABEL)
             {
-                if (err == ERROR_DUPLICATE_ENTRY_LABEL)
-                {
-                    print_warning(WARNING_REDUNDANT_ENTRY, line_number);
-                }
-                else
-                {
-                    print_error(err, line_number);
-                    is_valid_file = FALSE;
-                }
+                print_warning(WARNING_REDUNDANT_ENTRY, line_number);
             }
-            if (colon_pos != NULL) /* if it was part from a label content */
+            else
             {
-                print_warning(WARNING_LABEL_BEFORE_ENTRY, line_number);
+                print_error(err, line_number);
+                is_valid_file = FALSE;
             }
-            continue;
+        }
+        if (colon_pos != NULL) /* if it was part from a label content */
+        {
+            print_warning(WARNING_LABEL_BEFORE_ENTRY, line_number);
         }
     }
-
     return is_valid_file;
 }
 
@@ -0,0 +1,555 @@
+/* Source_Files/server.c */
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE /* CMSG_SPACE and CMSG_LEN */
+#define _GNU_SOURCE     /* struct ucred, for SO_PEERCRED */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "../Header_Files/server.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+#define REQUEST_MAGIC 0x41534d31UL /* "ASM1" */
+#define MAX_REQUEST_SIZE (1L << 20)
+#define STANDARD_STREAMS 3
+#define SOCKET_NAME "assembler.sock"
+
+/**
+ * @struct RequestHeader
+ * @brief What precedes the payload of a request (client and server share the machine and byte order).
+ */
+typedef struct
+{
+    unsigned long magic;
+    unsigned long size;  /* bytes of the payload: cwd, then every argument, each null terminated */
+    unsigned long umask; /* the client's file creation mask */
+} RequestHeader;
+
+/**
+ * @brief Checks that a directory is ours alone: owned by our uid, with no group or other rights.
+ *
+ * @return TRUE (1) if it is, FALSE (0) otherwise; errno is ENOENT if it does not exist.
+ */
+static int is_private_directory(const char *directory)
+{
+    struct stat st;
+
+    if (lstat(directory, &st) != 0)
+    {
+        return FALSE;
+    }
+    errno = 0;
+    return S_ISDIR(st.st_mode) && st.st_uid == getuid() && (st.st_mode & 077) == 0;
+}
+
+/* Builds the socket path used when none is given, in a directory only we can enter. */
+char *default_socket_path(char *buffer, int create)
+{
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    char directory[SOCKET_PATH_SIZE];
+
+    if (runtime && runtime[0] == '/' && strlen(runtime) + strlen("/" SOCKET_NAME) < SOCKET_PATH_SIZE)
+    {
+        strcpy(directory, runtime);
+    }
+    else
+    {
+        sprintf(directory, "/tmp/assembler-%lu", (unsigned long)getuid());
+        if (create && mkdir(directory, 0700) != 0 && errno != EEXIST)
+        {
+            print_error_no_line(ERROR_SERVER_SOCKET);
+            return NULL;
+        }
+    }
+
+    /* a directory made by another user (or open to one) could hold a socket of theirs */
+    if (!is_private_directory(directory))
+    {
+        if (errno != ENOENT)
+        {
+            print_error_no_line(ERROR_SERVER_UNTRUSTED);
+        }
+        return NULL; /* missing: no server was ever started here */
+    }
+    sprintf(buffer, "%s/%s", directory, SOCKET_NAME);
+    return buffer;
+}
+
+/**
+ * @brief Fills a socket address with a path.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the path is too long.
+ */
+static int make_address(struct sockaddr_un *address, const char *path)
+{
+    if (strlen(path) >= sizeof(address->sun_path))
+    {
+        return FALSE;
+    }
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, path);
+    return TRUE;
+}
+
+/**
+ * @brief Checks that the other end of a connected socket runs as our uid.
+ *
+ * @return TRUE (1) if it does, FALSE (0) if it does not or cannot be told.
+ */
+static int is_peer_trusted(int connection)
+{
+#ifdef SO_PEERCRED
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+
+    if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0 || length != sizeof(credentials))
+    {
+        return FALSE;
+    }
+    return credentials.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+
+    return getpeereid(connection, &uid, &gid) == 0 && uid == getuid();
+#endif
+}
+
+/**
+ * @brief Removes the socket file of a server that is no longer running.
+ *
+ * Anything else at the path (a regular file, or the socket of a server
+ * still accepting connections) is left alone.
+ *
+ * @return TRUE (1) if the path is free for bind, FALSE (0) otherwise.
+ */
+static int remove_stale_socket(const char *path, const struct sockaddr_un *address)
+{
+    struct stat st;
+    int probe, refused;
+
+    if (lstat(path, &st) != 0)
+    {
+        return errno == ENOENT;
+    }
+    if (!S_ISSOCK(st.st_mode))
+    {
+        return FALSE;
+    }
+    probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0)
+    {
+        return FALSE;
+    }
+    refused = connect(probe, (const struct sockaddr *)address, sizeof(*address)) != 0 && errno == ECONNREFUSED;
+    close(probe);
+    return refused && unlink(path) == 0;
+}
+
+/**
+ * @brief Reads exactly size bytes from a socket.
+ *
+ * @return TRUE (1) on success, FALSE (0) on error or end of stream.
+ */
+static int read_fully(int fd, void *data, size_t size)
+{
+    char *bytes = (char *)data;
+    ssize_t count;
+
+    while (size > 0)
+    {
+        count = read(fd, bytes, size);
+        if (count <= 0)
+        {
+            return FALSE;
+        }
+        bytes += count;
+        size -= (size_t)count;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Writes exactly size bytes to a socket.
+ *
+ * @return TRUE (1) on success, FALSE (0) on error.
+ */
+static int write_fully(int fd, const void *data, size_t size)
+{
+    const char *bytes = (const char *)data;
+    ssize_t count;
+
+    while (size > 0)
+    {
+        count = write(fd, bytes, size);
+        if (count <= 0)
+        {
+            return FALSE;
+        }
+        bytes += count;
+        size -= (size_t)count;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Receives the header of a request and the descriptors sent with it.
+ *
+ * @return TRUE (1) if a well formed header and three descriptors arrived, FALSE (0) otherwise.
+ */
+static int receive_header(int connection, RequestHeader *header, int fds[STANDARD_STREAMS])
+{
+    union
+    {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(STANDARD_STREAMS * sizeof(int))];
+    } control;
+    struct msghdr message;
+    struct iovec vector;
+    struct cmsghdr *cmsg;
+    ssize_t count;
+    int received = 0;
+
+    vector.iov_base = header;
+    vector.iov_len = sizeof(*header);
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    count = recvmsg(connection, &message, 0);
+    if (count <= 0)
+    {
+        return FALSE;
+    }
+    for (cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(STANDARD_STREAMS * sizeof(int)))
+        {
+            memcpy(fds, CMSG_DATA(cmsg), STANDARD_STREAMS * sizeof(int));
+            received = TRUE;
+        }
+    }
+    if (!received)
+    {
+        return FALSE;
+    }
+    if ((size_t)count < sizeof(*header) &&
+        !read_fully(connection, (char *)header + count, sizeof(*header) - (size_t)count))
+    {
+        return FALSE;
+    }
+    return header->magic == REQUEST_MAGIC && header->size > 0 && header->size <= MAX_REQUEST_SIZE;
+}
+
+/**
+ * @brief Splits a payload into the working directory and the argument vector.
+ *
+ * @return The malloc'd argument vector (argv[0] is a placeholder), or NULL if the payload is malformed.
+ */
+static char **split_payload(char *payload, size_t size, int *argc)
+{
+    char **argv;
+    size_t i;
+    int count = 0;
+
+    if (payload[size - 1] != '\0')
+    {
+        return NULL;
+    }
+    for (i = 0; i < size; i++)
+    {
+        count += payload[i] == '\0';
+    }
+
+    /* the cwd takes the place of the program name */
+    argv = (char **)malloc((count + 1) * sizeof(char *));
+    if (!argv)
+    {
+        return NULL;
+    }
+    *argc = 0;
+    for (i = 0; i < size; i += strlen(payload + i) + 1)
+    {
+        argv[(*argc)++] = payload + i;
+    }
+    argv[*argc] = NULL;
+    return argv;
+}
+
+/**
+ * @brief Runs one request with the client's descriptors as stdin, stdout and stderr.
+ *
+ * @return The exit status of the request.
+ */
+static int run_request(RequestHandler handler, const RequestHeader *header, char *payload, const int fds[STANDARD_STREAMS])
+{
+    int saved[STANDARD_STREAMS];
+    char **argv;
+    mode_t saved_mask;
+    int i, argc, saved_cwd, status = EXIT_FAILURE;
+
+    argv = split_payload(payload, header->size, &argc);
+    if (!argv)
+    {
+        return EXIT_FAILURE;
+    }
+
+    /* the server's own directory, to return to after the request */
+    saved_cwd = open(".", O_RDONLY);
+    if (saved_cwd < 0)
+    {
+        free(argv);
+        return EXIT_FAILURE;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    for (i = 0; i < STANDARD_STREAMS; i++)
+    {
+        saved[i] = dup(i);
+        dup2(fds[i], i);
+    }
+    clearerr(stdin);
+    saved_mask = umask((mode_t)header->umask);
+
+    /* relative file names are the client's */
+    if (chdir(argv[0]) != 0)
+    {
+        print_error_no_line(ERROR_FILE_READ);
+    }
+    else
+    {
+        status = handler(argc, argv);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    umask(saved_mask);
+    if (fchdir(saved_cwd) != 0)
+    {
+        print_error_no_line(ERROR_FILE_READ);
+    }
+    close(saved_cwd);
+    for (i = 0; i < STANDARD_STREAMS; i++)
+    {
+        if (saved[i] >= 0)
+        {
+            dup2(saved[i], i);
+            close(saved[i]);
+        }
+    }
+    clearerr(stdin);
+    free(argv);
+    return status;
+}
+
+/**
+ * @brief Serves one connection: reads the request, runs it and sends the exit status.
+ */
+static void serve_connection(int connection, RequestHandler handler)
+{
+    RequestHeader header;
+    int fds[STANDARD_STREAMS] = {-1, -1, -1};
+    char *payload = NULL;
+    unsigned char reply;
+    int i, status = EXIT_FAILURE;
+
+    /* requests run with the server's rights: only our own uid may send them */
+    if (!is_peer_trusted(connection))
+    {
+        print_error_no_line(ERROR_SERVER_UNTRUSTED);
+        return;
+    }
+
+    if (receive_header(connection, &header, fds))
+    {
+        payload = (char *)malloc(header.size);
+        if (payload && read_fully(connection, payload, header.size))
+        {
+            status = run_request(handler, &header, payload, fds);
+        }
+    }
+
+    reply = (unsigned char)status;
+    write_fully(connection, &reply, 1); /* a vanished client is not the server's problem */
+
+    free(payload);
+    for (i = 0; i < STANDARD_STREAMS; i++)
+    {
+        if (fds[i] >= 0)
+        {
+            close(fds[i]);
+        }
+    }
+}
+
+/* Listens on a UNIX domain socket and runs the requests of clients, one at a time. */
+int run_server(const char *path, RequestHandler handler)
+{
+    struct sockaddr_un address;
+    mode_t mask;
+    int listener, connection, bound;
+
+    if (!make_address(&address, path))
+    {
+        print_error_no_line(ERROR_INVALID_OPTION_VALUE);
+        return FALSE;
+    }
+
+    /* a closed client must not kill the server on its next write */
+    signal(SIGPIPE, SIG_IGN);
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        print_error_no_line(ERROR_SERVER_SOCKET);
+        return FALSE;
+    }
+    if (!remove_stale_socket(path, &address))
+    {
+        close(listener);
+        print_error_no_line(ERROR_SERVER_SOCKET);
+        return FALSE;
+    }
+
+    /* the socket is created 0600, so no other user can connect in the meantime */
+    mask = umask(0177);
+    bound = bind(listener, (struct sockaddr *)&address, sizeof(address)) == 0;
+    umask(mask);
+    if (!bound || listen(listener, 16) != 0)
+    {
+        close(listener);
+        print_error_no_line(ERROR_SERVER_SOCKET);
+        return FALSE;
+    }
+
+    printf("Serving requests on %s\n", path);
+    fflush(stdout);
+
+    for (;;)
+    {
+        connection = accept(listener, NULL, NULL);
+        if (connection < 0)
+        {
+            continue; /* interrupted, or a client that gave up */
+        }
+        serve_connection(connection, handler);
+        close(connection);
+    }
+}
+
+/* Sends a command line to a running server and waits for its exit status. */
+int run_client(const char *path, int argc, char *argv[], int *status)
+{
+    union
+    {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(STANDARD_STREAMS * sizeof(int))];
+    } control;
+    struct sockaddr_un address;
+    struct msghdr message;
+    struct iovec vector;
+    struct cmsghdr *cmsg;
+    RequestHeader header;
+    int fds[STANDARD_STREAMS] = {0, 1, 2};
+    char cwd[4096];
+    char *payload, *end;
+    unsigned char reply;
+    mode_t mask;
+    size_t size;
+    int i, connection;
+
+    if (!make_address(&address, path) || !getcwd(cwd, sizeof(cwd)))
+    {
+        return FALSE;
+    }
+    connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0)
+    {
+        return FALSE;
+    }
+    if (connect(connection, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(connection);
+        return FALSE; /* no server: the caller assembles locally */
+    }
+
+    /* our streams go to whoever listens: it must be ourselves */
+    if (!is_peer_trusted(connection))
+    {
+        close(connection);
+        print_error_no_line(ERROR_SERVER_UNTRUSTED);
+        return FALSE;
+    }
+
+    /* the payload: cwd, then the arguments, each null terminated */
+    size = strlen(cwd) + 1;
+    for (i = 1; i < argc; i++)
+    {
+        size += strlen(argv[i]) + 1;
+    }
+    payload = (char *)malloc(size);
+    if (!payload || size > MAX_REQUEST_SIZE)
+    {
+        free(payload);
+        close(connection);
+        return FALSE;
+    }
+    end = payload;
+    strcpy(end, cwd);
+    end += strlen(cwd) + 1;
+    for (i = 1; i < argc; i++)
+    {
+        strcpy(end, argv[i]);
+        end += strlen(argv[i]) + 1;
+    }
+
+    mask = umask(0);
+    umask(mask);
+    header.magic = REQUEST_MAGIC;
+    header.size = (unsigned long)size;
+    header.umask = (unsigned long)mask;
+
+    /* the standard streams travel with the header */
+    vector.iov_base = &header;
+    vector.iov_len = sizeof(header);
+    memset(&message, 0, sizeof(message));
+    memset(&control, 0, sizeof(control));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(STANDARD_STREAMS * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    fflush(stdout);
+    fflush(stderr);
+    if (sendmsg(connection, &message, 0) != (ssize_t)sizeof(header) || !write_fully(connection, payload, size))
+    {
+        free(payload);
+        close(connection);
+        return FALSE;
+    }
+    free(payload);
+
+    /* the server writes to our streams directly; only the status comes back */
+    *status = read_fully(connection, &reply, 1) ? reply : EXIT_FAILURE;
+    close(connection);
+    return TRUE;
+}
@@ -0,0 +1,185 @@
+/* Source_Files/source_reader.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../Header_Files/source_reader.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+/**
+ * @brief Reads a whole .as file into memory.
+ *
+ * Any failure leaves the buffer empty, the preprocessor reports it later.
+ */
+static void read_source(const char *name, SourceBuffer *buffer)
+{
+    char path[MAX_FILENAME_LENGTH + 4];
+    struct stat st;
+    ssize_t count;
+    size_t total = 0;
+    int fd;
+
+    buffer->data = NULL;
+    buffer->size = 0;
+
+    if (strlen(name) > MAX_FILENAME_LENGTH - 4)
+    {
+        return;
+    }
+    sprintf(path, "%s.as", name);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+        !(buffer->data = (char *)malloc((size_t)st.st_size)))
+    {
+        close(fd);
+        return;
+    }
+
+    while (total < (size_t)st.st_size)
+    {
+        count = read(fd, buffer->data + total, (size_t)st.st_size - total);
+        if (count < 0)
+        {
+            release_source(buffer);
+            close(fd);
+            return;
+        }
+        if (count == 0)
+        {
+            break; /* the file shrank, keep what is there */
+        }
+        total += (size_t)count;
+    }
+    close(fd);
+
+    buffer->size = total;
+    if (total == 0)
+    {
+        release_source(buffer);
+    }
+}
+
+/**
+ * @brief Reader thread: reads the files in order, at most depth ahead of the assembler.
+ */
+static void *source_reader_thread(void *arg)
+{
+    SourceReader *reader = (SourceReader *)arg;
+    SourceBuffer buffer;
+    int index;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&reader->lock);
+        while (!reader->stopping && reader->next_read - reader->next_taken >= reader->depth)
+        {
+            pthread_cond_wait(&reader->not_full, &reader->lock);
+        }
+        index = reader->next_read;
+        if (reader->stopping || index == reader->file_count)
+        {
+            pthread_mutex_unlock(&reader->lock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&reader->lock);
+
+        /* read outside the lock, the assembler keeps taking earlier files */
+        read_source(reader->files[index], &buffer);
+
+        pthread_mutex_lock(&reader->lock);
+        reader->ring[index % reader->depth] = buffer;
+        reader->next_read++;
+        pthread_cond_signal(&reader->not_empty);
+        pthread_mutex_unlock(&reader->lock);
+    }
+}
+
+/* Starts reading the given files in the background. */
+int start_source_reader(SourceReader *reader, char **files, int file_count, int depth)
+{
+    reader->files = files;
+    reader->file_count = file_count;
+    reader->next_read = 0;
+    reader->next_taken = 0;
+    reader->depth = depth < 1 ? 1 : depth;
+    reader->stopping = FALSE;
+    reader->ring = (SourceBuffer *)calloc(reader->depth, sizeof(SourceBuffer));
+    if (!reader->ring)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->not_full, NULL);
+    pthread_cond_init(&reader->not_empty, NULL);
+
+    if (pthread_create(&reader->thread, NULL, source_reader_thread, reader) != 0)
+    {
+        print_error_no_line(ERROR_THREAD_CREATE);
+        pthread_mutex_destroy(&reader->lock);
+        pthread_cond_destroy(&reader->not_full);
+        pthread_cond_destroy(&reader->not_empty);
+        free(reader->ring);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Takes the next file, in order, waiting until it was read. */
+void next_source(SourceReader *reader, SourceBuffer *buffer)
+{
+    SourceBuffer *slot;
+
+    pthread_mutex_lock(&reader->lock);
+    while (reader->next_taken == reader->next_read)
+    {
+        pthread_cond_wait(&reader->not_empty, &reader->lock);
+    }
+    slot = &reader->ring[reader->next_taken % reader->depth];
+    *buffer = *slot;
+    slot->data = NULL;
+    slot->size = 0;
+    reader->next_taken++;
+    pthread_cond_signal(&reader->not_full);
+    pthread_mutex_unlock(&reader->lock);
+}
+
+/* Frees the bytes of a file taken from a reader. */
+void release_source(SourceBuffer *buffer)
+{
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+}
+
+/* Stops the reader thread and frees whatever it still holds. */
+void stop_source_reader(SourceReader *reader)
+{
+    int i;
+
+    pthread_mutex_lock(&reader->lock);
+    reader->stopping = TRUE;
+    pthread_cond_signal(&reader->not_full);
+    pthread_mutex_unlock(&reader->lock);
+    pthread_join(reader->thread, NULL);
+
+    for (i = 0; i < reader->depth; i++)
+    {
+        release_source(&reader->ring[i]);
+    }
+    free(reader->ring);
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->not_full);
+    pthread_cond_destroy(&reader->not_empty);
+}
@@ -0,0 +1,178 @@
+/* Source_Files/task_pool.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include "../Header_Files/task_pool.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+/**
+ * @brief Worker thread loop: takes tasks from the queue until shutdown.
+ */
+static void *task_pool_worker(void *arg)
+{
+    TaskPool *pool = (TaskPool *)arg;
+    Task *task;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->head && !pool->shutting_down)
+        {
+            pthread_cond_wait(&pool->task_ready, &pool->lock);
+        }
+        if (!pool->head) /* shutting down and nothing left to run */
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+
+        task = pool->head;
+        pool->head = task->next;
+        if (!pool->head)
+        {
+            pool->tail = NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        task->function(task->arg);
+        free(task);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->pending--;
+        if (pool->pending == 0)
+        {
+            pthread_cond_broadcast(&pool->all_done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/* Starts a task pool with the given number of worker threads. */
+int init_task_pool(TaskPool *pool, int thread_count)
+{
+    int i;
+
+    if (thread_count < 1)
+    {
+        thread_count = 1;
+    }
+
+    pool->head = NULL;
+    pool->tail = NULL;
+    pool->pending = 0;
+    pool->shutting_down = FALSE;
+    pool->thread_count = 0;
+    pool->threads = (pthread_t *)malloc(thread_count * sizeof(pthread_t));
+    if (!pool->threads)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->task_ready, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+
+    for (i = 0; i < thread_count; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, task_pool_worker, pool) != 0)
+        {
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    /* a pool with fewer threads than asked still works, one with none does not */
+    if (pool->thread_count == 0)
+    {
+        destroy_task_pool(pool);
+        print_error_no_line(ERROR_THREAD_CREATE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Queues a task at the front or at the back of the queue.
+ */
+static int queue_task(TaskPool *pool, TaskFunction function, void *arg, int urgent)
+{
+    Task *task = (Task *)malloc(sizeof(Task));
+    if (!task)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return FALSE;
+    }
+    task->function = function;
+    task->arg = arg;
+    task->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->head)
+    {
+        pool->head = pool->tail = task;
+    }
+    else if (urgent)
+    {
+        task->next = pool->head;
+        pool->head = task;
+    }
+    else
+    {
+        pool->tail->next = task;
+        pool->tail = task;
+    }
+    pool->pending++;
+    pthread_cond_signal(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+    return TRUE;
+}
+
+/* Queues a task at the back of the queue. */
+int submit_task(TaskPool *pool, TaskFunction function, void *arg)
+{
+    return queue_task(pool, function, arg, FALSE);
+}
+
+/* Queues a task at the front of the queue. */
+int submit_urgent_task(TaskPool *pool, TaskFunction function, void *arg)
+{
+    return queue_task(pool, function, arg, TRUE);
+}
+
+/* Blocks until every queued and running task has finished. */
+void wait_task_pool(TaskPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+    {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Waits for all tasks, stops the worker threads and frees the pool. */
+void destroy_task_pool(TaskPool *pool)
+{
+    int i;
+
+    wait_task_pool(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = TRUE;
+    pthread_cond_broadcast(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->task_ready);
+    pthread_cond_destroy(&pool->all_done);
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->thread_count = 0;
+}
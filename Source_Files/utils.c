@@ -109,23 +109,32 @@ void trim_newline(char *str)
     }
 }
 
+/**
+ * @brief Sets the first count label slots to their empty state.
+ */
+static void clear_labels(LabelTable *label_table, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        memset(label_table->labels[i].name, 0, sizeof(label_table->labels[i].name));
+        memset(label_table->labels[i].type, 0, sizeof(label_table->labels[i].type));
+
+        label_table->labels[i].line_number = 0;
+        label_table->labels[i].address = 100; /* Default starting address */
+    }
+}
+
 /* Initializes the label table. */
 void init_label_table(LabelTable *label_table)
 {
     if (label_table != NULL)
     {
-        int i;
         label_table->count = 0;
 
         /* Initialize all labels */
-        for (i = 0; i < 100; i++)
-        {
-            memset(label_table->labels[i].name, 0, sizeof(label_table->labels[i].name));
-            memset(label_table->labels[i].type, 0, sizeof(label_table->labels[i].type));
-
-            label_table->labels[i].line_number = 0;
-            label_table->labels[i].address = 100; /* Default starting address */
-        }
+        clear_labels(label_table, MAX_LABELS);
     }
     else
     {
@@ -133,6 +142,19 @@ void init_label_table(LabelTable *label_table)
     }
 }
 
+/* Empties an initialized label table, clearing only the slots it used. */
+void reset_label_table(LabelTable *label_table)
+{
+    int used = label_table->count + 1; /* the slot after the last label may hold spill */
+
+    if (used > MAX_LABELS || used < 1)
+    {
+        used = MAX_LABELS;
+    }
+    clear_labels(label_table, used);
+    label_table->count = 0;
+}
+
 /* Initializes the virtual PC. */
 void init_virtual_pc(VirtualPC *vpc)
 {
@@ -141,3 +163,25 @@ void init_virtual_pc(VirtualPC *vpc)
     vpc->IC = 100;                                 /* Initialize IC to 100 */
     vpc->DC = 0;                                   /* Initialize DC to 0 */
 }
+
+/* Empties an initialized virtual PC, clearing only the words below its high-water mark. */
+void reset_virtual_pc(VirtualPC *vpc)
+{
+    uint32_t end = vpc->IC;
+
+    if (vpc->last_adress > 0 && (uint32_t)vpc->last_adress > end)
+    {
+        end = (uint32_t)vpc->last_adress;
+    }
+    if (end > STORAGE_SIZE)
+    {
+        end = STORAGE_SIZE;
+    }
+    if (end > 100)
+    {
+        memset(&vpc->storage[100], 0, (end - 100) * sizeof(Word));
+    }
+    vpc->last_adress = 100;
+    vpc->IC = 100;
+    vpc->DC = 0;
+}
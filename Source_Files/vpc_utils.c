@@ -7,13 +7,14 @@
 #include "../Header_Files/command_utils.h"
 #include "../Header_Files/label_utils.h"
 #include "../Header_Files/structs.h"
+#include "../Header_Files/encode_cache.h"
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* Processes a .data or .string directive and stores the values in the VirtualPC storage. */
-int process_data_or_string_directive(char *ptr, VirtualPC *vpc, int *storage_full)
+/* Encodes the values of a .data or .string directive into consecutive words. */
+int encode_data_or_string(char *ptr, Word *words)
 {
     int count = 0; /* keeps track of stored elements */
     ptr = advance_to_next_token(ptr);
@@ -33,16 +34,11 @@ int process_data_or_string_directive(char *ptr, VirtualPC *vpc, int *storage_ful
             if (ptr == endptr)
                 break;
 
-            if (vpc->DC + vpc->IC < STORAGE_SIZE)
-            {
-                vpc->storage[vpc->last_adress].value = num & 0xFFFFFF; /* store 24-bit value */
-                sprintf(vpc->storage[vpc->last_adress].encoded, "%d", num); /* store as string */
-                vpc->storage[vpc->last_adress].encoded[sizeof(vpc->storage[vpc-> last_adress].encoded) - 1] = '\0'; /* ensure null-termination */
-                vpc->last_adress++;
-            }
-            else
+            if (words)
             {
-                *storage_full = TRUE;
+                words[count].value = num & 0xFFFFFF; /* store 24-bit value */
+                sprintf(words[count].encoded, "%d", num); /* store as string */
+                words[count].encoded[sizeof(words[count].encoded) - 1] = '\0'; /* ensure null-termination */
             }
 
             count++;
@@ -68,51 +64,186 @@ int process_data_or_string_directive(char *ptr, VirtualPC *vpc, int *storage_ful
             /* iterate over characters in the string */
             while (*ptr && *ptr != '"')
             {
-                if (vpc->DC + vpc->IC < STORAGE_SIZE)
+                if (words)
                 {
-                    vpc->storage[vpc->last_adress].value = (int)(*ptr) & 0xFFFFFF; /* store 24-bit character */
-                    sprintf(vpc->storage[vpc->last_adress].encoded, "%c", *ptr);   /* store as string */
-                    vpc->last_adress++;
-                }
-                else
-                {
-                    *storage_full = TRUE;
+                    words[count].value = (int)(*ptr) & 0xFFFFFF; /* store 24-bit character */
+                    sprintf(words[count].encoded, "%c", *ptr);   /* store as string */
                 }
 
                 count++;
                 ptr++;
             }
 
-            if (vpc->DC + vpc->IC < STORAGE_SIZE)
+            if (words)
             {
-                vpc->storage[vpc->last_adress].value = 0; /* store null terminator */
-                vpc->last_adress++;
+                words[count].value = 0; /* store null terminator */
             }
-            else
+
+            count++;
+        }
+    }
+    else if (strncmp(ptr, ".fill", 5) == 0 || strncmp(ptr, ".space", 6) == 0)
+    {
+        long fill_count, value;
+
+        if (parse_fill_directive(ptr, &fill_count, &value) == ERROR_SUCCESS)
+        {
+            for (; words && count < fill_count; count++)
             {
-                *storage_full = TRUE;
+                words[count].value = (int)value & 0xFFFFFF;
+                words[count].encoded[0] = '\0';
             }
+            count = (int)fill_count;
+        }
+    }
+    else if (strncmp(ptr, ".incbin", 7) == 0)
+    {
+        const unsigned char *bytes;
+        const char *data;
+        size_t size, i;
 
-            count++;
+        if (read_incbin_directive(ptr, &data, &size) == ERROR_SUCCESS)
+        {
+            /* 3 bytes to a word, least significant first, as in the .obb image */
+            bytes = (const unsigned char *)data;
+            for (i = 0; words && i < size; i += INCBIN_WORD_BYTES, count++)
+            {
+                words[count].value = bytes[i] |
+                                     (i + 1 < size ? bytes[i + 1] << 8 : 0) |
+                                     (i + 2 < size ? (long)bytes[i + 2] << 16 : 0);
+                words[count].encoded[0] = '\0';
+            }
+            count = (int)((size + INCBIN_WORD_BYTES - 1) / INCBIN_WORD_BYTES);
         }
     }
     return count;
 }
 
-/* Generates words from a command from a valid line of command and stores it in the VirtualPC storage. */
-int process_and_store_command(const char *line, VirtualPC *vpc, int *storage_full)
+/* Processes a .data or .string directive and stores the values in the VirtualPC storage. */
+int process_data_or_string_directive(char *ptr, VirtualPC *vpc, int *storage_full)
+{
+    int count;
+
+    /* DC already holds every data word of the file, so either all values fit or none */
+    if (vpc->DC + vpc->IC < STORAGE_SIZE)
+    {
+        count = encode_data_or_string(ptr, &vpc->storage[vpc->last_adress]);
+        vpc->last_adress += count;
+        return count;
+    }
+    *storage_full = TRUE;
+    return encode_data_or_string(ptr, NULL);
+}
+
+/* Appends encoded data words to the data in the VirtualPC storage. */
+int store_data_words(const Word *words, int count, VirtualPC *vpc, int *storage_full)
+{
+    /* the same rule as process_data_or_string_directive */
+    if (vpc->DC + vpc->IC < STORAGE_SIZE)
+    {
+        memcpy(&vpc->storage[vpc->last_adress], words, count * sizeof(Word));
+        vpc->last_adress += count;
+        return count;
+    }
+    *storage_full = TRUE;
+    return count;
+}
+
+/**
+ * @brief Builds the encoding cache key of a command: its name and, per operand,
+ *        the text of a register or immediate or the addressing mode of a label.
+ *
+ * @param kinds Receives the addressing mode of each operand: 'r', '#', '&' or '$' (direct).
+ * @return TRUE (1) if the key fits in ENCODE_KEY_SIZE, FALSE (0) otherwise.
+ */
+static int normalize_command(const char *command, const char *params[2], int param_count,
+                             char key[ENCODE_KEY_SIZE], char kinds[2])
+{
+    size_t length = strlen(command);
+    const char *text;
+    int i;
+
+    if (length >= ENCODE_KEY_SIZE)
+    {
+        return FALSE;
+    }
+    strcpy(key, command);
+
+    for (i = 0; i < param_count; i++)
+    {
+        /* the same order of checks as process_operand */
+        text = params[i];
+        if (validate_register_operand(params[i]))
+            kinds[i] = 'r';
+        else if (params[i][0] == '#')
+            kinds[i] = '#';
+        else
+        {
+            kinds[i] = params[i][0] == '&' ? '&' : '$';
+            text = kinds[i] == '&' ? "&" : "$"; /* any label: the word is resolved later */
+        }
+
+        if (length + 1 + strlen(text) >= ENCODE_KEY_SIZE)
+        {
+            return FALSE;
+        }
+        key[length++] = i == 0 ? ' ' : ',';
+        strcpy(key + length, text);
+        length += strlen(text);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Sets or clears the label text of the operand words of a command.
+ *
+ * @param params The operand texts, or NULL to clear (for the cached template).
+ * @return The number of words.
+ */
+static int fix_label_words(Word words[MAX_COMMAND_WORDS], const char *params[2], int param_count, const char kinds[2])
+{
+    int i, count = 1;
+
+    for (i = 0; i < param_count; i++)
+    {
+        if (kinds[i] == 'r')
+        {
+            continue; /* a register gives no word */
+        }
+        if (kinds[i] != '#')
+        {
+            memset(words[count].encoded, 0, sizeof(words[count].encoded));
+            if (params)
+            {
+                strncpy(words[count].encoded, params[i], sizeof(words[count].encoded) - 1);
+            }
+        }
+        count++;
+    }
+    return count;
+}
+
+/* Encodes a valid command line into its first word and operand words. */
+int encode_command(const char *line, Word words[MAX_COMMAND_WORDS])
 {
     char command[MAX_LINE_LENGTH];
     char param1[MAX_LINE_LENGTH] = "";
     char param2[MAX_LINE_LENGTH] = "";
     char *modifiable_line;
     char *ptr;
-    int expected_params, i;
+    int expected_params, i, count;
     unsigned int first_word = 0;
     unsigned int second_word = 0;
     unsigned int third_word = 0;
     int param_flags[2] = {0, 0}; /* flags for parameter words */
     int opcode = -1, funct = -1;
+    EncodeCache *cache = get_current_encode_cache();
+    const EncodeCacheEntry *entry;
+    const char *params[2];
+    char kinds[2];
+    char key[ENCODE_KEY_SIZE];
+    Word template_words[MAX_COMMAND_WORDS];
+    int cacheable = FALSE;
 
     /* create modifiable copy of input line */
     modifiable_line = malloc(strlen(line) + 1);
@@ -146,6 +277,22 @@ int process_and_store_command(const char *line, VirtualPC *vpc, int *storage_ful
         sscanf(ptr, "%s", param2); /* read second parameter */
     }
 
+    /* the same command with the same registers and immediates was encoded before */
+    if (cache && expected_params >= 0)
+    {
+        params[0] = param1;
+        params[1] = param2;
+        cacheable = normalize_command(command, params, expected_params, key, kinds);
+        entry = cacheable ? find_encoding(cache, key) : NULL;
+        if (entry)
+        {
+            memcpy(words, entry->words, MAX_COMMAND_WORDS * sizeof(Word));
+            count = fix_label_words(words, params, expected_params, kinds);
+            free(modifiable_line);
+            return count;
+        }
+    }
+
     /* find opcode and funct code */
     for (i = 0; i < RESERVED_COMMANDS_COUNT; i++)
     {
@@ -189,43 +336,65 @@ int process_and_store_command(const char *line, VirtualPC *vpc, int *storage_ful
         first_word |= (funct & 0x1F) << 3; /* mask with 0x1F (11111) and shift left by 3 bits */
     }
 
-    /* store command word in vpc */
-    if (vpc->IC < STORAGE_SIZE)
+    /* the command word */
+    memset(words, 0, MAX_COMMAND_WORDS * sizeof(Word));
+    words[0].value = first_word;
+    strncpy(words[0].encoded, command, sizeof(words[0].encoded) - 1);
+    count = 1;
+
+    /* additional parameter words if needed */
+    if (param_flags[0])
     {
-        vpc->storage[vpc->IC].value = first_word;
-        strncpy(vpc->storage[vpc->IC].encoded, command, sizeof(vpc->storage[vpc->IC].encoded) - 1); 
-        vpc->storage[vpc->IC].encoded[sizeof(vpc->storage[vpc->IC].encoded) - 1] = '\0';
-        vpc->IC++;
-        vpc->last_adress++;
+        words[count].value = second_word;
+        strncpy(words[count].encoded, param1, sizeof(words[count].encoded) - 1); /* Store the first parameter that gave a word */
+        count++;
     }
-    else
+    if (param_flags[1])
     {
-        *storage_full = TRUE;
+        words[count].value = third_word;
+        strncpy(words[count].encoded, param2, sizeof(words[count].encoded) - 1); /* Store the second parameter that gave a word */
+        count++;
     }
 
-    /* store additional parameter words if needed */
-    if (param_flags[0])
+    if (cacheable)
     {
-        if (vpc->IC < STORAGE_SIZE)
-        {
-            vpc->storage[vpc->IC].value = second_word;
-            strncpy(vpc->storage[vpc->IC].encoded, param1, sizeof(vpc->storage[vpc->IC].encoded) - 1); /* Store the first parameter that gave a word */
-            vpc->storage[vpc->IC].encoded[sizeof(vpc->storage[vpc->IC].encoded) - 1] = '\0';
-            vpc->IC++;
-            vpc->last_adress++;
-        }
-        else
-        {
-            *storage_full = TRUE;
-        }
+        memcpy(template_words, words, sizeof(template_words));
+        fix_label_words(template_words, NULL, expected_params, kinds);
+        store_encoding(cache, key, template_words, count);
     }
-    if (param_flags[1])
+
+    free(modifiable_line); 
+    return count;
+}
+
+/* Generates words from a command from a valid line of command and stores it in the VirtualPC storage. */
+int process_and_store_command(const char *line, VirtualPC *vpc, int *storage_full)
+{
+    Word words[MAX_COMMAND_WORDS];
+
+    return store_command_words(words, encode_command(line, words), vpc, storage_full);
+}
+
+/* Appends encoded command words to the code in the VirtualPC storage. */
+int store_command_words(const Word *words, int count, VirtualPC *vpc, int *storage_full)
+{
+    int i;
+
+    /* the whole block fits: one copy */
+    if (vpc->IC + count <= STORAGE_SIZE)
+    {
+        memcpy(&vpc->storage[vpc->IC], words, count * sizeof(Word));
+        vpc->IC += count;
+        vpc->last_adress += count;
+        return count;
+    }
+
+    /* store the words in vpc */
+    for (i = 0; i < count; i++)
     {
         if (vpc->IC < STORAGE_SIZE)
         {
-            vpc->storage[vpc->IC].value = third_word;
-            strncpy(vpc->storage[vpc->IC].encoded, param2, sizeof(vpc->storage[vpc->IC].encoded) - 1); /* Store the second parameter that gave a word */
-            vpc->storage[vpc->IC].encoded[sizeof(vpc->storage[vpc->IC].encoded) - 1] = '\0';
+            vpc->storage[vpc->IC] = words[i];
             vpc->IC++;
             vpc->last_adress++;
         }
@@ -234,9 +403,7 @@ int process_and_store_command(const char *line, VirtualPC *vpc, int *storage_ful
             *storage_full = TRUE;
         }
     }
-
-    free(modifiable_line); 
-    return 1 + param_flags[0] + param_flags[1]; /* return number of stored words */
+    return count; /* return number of stored words */
 }
 
 /* Processes an operand and updates the binary representation in the provided words. */
@@ -0,0 +1,478 @@
+/* Source_Files/watch.c */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "../Header_Files/watch.h"
+#include "../Header_Files/object_cache.h"
+#include "../Header_Files/globals.h"
+#include "../Header_Files/errors.h"
+
+#ifdef __linux__
+
+/**
+ * @struct WatchedDirectory
+ * @brief A directory holding watched sources, with its inotify watch.
+ */
+typedef struct
+{
+    int wd;                              /* inotify watch descriptor */
+    char prefix[MAX_FILENAME_LENGTH];    /* what goes before a file name to form its base name */
+    int whole;                           /* every .as file in it is watched, not only the named ones */
+} WatchedDirectory;
+
+/**
+ * @struct WatchedSource
+ * @brief A source file and the hash of the bytes it was last assembled from.
+ */
+typedef struct
+{
+    char *base;      /* base name, without .as */
+    uint64_t hash;
+    int known;       /* FALSE until hash holds the contents of a readable file */
+    int dirty;       /* an event named the file since it was last looked at */
+} WatchedSource;
+
+/**
+ * @struct Watch
+ * @brief Everything watched, and the inotify instance reporting on it.
+ */
+typedef struct
+{
+    int fd;
+    WatchedDirectory *directories;
+    int directory_count;
+    WatchedSource *sources;
+    int source_count;
+    int source_capacity;
+} Watch;
+
+/**
+ * @brief Hashes the bytes of base.as.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the file could not be read.
+ */
+static int hash_source(const char *base, uint64_t *hash)
+{
+    char path[MAX_FILENAME_LENGTH + 4];
+    struct stat st;
+    void *data;
+    int fd;
+
+    sprintf(path, "%.*s.as", MAX_FILENAME_LENGTH - 1, base);
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return FALSE;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return FALSE;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        *hash = hash_bytes("", 0, 0);
+        return TRUE;
+    }
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return FALSE;
+    }
+    *hash = hash_bytes(data, (size_t)st.st_size, 0);
+    munmap(data, (size_t)st.st_size);
+    return TRUE;
+}
+
+/**
+ * @brief Finds a source by base name, adding it if asked to.
+ *
+ * @return The index of the source, or -1 if it is not watched (or could not be added).
+ */
+static int find_source(Watch *watch, const char *base, int add)
+{
+    WatchedSource *sources;
+    int i;
+
+    for (i = 0; i < watch->source_count; i++)
+    {
+        if (strcmp(watch->sources[i].base, base) == 0)
+        {
+            return i;
+        }
+    }
+    if (!add)
+    {
+        return -1;
+    }
+
+    if (watch->source_count == watch->source_capacity)
+    {
+        sources = (WatchedSource *)realloc(watch->sources, (watch->source_capacity ? watch->source_capacity * 2 : 16) * sizeof(WatchedSource));
+        if (!sources)
+        {
+            print_error_no_line(ERROR_MEMORY_ALLOCATION);
+            return -1;
+        }
+        watch->sources = sources;
+        watch->source_capacity = watch->source_capacity ? watch->source_capacity * 2 : 16;
+    }
+    watch->sources[i].base = strdup(base);
+    if (!watch->sources[i].base)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        return -1;
+    }
+    watch->sources[i].known = FALSE;
+    watch->sources[i].dirty = FALSE;
+    watch->source_count++;
+    return i;
+}
+
+/**
+ * @brief Returns the length of a file name without its .as extension, or 0 if it is not a source.
+ */
+static size_t source_stem_length(const char *name)
+{
+    size_t length = strlen(name);
+
+    if (length > 3 && strcmp(name + length - 3, ".as") == 0)
+    {
+        return length - 3;
+    }
+    return 0;
+}
+
+/**
+ * @brief Forms the base name of a file of a watched directory.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the name is too long.
+ */
+static int make_base(char *base, const WatchedDirectory *directory, const char *name, size_t stem_length)
+{
+    size_t prefix_length = strlen(directory->prefix);
+
+    if (prefix_length + stem_length >= MAX_FILENAME_LENGTH)
+    {
+        return FALSE;
+    }
+    memcpy(base, directory->prefix, prefix_length);
+    memcpy(base + prefix_length, name, stem_length);
+    base[prefix_length + stem_length] = '\0';
+    return TRUE;
+}
+
+/**
+ * @brief Adds every .as file of a directory to the watched sources.
+ */
+static void scan_directory(Watch *watch, const char *path, const WatchedDirectory *directory)
+{
+    char base[MAX_FILENAME_LENGTH];
+    struct dirent *entry;
+    size_t stem_length;
+    DIR *dir;
+
+    dir = opendir(path);
+    if (!dir)
+    {
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL)
+    {
+        stem_length = source_stem_length(entry->d_name);
+        if (stem_length > 0 && make_base(base, directory, entry->d_name, stem_length))
+        {
+            find_source(watch, base, TRUE);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief Starts watching a directory (once, however many paths name it).
+ *
+ * @return The watched directory, or NULL if it could not be watched.
+ */
+static WatchedDirectory *add_directory(Watch *watch, const char *path, const char *prefix, int whole)
+{
+    WatchedDirectory *directories;
+    int i, wd;
+
+    if (strlen(prefix) >= MAX_FILENAME_LENGTH)
+    {
+        return NULL;
+    }
+
+    /* written and closed, renamed into place, or created */
+    wd = inotify_add_watch(watch->fd, path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0)
+    {
+        return NULL;
+    }
+
+    /* the same directory named twice, with the same prefix, is the same entry */
+    for (i = 0; i < watch->directory_count; i++)
+    {
+        if (watch->directories[i].wd == wd && strcmp(watch->directories[i].prefix, prefix) == 0)
+        {
+            watch->directories[i].whole |= whole;
+            return &watch->directories[i];
+        }
+    }
+
+    directories = (WatchedDirectory *)realloc(watch->directories, (watch->directory_count + 1) * sizeof(WatchedDirectory));
+    if (!directories)
+    {
+        return NULL;
+    }
+    watch->directories = directories;
+    directories[watch->directory_count].wd = wd;
+    strcpy(directories[watch->directory_count].prefix, prefix);
+    directories[watch->directory_count].whole = whole;
+    return &directories[watch->directory_count++];
+}
+
+/**
+ * @brief Watches one command line path: a directory, or the base name of a source.
+ *
+ * @return TRUE (1) on success, FALSE (0) if it could not be watched (the error is printed).
+ */
+static int watch_path(Watch *watch, const char *path)
+{
+    char directory_path[MAX_FILENAME_LENGTH];
+    char prefix[MAX_FILENAME_LENGTH];
+    WatchedDirectory *directory;
+    const char *slash;
+    struct stat st;
+    size_t length;
+
+    length = strlen(path);
+    if (length + 2 >= MAX_FILENAME_LENGTH)
+    {
+        print_error_no_line(ERROR_FILENAME_TOO_LONG);
+        return FALSE;
+    }
+
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        sprintf(prefix, "%s%s", path, path[length - 1] == '/' ? "" : "/");
+        directory = add_directory(watch, path, prefix, TRUE);
+        if (!directory)
+        {
+            print_error_no_line(ERROR_WATCH_FAILED);
+            return FALSE;
+        }
+        scan_directory(watch, path, directory);
+        return TRUE;
+    }
+
+    /* a source: watch the directory it lives in, since editors often replace files */
+    slash = strrchr(path, '/');
+    if (slash)
+    {
+        sprintf(directory_path, "%.*s", slash == path ? 1 : (int)(slash - path), path);
+        sprintf(prefix, "%.*s", (int)(slash - path + 1), path);
+    }
+    else
+    {
+        strcpy(directory_path, ".");
+        prefix[0] = '\0';
+    }
+    directory = add_directory(watch, directory_path, prefix, FALSE);
+    if (!directory)
+    {
+        print_error_no_line(ERROR_WATCH_FAILED);
+        return FALSE;
+    }
+    return find_source(watch, path, TRUE) >= 0;
+}
+
+/**
+ * @brief Reads the pending inotify events and marks the sources they name.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the events could not be read.
+ */
+static int read_events(Watch *watch)
+{
+    union
+    {
+        struct inotify_event align;
+        char buffer[16 * (sizeof(struct inotify_event) + 256)];
+    } events;
+    const struct inotify_event *event;
+    char base[MAX_FILENAME_LENGTH];
+    size_t stem_length;
+    ssize_t count;
+    char *next;
+    int i, index;
+
+    count = read(watch->fd, events.buffer, sizeof(events.buffer));
+    if (count <= 0)
+    {
+        return FALSE;
+    }
+    for (next = events.buffer; next < events.buffer + count; next += sizeof(struct inotify_event) + event->len)
+    {
+        event = (const struct inotify_event *)next;
+        stem_length = event->len > 0 ? source_stem_length(event->name) : 0;
+        if (stem_length == 0 || (event->mask & IN_ISDIR))
+        {
+            continue; /* outputs, temporary files and everything else */
+        }
+        for (i = 0; i < watch->directory_count; i++)
+        {
+            if (watch->directories[i].wd == event->wd && make_base(base, &watch->directories[i], event->name, stem_length))
+            {
+                index = find_source(watch, base, watch->directories[i].whole);
+                if (index >= 0)
+                {
+                    watch->sources[index].dirty = TRUE;
+                }
+            }
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Collects the dirty sources whose contents changed since they were last assembled.
+ *
+ * @return The number of files put in batch.
+ */
+static int collect_changes(Watch *watch, char **batch)
+{
+    WatchedSource *source;
+    uint64_t hash;
+    int i, count = 0;
+
+    for (i = 0; i < watch->source_count; i++)
+    {
+        source = &watch->sources[i];
+        if (!source->dirty)
+        {
+            continue;
+        }
+        source->dirty = FALSE;
+        if (!hash_source(source->base, &hash))
+        {
+            source->known = FALSE; /* removed or half written, the next event tells */
+            continue;
+        }
+        if (source->known && source->hash == hash)
+        {
+            continue; /* saved without changes */
+        }
+        source->hash = hash;
+        source->known = TRUE;
+        batch[count++] = source->base;
+    }
+    return count;
+}
+
+/* Assembles the given sources, then again whenever their contents change. */
+int run_watch(char **paths, int count, WatchHandler handler)
+{
+    struct pollfd poller;
+    Watch watch;
+    char **batch = NULL;
+    int i, batch_count;
+
+    memset(&watch, 0, sizeof(watch));
+    watch.fd = inotify_init1(IN_CLOEXEC);
+    if (watch.fd < 0)
+    {
+        print_error_no_line(ERROR_WATCH_FAILED);
+        return FALSE;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (!watch_path(&watch, paths[i]))
+        {
+            close(watch.fd);
+            return FALSE;
+        }
+    }
+
+    /* the first run assembles everything */
+    for (i = 0; i < watch.source_count; i++)
+    {
+        watch.sources[i].known = hash_source(watch.sources[i].base, &watch.sources[i].hash);
+    }
+    batch = (char **)malloc((watch.source_count + 1) * sizeof(char *));
+    if (!batch)
+    {
+        print_error_no_line(ERROR_MEMORY_ALLOCATION);
+        close(watch.fd);
+        return FALSE;
+    }
+    for (i = 0; i < watch.source_count; i++)
+    {
+        batch[i] = watch.sources[i].base;
+    }
+    if (watch.source_count > 0)
+    {
+        handler(batch, watch.source_count);
+    }
+    printf("\nWatching for changes...\n");
+    fflush(stdout);
+
+    poller.fd = watch.fd;
+    poller.events = POLLIN;
+    for (;;)
+    {
+        /* sleep until something happens, then until a burst of events is over */
+        if (poll(&poller, 1, -1) < 0 || !read_events(&watch))
+        {
+            continue;
+        }
+        while (poll(&poller, 1, WATCH_DEBOUNCE_MS) > 0)
+        {
+            read_events(&watch);
+        }
+
+        /* new files in watched directories may have grown the list */
+        free(batch);
+        batch = (char **)malloc((watch.source_count + 1) * sizeof(char *));
+        if (!batch)
+        {
+            print_error_no_line(ERROR_MEMORY_ALLOCATION);
+            close(watch.fd);
+            return FALSE;
+        }
+        batch_count = collect_changes(&watch, batch);
+        if (batch_count > 0)
+        {
+            handler(batch, batch_count);
+            printf("\nWatching for changes...\n");
+            fflush(stdout);
+        }
+    }
+}
+
+#else /* no inotify */
+
+/* Assembles the given sources, then again whenever their contents change. */
+int run_watch(char **paths, int count, WatchHandler handler)
+{
+    (void)paths;
+    (void)count;
+    (void)handler;
+    print_error_no_line(ERROR_WATCH_FAILED);
+    return FALSE;
+}
+
+#endif
@@ -0,0 +1,11 @@
+; args: -MD
+; .fill, .space and .incbin words after the code
+.entry BYTES
+MAIN: lea ONES, r1
+      lea BYTES, r2
+      stop
+ONES: .fill 3, -1
+      .space 2
+BYTES: .incbin "bytes.bin"
+EMPTY: .fill 0, 5
+      .data 9
@@ -0,0 +1,7 @@
+; args: --cache-dir cache -MD
+; runs: 2
+; the second run copies the outputs from the cache and writes the .d file
+.entry MAIN
+MAIN: mov #3, r1
+      prn r1
+      stop
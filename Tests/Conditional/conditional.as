@@ -0,0 +1,31 @@
+; args: -D DEBUG -D LEVEL=3
+; blocks kept or left out by -D symbols and .define/.undef
+.define SIZE 2
+MAIN: mov #1, r1
+.ifdef DEBUG
+      prn r1
+.endif
+.ifndef DEBUG
+      dec r1
+.endif
+.if LEVEL == 1
+      inc r1
+.elif LEVEL >= 3
+      inc r2
+.ifdef SIZE
+      inc r3
+.else
+      inc r4
+.endif
+.else
+      inc r5
+.endif
+.undef SIZE
+.if !SIZE
+      clr r6
+.endif
+.ifdef MISSING
+.include "missing.inc"
+      not a line the assembler could read
+.endif
+      stop
@@ -0,0 +1,8 @@
+; args: -I lib -MD
+; .include found next to the source, in -I lib, and nested
+.include "header.inc"
+MAIN: mov COUNT, r1
+      double r1
+      prn r1
+      stop
+.include "data.inc"
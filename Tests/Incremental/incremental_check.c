@@ -0,0 +1,356 @@
+/* Tests/Incremental/incremental_check.c */
+/*
+ * Checks incremental reassembly against full builds.
+ *
+ *   incremental_check SEED EDITS FILE.am...
+ *
+ * The first file is the starting source; the lines of every file make the
+ * pool new lines are drawn from. Each edit replaces up to three lines at a
+ * random place with up to three lines of the pool, now and then with a
+ * character dropped (so lines also become invalid), and now and then
+ * replaces the whole source. After every edit the source is assembled from
+ * scratch with first_pass, second_pass and fill_addresses_words, and the
+ * diagnostics, result, label table, counters and image must be those of
+ * the incremental state. Exits with EXIT_SUCCESS if every edit agreed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../Header_Files/incremental.h"
+#include "../../Header_Files/first_pass.h"
+#include "../../Header_Files/second_pass.h"
+#include "../../Header_Files/output_builder.h"
+#include "../../Header_Files/preprocessor_utils.h"
+#include "../../Header_Files/utils.h"
+
+#define MAX_POOL_LINES 4096
+#define MAX_SOURCE_LINES 4096
+#define MAX_EDIT_LINES 3
+
+static char pool[MAX_POOL_LINES][MAX_LINE_LENGTH];
+static int pool_count;
+static char source[MAX_SOURCE_LINES][MAX_LINE_LENGTH]; /* the lines, as edited */
+static int source_count;
+
+/**
+ * @brief Appends the lines of a file to the pool, each ending with a newline.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the file could not be read.
+ */
+static int load_pool(const char *path)
+{
+    char line[MAX_LINE_LENGTH];
+    FILE *fp = fopen(path, "r");
+
+    if (!fp)
+    {
+        return FALSE;
+    }
+    while (pool_count < MAX_POOL_LINES && fgets(line, sizeof(line) - 1, fp))
+    {
+        if (line[strlen(line) - 1] != '\n')
+        {
+            strcat(line, "\n");
+        }
+        strcpy(pool[pool_count++], line);
+    }
+    fclose(fp);
+    return TRUE;
+}
+
+/**
+ * @brief Draws a line of the pool, with one character dropped now and then.
+ */
+static void draw_line(char *line)
+{
+    size_t length, position;
+
+    strcpy(line, pool[rand() % pool_count]);
+    length = strlen(line);
+    if (rand() % 5 == 0 && length > 2)
+    {
+        position = (size_t)rand() % (length - 2);
+        memmove(line + position, line + position + 1, length - position);
+    }
+}
+
+/**
+ * @brief Compares the diagnostics of a full build with those of the incremental state.
+ *
+ * @return TRUE (1) if they are the same, in the same order, FALSE (0) otherwise.
+ */
+static int same_diagnostics(const DiagnosticSink *full, const DiagnosticSink *incremental)
+{
+    const Diagnostic *a, *b;
+    int i;
+
+    if (full->history_count != incremental->history_count)
+    {
+        printf("%d diagnostics, %d incrementally\n", full->history_count, incremental->history_count);
+        return FALSE;
+    }
+    for (i = 0; i < full->history_count; i++)
+    {
+        a = &full->history[i];
+        b = &incremental->history[i];
+        if (a->severity != b->severity || a->code != b->code || a->line_number != b->line_number ||
+            a->column_start != b->column_start || a->column_end != b->column_end ||
+            a->has_excerpt != b->has_excerpt || strcmp(a->excerpt, b->excerpt) != 0)
+        {
+            printf("diagnostic %d: code %d at line %d, %d at line %d incrementally\n",
+                   i, a->code, a->line_number, b->code, b->line_number);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Compares a full build with the incremental state.
+ *
+ * @return TRUE (1) if they agree, FALSE (0) after printing the first difference.
+ */
+static int same_build(const IncrementalAssembly *state, int success, const LabelTable *labels, const VirtualPC *vpc)
+{
+    const Label *a, *b;
+    int i, end;
+
+    if (success != state->success)
+    {
+        printf("result %d, %d incrementally\n", success, state->success);
+        return FALSE;
+    }
+    if (labels->count != state->label_table.count)
+    {
+        printf("%d labels, %d incrementally\n", labels->count, state->label_table.count);
+        return FALSE;
+    }
+    for (i = 0; i < labels->count; i++)
+    {
+        a = &labels->labels[i];
+        b = &state->label_table.labels[i];
+        if (strcmp(a->name, b->name) != 0 || a->address != b->address || strcmp(a->type, b->type) != 0 ||
+            a->line_number != b->line_number)
+        {
+            printf("label %d: %s %u %s, %s %u %s incrementally\n", i, a->name, a->address, a->type,
+                   b->name, b->address, b->type);
+            return FALSE;
+        }
+    }
+
+    /* the image only counts for a valid source */
+    if (!success)
+    {
+        return TRUE;
+    }
+    if (vpc->IC != state->vpc->IC || vpc->DC != state->vpc->DC || vpc->last_adress != state->vpc->last_adress)
+    {
+        printf("IC %lu DC %lu, IC %lu DC %lu incrementally\n", (unsigned long)vpc->IC, (unsigned long)vpc->DC,
+               (unsigned long)state->vpc->IC, (unsigned long)state->vpc->DC);
+        return FALSE;
+    }
+    end = (int)vpc->IC > vpc->last_adress ? (int)vpc->IC : vpc->last_adress;
+    for (i = 0; i <= end && i < STORAGE_SIZE; i++)
+    {
+        if (vpc->storage[i].value != state->vpc->storage[i].value ||
+            strcmp(vpc->storage[i].encoded, state->vpc->storage[i].encoded) != 0)
+        {
+            printf("word %d: %d, %d incrementally\n", i, (int)vpc->storage[i].value, (int)state->vpc->storage[i].value);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Assembles the source from scratch, capturing its diagnostics.
+ *
+ * @return TRUE (1) if the source is valid, FALSE (0) otherwise.
+ */
+static int full_build(VirtualPC *vpc, LabelTable *labels, const McroTable *mcros, DiagnosticSink *sink)
+{
+    FILE *fp = tmpfile();
+    int i, success;
+
+    if (!fp)
+    {
+        return FALSE;
+    }
+    for (i = 0; i < source_count; i++)
+    {
+        fputs(source[i], fp);
+    }
+    rewind(fp);
+
+    reset_virtual_pc(vpc);
+    init_label_table(labels);
+    reset_diagnostic_sink(sink, "check", 0);
+    capture_diagnostics(sink);
+    set_current_sink(sink);
+    success = first_pass(fp, vpc, labels, mcros);
+    success = second_pass(fp, labels, vpc) && success;
+    if (success)
+    {
+        fill_addresses_words(fp, labels, vpc);
+    }
+    set_current_sink(NULL);
+    fclose(fp);
+    return success;
+}
+
+/**
+ * @brief Inserts the starting source as the first edit.
+ *
+ * @return TRUE (1) on success, FALSE (0) otherwise.
+ */
+static int insert_source(IncrementalAssembly *state)
+{
+    char *text;
+    size_t length = 0;
+    int i, inserted;
+
+    for (i = 0; i < source_count; i++)
+    {
+        length += strlen(source[i]);
+    }
+    text = (char *)malloc(length + 1);
+    if (!text)
+    {
+        return FALSE;
+    }
+    length = 0;
+    for (i = 0; i < source_count; i++)
+    {
+        strcpy(text + length, source[i]);
+        length += strlen(source[i]);
+    }
+    inserted = edit_incremental(state, 1, 0, text, length);
+    free(text);
+    return inserted;
+}
+
+int main(int argc, char *argv[])
+{
+    static LabelTable labels;
+    static McroTable mcros;
+    IncrementalAssembly state;
+    DiagnosticSink full_sink, incremental_sink;
+    VirtualPC *full_vpc, *incremental_vpc;
+    char lines[MAX_EDIT_LINES][MAX_LINE_LENGTH];
+    char text[MAX_EDIT_LINES * MAX_LINE_LENGTH + 1];
+    int seed, edits, edit, first, removed, added, i, success;
+    size_t length;
+
+    if (argc < 4)
+    {
+        fprintf(stderr, "usage: %s SEED EDITS FILE.am...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    seed = atoi(argv[1]);
+    edits = atoi(argv[2]);
+    for (i = 3; i < argc; i++)
+    {
+        if (!load_pool(argv[i]))
+        {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (i == 3)
+        {
+            source_count = pool_count; /* the first file is the starting source */
+        }
+    }
+    if (pool_count == 0)
+    {
+        fprintf(stderr, "no lines to edit with\n");
+        return EXIT_FAILURE;
+    }
+    memcpy(source, pool, (size_t)source_count * MAX_LINE_LENGTH);
+    srand((unsigned int)seed);
+
+    /* the images are mostly untouched: calloc'd pages stay unmapped */
+    full_vpc = (VirtualPC *)calloc(1, sizeof(VirtualPC));
+    incremental_vpc = (VirtualPC *)calloc(1, sizeof(VirtualPC));
+    if (!full_vpc || !incremental_vpc)
+    {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+    init_mcro_table(&mcros);
+    init_diagnostic_sink(&full_sink);
+    init_diagnostic_sink(&incremental_sink);
+    init_incremental(&state, incremental_vpc, &mcros, "check");
+
+    if (!insert_source(&state))
+    {
+        printf("the starting source could not be inserted\n");
+        return EXIT_FAILURE;
+    }
+
+    for (edit = 0; edit <= edits; edit++)
+    {
+        if (edit > 0)
+        {
+            /* replace up to MAX_EDIT_LINES lines somewhere (or at the end) with new ones */
+            first = rand() % (source_count + 1) + 1;
+            removed = source_count - first + 1;
+            removed = removed > 0 ? rand() % ((removed < MAX_EDIT_LINES ? removed : MAX_EDIT_LINES) + 1) : 0;
+            added = rand() % (MAX_EDIT_LINES + 1);
+            if (rand() % 500 == 0)
+            {
+                first = 1; /* the whole source goes */
+                removed = source_count;
+                added = 0;
+            }
+            if (source_count - removed + added > MAX_SOURCE_LINES)
+            {
+                added = 0;
+            }
+
+            length = 0;
+            for (i = 0; i < added; i++)
+            {
+                draw_line(lines[i]);
+                strcpy(text + length, lines[i]);
+                length += strlen(lines[i]);
+            }
+            if (!edit_incremental(&state, first, removed, text, length))
+            {
+                printf("edit %d could not be applied\n", edit);
+                return EXIT_FAILURE;
+            }
+            memmove(source[first - 1 + added], source[first - 1 + removed],
+                    (size_t)(source_count - (first - 1) - removed) * MAX_LINE_LENGTH);
+            for (i = 0; i < added; i++)
+            {
+                strcpy(source[first - 1 + i], lines[i]);
+            }
+            source_count += added - removed;
+        }
+
+        success = full_build(full_vpc, &labels, &mcros, &full_sink);
+        reset_diagnostic_sink(&incremental_sink, "check", 0);
+        capture_diagnostics(&incremental_sink);
+        set_current_sink(&incremental_sink);
+        report_incremental_diagnostics(&state);
+        set_current_sink(NULL);
+
+        if (!same_diagnostics(&full_sink, &incremental_sink) || !same_build(&state, success, &labels, full_vpc))
+        {
+            printf("seed %d, edit %d: the incremental state differs from a full build of:\n", seed, edit);
+            for (i = 0; i < source_count; i++)
+            {
+                printf("%4d: %s", i + 1, source[i]);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("incremental: seed %d, %d edits agree with full builds\n", seed, edits);
+    free_incremental(&state);
+    destroy_diagnostic_sink(&full_sink);
+    destroy_diagnostic_sink(&incremental_sink);
+    free(full_vpc);
+    free(incremental_vpc);
+    return EXIT_SUCCESS;
+}
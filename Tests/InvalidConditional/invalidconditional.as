@@ -0,0 +1,16 @@
+; args: -D LEVEL=2
+; expect: ERROR_COND_WITHOUT_IF ERROR_COND_AFTER_ELSE ERROR_COND_SYNTAX
+; expect: ERROR_COND_UNTERMINATED
+MAIN: mov #1, r1
+.else                  ; ❌ no .if before it
+.if LEVEL == 2
+      inc r1
+.else
+      dec r1
+.elif LEVEL == 3       ; ❌ after the .else of the same block
+.endif
+.if LEVEL =< 2         ; ❌ not a comparison operator
+      inc r2
+.endif
+.ifdef LEVEL           ; ❌ never closed
+      stop
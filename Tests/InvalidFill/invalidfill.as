@@ -0,0 +1,8 @@
+; expect: ERROR_INVALID_FILL ERROR_INVALID_DATA_TOO_LARGE
+MAIN: stop
+A: .fill 2097153, 1       ; ❌ more words than the image holds
+B: .fill 2, 8388608       ; ❌ value out of the range of .data
+C: .fill 4                ; ❌ no value
+D: .space -1              ; ❌ negative count
+E: .space 3, 0            ; ❌ .space takes no value
+F: .fill 2, 1
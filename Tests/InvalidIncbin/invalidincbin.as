@@ -0,0 +1,5 @@
+; expect: ERROR_INCLUDE_NOT_FOUND ERROR_INCBIN_SYNTAX
+MAIN: stop
+A: .incbin "missing.bin"   ; ❌ no such file
+B: .incbin missing.bin     ; ❌ the name is not quoted
+C: .data 1
@@ -0,0 +1,6 @@
+; args: -MD
+; expect: ERROR_INCLUDE_CYCLE ERROR_INCLUDE_NOT_FOUND
+MAIN: prn #1
+.include "first.inc"       ; ❌ second.inc includes first.inc back
+.include "missing.inc"     ; ❌ no such file
+      stop
@@ -0,0 +1,16 @@
+; expect: ERROR_MCRO_INVALID_PARAM ERROR_MCRO_ARG_COUNT
+; expect: ERROR_MACRO_CALL_EXTRA_TEXT
+mcro load src, dst
+    mov src, dst
+mcroend
+mcro show
+    prn #1
+mcroend
+mcro bad r1, x      ; ❌ a register as a parameter
+    inc x
+mcroend
+      load r1             ; ❌ one argument for two parameters
+      load r1, r2, r3     ; ❌ three arguments for two parameters
+      show r4             ; ❌ an argument for a macro without parameters
+      load r1, r2
+      stop
@@ -0,0 +1,7 @@
+; args: --mlib tools.mlib
+; expect: ERROR_MCRO_ARG_COUNT ERROR_MACRO_CALL_EXTRA_TEXT
+MAIN: mov #1, r1
+      swap r1, r2           ; ❌ two arguments for three parameters
+      swap r1, r2, r3, r4   ; ❌ four arguments for three parameters
+      finish now            ; ❌ an argument for a macro without parameters
+      finish
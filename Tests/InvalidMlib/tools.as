@@ -0,0 +1,10 @@
+; a macro library
+mcro swap a, b, tmp
+    mov a, tmp
+    mov b, a
+    mov tmp, b
+mcroend
+
+mcro finish
+    stop
+mcroend
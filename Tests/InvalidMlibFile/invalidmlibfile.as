@@ -0,0 +1,7 @@
+; args: --mlib misaligned.mlib
+; expect: ERROR_MLIB_INVALID
+; misaligned.mlib is a compiled library whose macro table offset was moved
+; by one byte: it is rejected when mapped, before any source is read
+MAIN: mov #1, r1
+      swap r1, r2, r3
+      finish
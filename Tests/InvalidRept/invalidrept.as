@@ -0,0 +1,13 @@
+; expect: ERROR_INVALID_DIRECT_FIRST_OPERAND ERROR_LABEL_DUPLICATE
+; expect: ERROR_UNDEFINED_LABEL_RELATIVE
+; errors in a .rept body are reported once, at the line of the body
+MAIN: prn #1
+.rept 2
+; ❌ immediate source operand for lea
+    lea #5, r1
+; ❌ the label is defined again by the second iteration
+IN: inc r2
+; ❌ distance to an undefined label
+    jmp &NOWHERE
+.endr
+      stop
@@ -0,0 +1,13 @@
+; expect: ERROR_REPT_SYNTAX ERROR_REPT_NESTED ERROR_ENDR_WITHOUT_REPT
+; expect: ERROR_REPT_UNTERMINATED
+MAIN: prn #1
+.rept 100001          ; ❌ more than 100000 repetitions
+.endr
+.rept 2
+    inc r1
+.rept 2               ; ❌ blocks do not nest
+    inc r2
+.endr
+.endr                 ; ❌ its block was closed by the .endr before
+.rept 3               ; ❌ never closed
+      stop
@@ -0,0 +1,25 @@
+; Parameterized macros: every whole parameter name in the body is replaced
+.entry MAIN
+.extern PRINT
+mcro load src, dst
+    mov src, dst
+    add #1, dst
+mcroend
+mcro twice reg
+    inc reg
+    inc reg
+mcroend
+mcro show
+    prn STR
+mcroend
+MAIN: prn #0
+      load r1, r2
+      load #5, r3
+      load r1, r2
+      twice r4
+      load COUNT, r5
+      show
+      jsr PRINT
+      stop
+STR: .string "src dst"
+COUNT: .data 7
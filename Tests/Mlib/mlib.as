@@ -0,0 +1,11 @@
+; args: --mlib shapes.mlib
+; library macros, and a macro of the file taking precedence over one
+mcro bump reg
+    add #2, reg
+mcroend
+MAIN: mov #1, r1
+      mov #2, r2
+      swap r1, r2, r3
+      bump r1
+      prn r1
+      finish
@@ -0,0 +1,14 @@
+; a macro library: only macro definitions, comments and blank lines
+mcro swap a, b, tmp
+    mov a, tmp
+    mov b, a
+    mov tmp, b
+mcroend
+
+mcro bump reg
+    inc reg
+mcroend
+
+mcro finish
+    stop
+mcroend
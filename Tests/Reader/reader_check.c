@@ -0,0 +1,277 @@
+/* Tests/Reader/reader_check.c */
+/*
+ * Checks the mapped readers of output_reader.c against a plain stdio parse.
+ *
+ *   reader_check TEMP FILE...
+ *
+ * Every FILE.ob is read with next_object_word and, line by line, with fgets
+ * and sscanf as the tools did before the readers; every FILE.ent or FILE.ext
+ * with next_symbol and the same way. Both must give the same counts,
+ * addresses, words and symbols, and the reader must reach the end without an
+ * error. Each .ob is then written to TEMP with its lines spelled differently
+ * (addresses without leading zeros, words in upper case, blanks and CRLF),
+ * which the byte-by-byte path must read to the same words, and written again
+ * cut in the address of its last line, which must be an error. Exits with
+ * EXIT_SUCCESS if every file agreed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../Header_Files/output_reader.h"
+#include "../../Header_Files/globals.h"
+
+/**
+ * @struct ParsedObject
+ * @brief A .ob file as the stdio parse reads it.
+ */
+typedef struct
+{
+    int code_words;
+    int data_words;
+    unsigned int *addresses;
+    unsigned int *words;
+} ParsedObject;
+
+/**
+ * @brief Reads a .ob file with fgets and sscanf.
+ *
+ * @return TRUE (1) on success, FALSE (0) if the file could not be read or is malformed.
+ */
+static int parse_object(const char *path, ParsedObject *object)
+{
+    char line[MAX_LINE_LENGTH];
+    FILE *fp = fopen(path, "r");
+    int i;
+
+    object->addresses = NULL;
+    object->words = NULL;
+    if (!fp)
+    {
+        return FALSE;
+    }
+    if (!fgets(line, sizeof(line), fp) || sscanf(line, "%d %d", &object->code_words, &object->data_words) != 2)
+    {
+        fclose(fp);
+        return FALSE;
+    }
+    object->addresses = (unsigned int *)malloc((object->code_words + object->data_words + 1) * sizeof(unsigned int));
+    object->words = (unsigned int *)malloc((object->code_words + object->data_words + 1) * sizeof(unsigned int));
+    if (!object->addresses || !object->words)
+    {
+        fclose(fp);
+        return FALSE;
+    }
+    for (i = 0; i < object->code_words + object->data_words; i++)
+    {
+        if (!fgets(line, sizeof(line), fp) || sscanf(line, "%u %x", &object->addresses[i], &object->words[i]) != 2)
+        {
+            fclose(fp);
+            return FALSE;
+        }
+    }
+    fclose(fp);
+    return TRUE;
+}
+
+/**
+ * @brief Reads a .ob file with the object reader and compares it with the stdio parse.
+ *
+ * @return TRUE (1) if both read the same words, FALSE (0) otherwise (the difference is printed).
+ */
+static int same_object(const char *path, const char *shown, const ParsedObject *object)
+{
+    ObjectReader reader;
+    uint32_t address;
+    Word word;
+    int i = 0;
+
+    if (!open_object_reader(path, &reader))
+    {
+        printf("%s: the reader could not open it\n", shown);
+        return FALSE;
+    }
+    if ((int)reader.code_words != object->code_words || (int)reader.data_words != object->data_words)
+    {
+        printf("%s: the reader read %u %u words, the stdio parse %d %d\n", shown,
+               (unsigned int)reader.code_words, (unsigned int)reader.data_words, object->code_words, object->data_words);
+        close_object_reader(&reader);
+        return FALSE;
+    }
+    while (next_object_word(&reader, &address, &word))
+    {
+        if (i >= object->code_words + object->data_words || address != object->addresses[i] ||
+            ((unsigned int)word.value & 0xFFFFFF) != object->words[i])
+        {
+            printf("%s: word %d differs\n", shown, i);
+            close_object_reader(&reader);
+            return FALSE;
+        }
+        i++;
+    }
+    if (reader.text.error || i != object->code_words + object->data_words)
+    {
+        printf("%s: the reader stopped at word %d (line %d)\n", shown, i, reader.text.line_number);
+        close_object_reader(&reader);
+        return FALSE;
+    }
+    close_object_reader(&reader);
+    return TRUE;
+}
+
+/**
+ * @brief Writes a parsed .ob file to temp, respelled or cut in its last line.
+ *
+ * @return TRUE (1) on success, FALSE (0) if temp could not be written.
+ */
+static int write_variant(const char *temp, const ParsedObject *object, int cut)
+{
+    FILE *fp = fopen(temp, "w");
+    int i, count = object->code_words + object->data_words;
+
+    if (!fp)
+    {
+        return FALSE;
+    }
+    fprintf(fp, " %d\t%d \r\n", object->code_words, object->data_words);
+    for (i = 0; i < count; i++)
+    {
+        if (cut && i == count - 1)
+        {
+            fprintf(fp, "%.3s", "0000000"); /* only part of the address */
+            break;
+        }
+        fprintf(fp, "\t%u  %X \r\n", object->addresses[i], object->words[i]);
+    }
+    return fclose(fp) == 0;
+}
+
+/**
+ * @brief Checks a .ob file, as written and in the variants written to temp.
+ *
+ * @return TRUE (1) if every check passed, FALSE (0) otherwise.
+ */
+static int check_object(const char *path, const char *temp)
+{
+    ParsedObject object;
+    ObjectReader reader;
+    uint32_t address;
+    Word word;
+    char shown[MAX_LINE_LENGTH + 16];
+    int result;
+
+    if (!parse_object(path, &object))
+    {
+        printf("%s: the stdio parse could not read it\n", path);
+        free(object.addresses);
+        free(object.words);
+        return FALSE;
+    }
+    result = same_object(path, path, &object);
+
+    sprintf(shown, "%.*s (respelled)", MAX_LINE_LENGTH, path);
+    if (result && !(write_variant(temp, &object, FALSE) && same_object(temp, shown, &object)))
+    {
+        result = FALSE;
+    }
+
+    /* a cut last line is an error, not a shorter image */
+    if (result && object.code_words + object.data_words > 0 && write_variant(temp, &object, TRUE))
+    {
+        if (open_object_reader(temp, &reader))
+        {
+            while (next_object_word(&reader, &address, &word))
+            {
+            }
+            if (!reader.text.error)
+            {
+                printf("%s (cut): the reader did not report the cut line\n", path);
+                result = FALSE;
+            }
+            close_object_reader(&reader);
+        }
+    }
+
+    remove(temp);
+    free(object.addresses);
+    free(object.words);
+    return result;
+}
+
+/**
+ * @brief Reads a .ent or .ext file with the symbol reader and with fgets and sscanf.
+ *
+ * @return TRUE (1) if both read the same symbols, FALSE (0) otherwise.
+ */
+static int check_symbols(const char *path, SymbolFileKind kind)
+{
+    char line[MAX_LINE_LENGTH];
+    char name[MAX_LINE_LENGTH];
+    unsigned int address;
+    SymbolReader reader;
+    Label label;
+    FILE *fp = fopen(path, "r");
+    int i = 0, result = TRUE;
+
+    if (!fp || !open_symbol_reader(path, kind, &reader))
+    {
+        printf("%s: could not be opened\n", path);
+        if (fp)
+        {
+            fclose(fp);
+        }
+        return FALSE;
+    }
+    while (result && fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "%s %u", name, &address) != 2 || !next_symbol(&reader, &label) ||
+            strcmp(label.name, name) != 0 || label.address != address)
+        {
+            printf("%s: symbol %d differs\n", path, i);
+            result = FALSE;
+        }
+        i++;
+    }
+    if (result && (next_symbol(&reader, &label) || reader.text.error))
+    {
+        printf("%s: the reader did not stop after symbol %d\n", path, i);
+        result = FALSE;
+    }
+    fclose(fp);
+    close_symbol_reader(&reader);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *extension;
+    int i, result = TRUE;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s TEMP FILE...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (i = 2; i < argc; i++)
+    {
+        extension = strrchr(argv[i], '.');
+        if (extension && strcmp(extension, ".ob") == 0)
+        {
+            result &= check_object(argv[i], argv[1]);
+        }
+        else if (extension && (strcmp(extension, ".ent") == 0 || strcmp(extension, ".ext") == 0))
+        {
+            result &= check_symbols(argv[i], strcmp(extension, ".ent") == 0 ? SYMBOLS_ENTRY : SYMBOLS_EXTERNAL);
+        }
+        else
+        {
+            fprintf(stderr, "%s: not a .ob, .ent or .ext file\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!result)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("reader: %d files read as the stdio parse reads them\n", argc - 2);
+    return EXIT_SUCCESS;
+}
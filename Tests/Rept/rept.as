@@ -0,0 +1,23 @@
+; .rept blocks: label operands and &label distances resolved per iteration
+.entry LOOP
+.extern OUT
+mcro twice reg
+    inc reg
+    inc reg
+mcroend
+MAIN: clr r3
+LOOP: prn r3
+.rept 3
+    add #1, r3
+    jmp &LOOP
+    twice r2
+    mov TABLE, OUT
+.endr
+.rept 0
+    stop
+.endr
+      stop
+TABLE: .data 1
+.rept 2
+    .data 7, -7
+.endr
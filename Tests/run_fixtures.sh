@@ -0,0 +1,190 @@
+#!/bin/sh
+# Tests/run_fixtures.sh
+#
+# Assembles every fixture Tests/<Name>/<name>.as (the directory name in lower
+# case) in a scratch copy of its directory and compares the outputs with the
+# files committed next to it:
+#
+#   - the .am, .ob, .ent, .ext and .d files written must be exactly the ones
+#     committed, with the same bytes;
+#   - a fixture with a committed .ob must assemble; one without is invalid,
+#     and writing no .ob is what tells it failed (a file that fails in the
+#     preprocessor does not change the exit status).
+#
+# The first lines of the .as file may say how to run it:
+#
+#   ; args: OPTIONS      options for the command line (-I, -D, -MD, --mlib ...)
+#   ; expect: CODE...    diagnostic codes the run must report (may be repeated,
+#                        as a line holds at most 80 characters)
+#   ; runs: N            assemble N times in the same directory (e.g. to hit
+#                        --cache-dir), checking the outputs after every run
+#
+# Every library named by --mlib FILE.mlib is compiled from FILE.as first; a
+# .mlib committed without its source (a damaged library) is used as it is.
+#
+# A valid fixture is then assembled again with --binary and --compress:
+# --obb-to-text must turn the .obb back into the committed .ob, .ent and
+# .ext, and --expand the .obz back into the committed .ob.
+#
+# A directory without <name>.as holds damaged objects: converting each
+# FILE.obb with --obb-to-text must fail with ERROR_BINARY_FILE_INVALID, and
+# expanding each FILE.obz with --expand with ERROR_FILE_READ (not a crash),
+# leaving the directory as it was (a FILE.ob next to it included).
+#
+#   run_fixtures.sh ASSEMBLER TESTS_DIR
+
+assembler=$1
+tests=$2
+if [ -z "$assembler" ] || [ -z "$tests" ]; then
+    echo "usage: $0 ASSEMBLER TESTS_DIR" >&2
+    exit 1
+fi
+case $assembler in
+    /*) ;;
+    *) assembler=$(pwd)/$assembler ;;
+esac
+
+scratch=$(mktemp -d) || exit 1
+trap 'rm -rf "$scratch"' EXIT
+passed=0
+failed=0
+
+# compare_outputs LABEL EXT...: the outputs written in $work against $dir
+compare_outputs() {
+    label=$1
+    shift
+    for ext in "$@"; do
+        if [ -f "$dir/$name.$ext" ] && [ ! -f "$work/$name.$ext" ]; then
+            echo "$label: $name.$ext was not written"
+            ok=0
+        elif [ ! -f "$dir/$name.$ext" ] && [ -f "$work/$name.$ext" ]; then
+            echo "$label: $name.$ext was written"
+            ok=0
+        elif [ -f "$dir/$name.$ext" ] && ! cmp -s "$dir/$name.$ext" "$work/$name.$ext"; then
+            echo "$label: $name.$ext differs:"
+            diff "$dir/$name.$ext" "$work/$name.$ext" | head -20
+            ok=0
+        fi
+    done
+}
+
+# check_damaged OPTION CODE FILE: converting a damaged object must fail cleanly
+check_damaged() {
+    object=$(basename "$3")
+    rm -rf "$work"
+    cp -R "$dir" "$work"
+    (cd "$work" && "$assembler" --diagnostics-format=jsonl $1 "${object%.*}" >/dev/null 2>"$scratch/$fixture.log")
+    status=$?
+    if [ $status -eq 0 ]; then
+        echo "$fixture: $object was converted"
+        ok=0
+    elif [ $status -gt 128 ]; then
+        echo "$fixture: $object crashed the assembler"
+        ok=0
+    elif ! grep -q "\"code\":\"$2\"" "$scratch/$fixture.log"; then
+        echo "$fixture: $object did not report $2"
+        ok=0
+    fi
+    if ! diff -r "$dir" "$work" >/dev/null; then
+        echo "$fixture: converting $object changed the directory"
+        ok=0
+    fi
+}
+
+for dir in "$tests"/*/; do
+    fixture=$(basename "$dir")
+    name=$(echo "$fixture" | tr 'A-Z' 'a-z')
+    work=$scratch/$fixture
+
+    if [ ! -f "$dir/$name.as" ]; then
+        ok=1
+        found=0
+        for object in "$dir"/*.obb; do
+            [ -f "$object" ] || continue
+            found=1
+            check_damaged --obb-to-text ERROR_BINARY_FILE_INVALID "$object"
+        done
+        for object in "$dir"/*.obz; do
+            [ -f "$object" ] || continue
+            found=1
+            check_damaged --expand ERROR_FILE_READ "$object"
+        done
+        [ $found -eq 1 ] || continue
+        if [ $ok -eq 1 ]; then
+            passed=$((passed + 1))
+        else
+            failed=$((failed + 1))
+        fi
+        continue
+    fi
+
+    cp -R "$dir" "$work"
+    args=$(sed -n 's/^; args: *//p' "$dir/$name.as")
+    expect=$(sed -n 's/^; expect: *//p' "$dir/$name.as")
+    runs=$(sed -n 's/^; runs: *//p' "$dir/$name.as")
+    runs=${runs:-1}
+
+    ok=1
+    set -- $args
+    while [ $# -gt 0 ]; do
+        if [ "$1" = "--mlib" ] && [ $# -gt 1 ] && [ -f "$work/${2%.mlib}.as" ]; then
+            (cd "$work" && "$assembler" --compile-mlib "${2%.mlib}" >/dev/null 2>&1) || {
+                echo "$fixture: the library ${2%.mlib}.as does not compile"
+                ok=0
+            }
+        fi
+        shift
+    done
+
+    run=1
+    while [ $run -le $runs ]; do
+        label=$fixture
+        [ $runs -gt 1 ] && label="$fixture (run $run)"
+        for ext in am ob ent ext d; do
+            rm -f "$work/$name.$ext"
+        done
+        (cd "$work" && "$assembler" --diagnostics-format=jsonl $args "$name" >/dev/null 2>"$scratch/$fixture.log")
+        status=$?
+        if [ -f "$dir/$name.ob" ] && [ $status -ne 0 ]; then
+            echo "$label: failed to assemble:"
+            cat "$scratch/$fixture.log"
+            ok=0
+        fi
+        for code in $expect; do
+            if ! grep -q "\"code\":\"$code\"" "$scratch/$fixture.log"; then
+                echo "$label: $code was not reported"
+                ok=0
+            fi
+        done
+        compare_outputs "$label" am ob ent ext d
+        run=$((run + 1))
+    done
+
+    # the binary and compressed objects hold the same image and symbols as the text outputs
+    if [ -f "$dir/$name.ob" ]; then
+        (cd "$work" && "$assembler" $args --binary --compress "$name" >/dev/null 2>&1)
+        rm -f "$work/$name.ob" "$work/$name.ent" "$work/$name.ext"
+        if ! (cd "$work" && "$assembler" --obb-to-text "$name" >/dev/null 2>"$scratch/$fixture.log"); then
+            echo "$fixture (--obb-to-text): failed:"
+            cat "$scratch/$fixture.log"
+            ok=0
+        fi
+        compare_outputs "$fixture (--obb-to-text)" ob ent ext
+        rm -f "$work/$name.ob"
+        if ! (cd "$work" && "$assembler" --expand "$name" >/dev/null 2>"$scratch/$fixture.log"); then
+            echo "$fixture (--expand): failed:"
+            cat "$scratch/$fixture.log"
+            ok=0
+        fi
+        compare_outputs "$fixture (--expand)" ob
+    fi
+
+    if [ $ok -eq 1 ]; then
+        passed=$((passed + 1))
+    else
+        failed=$((failed + 1))
+    fi
+done
+
+echo "fixtures: $passed passed, $failed failed"
+[ $failed -eq 0 ]